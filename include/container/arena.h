@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <memory>
+#include <memory_resource>
+
+namespace nemo {
+
+/**
+ * @brief 单调递增的内存池
+ * @details 基于std::pmr::monotonic_buffer_resource, 先使用内联的初始内存块,
+ *          用完后向上游申请更大的内存块. 释放单个对象不做任何事情,
+ *          所有内存在reset()时一次性归还, 适合生命周期相同的一批小对象
+ * @tparam InitialSize 内联初始内存块的大小
+ */
+template<size_t InitialSize>
+class Arena : public std::pmr::memory_resource {
+public:
+    typedef std::shared_ptr<Arena> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<Arena> UniquePtr; ///< 智能指针定义
+
+    /**
+     * @brief 构造函数
+     * @param[in] upstream 初始内存块用完后使用的上游内存资源
+     */
+    explicit Arena(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) :
+        resource_(initial_, InitialSize, upstream) {
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * @brief 归还所有内存, 之后的分配重新从初始内存块开始
+     * @attention 调用之前必须保证从这里分配的对象都已经析构
+     */
+    void reset() {
+        resource_.release();
+        allocCount_ = 0;
+        allocBytes_ = 0;
+    }
+
+    /**
+     * @brief 上次reset之后的分配次数
+     */
+    size_t getAllocCount() const { return allocCount_; }
+
+    /**
+     * @brief 上次reset之后分配的字节数
+     */
+    size_t getAllocBytes() const { return allocBytes_; }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        ++allocCount_;
+        allocBytes_ += bytes;
+        return resource_.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        static_cast<void>(p);
+        static_cast<void>(bytes);
+        static_cast<void>(alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+private:
+    alignas(std::max_align_t) char initial_[InitialSize];
+    std::pmr::monotonic_buffer_resource resource_;
+    size_t allocCount_{0};
+    size_t allocBytes_{0};
+};
+
+} // namespace nemo
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "common/noncopyable.h"
+
+namespace nemo {
+
+/**
+ * @brief 基于epoch的延迟回收(RCU风格)
+ * @details 写者发布新的数据后调用retire()交出旧数据, 旧数据在所有可能还在读它的
+ *          读者离开临界区之后才会被释放. 读者进出临界区只有普通的原子读写和内存屏障,
+ *          没有原子读改写操作, 也不会被写者阻塞.
+ *          读者以Reader为单位注册(例如每个连接一个), 注册和注销需要加锁.
+ *          频繁创建读者的场景(每个连接, 每次唤醒)通过ReaderLease从线程缓存中借用已经注册的读者
+ */
+class EpochDomain : Noncopyable {
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0}; ///< 进入临界区时的epoch, 0表示不在临界区
+        bool used = false;
+    };
+
+public:
+    typedef std::shared_ptr<EpochDomain> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<EpochDomain> UniquePtr; ///< 智能指针定义
+
+    /**
+     * @brief 读者, 同一时间只能被一个协程使用, 不支持嵌套进入
+     */
+    class Reader : Noncopyable {
+    public:
+        explicit Reader(EpochDomain* domain);
+        ~Reader();
+
+        /**
+         * @brief 进入临界区, 之后读到的数据在exit()之前不会被释放
+         */
+        void enter() {
+            uint64_t epoch = domain_->epoch_.load(std::memory_order_acquire);
+            slot_->epoch.store(epoch, std::memory_order_relaxed);
+            //保证写者扫描时要么看到这个读者, 要么读者读到写者发布的新数据
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        /**
+         * @brief 离开临界区
+         */
+        void exit() {
+            slot_->epoch.store(0, std::memory_order_release);
+        }
+
+        bool isActive() const {
+            return slot_->epoch.load(std::memory_order_relaxed) != 0;
+        }
+
+    private:
+        EpochDomain* domain_;
+        Slot* slot_;
+    };
+
+    /**
+     * @brief 借用一个已经注册的读者, 析构时归还
+     * @details 优先从当前线程的缓存中取, 不加锁也不扫描槽位.
+     *          借用期间只能被一个协程使用, 协程切换线程后归还到新线程的缓存中
+     */
+    class ReaderLease : Noncopyable {
+    public:
+        explicit ReaderLease(EpochDomain* domain) : domain_(domain), reader_(domain->acquire()) {}
+        ~ReaderLease() { domain_->release(reader_); }
+
+        Reader& get() { return *reader_; }
+
+    private:
+        EpochDomain* domain_;
+        Reader* reader_;
+    };
+
+    /**
+     * @brief 读者临界区的RAII封装
+     */
+    class Guard : Noncopyable {
+    public:
+        explicit Guard(Reader& reader) : reader_(reader) { reader_.enter(); }
+        ~Guard() { reader_.exit(); }
+
+    private:
+        Reader& reader_;
+    };
+
+public:
+    EpochDomain();
+
+    /**
+     * @brief 析构函数, 释放所有待回收的数据
+     * @attention 调用者需要保证已经没有读者
+     */
+    ~EpochDomain();
+
+    /**
+     * @brief 交出已经被替换下来的数据, 等到安全时调用deleter释放
+     * @attention 必须先发布新的数据, 再调用retire
+     */
+    void retire(const void* ptr, void (*deleter)(const void*));
+
+    template<typename T>
+    void retire(const T* ptr) {
+        retire(ptr, [](const void* p) { delete static_cast<const T*>(p); });
+    }
+
+    /**
+     * @brief 释放已经没有读者的数据
+     * @return 释放的个数
+     */
+    size_t reclaim();
+
+    /**
+     * @brief 还没有释放的数据个数
+     */
+    size_t getRetiredCount() const;
+
+    /**
+     * @brief 借出一个读者, 没有空闲的读者时注册一个新的
+     * @attention 必须通过release()归还, 一般使用ReaderLease
+     */
+    Reader* acquire();
+
+    /**
+     * @brief 归还acquire()借出的读者, 读者必须已经离开临界区
+     */
+    void release(Reader* reader);
+
+private:
+    size_t reclaimUnsafe();
+
+private:
+    struct Retired {
+        uint64_t epoch;                 ///< 交出时的epoch, 在此之后进入的读者看不到它
+        const void* ptr;
+        void (*deleter)(const void*);
+    };
+
+    const uint64_t id_;                         ///< 进程内唯一, 不复用, 用来识别线程缓存属于哪个域
+    std::shared_ptr<void> alive_;               ///< 析构时释放, 线程缓存据此判断域是否还存在
+    std::atomic<uint64_t> epoch_{1};            ///< 全局epoch, 每次retire加1
+    mutable std::mutex mutex_;                  ///< 保护slots_, retired_和idleReaders_
+    std::vector<std::unique_ptr<Slot>> slots_;  ///< 读者的槽位, 注销后复用
+    std::vector<Retired> retired_;              ///< 待回收的数据
+    std::vector<std::unique_ptr<Reader>> pooledReaders_; ///< acquire()注册的读者, 随域一起注销
+    std::vector<Reader*> idleReaders_;          ///< 不在任何线程缓存中的空闲读者
+};
+
+} // namespace nemo
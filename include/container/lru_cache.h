@@ -21,16 +21,40 @@ public:
     typedef Value                       value_type;
 
 public:
+    /**
+     * @brief 构造函数
+     * @param[in] limit 最多缓存的元素个数, 为0时不缓存任何元素
+     */
     explicit LruCache(size_type limit, size_type buckets = 16, const Hash& hasher = Hash(),
         const Equal& equaler = Equal());
     ~LruCache();
 
     bool get(const key_type& key, value_type& v);
+
+    /**
+     * @brief 异构查找, Hash和Equal都声明了is_transparent时可以不构造key_type
+     */
+    template<typename K>
+        requires requires { typename Hash::is_transparent; typename Equal::is_transparent; }
+    bool get(const K& key, value_type& v);
+
     void put(const key_type& key, const value_type& v);
     void put(const key_type& key, value_type&& v);
     void put(key_type&& key, const value_type& v);
     void put(key_type&& key, value_type&& v);
 
+    /**
+     * @brief 删除key, 返回是否存在
+     */
+    bool erase(const key_type& key);
+
+    /**
+     * @brief 淘汰最久没有使用的元素
+     * @param[out] v 被淘汰的值, 可以为空
+     * @return 缓存为空时返回false
+     */
+    bool evict(value_type* v = nullptr);
+
     size_type size() const { return map_.size(); }
     size_type limit() const { return limit_; }
 
@@ -56,6 +80,12 @@ private:
     void moveToHeader(NodeType* node);
     void clearWithoutLink();
 
+    /**
+     * @brief 插入新元素之前调用, 缓存已满时淘汰最久没有使用的元素
+     * @return limit_为0时返回false, 不能插入
+     */
+    bool makeRoom();
+
 private:
     NodeBaseType* header_{allocateNodeBase()};
     size_type limit_;
@@ -68,6 +98,17 @@ void LruCache<Key, Value, Hash, Equal>::moveToHeader(NodeType* node) {
     LinkAfter(header_, node);
 }
 
+template<typename Key, typename Value, typename Hash, typename Equal>
+bool LruCache<Key, Value, Hash, Equal>::makeRoom() {
+    if (0 == limit_) {
+        return false;
+    }
+    if (map_.size() >= limit_) {
+        evict();
+    }
+    return true;
+}
+
 template<typename Key, typename Value, typename Hash, typename Equal>
 void LruCache<Key, Value, Hash, Equal>::clearWithoutLink() {
     map_.clear();
@@ -104,6 +145,20 @@ bool LruCache<Key, Value, Hash, Equal>::get(const key_type& key, value_type& v)
     return false;
 }
 
+template<typename Key, typename Value, typename Hash, typename Equal>
+template<typename K>
+    requires requires { typename Hash::is_transparent; typename Equal::is_transparent; }
+bool LruCache<Key, Value, Hash, Equal>::get(const K& key, value_type& v) {
+    typename MapType::iterator iter = map_.find(key);
+    if (iter != map_.end()) {
+        NodeType* node = static_cast<NodeType*>(iter->second);
+        v = node->value.second;
+        moveToHeader(node);
+        return true;
+    }
+    return false;
+}
+
 template<typename Key, typename Value, typename Hash, typename Equal>
 void LruCache<Key, Value, Hash, Equal>::put(const key_type& key, const value_type& v) {
     typename MapType::iterator iter = map_.find(key);
@@ -114,15 +169,13 @@ void LruCache<Key, Value, Hash, Equal>::put(const key_type& key, const value_typ
     } else {
         // 不必考虑自定义一个内存池来复用节点
         // 一个好的malloc肯定会考虑到相同大小内存块的频繁申请和释放这种情况
-        if (map_.size() >= limit_) {
-            NodeType* node = static_cast<NodeType*>(UnlinkBefore(header_));
-            map_.erase(node->value.first);
-            destoryNode(node);
+        if (!makeRoom()) {
+            return;
         }
         NodeType* newNode = allocateNode();
         auto myPair = map_.emplace(key, newNode);
         construct(&newNode->value, myPair.first, v);
-        LinkBefore(header_, newNode);
+        LinkAfter(header_, newNode);
     }
 }
 
@@ -134,15 +187,13 @@ void LruCache<Key, Value, Hash, Equal>::put(const key_type& key, value_type&& v)
         node->value.second = std::move(v);
         moveToHeader(node);
     } else {
-        if (map_.size() >= limit_) {
-            NodeType* node = static_cast<NodeType*>(UnlinkBefore(header_));
-            map_.erase(node->value.first);
-            destoryNode(node);
+        if (!makeRoom()) {
+            return;
         }
         NodeType* newNode = allocateNode();
         auto myPair = map_.emplace(key, newNode);
         construct(&newNode->value, myPair.first, std::move(v));
-        LinkBefore(header_, newNode);
+        LinkAfter(header_, newNode);
     }
 }
 
@@ -154,15 +205,13 @@ void LruCache<Key, Value, Hash, Equal>::put(key_type&& key, const value_type& v)
         node->value.second = v;
         moveToHeader(node);
     } else {
-        if (map_.size() >= limit_) {
-            NodeType* node = static_cast<NodeType*>(UnlinkBefore(header_));
-            map_.erase(node->value.first);
-            destoryNode(node);
+        if (!makeRoom()) {
+            return;
         }
         NodeType* newNode = allocateNode();
         auto myPair = map_.emplace(std::move(key), newNode);
         construct(&newNode->value, myPair.first, std::move(v));
-        LinkBefore(header_, newNode);
+        LinkAfter(header_, newNode);
     }
 }
 
@@ -174,10 +223,8 @@ void LruCache<Key, Value, Hash, Equal>::put(key_type&& key, value_type&& v) {
         node->value.second = std::move(v);
         moveToHeader(node);
     } else {
-        if (map_.size() >= limit_) {
-            NodeType* node = static_cast<NodeType*>(UnlinkBefore(header_));
-            map_.erase(node->value.first);
-            destoryNode(node);
+        if (!makeRoom()) {
+            return;
         }
         NodeType* newNode = allocateNode();
         auto myPair = map_.emplace(std::move(key), static_cast<NodeBaseType*>(newNode));
@@ -186,6 +233,33 @@ void LruCache<Key, Value, Hash, Equal>::put(key_type&& key, value_type&& v) {
     }
 }
 
+template<typename Key, typename Value, typename Hash, typename Equal>
+bool LruCache<Key, Value, Hash, Equal>::erase(const key_type& key) {
+    typename MapType::iterator iter = map_.find(key);
+    if (iter == map_.end()) {
+        return false;
+    }
+    NodeType* node = static_cast<NodeType*>(iter->second);
+    UnlinkSelfUnckecked(node);
+    map_.erase(iter);
+    destoryNode(node);
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+bool LruCache<Key, Value, Hash, Equal>::evict(value_type* v) {
+    if (map_.empty()) {
+        return false;
+    }
+    NodeType* node = static_cast<NodeType*>(UnlinkBefore(header_));
+    if (v) {
+        *v = std::move(node->value.second);
+    }
+    map_.erase(node->value.first);
+    destoryNode(node);
+    return true;
+}
+
 template<typename Key, typename Value, typename Hash, typename Equal>
 void LruCache<Key, Value, Hash, Equal>::clear() {
     clearWithoutLink();
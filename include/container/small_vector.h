@@ -0,0 +1,149 @@
+#pragma once
+
+#include <string.h>
+
+#include <type_traits>
+#include <utility>
+
+namespace nemo {
+
+/**
+ * @brief 带内联存储的vector, 元素个数不超过N时不分配堆内存
+ * @details 只支持可平凡拷贝的元素类型, 扩容和删除直接使用memcpy/memmove
+ */
+template<typename T, size_t N>
+class SmallVector {
+    static_assert(std::is_trivially_copyable_v<T>, "SmallVector requires trivially copyable type");
+
+public:
+    typedef T                value_type;
+    typedef size_t           size_type;
+    typedef T*               iterator;
+    typedef const T*         const_iterator;
+
+public:
+    SmallVector() = default;
+
+    SmallVector(const SmallVector& other) {
+        append(other.begin(), other.size());
+    }
+
+    SmallVector(SmallVector&& other) noexcept {
+        moveFrom(other);
+    }
+
+    ~SmallVector() {
+        if(!isInline()) {
+            ::operator delete(data_);
+        }
+    }
+
+    SmallVector& operator=(const SmallVector& other) {
+        if(this != &other) {
+            clear();
+            append(other.begin(), other.size());
+        }
+        return *this;
+    }
+
+    SmallVector& operator=(SmallVector&& other) noexcept {
+        if(this != &other) {
+            if(!isInline()) {
+                ::operator delete(data_);
+            }
+            data_ = inline_;
+            capacity_ = N;
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+public:
+    void push_back(const T& val) {
+        if(size_ == capacity_) {
+            grow(capacity_ * 2);
+        }
+        data_[size_++] = val;
+    }
+
+    /**
+     * @brief 删除第index个元素, 后面的元素前移
+     */
+    void erase(size_type index) {
+        ::memmove(data_ + index, data_ + index + 1, (size_ - index - 1) * sizeof(T));
+        --size_;
+    }
+
+    void pop_back() { --size_; }
+
+    /**
+     * @brief 清空元素, 保留已经分配的内存
+     */
+    void clear() noexcept { size_ = 0; }
+
+    void reserve(size_type n) {
+        if(n > capacity_) {
+            grow(n);
+        }
+    }
+
+    T& operator[](size_type index) { return data_[index]; }
+    const T& operator[](size_type index) const { return data_[index]; }
+    T& back() { return data_[size_ - 1]; }
+    const T& back() const { return data_[size_ - 1]; }
+
+    iterator begin() noexcept { return data_; }
+    iterator end() noexcept { return data_ + size_; }
+    const_iterator begin() const noexcept { return data_; }
+    const_iterator end() const noexcept { return data_ + size_; }
+
+    T* data() noexcept { return data_; }
+    const T* data() const noexcept { return data_; }
+    size_type size() const noexcept { return size_; }
+    size_type capacity() const noexcept { return capacity_; }
+    bool empty() const noexcept { return size_ == 0; }
+
+    /**
+     * @brief 数据是否还在内联存储中
+     */
+    bool isInline() const noexcept { return data_ == inline_; }
+
+private:
+    void grow(size_type n) {
+        T* newData = static_cast<T*>(::operator new(n * sizeof(T)));
+        ::memcpy(newData, data_, size_ * sizeof(T));
+        if(!isInline()) {
+            ::operator delete(data_);
+        }
+        data_ = newData;
+        capacity_ = n;
+    }
+
+    void append(const T* vals, size_type n) {
+        reserve(size_ + n);
+        ::memcpy(data_ + size_, vals, n * sizeof(T));
+        size_ += n;
+    }
+
+    void moveFrom(SmallVector& other) {
+        if(other.isInline()) {
+            size_ = 0;
+            append(other.begin(), other.size());
+        } else { //堆内存直接接管
+            data_ = other.data_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            other.data_ = other.inline_;
+            other.capacity_ = N;
+        }
+        other.size_ = 0;
+    }
+
+private:
+    T inline_[N];
+    T* data_{inline_};
+    size_type size_{0};
+    size_type capacity_{N};
+};
+
+} // namespace nemo
@@ -101,7 +101,7 @@ private:
     bool isBlocking();
     TaskQueue steal(size_t n);
     SuspendEntry suspendBySelf(Task* task);
-    bool wakeUpBySelf(const TaskSharedPtr& task);
+    bool wakeUpBySelf(TaskSharedPtr&& task);
 
 private:
     static void SetCurrentProcessor(Processor* processor);
@@ -163,7 +163,9 @@ public:
         if (std::holds_alternative<Task::UniquePtr>(runner_)) {
             task = std::move(std::get<0>(runner_));
         } else if (std::holds_alternative<Callback>(runner_)) {
-            task = std::make_unique<Task>(std::get<1>(runner_));
+            // 移走回调, 回调捕获的对象(连接等)随task结束释放, 不能留在Runnable里等下一次赋值
+            task = std::make_unique<Task>(std::move(std::get<1>(runner_)));
+            runner_ = Task::UniquePtr();
         }
         return task;
     }
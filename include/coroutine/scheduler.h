@@ -50,6 +50,7 @@ public:
     void addTask(std::list<Runnable>&& tasks);
     void addTask(TaskQueue&& tasks);
     uint64_t taskCount() const { return taskCount_; }
+    int getThreadNumber() const { return threadNumber_; }
 
 private:
     typedef std::vector<Processor::UniquePtr>::size_type IndexType;
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "common/noncopyable.h"
+#include "coroutine/processor.h"
+
+namespace nemo {
+namespace coroutine {
+
+/**
+ * @brief 等待一组协程结束
+ * @details add()增加计数, done()减少计数, wait()挂起当前协程直到计数为0.
+ *          只能在协程中等待, done()可以在任意线程调用
+ */
+class WaitGroup : Noncopyable {
+public:
+    typedef std::shared_ptr<WaitGroup> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<WaitGroup> UniquePtr; ///< 智能指针定义
+    typedef std::chrono::steady_clock Clock;
+
+    explicit WaitGroup(size_t count = 0) : count_(count) {}
+
+    /**
+     * @brief 增加计数
+     */
+    void add(size_t n = 1);
+
+    /**
+     * @brief 减少计数, 减到0时唤醒所有等待的协程
+     */
+    void done();
+
+    /**
+     * @brief 等待计数减到0
+     */
+    void wait();
+
+    /**
+     * @brief 等待计数减到0或者超时
+     * @return 计数是否已经减到0
+     */
+    bool waitUntil(Clock::time_point deadline);
+
+    /**
+     * @brief 当前计数
+     */
+    size_t count();
+
+private:
+    std::mutex mutex_;
+    size_t count_;
+    std::vector<Processor::SuspendEntry> waiters_;
+};
+
+} // namespace coroutine
+} // namespace nemo
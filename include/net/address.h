@@ -10,6 +10,7 @@
 #include <map>
 #include <memory>
 #include <iterator>
+#include <vector>
 
 #include "net/socket_attribute.h"
 #include "common/types.h"
@@ -21,6 +22,20 @@ class IpAddress;
 
 struct addrinfo* GetAddrInfo(StringArg host, const SocketAttribute& attr);
 
+class Address;
+
+/**
+ * @brief 解析host[:port]得到的所有地址
+ * @details 在开启hook的协程中解析域名时使用DnsResolver, 只挂起当前协程;
+ *          其他情况(数字地址, 非数字端口, 不在协程中)使用getaddrinfo
+ * @param[in] host 域名,服务器名等.举例: www.baidu.top[:80] (方括号为可选内容)
+ * @param[in] attr socket的属性
+ * @param[out] result 解析到的地址
+ * @return 是否解析成功
+ */
+bool ResolveAddresses(StringArg host, const SocketAttribute& attr,
+                    std::vector<std::unique_ptr<Address>>& result);
+
 /**
  * @brief 地址的基类
  */
@@ -270,6 +285,15 @@ private:
 class UnixAddress : public Address {
 public:
     typedef std::shared_ptr<UnixAddress> ptr; ///智能指针定义
+    typedef std::unique_ptr<UnixAddress> UniquePtr; ///< 智能指针定义
+
+    /**
+     * @brief 解析配置中的Unix域socket地址
+     * @details unix:/path为文件系统路径, unix:@name为抽象命名空间(不在文件系统中创建文件,
+     *          最后一个引用关闭时自动消失)
+     * @return 没有unix:前缀, 名字为空或者过长时返回nullptr
+     */
+    static UniquePtr Parse(StringArg address);
 
     /**
      * @brief 无参构造函数
@@ -280,8 +304,9 @@ public:
      * 
      * @brief 通过Unix二进制地址构造UnixAddress
      * @param[in] address Unix二进制地址
+     * @param[in] length 地址的有效长度, 抽象命名空间的名字由长度决定
      */
-    UnixAddress(const sockaddr_un& address);
+    UnixAddress(const sockaddr_un& address, socklen_t length = sizeof(sockaddr_un));
 
     /**
      * @brief 通过路径构造UnixAddress
@@ -294,6 +319,13 @@ public:
     socklen_t getAddrLen() const override;
     void setAddrLen(uint32_t value);
     std::string getPath() const;
+
+    /**
+     * @brief 是否是抽象命名空间的地址
+     */
+    bool isAbstract() const {
+        return length_ > offsetof(sockaddr_un, sun_path) && '\0' == addr_.sun_path[0];
+    }
     std::ostream& dump(std::ostream& os) const override;
 
 private:
@@ -339,20 +371,15 @@ template<typename Iter>
 Iter Address::Lookup(StringArg host,
     Iter dest,
     const SocketAttribute& attr) {
-    struct addrinfo* info = GetAddrInfo(host, attr);
-    if (nullptr == info) {
+    std::vector<Address::UniquePtr> addresses;
+    if(!ResolveAddresses(host, attr, addresses)) {
         return dest;
     }
 
-    struct addrinfo* next = info;
-    while (next) {
-        Address::UniquePtr tmp = Create(next->ai_addr, (socklen_t)next->ai_addrlen);
-        *dest = std::move(tmp);
+    for(Address::UniquePtr& address : addresses) {
+        *dest = std::move(address);
         ++dest;
-        next = next->ai_next;
     }
-
-    ::freeaddrinfo(info);
     return dest;
 }
 
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "net/address.h"
+#include "container/lru_cache.h"
+#include "common/singleton.h"
+#include "common/types.h"
+
+namespace nemo {
+namespace net {
+
+/**
+ * @brief 协程中使用的DNS解析器
+ * @details 查询通过hook的UDP socket发送, 等待响应时只挂起当前协程(截断时改用TCP).
+ *          先查/etc/hosts, 再按resolv.conf中的nameserver、search、ndots、timeout、attempts查询.
+ *          A和AAAA记录分别缓存, 成功的结果按记录的TTL缓存(不超过dns.max_ttl),
+ *          NXDOMAIN和没有记录的结果按SOA的TTL缓存(没有SOA时为dns.negative_ttl).
+ *          同时查询IPv4和IPv6时两个查询并发发送, 结果按Happy Eyeballs(RFC 8305)交替排列, IPv6在前
+ */
+class DnsResolver : public Singleton<DnsResolver> {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * @brief 构造函数, 读取hosts文件和resolv.conf
+     */
+    DnsResolver(Token);
+
+    /**
+     * @brief 解析域名
+     * @param[in] name 域名, 以'.'结尾时不追加search域
+     * @param[in] family AF_INET, AF_INET6或AF_UNSPEC(两者都查询)
+     * @param[out] result 解析到的地址, 端口为0
+     * @return 是否解析到地址
+     */
+    bool resolve(StringArg name, int family, std::vector<IpAddress::UniquePtr>& result);
+
+    /**
+     * @brief 清空缓存
+     */
+    void clear();
+
+    /**
+     * @brief 是否启用(dns.enable), 不启用时Address::Lookup使用getaddrinfo
+     */
+    static bool IsEnabled();
+
+private:
+    /**
+     * @brief 一个域名一种记录的查询结果, 地址为空表示否定结果
+     */
+    struct Record {
+        std::vector<String> addresses;  ///< 网络字节序的原始地址(4或16字节)
+        Clock::time_point expires;
+    };
+
+    /**
+     * @brief 一次查询的状态
+     */
+    struct Question {
+        uint16_t type;
+        uint16_t id;
+        bool done = false;
+        bool negative = false;          ///< NXDOMAIN或者没有记录
+        bool truncated = false;
+        uint32_t ttl = 0;
+        std::vector<String> addresses;
+    };
+
+    /**
+     * @brief 按search域展开需要查询的完整域名
+     */
+    std::vector<String> candidates(const String& name) const;
+
+    /**
+     * @brief 查询一个完整域名的若干种记录, 先查缓存
+     * @return 是否有记录
+     */
+    bool lookup(const String& name, const std::vector<uint16_t>& types,
+                std::vector<std::vector<String>>& addresses);
+
+    /**
+     * @brief 依次向nameserver发送查询, 直到所有问题都有结果或者重试次数用完
+     */
+    void query(const String& name, std::vector<Question>& questions);
+
+    /**
+     * @brief 通过UDP发送查询并等待响应
+     * @return 是否收到所有问题的响应
+     */
+    bool exchangeUdp(const Address* server, const String& name, std::vector<Question>& questions);
+
+    /**
+     * @brief 通过TCP查询一个问题(UDP响应被截断时)
+     */
+    bool exchangeTcp(const Address* server, const String& name, Question& question);
+
+    /**
+     * @brief 读取resolv.conf
+     */
+    void loadResolvConf(StringArg path);
+
+    /**
+     * @brief 读取hosts文件
+     */
+    void loadHosts(StringArg path);
+
+    static String CacheKey(const String& name, uint16_t type);
+
+private:
+    std::vector<Address::UniquePtr> nameservers_;
+    std::vector<String> search_;
+    uint32_t ndots_;
+    uint32_t timeoutMillionSeconds_;    ///< 每次查询的超时时间
+    uint32_t attempts_;                 ///< 每个nameserver的查询次数
+    std::unordered_multimap<String, String> hosts_; ///< 小写的域名 -> 原始地址
+    std::mutex mutex_;
+    LruCache<String, Record> cache_;
+};
+
+} // namespace net
+} // namespace nemo
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "common/types.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+/**
+ * @brief HPACK动态表(RFC 7541 2.3.2)
+ * @details 新的字段插入到表头, 超过容量时从表尾淘汰.
+ *          每个字段占用的大小为名称长度+值长度+32
+ */
+class HpackTable {
+public:
+    typedef std::pair<String, String> Field;
+
+    /// 每个字段额外计入的大小
+    constexpr static size_t kEntryOverhead = 32;
+    /// 静态表的字段数
+    constexpr static size_t kStaticTableSize = 61;
+
+public:
+    explicit HpackTable(size_t maxSize = 4096) : size_(0), maxSize_(maxSize) {}
+
+    /**
+     * @brief 按索引获取字段, 1~61为静态表, 之后为动态表
+     * @return 索引越界返回nullptr
+     */
+    const Field* get(size_t index) const;
+
+    /**
+     * @brief 插入字段, 字段本身超过容量时清空动态表
+     */
+    void add(StringArg name, StringArg value);
+
+    /**
+     * @brief 查找字段
+     * @param[out] nameIndex 只有名称相同的字段的索引, 没有时为0
+     * @return 名称和值都相同的字段的索引, 没有时为0
+     */
+    size_t find(StringArg name, StringArg value, size_t* nameIndex) const;
+
+    /**
+     * @brief 修改容量, 淘汰超出的字段
+     */
+    void setMaxSize(size_t maxSize);
+
+    size_t getMaxSize() const { return maxSize_; }
+    size_t getSize() const { return size_; }
+    size_t getCount() const { return entries_.size(); }
+
+private:
+    void evict(size_t limit);
+
+private:
+    std::deque<Field> entries_; ///< 动态表, 表头为最新插入的字段
+    size_t size_;               ///< 当前大小
+    size_t maxSize_;            ///< 容量
+};
+
+/**
+ * @brief HPACK头部块解码器
+ * @details 每个连接一个, 需要按收到的顺序解码所有头部块
+ */
+class HpackDecoder {
+public:
+    typedef std::shared_ptr<HpackDecoder> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<HpackDecoder> UniquePtr; ///< 智能指针定义
+    typedef std::vector<HpackTable::Field> FieldVector;
+
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] maxTableSize 本端通过SETTINGS_HEADER_TABLE_SIZE允许的动态表大小上限
+     */
+    explicit HpackDecoder(size_t maxTableSize = 4096);
+
+    /**
+     * @brief 解码一个完整的头部块
+     * @details 字段大小按名称+值+32累计, 超过maxListSize后清空fields并且不再输出字段,
+     *          但仍然解码完整个头部块, 保持动态表与对端一致.
+     *          少量字节的索引可以引用很大的动态表条目, 不能只限制压缩后的大小
+     * @param[out] fields 解码出的字段, 按出现顺序追加
+     * @param[in] maxListSize 解码后头部列表大小的上限
+     * @param[out] listSize 解码后头部列表的大小, 大于maxListSize表示超出了上限
+     * @return 头部块不合法(COMPRESSION_ERROR)时返回false
+     */
+    bool decode(const uint8_t* data, size_t len, FieldVector& fields,
+                size_t maxListSize = SIZE_MAX, size_t* listSize = nullptr);
+
+    const HpackTable& getTable() const { return table_; }
+
+private:
+    HpackTable table_;
+    size_t maxTableSize_; ///< 动态表大小更新不能超过该值
+};
+
+/**
+ * @brief HPACK头部块编码器
+ */
+class HpackEncoder {
+public:
+    typedef std::shared_ptr<HpackEncoder> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<HpackEncoder> UniquePtr; ///< 智能指针定义
+
+public:
+    explicit HpackEncoder(size_t maxTableSize = 4096);
+
+    /**
+     * @brief 对端修改了SETTINGS_HEADER_TABLE_SIZE, 下一个头部块开头发送大小更新
+     */
+    void setMaxTableSize(size_t maxTableSize);
+
+    /**
+     * @brief 开始一个新的头部块, 输出待发送的动态表大小更新
+     */
+    void begin(String& out);
+
+    /**
+     * @brief 编码一个字段, 名称必须是小写
+     * @param[in] indexing 是否加入动态表, 取值经常变化的字段不需要加入
+     */
+    void encode(StringArg name, StringArg value, String& out, bool indexing = true);
+
+    const HpackTable& getTable() const { return table_; }
+
+private:
+    HpackTable table_;
+    size_t pendingTableSize_; ///< 待发送的大小更新, SIZE_MAX表示没有
+};
+
+namespace hpack {
+
+/**
+ * @brief 编码整数(RFC 7541 5.1)
+ * @param[in] prefix 前缀位数, 1~8
+ * @param[in] flags 第一个字节中前缀之外的高位
+ */
+void EncodeInteger(uint64_t value, uint8_t prefix, uint8_t flags, String& out);
+
+/**
+ * @brief 解码整数
+ * @return 消耗的字节数, 数据不完整或者超过2^32-1时返回0
+ */
+size_t DecodeInteger(const uint8_t* data, size_t len, uint8_t prefix, uint64_t& value);
+
+/**
+ * @brief Huffman编码后的字节数
+ */
+size_t HuffmanEncodedLength(StringArg data);
+
+/**
+ * @brief Huffman编码, 追加到out
+ */
+void HuffmanEncode(StringArg data, String& out);
+
+/**
+ * @brief Huffman解码, 追加到out
+ * @return 编码不合法(包含EOS或者填充不正确)时返回false
+ */
+bool HuffmanDecode(const uint8_t* data, size_t len, String& out);
+
+} // namespace hpack
+
+} // namespace http
+} // namespace net
+} // namespace nemo
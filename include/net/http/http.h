@@ -2,9 +2,13 @@
 
 #include <memory>
 #include <map>
+#include <memory_resource>
+#include <optional>
 
 #include "net/http/http_method.h"
 #include "net/http/http_status.h"
+#include "net/http/http_header.h"
+#include "net/socket_attribute.h"
 #include "common/types.h"
 #include "common/lexical_cast.h"
 #include "util/case_insensitive_compare.h"
@@ -67,6 +71,35 @@ T GetAs(const MapType& m, const std::string& key, const T& defaultVal = T()) {
     return defaultVal;
 }
 
+/**
+ * @brief 获取HttpHeaders中的字段值,并转成对应类型,返回是否成功
+ */
+template<typename T>
+bool CheckGetAs(const HttpHeaders& m, const std::string& key, T& val, const T& defaultVal = T()) {
+    StringArg str;
+    if(!m.has(key, &str)) {
+        val = defaultVal;
+        return false;
+    }
+    try {
+        val = boost::lexical_cast<T>(str.data(), str.size());
+        return true;
+    } catch (...) {
+        val = defaultVal;
+    }
+    return false;
+}
+
+/**
+ * @brief 获取HttpHeaders中的字段值,并转成对应类型
+ */
+template<typename T>
+T GetAs(const HttpHeaders& m, const std::string& key, const T& defaultVal = T()) {
+    T val;
+    CheckGetAs(m, key, val, defaultVal);
+    return val;
+}
+
 class HttpResponse; //前置声明
 
 /**
@@ -77,14 +110,18 @@ friend class HttpSession;
 public:
     typedef std::shared_ptr<HttpRequest> SharedPtr; ///< 智能指针定义
     typedef std::unique_ptr<HttpRequest> UniquePtr; ///< 智能指针定义
-    typedef std::map<String, String, string_util::CaseInsensitiveLess> MapType; ///< MapType定义
+    typedef std::pmr::map<std::pmr::string, std::pmr::string,
+                        string_util::CaseInsensitiveLess> MapType; ///< MapType定义
 
     /**
      * @brief 构造函数
      * @param[in] version 版本
      * @param[in] close 是否keepalive
+     * @param[in] resource 头部/参数/Cookie使用的内存资源, 传入请求级别的内存池时,
+     *                     请求不能比内存池活得更久
      */
-    HttpRequest(HttpVersion version = HttpVersion::HTTP11, bool close = true);
+    HttpRequest(HttpVersion version = HttpVersion::HTTP11, bool close = true,
+                std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     bool createResponse(std::unique_ptr<HttpResponse>& response);
 
@@ -114,9 +151,14 @@ public:
     const String& getBody() const { return body_; }
 
     /**
-     * @brief 返回HTTP请求的消息头MAP
+     * @brief 返回HTTP请求的消息头
+     */
+    const HttpHeaders& getHeaders() const { return headers_; }
+
+    /**
+     * @brief 返回头部/参数/Cookie使用的内存资源
      */
-    const MapType& getHeaders() const { return headers_; }
+    std::pmr::memory_resource* getResource() const { return headers_.getResource(); }
 
     /**
      * @brief 返回HTTP请求的参数MAP
@@ -128,6 +170,23 @@ public:
      */
     const MapType& getCookies() const { return cookies_; }
 
+    /**
+     * @brief 返回路由匹配到的路径参数MAP, 例如/users/:id中的id
+     */
+    const MapType& getRouteParams() const { return routeParams_; }
+
+    /**
+     * @brief 返回Unix域socket连接的对端进程凭证, 其他连接返回nullptr
+     */
+    const PeerCredentials* getPeerCredentials() const {
+        return peerCredentials_ ? &*peerCredentials_ : nullptr;
+    }
+
+    /**
+     * @brief 设置对端进程凭证, 由接收请求的连接设置
+     */
+    void setPeerCredentials(const PeerCredentials& credentials) { peerCredentials_ = credentials; }
+
     /**
      * @brief 设置HTTP请求的方法名
      * @param[in] method HTTP请求
@@ -192,9 +251,9 @@ public:
      * @brief 设置HTTP请求的头部MAP
      * @param[in] headers map
      */
-    void setHeaders(const MapType& headers) { headers_ = headers; }
+    void setHeaders(const HttpHeaders& headers) { headers_ = headers; }
 
-    void setHeaders(MapType&& headers) { headers_ = std::move(headers); }
+    void setHeaders(HttpHeaders&& headers) { headers_ = std::move(headers); }
 
     /**
      * @brief 设置HTTP请求的参数MAP
@@ -218,7 +277,13 @@ public:
      * @param[in] defaultVal 默认值
      * @return 如果存在则返回对应值,否则返回默认值
      */
-    String getHeader(const String& key, const String& defaultVal = "") const;
+    String getHeader(StringArg key, const String& defaultVal = "") const;
+
+    /**
+     * @brief 通过编号获取常用头部, 不存在时返回空
+     * @attention 返回值指向请求内部的内存, 修改头部后失效
+     */
+    StringArg getHeader(HttpHeaderId id) const { return headers_.get(id); }
 
     /**
      * @brief 获取HTTP请求的请求参数
@@ -236,14 +301,25 @@ public:
      */
     String getCookie(const String& key, const String& defaultVal = "");
 
+    /**
+     * @brief 获取路由匹配到的路径参数
+     * @param[in] key 参数名, 不包括':'和'*'
+     * @param[in] defaultVal 默认值
+     * @return 如果存在则返回对应值,否则返回默认值
+     */
+    String getRouteParam(StringArg key, const String& defaultVal = "") const;
+
+    /**
+     * @brief 设置路径参数, 由ServletDispatcher在匹配路由时调用
+     */
+    void setRouteParam(StringArg key, StringArg val);
+
     /**
      * @brief 设置HTTP请求的头部参数
      * @param[in] key 关键字
      * @param[in] val 值
      */
-    void setHeader(const String& key, const String& val);
-
-    void setHeader(const String& key, String&& val);
+    void setHeader(StringArg key, StringArg val);
 
     /**
      * @brief 设置HTTP请求的请求参数
@@ -267,7 +343,7 @@ public:
      * @brief 删除HTTP请求的头部参数
      * @param[in] key 关键字
      */
-    void delHeader(const String& key);
+    void delHeader(StringArg key);
 
     /**
      * @brief 删除HTTP请求的请求参数
@@ -287,7 +363,7 @@ public:
      * @param[out] val 如果存在,val非空则赋值
      * @return 是否存在
      */
-    bool hasHeader(const String& key, String* val = nullptr);
+    bool hasHeader(StringArg key, String* val = nullptr) const;
 
     /**
      * @brief 判断HTTP请求的请求参数是否存在
@@ -416,9 +492,11 @@ private:
     String query_;        //请求参数
     String fragment_;     //请求fragment
     String body_;         //请求消息体
-    MapType headers_;          //请求头部Map
+    HttpHeaders headers_;      //请求头部
     MapType params_;           //请求参数Map
     MapType cookies_;          //请求Cookie Map
+    MapType routeParams_;      //路径参数Map
+    std::optional<PeerCredentials> peerCredentials_; //Unix域socket的对端凭证
 };
 
 /**
@@ -434,8 +512,10 @@ public:
      * @brief 构造函数
      * @param[in] version 版本
      * @param[in] close 是否自动关闭
+     * @param[in] resource 头部使用的内存资源
      */
-    HttpResponse(HttpVersion version = HttpVersion::HTTP11, bool close = true);
+    HttpResponse(HttpVersion version = HttpVersion::HTTP11, bool close = true,
+                std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     /**
      * @brief 返回响应状态
@@ -461,10 +541,9 @@ public:
     const String& getReason() const { return reason_; }
 
     /**
-     * @brief 返回响应头部MAP
-     * @return MAP
+     * @brief 返回响应头部
      */
-    const MapType& getHeaders() const { return headers_; }
+    const HttpHeaders& getHeaders() const { return headers_; }
 
     /**
      * @brief 设置响应状态
@@ -498,9 +577,9 @@ public:
      * @brief 设置响应头部MAP
      * @param[in] headers MAP
      */
-    void setHeaders(const MapType& headers) { headers_ = headers; }
+    void setHeaders(const HttpHeaders& headers) { headers_ = headers; }
 
-    void setHeaders(MapType&& headers) { headers_ = std::move(headers); }
+    void setHeaders(HttpHeaders&& headers) { headers_ = std::move(headers); }
 
     /**
      * @brief 是否自动关闭
@@ -530,22 +609,26 @@ public:
      * @param[in] defaultVal 默认值
      * @return 如果存在返回对应值,否则返回defaultVal
      */
-    String getHeader(const String& key, const String& defaultVal = "") const;
+    String getHeader(StringArg key, const String& defaultVal = "") const;
+
+    /**
+     * @brief 通过编号获取常用头部, 不存在时返回空
+     * @attention 返回值指向响应内部的内存, 修改头部后失效
+     */
+    StringArg getHeader(HttpHeaderId id) const { return headers_.get(id); }
 
     /**
      * @brief 设置响应头部参数
      * @param[in] key 关键字
      * @param[in] val 值
      */
-    void setHeader(const String& key, const String& val);
-
-    void setHeader(const String& key, String&& val);
+    void setHeader(StringArg key, StringArg val);
 
     /**
      * @brief 删除响应头部参数
      * @param[in] key 关键字
      */
-    void delHeader(const String& key);
+    void delHeader(StringArg key);
 
     /**
      * @brief 检查并获取响应头部参数
@@ -579,11 +662,33 @@ public:
      */
     std::ostream& dump(std::ostream& os) const;
 
+    /**
+     * @brief 只序列化状态行和头部, 不包括结束头部的空行和消息体
+     * @param[in, out] os 输出流
+     * @return 输出流
+     */
+    std::ostream& dumpHeader(std::ostream& os) const;
+
+    /**
+     * @brief 序列化后追加到out末尾, out有足够容量时不分配内存
+     */
+    void appendTo(String& out) const;
+
+    /**
+     * @brief 只把状态行和头部追加到out末尾, 不包括结束头部的空行和消息体
+     */
+    void appendHeaderTo(String& out) const;
+
     /**
      * @brief 转成字符串
      */
     String toString() const;
 
+    /**
+     * @brief 返回通过setCookie设置的Set-Cookie字段
+     */
+    const std::vector<String>& getCookies() const { return cookies_; }
+
     void setRedirect(const String& uri);
     void setCookie(const String& key, const String& val,
                    time_t expired = 0, const String& path = "",
@@ -595,10 +700,15 @@ private:
     bool webSocket_;                        ///< 是否为websocket
     String body_;                      ///< 响应消息体
     String reason_;                    ///< 响应原因
-    MapType headers_;                       ///< 响应头部MAP
+    HttpHeaders headers_;                   ///< 响应头部
     std::vector<String> cookies_;      ///< cookies
 };
 
+/**
+ * @brief 逗号分隔的字段值(Connection/Upgrade等)中是否包含token, 不区分大小写
+ */
+bool HasHeaderToken(StringArg value, StringArg token);
+
 /**
  * @brief 流式输出HttpRequest
  * @param[in, out] os 输出流
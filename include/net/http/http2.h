@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "common/types.h"
+
+/* Error Codes (RFC 7540 7) */
+#define HTTP2_ERROR_MAP(XX)                                \
+  XX(0x0, NO_ERROR,             NO_ERROR)                  \
+  XX(0x1, PROTOCOL_ERROR,       PROTOCOL_ERROR)            \
+  XX(0x2, INTERNAL_ERROR,       INTERNAL_ERROR)            \
+  XX(0x3, FLOW_CONTROL_ERROR,   FLOW_CONTROL_ERROR)        \
+  XX(0x4, SETTINGS_TIMEOUT,     SETTINGS_TIMEOUT)          \
+  XX(0x5, STREAM_CLOSED,        STREAM_CLOSED)             \
+  XX(0x6, FRAME_SIZE_ERROR,     FRAME_SIZE_ERROR)          \
+  XX(0x7, REFUSED_STREAM,       REFUSED_STREAM)            \
+  XX(0x8, CANCEL,               CANCEL)                    \
+  XX(0x9, COMPRESSION_ERROR,    COMPRESSION_ERROR)         \
+  XX(0xa, CONNECT_ERROR,        CONNECT_ERROR)             \
+  XX(0xb, ENHANCE_YOUR_CALM,    ENHANCE_YOUR_CALM)         \
+  XX(0xc, INADEQUATE_SECURITY,  INADEQUATE_SECURITY)       \
+  XX(0xd, HTTP_1_1_REQUIRED,    HTTP_1_1_REQUIRED)         \
+
+namespace nemo {
+namespace net {
+namespace http {
+
+/**
+ * @brief 帧类型(RFC 7540 6)
+ */
+enum class Http2FrameType : uint8_t {
+    DATA = 0x0,
+    HEADERS = 0x1,
+    PRIORITY = 0x2,
+    RST_STREAM = 0x3,
+    SETTINGS = 0x4,
+    PUSH_PROMISE = 0x5,
+    PING = 0x6,
+    GOAWAY = 0x7,
+    WINDOW_UPDATE = 0x8,
+    CONTINUATION = 0x9
+};
+
+/**
+ * @brief 帧标志位
+ */
+struct Http2Flag {
+    constexpr static uint8_t END_STREAM = 0x1;
+    constexpr static uint8_t ACK = 0x1;
+    constexpr static uint8_t END_HEADERS = 0x4;
+    constexpr static uint8_t PADDED = 0x8;
+    constexpr static uint8_t PRIORITY = 0x20;
+};
+
+/**
+ * @brief 错误码
+ */
+enum class Http2Error : uint32_t {
+#define XX(code, name, desc) name = code,
+    HTTP2_ERROR_MAP(XX)
+#undef XX
+};
+
+/**
+ * @brief SETTINGS参数(RFC 7540 6.5.2)
+ */
+enum class Http2Setting : uint16_t {
+    HEADER_TABLE_SIZE = 0x1,
+    ENABLE_PUSH = 0x2,
+    MAX_CONCURRENT_STREAMS = 0x3,
+    INITIAL_WINDOW_SIZE = 0x4,
+    MAX_FRAME_SIZE = 0x5,
+    MAX_HEADER_LIST_SIZE = 0x6
+};
+
+/// 客户端连接前言
+constexpr StringArg kHttp2Preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+/// 帧头大小
+constexpr size_t kHttp2FrameHeaderSize = 9;
+/// 默认(也是最小)的帧负载上限
+constexpr uint32_t kHttp2DefaultMaxFrameSize = 16384;
+/// 帧负载上限的最大值
+constexpr uint32_t kHttp2MaxFrameSizeLimit = (1u << 24) - 1;
+/// 默认的流量控制窗口
+constexpr int32_t kHttp2DefaultWindowSize = 65535;
+/// 流量控制窗口的最大值
+constexpr int64_t kHttp2MaxWindowSize = (1ll << 31) - 1;
+
+/**
+ * @brief 帧头
+ */
+struct Http2FrameHeader {
+    uint32_t length = 0;        ///< 负载长度, 24位
+    Http2FrameType type = Http2FrameType::DATA;
+    uint8_t flags = 0;
+    uint32_t streamId = 0;      ///< 流ID, 31位
+
+    bool hasFlag(uint8_t flag) const { return flags & flag; }
+
+    /**
+     * @brief 从9个字节中解析帧头
+     */
+    void parse(const void* data);
+
+    /**
+     * @brief 序列化后追加到out
+     */
+    void appendTo(String& out) const;
+};
+
+/**
+ * @brief 追加一个完整的帧
+ */
+void AppendHttp2Frame(String& out, Http2FrameType type, uint8_t flags,
+                      uint32_t streamId, StringArg payload = StringArg());
+
+/**
+ * @brief 读取大端序的32位整数
+ */
+inline uint32_t ReadHttp2Uint32(const void* data) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+/**
+ * @brief 追加大端序的32位整数
+ */
+void AppendHttp2Uint32(String& out, uint32_t value);
+
+const char* Http2Error2String(Http2Error error);
+
+} // namespace http
+} // namespace net
+} // namespace nemo
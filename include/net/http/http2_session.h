@@ -0,0 +1,241 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "net/http/http.h"
+#include "net/http/http2.h"
+#include "net/http/hpack.h"
+#include "net/http/servlet.h"
+#include "net/http/http_cache.h"
+#include "net/http/rate_limiter.h"
+#include "net/socket.h"
+#include "coroutine/processor.h"
+#include "coroutine/scheduler.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+/**
+ * @brief HTTP/2服务端连接
+ * @details 一个连接上的协程分工如下:
+ *          - 读协程(调用run()的协程)解析所有的帧, 维护流的状态和流量控制窗口
+ *          - 写协程是唯一写socket的协程, 按顺序编码头部并根据发送窗口切分DATA帧
+ *          - 每个完整的请求在handle调度器上启动一个协程执行servlet, 多个流并发处理
+ *          共享状态由mutex_保护, 持有锁时不做任何IO.
+ *          servlet收到的HttpSession为nullptr, 请求消息体总是完整读取后再交给servlet,
+ *          需要流式读取消息体的servlet会收到RST_STREAM(HTTP_1_1_REQUIRED), 客户端改用HTTP/1.1重试
+ */
+class Http2Session : public std::enable_shared_from_this<Http2Session> {
+public:
+    typedef std::shared_ptr<Http2Session> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<Http2Session> UniquePtr; ///< 智能指针定义
+
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] sock 客户端连接
+     * @param[in] dispatcher servlet分发器, 生命周期需要长于连接
+     * @param[in] scheduler 执行servlet的调度器
+     * @param[in] serverName 响应中的Server字段
+     */
+    Http2Session(Socket::SharedPtr sock, ServletDispatcher* dispatcher,
+                 coroutine::Scheduler* scheduler, StringArg serverName);
+
+    ~Http2Session();
+
+    /**
+     * @brief 处理连接直到关闭, 返回时连接上的所有协程都已经结束
+     * @param[in] data 已经从socket读出的数据, 从客户端连接前言开始
+     */
+    void run(StringArg data);
+
+    /**
+     * @brief h2c升级, 已经发送101响应后处理连接
+     * @param[in] request 升级请求(消息体已经读完), 作为流1处理, 为空时等同于run()
+     * @param[in] settings HTTP2-Settings字段解码后的SETTINGS负载
+     * @param[in] data 已经从socket读出的数据, 从客户端连接前言开始
+     */
+    void runUpgrade(const HttpRequest* request, StringArg settings, StringArg data);
+
+    /**
+     * @brief 设置响应缓存, 为空时不使用缓存
+     */
+    void setResponseCache(const HttpResponseCache::SharedPtr& cache) { cache_ = cache; }
+
+    /**
+     * @brief 设置限流, 超过限制的流直接返回429
+     */
+    void setRateLimiter(const HttpRateLimiter::SharedPtr& rateLimiter) { rateLimiter_ = rateLimiter; }
+
+    /**
+     * @brief 优雅关闭, 可以在任意线程调用
+     * @details 发送GOAWAY并拒绝之后的新流(REFUSED_STREAM), 已经打开的流处理完并发送完响应后关闭连接
+     */
+    void shutdown();
+
+    /**
+     * @brief 是否启用HTTP/2(http.http2.enable)
+     */
+    static bool IsEnabled();
+
+    /**
+     * @brief 解码HTTP2-Settings字段(base64url)
+     * @return 不合法时返回false
+     */
+    static bool DecodeSettingsHeader(StringArg value, String& settings);
+
+private:
+    struct Stream;
+    typedef std::shared_ptr<Stream> StreamPtr;
+
+    /**
+     * @brief 读循环
+     */
+    void readLoop(StringArg data);
+
+    /**
+     * @brief 写协程
+     */
+    void writeLoop();
+
+    /**
+     * @brief 确保缓冲区中至少有n个字节
+     */
+    bool ensure(size_t n);
+
+    /**
+     * @brief 处理一个帧
+     * @return 连接级别的错误码, NO_ERROR表示继续
+     */
+    Http2Error onFrame(const Http2FrameHeader& header, const uint8_t* payload);
+    Http2Error onData(const Http2FrameHeader& header, const uint8_t* payload);
+    Http2Error onHeaders(const Http2FrameHeader& header, const uint8_t* payload);
+    Http2Error onContinuation(const Http2FrameHeader& header, const uint8_t* payload);
+    Http2Error onHeaderBlock();
+    Http2Error onSettings(const Http2FrameHeader& header, const uint8_t* payload);
+    Http2Error applySettings(const uint8_t* payload, size_t len);
+    Http2Error onWindowUpdate(const Http2FrameHeader& header, const uint8_t* payload);
+
+    /**
+     * @brief 请求完整后启动处理协程
+     * @pre 持有mutex_
+     */
+    void dispatch(const StreamPtr& stream);
+
+    /**
+     * @brief 在处理协程中执行servlet
+     */
+    void handle(const StreamPtr& stream, HttpServlet* servlet);
+
+    /**
+     * @brief 发送立即结束流的响应
+     * @param[in] retryAfter 不为0时设置Retry-After(秒)
+     * @pre 持有mutex_
+     */
+    void respondError(const StreamPtr& stream, HttpStatus status, uint32_t retryAfter = 0);
+
+    /**
+     * @brief 关闭流并发送RST_STREAM
+     * @pre 持有mutex_
+     */
+    void resetStream(uint32_t streamId, Http2Error error);
+
+    /**
+     * @brief 移除被重置的流, 处理协程还在执行时计入resetHandlers_
+     * @pre 持有mutex_
+     */
+    void removeStream(uint32_t streamId);
+
+    /**
+     * @brief 把待发送的帧编码到out中
+     * @pre 持有mutex_
+     */
+    void collectFrames(String& out);
+
+    /**
+     * @brief 编码响应头部, 按对端的帧大小拆分为HEADERS和CONTINUATION
+     * @pre 持有mutex_
+     */
+    void encodeHeaders(Stream* stream, String& out);
+
+    /**
+     * @brief 流已经发送完并且对端不会再发送数据时移除
+     * @pre 持有mutex_
+     */
+    void tryClose(const StreamPtr& stream);
+
+    /**
+     * @brief 唤醒写协程
+     * @pre 持有mutex_
+     */
+    void notifyWriter();
+
+    /**
+     * @brief 唤醒等待连接结束的读协程
+     * @pre 持有mutex_
+     */
+    void notifyDone();
+
+    /**
+     * @brief 把消费掉的数据计入接收窗口, 超过一半时发送WINDOW_UPDATE
+     * @pre 持有mutex_
+     */
+    void consumeWindow(Stream* stream, uint32_t len);
+
+private:
+    Socket::SharedPtr sock_;
+    ServletDispatcher* dispatcher_;
+    coroutine::Scheduler* scheduler_;
+    String serverName_;
+    HttpResponseCache::SharedPtr cache_;
+    HttpRateLimiter::SharedPtr rateLimiter_;
+    std::optional<PeerCredentials> peerCredentials_; ///< Unix域socket的对端凭证, 设置到每个请求上
+
+    //以下只由读协程访问
+    EpochDomain::Reader* routeReader_;      ///< 借用的读者, 进出临界区时持有mutex_, 有处理协程时一直在临界区内
+    String readBuffer_;                     ///< 读缓冲区, [readPos_, readEnd_)为未处理数据
+    size_t readPos_;
+    size_t readEnd_;
+    HpackDecoder decoder_;
+    String headerBlock_;                    ///< 正在接收的头部块
+    uint32_t headerStreamId_;               ///< 正在接收头部块的流, 0表示没有
+    bool headerEndStream_;                  ///< 头部块所在的HEADERS帧是否带有END_STREAM
+    uint32_t lastStreamId_;                 ///< 最大的客户端流ID, 写入时持有mutex_
+    bool goawayReceived_;                   ///< 对端已经发送GOAWAY
+    bool peerClosed_;                       ///< 对端已经关闭连接
+    std::chrono::steady_clock::time_point resetWindowStart_; ///< 统计客户端RST_STREAM频率的窗口起点
+    uint32_t resetCount_;                   ///< 当前窗口内收到的RST_STREAM数
+
+    //以下由mutex_保护
+    std::mutex mutex_;
+    std::map<uint32_t, StreamPtr> streams_; ///< 活跃的流
+    std::deque<StreamPtr> sendQueue_;       ///< 有响应待发送的流, 按响应完成的顺序
+    String controlFrames_;                  ///< 待发送的控制帧, 优先于流的数据发送
+    HpackEncoder encoder_;
+    uint32_t peerMaxFrameSize_;             ///< 对端允许的帧负载上限
+    int32_t peerInitialWindow_;             ///< 对端设置的流初始发送窗口
+    int64_t sendWindow_;                    ///< 连接的发送窗口
+    int64_t recvWindow_;                    ///< 连接的接收窗口
+    int64_t recvConsumed_;                  ///< 连接上已经消费还没有通告的字节数
+    size_t activeHandlers_;                 ///< 正在执行的处理协程数
+    size_t resetHandlers_;                  ///< 流已经被重置但仍在执行的处理协程数, 计入并发数
+    bool closing_;                          ///< 读循环已经结束, 不再接受新的流
+    bool goawaySent_;                       ///< 已经调用shutdown()发送GOAWAY, 不再接受新的流
+    uint32_t goawayStreamId_;               ///< shutdown()发送的GOAWAY中的流ID, 之后不能再增大
+    bool readShutdown_;                     ///< 所有流结束后已经关闭socket读端
+    bool writerDone_;                       ///< 写协程已经结束
+    bool writeError_;                       ///< socket写入失败
+    bool writerWaiting_;
+    coroutine::Processor::SuspendEntry writerEntry_;
+    bool doneWaiting_;
+    coroutine::Processor::SuspendEntry doneEntry_;
+};
+
+} // namespace http
+} // namespace net
+} // namespace nemo
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <memory>
+
+#include "net/http/http.h"
+#include "net/http/http_compress.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+class HttpSession;
+
+/**
+ * @brief HTTP请求消息体读取器
+ * @details 由servlet按需从连接上拉取消息体, 支持Content-Length和chunked两种编码,
+ *          内存占用只和每次读取的大小有关, 与消息体大小无关
+ */
+class HttpBodyReader {
+public:
+    typedef std::shared_ptr<HttpBodyReader> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<HttpBodyReader> UniquePtr; ///< 智能指针定义
+
+    /**
+     * @brief 构造函数
+     * @param[in] session 消息体所在的连接
+     */
+    explicit HttpBodyReader(HttpSession* session);
+
+    /**
+     * @brief 根据请求头部重置读取器
+     * @param[in] request HTTP请求
+     * @return 头部中描述的消息体是否合法
+     */
+    bool reset(HttpRequest* request);
+
+    /**
+     * @brief 读取消息体
+     * @param[out] buff 读取的数据
+     * @param[in] len buff的大小
+     * @return >0 读到的字节数
+     *         =0 消息体已读完
+     *         <0 连接异常或者编码错误
+     */
+    ssize_t read(void* buff, size_t len);
+
+    /**
+     * @brief 读取剩余的全部消息体
+     * @param[out] body 消息体追加到body后
+     * @param[in] maxSize body的最大长度
+     * @return >=0 成功, <0 失败或者超过maxSize
+     */
+    int readAll(String& body, size_t maxSize);
+
+    /**
+     * @brief 丢弃剩余的消息体, 使连接可以继续处理下一个请求
+     * @return =0 成功, <0 失败
+     */
+    int discard();
+
+    /**
+     * @brief 是否chunked编码
+     */
+    bool isChunked() const { return chunked_; }
+
+    /**
+     * @brief 消息体是否已经读完
+     */
+    bool isFinished() const { return state_ == State::DONE; }
+
+    /**
+     * @brief 返回消息体长度, chunked编码时返回-1
+     */
+    int64_t getContentLength() const { return contentLength_; }
+
+    /**
+     * @brief 返回已读取的消息体字节数
+     */
+    uint64_t getReadBytes() const { return readBytes_; }
+
+private:
+    enum class State : int8_t {
+        CHUNK_SIZE, ///< 等待chunk大小行
+        DATA,       ///< 读取数据
+        CHUNK_END,  ///< 等待chunk数据后的CRLF
+        TRAILER,    ///< 读取trailer
+        DONE,       ///< 消息体结束
+        ERROR       ///< 出错
+    };
+
+    /**
+     * @brief 处理chunk的控制部分, 直到需要读取数据或者消息体结束
+     * @return =0 成功, <0 失败
+     */
+    int advance();
+
+    /**
+     * @brief 数据读取了n个字节后更新状态
+     */
+    void onData(size_t n);
+
+private:
+    HttpSession* session_;
+    State state_;
+    bool chunked_;
+    int64_t contentLength_;
+    uint64_t remaining_;    ///< 当前chunk或者定长消息体剩余的字节数
+    uint64_t readBytes_;
+};
+
+/**
+ * @brief HTTP响应消息体写入器
+ * @details 响应头部在第一次写入时发送. 如果响应头部设置了Content-Length则按定长发送,
+ *          否则HTTP/1.1使用chunked编码, HTTP/1.0在发送完成后关闭连接.
+ *          写入的数据先合并到连接的发送缓冲区中, 缓冲区满时协程阻塞直到数据发出,
+ *          由此对servlet形成背压
+ */
+class HttpBodyWriter {
+public:
+    typedef std::shared_ptr<HttpBodyWriter> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<HttpBodyWriter> UniquePtr; ///< 智能指针定义
+
+    /**
+     * @brief 构造函数
+     * @param[in] session 响应所在的连接
+     */
+    explicit HttpBodyWriter(HttpSession* session);
+
+    /**
+     * @brief 绑定要发送的响应, 传入nullptr表示解除绑定
+     * @param[in] response HTTP响应
+     */
+    void reset(HttpResponse* response);
+
+    /**
+     * @brief 写入消息体
+     * @param[in] data 数据
+     * @param[in] len 数据长度
+     * @return >=0 写入的字节数
+     *         <0 连接异常或者超出了Content-Length
+     */
+    ssize_t write(const void* data, size_t len);
+
+    ssize_t write(StringArg data) { return write(data.data(), data.size()); }
+
+    /**
+     * @brief 发送文件的一段作为消息体
+     * @details 不压缩时通过Socket::sendFile发送, 数据不经过用户态(HTTPS开启kTLS时同样如此),
+     *          需要压缩时读出文件内容再写入
+     * @param[in] fd 文件描述符
+     * @param[in] offset 文件中的起始位置
+     * @param[in] length 发送的长度
+     * @return >=0 发送的字节数
+     *         <0 连接或文件异常, 或者超出了Content-Length
+     */
+    int64_t sendFile(int fd, off_t offset, size_t length);
+
+    /**
+     * @brief 结束消息体并发送缓存的数据
+     * @return >=0 成功, <0 失败, 此时连接不能再复用
+     */
+    int finish();
+
+    /**
+     * @brief 是否绑定了响应, 即响应以流的方式发送
+     */
+    bool isStreaming() const { return response_ != nullptr; }
+
+    /**
+     * @brief 响应头部是否已经发送
+     */
+    bool isStarted() const { return started_; }
+
+    /**
+     * @brief 是否已经结束
+     */
+    bool isFinished() const { return finished_; }
+
+    /**
+     * @brief 是否chunked编码
+     */
+    bool isChunked() const { return chunked_; }
+
+private:
+    /**
+     * @brief 确定消息体编码并发送响应头部
+     */
+    int start();
+
+    /**
+     * @brief 按传输编码写入(压缩之后的)数据
+     */
+    int64_t writeRaw(const void* data, size_t len);
+
+    /**
+     * @brief 为长度为len的一段数据加上chunked框架, 或者从Content-Length中扣除
+     * @param[in] send 发送数据本身, 返回<0表示失败
+     * @return >=0 发送的字节数, <0 连接异常或者超出了Content-Length
+     */
+    template<class Send>
+    int64_t writeFramed(size_t len, Send&& send);
+
+private:
+    /// 需要压缩时每次从文件读取的大小
+    constexpr static size_t kFileReadSize = 16 * 1024;
+
+private:
+    HttpSession* session_;
+    HttpResponse* response_;
+    HttpCompressor::UniquePtr compressor_; ///< 客户端接受压缩时使用
+    bool started_;
+    bool finished_;
+    bool chunked_;
+    int64_t remaining_;     ///< 定长消息体剩余的字节数, -1表示以关闭连接结束
+};
+
+} // namespace http
+} // namespace net
+} // namespace nemo
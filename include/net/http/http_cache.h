@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "net/http/http.h"
+#include "net/http/servlet.h"
+#include "container/lru_cache.h"
+#include "coroutine/scheduler.h"
+#include "common/types.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+/**
+ * @brief 响应中与共享缓存相关的Cache-Control指令
+ */
+struct HttpCacheControl {
+    bool noStore = false;
+    bool noCache = false;
+    bool isPrivate = false;
+    int64_t maxAge = -1;                ///< 秒, -1表示没有
+    int64_t sMaxAge = -1;               ///< 秒, -1表示没有, 优先于max-age
+    int64_t staleWhileRevalidate = 0;   ///< 秒
+
+    /**
+     * @brief 解析Cache-Control字段, 忽略不认识的指令
+     */
+    void parse(StringArg value);
+
+    /**
+     * @brief 共享缓存的新鲜期, <=0表示不能缓存
+     */
+    int64_t getTtl() const { return sMaxAge >= 0 ? sMaxAge : maxAge; }
+};
+
+/**
+ * @brief 响应缓存, 位于过滤器之后, servlet之前
+ * @details 路由挂载了过滤器时先执行过滤器的before(), 命中缓存也不会跳过鉴权、限流等过滤器.
+ *          只缓存GET请求, 键为路径+查询串, 响应的Vary字段列出的请求头部值也是键的一部分.
+ *          按Cache-Control的s-maxage/max-age决定新鲜期, 过期后在stale-while-revalidate
+ *          窗口内继续返回旧响应, 同时每个键只由一个协程在后台重新执行servlet.
+ *          带有If-None-Match并且与缓存的ETag匹配时返回304.
+ *          缓存分为若干分片, 每个分片有独立的锁和LruCache, 按字节数淘汰
+ */
+class HttpResponseCache : public std::enable_shared_from_this<HttpResponseCache> {
+public:
+    typedef std::shared_ptr<HttpResponseCache> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<HttpResponseCache> UniquePtr; ///< 智能指针定义
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * @brief 构造函数, 容量和分片数取自配置
+     * @param[in] scheduler 执行后台刷新的调度器
+     */
+    explicit HttpResponseCache(coroutine::Scheduler* scheduler);
+
+    /**
+     * @brief 处理请求, 命中时直接填充response, 否则执行servlet并尝试缓存结果
+     * @param[in] dispatcher 后台刷新时重新查找servlet, 生命周期需要长于缓存
+     * @param[in] servlet 请求匹配到的servlet, 挂载了过滤器时在过滤器之内查找缓存
+     * @return servlet的返回值, 命中缓存时为0
+     */
+    int32_t handle(ServletDispatcher* dispatcher, HttpServlet* servlet,
+                   HttpRequest* request, HttpResponse* response, HttpSession* session);
+
+    /**
+     * @brief 删除路径+查询串对应的所有缓存
+     */
+    void invalidate(StringArg path, StringArg query = StringArg());
+
+    /**
+     * @brief 清空缓存
+     */
+    void clear();
+
+    /**
+     * @brief 当前缓存的字节数
+     */
+    size_t getBytes();
+
+    /**
+     * @brief 是否启用(http.cache.enable)
+     */
+    static bool IsEnabled();
+
+    /**
+     * @brief If-None-Match是否与etag匹配(弱比较)
+     */
+    static bool MatchETag(StringArg ifNoneMatch, StringArg etag);
+
+private:
+    struct Entry;
+    struct Resource;
+    typedef std::shared_ptr<Entry> EntryPtr;
+    typedef std::shared_ptr<Resource> ResourcePtr;
+
+    /**
+     * @brief 一个分片, 以基础键(路径+查询串)为键, 同一个资源的各个Vary变体放在一起
+     */
+    struct Shard {
+        std::mutex mutex;
+        LruCache<String, ResourcePtr> resources;
+        size_t bytes = 0;
+        size_t maxBytes;
+
+        Shard(size_t maxEntries, size_t maxBytes);
+    };
+
+    /**
+     * @brief 选择基础键所在的分片
+     */
+    Shard& getShard(const String& baseKey);
+
+    /**
+     * @brief 在过滤器之内处理请求, 命中时直接填充response, 否则执行servlet
+     * @param[in] servlet 实际处理请求的servlet(不包括过滤器)
+     */
+    int32_t serveOrHandle(ServletDispatcher* dispatcher, HttpServlet* servlet,
+                          HttpRequest* request, HttpResponse* response, HttpSession* session);
+
+    /**
+     * @brief 查找请求对应的缓存
+     */
+    EntryPtr lookup(const String& baseKey, const HttpRequest* request);
+
+    /**
+     * @brief 响应可以缓存时保存
+     */
+    void store(const String& baseKey, const HttpRequest* request, const HttpResponse* response);
+
+    /**
+     * @brief 用缓存填充响应, 满足条件请求时返回304
+     */
+    static void Serve(const Entry& entry, const HttpRequest* request,
+                      HttpResponse* response, Clock::time_point now);
+
+    /**
+     * @brief 在后台协程中重新执行servlet刷新缓存
+     * @details 只执行实际的servlet, 不执行过滤器. 后台没有客户端连接,
+     *          servlet拿到的是一个没有连接的session: 消息体为空, 流式发送失败
+     */
+    void refresh(ServletDispatcher* dispatcher, const String& baseKey,
+                 const HttpRequest* request, const EntryPtr& entry);
+
+    /**
+     * @brief 基础键: 路径+查询串
+     */
+    static String BaseKey(StringArg path, StringArg query);
+
+    /**
+     * @brief Vary字段对应的请求头部值, 用来区分同一个资源的变体
+     */
+    static String VaryKey(const std::vector<String>& vary, const HttpRequest* request);
+
+private:
+    coroutine::Scheduler* scheduler_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+} // namespace http
+} // namespace net
+} // namespace nemo
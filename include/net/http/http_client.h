@@ -0,0 +1,195 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "net/http/http_connection.h"
+#include "coroutine/wait_group.h"
+#include "common/types.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+/**
+ * @brief HttpClient的一个请求
+ */
+struct HttpClientRequest {
+    HttpMethod method = HttpMethod::GET;    ///< 请求类型
+    String url;                             ///< 完整的url
+    std::map<String, String> headers;       ///< HTTP请求头部参数
+    String body;                            ///< 请求消息体
+    bool hedge = false;                     ///< 是否发送对冲请求, 只对GET和HEAD生效
+};
+
+/**
+ * @brief HttpClient的配置
+ */
+struct HttpClientOptions {
+    uint32_t maxIdlePerHost = 32;           ///< 每个主机最多保留的空闲连接数
+    uint32_t maxAliveTime = 60 * 1000;      ///< 连接的最长存活时间(毫秒)
+    uint32_t maxRequestPerConnection = 1000;///< 每个连接最多处理的请求数
+    double hedgePercentile = 95;            ///< 请求耗时超过该百分位时发送对冲请求
+    uint32_t hedgeMinDelay = 5;             ///< 对冲请求的最短延迟(毫秒)
+    uint32_t hedgeDefaultDelay = 50;        ///< 耗时样本不足时对冲请求的延迟(毫秒)
+};
+
+/**
+ * @brief 异步请求的结果
+ * @details 只能在协程中等待
+ */
+class HttpFuture {
+friend class HttpClient;
+public:
+    typedef std::shared_ptr<HttpFuture> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<HttpFuture> UniquePtr; ///< 智能指针定义
+    typedef std::chrono::steady_clock Clock;
+
+    HttpFuture();
+
+    /**
+     * @brief 等待请求结束
+     */
+    void wait() { done_.wait(); }
+
+    /**
+     * @brief 等待请求结束或者超时
+     * @return 请求是否已经结束
+     */
+    bool waitUntil(Clock::time_point deadline) { return done_.waitUntil(deadline); }
+
+    /**
+     * @brief 请求是否已经结束
+     */
+    bool isReady();
+
+    /**
+     * @brief 取出结果, 请求没有结束时返回nullptr
+     */
+    HttpResult::UniquePtr get();
+
+    /**
+     * @brief 取消请求, 正在进行的请求所在的连接被关闭, 结果为CANCELLED
+     */
+    void cancel();
+
+private:
+    /**
+     * @brief 设置结果, 只有第一个结果生效, 其他仍在进行的请求被取消
+     * @return 是否生效
+     */
+    bool complete(HttpResult::UniquePtr&& result);
+
+    /**
+     * @brief 登记正在进行的请求使用的socket, 请求已经结束时返回false
+     */
+    bool attach(Socket* sock);
+
+    void detach(Socket* sock);
+
+private:
+    std::mutex mutex_;
+    bool finished_ = false;
+    HttpResult::UniquePtr result_;
+    std::vector<Socket*> sockets_;          ///< 正在进行的请求使用的socket
+    coroutine::WaitGroup done_{1};
+};
+
+/**
+ * @brief 并发请求多个后端的HTTP客户端
+ * @details 每个主机一个HttpConnectionPool, 请求在独立的协程中执行.
+ *          对冲请求: 请求耗时超过该主机最近请求耗时的百分位时, 在另一个连接上再发送一次,
+ *          先返回的结果生效, 另一个被取消.
+ *          async()之外的接口只能在协程中调用
+ */
+class HttpClient {
+public:
+    typedef std::shared_ptr<HttpClient> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<HttpClient> UniquePtr; ///< 智能指针定义
+    typedef std::chrono::steady_clock Clock;
+
+    explicit HttpClient(const HttpClientOptions& options = HttpClientOptions());
+
+    /**
+     * @brief 在新的协程中发送请求
+     * @param[in] request 请求
+     * @param[in] timeoutMillionSeconds 超时时间(毫秒)
+     */
+    HttpFuture::SharedPtr async(const HttpClientRequest& request, uint64_t timeoutMillionSeconds);
+
+    /**
+     * @brief 并发发送所有请求, 等待全部结束或者超时, 超时未结束的请求被取消
+     * @param[in] requests 请求
+     * @param[in] timeoutMillionSeconds 所有请求共同的超时时间(毫秒)
+     * @return 与请求一一对应的结果
+     */
+    std::vector<HttpResult::UniquePtr> fanOut(const std::vector<HttpClientRequest>& requests,
+                                            uint64_t timeoutMillionSeconds);
+
+    /**
+     * @brief 按主机分组, 每组在一个连接上以HTTP/1.1流水线发送, 各组并发
+     * @param[in] requests 请求
+     * @param[in] timeoutMillionSeconds 每个响应的超时时间(毫秒)
+     * @return 与请求一一对应的结果
+     */
+    std::vector<HttpResult::UniquePtr> pipeline(const std::vector<HttpClientRequest>& requests,
+                                            uint64_t timeoutMillionSeconds);
+
+    /**
+     * @brief 取得主机的连接池
+     */
+    HttpConnectionPool::SharedPtr getPool(const Uri* uri);
+
+private:
+    /**
+     * @brief 最近请求的耗时, 用来计算对冲请求的延迟
+     */
+    class LatencyTracker {
+    public:
+        void add(uint32_t millionSeconds);
+        /**
+         * @brief 样本不足时返回-1
+         */
+        int64_t percentile(double p);
+
+    private:
+        static constexpr size_t kSamples = 256;
+        static constexpr size_t kMinSamples = 20;
+
+        std::mutex mutex_;
+        uint32_t samples_[kSamples];
+        size_t count_ = 0;
+    };
+
+    /**
+     * @brief 一个主机的连接池和请求耗时
+     */
+    struct Origin {
+        HttpConnectionPool::SharedPtr pool;
+        LatencyTracker latency;
+    };
+    typedef std::shared_ptr<Origin> OriginPtr;
+
+    OriginPtr getOrigin(const Uri* uri);
+
+    /**
+     * @brief 在一个连接上执行一次请求, 结果交给future
+     */
+    static void RunAttempt(HttpFuture::SharedPtr future, OriginPtr origin,
+                            std::shared_ptr<HttpRequest> request, Clock::time_point deadline);
+
+private:
+    HttpClientOptions options_;
+    std::mutex mutex_;
+    std::unordered_map<String, OriginPtr> origins_;    ///< scheme://host:port -> 主机
+};
+
+} // namespace http
+} // namespace net
+} // namespace nemo
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+
+#include "common/types.h"
+
+/* Content Codings (RFC 9110 8.4.1), 按服务端偏好从低到高排列 */
+#define HTTP_CONTENT_CODING_MAP(XX)     \
+  XX(0, IDENTITY,   identity)           \
+  XX(1, DEFLATE,    deflate)            \
+  XX(2, GZIP,       gzip)               \
+  XX(3, BROTLI,     br)                 \
+
+namespace nemo {
+namespace net {
+namespace http {
+
+class HttpResponse;
+
+/**
+ * @brief 消息体的压缩编码
+ */
+enum class HttpContentCoding : uint8_t {
+#define XX(num, name, string) name = num,
+    HTTP_CONTENT_CODING_MAP(XX)
+#undef XX
+};
+
+const char* HttpContentCoding2String(HttpContentCoding coding);
+
+/**
+ * @brief 根据Accept-Encoding选择压缩编码
+ * @details q值最高的编码中按br > gzip > deflate的顺序选择, q=0表示拒绝,
+ *          *匹配没有显式列出的编码. 当前版本不支持的编码(没有brotli)不会被选中
+ */
+HttpContentCoding NegotiateContentCoding(StringArg acceptEncoding);
+
+/**
+ * @brief 流式压缩器
+ */
+class HttpCompressor {
+public:
+    typedef std::shared_ptr<HttpCompressor> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<HttpCompressor> UniquePtr; ///< 智能指针定义
+
+    virtual ~HttpCompressor() = default;
+
+    /**
+     * @brief 压缩一段数据, 输出追加到out
+     * @param[in] finish 是否是最后一段, 为true时输出压缩流的结尾,
+     *            为false时同步刷新, 已经传入的数据全部输出, 对端可以立即解码
+     * @return 是否成功
+     */
+    virtual bool compress(const void* data, size_t len, String& out, bool finish) = 0;
+
+    /**
+     * @brief 创建压缩器, 级别取自配置
+     * @return 不支持的编码返回nullptr
+     */
+    static UniquePtr Create(HttpContentCoding coding);
+};
+
+/**
+ * @brief 响应压缩阶段
+ * @details 只压缩Content-Type在http.compress.types中的响应, 已经带有
+ *          Content-Encoding的响应原样发送.
+ *          完整消息体的响应压缩结果缓存在LRU中, 以(编码, 消息体摘要)为键,
+ *          命中时比较原始消息体, 摘要冲突不会返回其它响应的内容.
+ *          同一个消息体第二次出现时才放入缓存, 每次都不同的动态响应不会挤掉热点
+ */
+class HttpCompression {
+public:
+    /**
+     * @brief 是否启用压缩(http.compress.enable, 默认关闭)
+     */
+    static bool IsEnabled();
+
+    /**
+     * @brief 响应的Content-Type是否在允许压缩的列表中
+     */
+    static bool IsCompressibleType(StringArg contentType);
+
+    /**
+     * @brief 响应是否可以压缩(状态码、已有编码、类型), 不检查大小
+     */
+    static bool IsCompressible(const HttpResponse* response);
+
+    /**
+     * @brief 压缩完整的响应消息体
+     * @details 设置Content-Encoding和Vary, 强ETag改为弱ETag
+     * @param[in] coding 协商出的编码
+     * @return 是否压缩了消息体
+     */
+    static bool Apply(HttpContentCoding coding, HttpResponse* response);
+
+    /**
+     * @brief 为流式响应创建压缩器, 同时修改响应头部
+     * @details 已知Content-Length小于http.compress.min_size时不压缩,
+     *          压缩后长度未知, Content-Length会被移除
+     * @return 不需要压缩时返回nullptr
+     */
+    static HttpCompressor::UniquePtr Start(HttpContentCoding coding, HttpResponse* response);
+
+    /**
+     * @brief 清空压缩结果缓存
+     */
+    static void ClearCache();
+
+private:
+    /**
+     * @brief 设置压缩后的头部
+     */
+    static void SetEncodingHeaders(HttpContentCoding coding, HttpResponse* response);
+};
+
+} // namespace http
+} // namespace net
+} // namespace nemo
@@ -1,7 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <mutex>
-#include <list>
+#include <vector>
 
 #include "net/io/socket_stream.h"
 #include "net/http/http.h"
@@ -31,6 +32,7 @@ struct HttpResult {
         CREATE_SOCKET_ERROR     = 7,    ///< 创建Socket失败
         POOL_GET_CONNECTION     = 8,    ///< 从连接池中取连接失败
         POOL_INVALID_CONNECTION = 9,    ///< 无效的连接
+        CANCELLED               = 10,   ///< 请求被取消
     };
 
     /**
@@ -203,19 +205,70 @@ private:
     io::SocketStream::UniquePtr sockStream_;
     uint64_t createTime_ = 0;   ///< 创建时间
     uint64_t request_ = 0;
+    String pending_;            ///< 已经读到但属于下一个响应的数据(流水线)
 };
 
-class HttpConnectionPool {
+/**
+ * @brief 到同一个主机的HTTP连接池
+ * @details 空闲连接按线程分片保存在多个栈中, 取连接时先取本线程分片栈顶最近归还的连接,
+ *          没有时从其他分片取, 仍然没有才建立新连接.
+ *          取出的连接由Lease持有, Lease析构时归还, 超过存活时间、请求数或者对端已经关闭的连接不再归还.
+ *          maintain()清理空闲超时和已经失效的连接, 并把空闲连接补足到最小空闲数
+ */
+class HttpConnectionPool : public std::enable_shared_from_this<HttpConnectionPool> {
 public:
     typedef std::shared_ptr<HttpConnectionPool> SharedPtr; ///< 智能指针定义
     typedef std::unique_ptr<HttpConnectionPool> UniquePtr; ///< 智能指针定义
 
-    static HttpConnectionPool::UniquePtr Create(StringArg uriStr,
+    /**
+     * @brief 从连接池取出的连接, 析构时归还连接池
+     * @attention 不能比连接池存活得更久
+     */
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(HttpConnectionPool* pool, HttpConnection::UniquePtr&& connection, bool reused);
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        ~Lease();
+
+        HttpConnection* get() const { return connection_.get(); }
+        HttpConnection* operator->() const { return connection_.get(); }
+        explicit operator bool() const { return connection_ != nullptr; }
+
+        /**
+         * @brief 是否是复用的空闲连接
+         */
+        bool isReused() const { return reused_; }
+
+        /**
+         * @brief 不再归还连接池, Lease析构时关闭连接(请求失败或者响应要求关闭连接时)
+         */
+        void discard() { discarded_ = true; }
+
+    private:
+        HttpConnectionPool* pool_ = nullptr;
+        HttpConnection::UniquePtr connection_;
+        bool reused_ = false;
+        bool discarded_ = false;
+    };
+
+    static HttpConnectionPool::SharedPtr Create(StringArg uriStr,
                     StringArg vhost,
                     uint32_t maxSize,
                     uint32_t maxAliveTime,
                     uint32_t maxRequest);
 
+    /**
+     * @brief 构造函数
+     * @param[in] host 主机
+     * @param[in] vhost 请求的Host字段, 为空时使用host
+     * @param[in] port 端口, 为0时使用协议的默认端口
+     * @param[in] maxSize 最多保留的空闲连接数, 0表示不限制
+     * @param[in] maxAliveTime 连接的最长存活时间(毫秒), 0表示不限制
+     * @param[in] maxRequest 每个连接最多处理的请求数, 0表示不限制
+     * @param[in] isHttps 是否为https
+     */
     HttpConnectionPool(StringArg host,
                     StringArg vhost,
                     uint32_t port,
@@ -224,8 +277,44 @@ public:
                     uint32_t maxRequest,
                     bool isHttps);
 
-    HttpConnection* getConnection();
+    /**
+     * @brief 取出一个连接
+     * @return 无法建立连接时返回空的Lease
+     */
+    Lease acquire();
+
+    /**
+     * @brief 设置最小空闲连接数, maintain()会预先建立连接补足
+     */
+    void setMinIdle(uint32_t minIdle) { minIdle_ = minIdle; }
+
+    /**
+     * @brief 设置空闲连接的超时时间(毫秒), 0表示不限制
+     */
+    void setIdleTimeout(uint32_t idleTimeoutMillionSeconds) {
+        idleTimeoutMillionSeconds_ = idleTimeoutMillionSeconds;
+    }
+
+    /**
+     * @brief 清理失效的空闲连接, 补足最小空闲连接数
+     */
+    void maintain();
 
+    /**
+     * @brief 在协程中定期执行maintain(), 连接池析构后停止
+     * @param[in] intervalMillionSeconds 执行间隔(毫秒)
+     */
+    void startMaintenance(uint32_t intervalMillionSeconds = 1000);
+
+    /**
+     * @brief 当前空闲连接数
+     */
+    size_t getIdleCount() const { return idleCount_; }
+
+    /**
+     * @brief 当前被取出的连接数
+     */
+    size_t getLeasedCount() const { return leasedCount_; }
 
     /**
      * @brief 发送HTTP的GET请求
@@ -330,16 +419,93 @@ public:
     HttpResult::UniquePtr doRequest(HttpRequest* request, 
                 uint64_t timeoutMillionSeconds);
 
+    /**
+     * @brief 在取出的连接上发送HTTP请求
+     * @details 请求失败或者响应要求关闭连接时, 连接不再归还连接池
+     * @param[in] connection acquire()取出的连接
+     * @param[in] req 请求结构体
+     * @param[in] timeoutMillionSeconds 超时时间(毫秒)
+     * @return 返回HTTP结果结构体
+     */
+    HttpResult::UniquePtr doRequest(Lease& connection,
+                const HttpRequest* request,
+                uint64_t timeoutMillionSeconds);
+
+    /**
+     * @brief 构造发往连接池主机的请求, 默认使用长连接, 没有Host字段时补上
+     * @param[in] method 请求类型
+     * @param[in] path 路径(可以带查询参数)
+     * @param[in] headers HTTP请求头部参数
+     * @param[in] body 请求消息体
+     */
+    HttpRequest::UniquePtr createRequest(HttpMethod method,
+                StringArg path,
+                const std::map<String, String>& headers = {},
+                StringArg body = "");
+
+    /**
+     * @brief HTTP/1.1流水线: 在一个连接上连续发送多个请求, 再依次读取响应
+     * @details 只有GET请求参与流水线, 其他请求单独发送.
+     *          服务器确认支持HTTP/1.1长连接之前每次只发送一个请求;
+     *          连接中途被关闭时, 没有收到响应的请求在新连接上重新发送
+     * @param[in] requests 请求
+     * @param[in] timeoutMillionSeconds 每个响应的超时时间(毫秒)
+     * @return 与请求一一对应的结果
+     */
+    std::vector<HttpResult::UniquePtr> doPipeline(const std::vector<const HttpRequest*>& requests,
+                uint64_t timeoutMillionSeconds);
+
+private:
+    /**
+     * @brief 空闲连接
+     */
+    struct IdleConnection {
+        HttpConnection::UniquePtr connection;
+        uint64_t idleSince;                     ///< 归还的时间(毫秒)
+    };
+
+    /**
+     * @brief 一个分片的空闲连接栈, 栈顶是最近归还的连接
+     */
+    struct Shard {
+        std::mutex mutex;
+        std::vector<IdleConnection> idle;
+    };
+
+    /**
+     * @brief 建立新连接
+     */
+    HttpConnection::UniquePtr connect();
+
+    /**
+     * @brief 连接是否还可以复用
+     */
+    bool isReusable(const HttpConnection* connection, uint64_t idleSince, uint64_t now) const;
+
+    /**
+     * @brief 归还连接
+     */
+    void release(HttpConnection::UniquePtr&& connection);
+
+    /**
+     * @brief 当前线程对应的分片下标
+     */
+    size_t shardIndex() const;
+
 private:
-    std::mutex mutex_;
     String host_;                               ///< host
     String vhost_;                              ///< virtual host
     uint32_t port_;                             ///< 端口
-    uint32_t maxSize_;                          ///< 最大连接数
+    uint32_t maxSize_;                          ///< 最多保留的空闲连接数
     uint32_t maxAliveTime_;                     ///< 存活时间
     uint32_t maxRequest_;                       ///< 最大请求数
-    std::list<HttpConnection::UniquePtr> connections_;  ///< http连接
     bool isHttps_;                              ///< 是否为https
+    std::atomic<uint32_t> minIdle_{0};          ///< 最小空闲连接数
+    std::atomic<uint32_t> idleTimeoutMillionSeconds_{30000}; ///< 空闲超时时间
+    std::atomic<size_t> idleCount_{0};          ///< 空闲连接数
+    std::atomic<size_t> leasedCount_{0};        ///< 被取出的连接数
+    std::atomic<bool> pipelining_{false};       ///< 服务器是否支持流水线
+    std::vector<std::unique_ptr<Shard>> shards_;    ///< 空闲连接分片
 };
 
 } // namespace http
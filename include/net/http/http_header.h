@@ -0,0 +1,214 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <memory_resource>
+#include <utility>
+
+#include "common/types.h"
+#include "container/small_vector.h"
+
+#define HTTP_HEADER_MAP(XX)                                 \
+  XX(1,  HOST,                Host)                         \
+  XX(2,  CONTENT_LENGTH,      Content-Length)               \
+  XX(3,  CONTENT_TYPE,        Content-Type)                 \
+  XX(4,  CONNECTION,          Connection)                   \
+  XX(5,  TRANSFER_ENCODING,   Transfer-Encoding)            \
+  XX(6,  ACCEPT,              Accept)                       \
+  XX(7,  ACCEPT_ENCODING,     Accept-Encoding)              \
+  XX(8,  ACCEPT_LANGUAGE,     Accept-Language)              \
+  XX(9,  USER_AGENT,          User-Agent)                   \
+  XX(10, COOKIE,              Cookie)                       \
+  XX(11, SET_COOKIE,          Set-Cookie)                   \
+  XX(12, CACHE_CONTROL,       Cache-Control)                \
+  XX(13, CONTENT_ENCODING,    Content-Encoding)             \
+  XX(14, DATE,                Date)                         \
+  XX(15, SERVER,              Server)                       \
+  XX(16, UPGRADE,             Upgrade)                      \
+  XX(17, EXPECT,              Expect)                       \
+  XX(18, KEEP_ALIVE,          Keep-Alive)                   \
+  XX(19, LOCATION,            Location)                     \
+  XX(20, ETAG,                ETag)                         \
+  XX(21, IF_NONE_MATCH,       If-None-Match)                \
+  XX(22, IF_MODIFIED_SINCE,   If-Modified-Since)            \
+  XX(23, LAST_MODIFIED,       Last-Modified)                \
+  XX(24, RANGE,               Range)                        \
+  XX(25, REFERER,             Referer)                      \
+  XX(26, AUTHORIZATION,       Authorization)                \
+  XX(27, ORIGIN,              Origin)                       \
+  XX(28, VARY,                Vary)                         \
+  XX(29, X_FORWARDED_FOR,     X-Forwarded-For)              \
+  XX(30, SEC_WEBSOCKET_KEY,   Sec-WebSocket-Key)            \
+  XX(31, SEC_WEBSOCKET_VERSION, Sec-WebSocket-Version)      \
+
+namespace nemo {
+namespace net {
+namespace http {
+
+/**
+ * @brief 常用HTTP头部字段的编号, 解析时预先计算, 查找时不需要比较字符串
+ */
+enum class HttpHeaderId : uint8_t {
+    UNKNOWN = 0,
+#define XX(num, name, string) name = num,
+    HTTP_HEADER_MAP(XX)
+#undef XX
+    COUNT
+};
+
+/**
+ * @brief 把头部字段名转成编号(忽略大小写)
+ * @return 不是常用字段时返回HttpHeaderId::UNKNOWN
+ */
+HttpHeaderId String2HttpHeaderId(StringArg name);
+
+/**
+ * @brief 返回常用字段的标准名称
+ */
+const char* HttpHeaderId2String(HttpHeaderId id);
+
+/**
+ * @brief 扁平的HTTP头部容器
+ * @details 所有字段名和字段值连续存放在一块内存中, 字段索引存放在内联数组中,
+ *          常见的请求只需要一次内存分配. 常用字段通过编号直接定位,
+ *          其余字段线性查找(忽略大小写). 字段名不重复, set会覆盖已有的值.
+ *          覆盖和删除留下的空洞超过一半时整理内存
+ */
+class HttpHeaders {
+public:
+    /// 头部字段, 指向容器内部的内存, 容器修改后失效
+    typedef std::pair<StringArg, StringArg> value_type;
+
+private:
+    struct Entry {
+        uint32_t nameOffset;
+        uint32_t valueOffset;
+        uint32_t valueLength;
+        uint32_t valueCapacity;     ///< 值占用的空间, 覆盖时放得下就原地写入
+        uint16_t nameLength;
+        HttpHeaderId id;
+    };
+    typedef SmallVector<Entry, 16> EntryVector;
+
+public:
+    /**
+     * @brief 按插入顺序遍历字段的迭代器
+     */
+    class const_iterator {
+    public:
+        const_iterator(const HttpHeaders* headers, size_t index) :
+            headers_(headers), index_(index) {
+        }
+        value_type operator*() const { return headers_->at(index_); }
+        const_iterator& operator++() { ++index_; return *this; }
+        bool operator==(const const_iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const const_iterator& other) const { return index_ != other.index_; }
+
+    private:
+        const HttpHeaders* headers_;
+        size_t index_;
+    };
+
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] resource 字段内容使用的内存资源, 可以传入请求级别的内存池
+     */
+    explicit HttpHeaders(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    /**
+     * @brief 获取字段值
+     * @param[in] name 字段名, 忽略大小写
+     * @param[in] defaultVal 默认值
+     */
+    StringArg get(StringArg name, StringArg defaultVal = StringArg()) const;
+
+    /**
+     * @brief 通过编号获取常用字段的值, O(1)
+     */
+    StringArg get(HttpHeaderId id, StringArg defaultVal = StringArg()) const;
+
+    /**
+     * @brief 字段是否存在
+     * @param[in] name 字段名
+     * @param[out] val 如果存在, val非空则赋值
+     */
+    bool has(StringArg name, StringArg* val = nullptr) const;
+
+    bool has(HttpHeaderId id) const { return known_[static_cast<size_t>(id)] >= 0; }
+
+    /**
+     * @brief 设置字段, 已经存在时覆盖
+     */
+    void set(StringArg name, StringArg value);
+
+    /**
+     * @brief 删除字段
+     */
+    void erase(StringArg name);
+
+    /**
+     * @brief 清空所有字段, 保留已经分配的内存
+     */
+    void clear();
+
+    /**
+     * @brief 返回第index个字段
+     */
+    value_type at(size_t index) const;
+
+    /**
+     * @brief 字段内容使用的内存资源
+     */
+    std::pmr::memory_resource* getResource() const { return storage_.get_allocator().resource(); }
+
+    /**
+     * @brief 字段内容占用的内存, 包括还没有整理的空洞
+     */
+    size_t getStorageSize() const { return storage_.size(); }
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, entries_.size()); }
+
+private:
+    /**
+     * @brief 查找字段的索引, 不存在返回-1
+     */
+    int find(StringArg name, HttpHeaderId id) const;
+
+    StringArg valueOf(const Entry& entry) const {
+        return StringArg(storage_.data() + entry.valueOffset, entry.valueLength);
+    }
+
+    /**
+     * @brief 把数据追加到storage_中, 返回偏移
+     */
+    uint32_t store(StringArg data);
+
+    /**
+     * @brief 释放一段不再使用的空间, 位于末尾时直接截断, 否则记为空洞
+     */
+    void release(uint32_t offset, uint32_t length);
+
+    /**
+     * @brief 空洞超过一半时把所有字段重新紧凑存放
+     */
+    void compact();
+
+    /**
+     * @brief 删除第index个字段并更新常用字段的索引
+     */
+    void eraseAt(int index);
+
+private:
+    std::pmr::string storage_;                              ///< 字段名和字段值
+    uint32_t holes_ = 0;                                    ///< storage_中不再使用的字节数
+    EntryVector entries_;                                   ///< 字段索引, 保持插入顺序
+    int16_t known_[static_cast<size_t>(HttpHeaderId::COUNT)]; ///< 常用字段在entries_中的位置, -1表示不存在
+};
+
+} // namespace http
+} // namespace net
+} // namespace nemo
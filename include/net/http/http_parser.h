@@ -3,6 +3,7 @@
 #include "net/http/http.h"
 #include "net/http/http11_parser.h"
 #include "net/http/http_client_parser.h"
+#include "net/http/http_simd_parser.h"
 
 namespace nemo {
 namespace net {
@@ -38,11 +39,22 @@ public:
      */
     static size_t GetHttpRequestMaxBodySize();
 
+    /**
+     * @brief 是否使用SIMD解析器(http.request.parser为simd), 否则使用ragel解析器
+     */
+    static bool IsSimdParserEnabled();
+
     /**
      * @brief 构造函数
      */
     HttpRequestParser();
 
+    /**
+     * @brief 重置解析器状态, 以便在同一个连接上解析下一个请求
+     * @param[in] resource 新请求使用的内存资源
+     */
+    void reset(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
     /**
      * @brief 解析协议
      * @param[in, out] data 协议文本内存
@@ -67,7 +79,7 @@ public:
 
     bool hasError() {
         return error_ != HttpParserError::OK || 
-            http_parser_has_error(&parser_);
+            (!simd_ && http_parser_has_error(&parser_));
     }
 
     /**
@@ -75,6 +87,11 @@ public:
      */
     HttpRequest* getRequest() const { return request_.get(); }
 
+    /**
+     * @brief 是否使用SIMD解析器
+     */
+    bool isSimd() const { return simd_; }
+
     /**
      * @brief 获取消息体长度
      */
@@ -85,10 +102,19 @@ public:
      */
     const http_parser& getParser() const { return parser_; }
 
+private:
+    /**
+     * @brief 用SIMD解析器解析, 要求data中包含完整的头部
+     */
+    size_t executeSimd(char* data, size_t len);
+
 private:
     http_parser parser_;             ///< http_parser
     HttpRequest::UniquePtr request_; ///< HttpRequest结构 
     HttpParserError error_;              
+    bool simd_;                      ///< 是否使用SIMD解析器
+    bool simdFinished_;              ///< SIMD解析器是否解析完成
+    HttpRequestSlices slices_;       ///< SIMD解析器的输出
 };
 
 /**
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "net/http/http_method.h"
+#include "common/types.h"
+#include "container/small_vector.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+class IServletCreator;
+
+/**
+ * @brief 基于压缩前缀树(radix tree)的路由表
+ * @details 路由模式由三种片段组成:
+ *          - 静态片段: /api/users
+ *          - 参数片段: /api/users/:id, 匹配到下一个'/'之前的内容(不能为空)
+ *          - 通配片段: '*'或者'*file', 例如/Nemo_*, 匹配剩余的全部内容(可以为空), 只能出现在末尾
+ *          匹配时静态片段优先, 其次参数片段, 最后通配片段, 失败时回溯.
+ *          查找的代价只和路径长度有关, 与路由数量无关
+ * @attention 非线程安全, 并发读写时由调用者复制一份修改后再整体替换(见ServletDispatcher)
+ */
+class HttpRouter {
+public:
+    typedef std::shared_ptr<HttpRouter> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<HttpRouter> UniquePtr; ///< 智能指针定义
+    typedef std::shared_ptr<IServletCreator> Handler; ///< 路由处理器, 复制路由表时共享
+
+    /// 匹配所有方法
+    constexpr static HttpMethod kAnyMethod = HttpMethod::INVALID_METHOD;
+
+    /**
+     * @brief 路径参数, 名称指向路由表, 值指向请求路径
+     */
+    struct Param {
+        StringArg name;
+        StringArg value;
+    };
+    typedef SmallVector<Param, 8> Params;
+
+public:
+    HttpRouter();
+    ~HttpRouter();
+
+    /**
+     * @brief 深拷贝路由树, 处理器是共享的
+     */
+    HttpRouter(const HttpRouter& other);
+    HttpRouter& operator=(const HttpRouter&) = delete;
+
+    /**
+     * @brief 添加路由, 已经存在时覆盖
+     * @param[in] method 请求方法, kAnyMethod表示匹配所有方法
+     * @param[in] pattern 路由模式
+     * @param[in] handler 处理器
+     * @return 模式不合法或者与已有的参数/通配片段名称冲突时返回false
+     */
+    bool add(HttpMethod method, StringArg pattern, Handler&& handler);
+
+    /**
+     * @brief 删除路由
+     * @return 路由是否存在
+     */
+    bool remove(HttpMethod method, StringArg pattern);
+
+    /**
+     * @brief 查找路由
+     * @param[in] method 请求方法, 优先匹配相同方法的路由, 其次是kAnyMethod的路由
+     * @param[in] path 请求路径
+     * @param[out] params 非空时保存匹配到的路径参数
+     * @return 没有匹配的路由返回nullptr
+     */
+    IServletCreator* match(HttpMethod method, StringArg path, Params* params = nullptr) const;
+
+    /**
+     * @brief 返回能匹配path的路由允许的方法, 用于405响应的Allow头部
+     * @details 只在按请求方法匹配失败后调用, 这时匹配所有方法的路由不会命中path
+     * @return 以", "分隔的方法列表, 没有路由匹配path时返回空
+     */
+    String getAllowedMethods(StringArg path) const;
+
+    /**
+     * @brief 查找模式完全相同的路由(不做参数匹配)
+     */
+    IServletCreator* find(HttpMethod method, StringArg pattern) const;
+
+    /**
+     * @brief 遍历所有路由, 可以在回调中替换处理器
+     * @param[in] cb 参数为方法、注册时的路由模式和处理器
+     */
+    void forEach(const std::function<void(HttpMethod method, StringArg pattern, Handler& handler)>& cb);
+
+    /**
+     * @brief 路由数量
+     */
+    size_t size() const { return size_; }
+
+    /**
+     * @brief 删除所有路由
+     */
+    void clear();
+
+private:
+    struct Node;
+
+    /**
+     * @brief 按模式找到对应的节点
+     * @param[in] create 不存在时是否创建
+     */
+    Node* locate(StringArg pattern, bool create);
+
+    /**
+     * @brief 在node的静态子节点中插入s, 返回s结尾处的节点
+     */
+    static Node* insertStatic(Node* node, StringArg s);
+
+    /**
+     * @brief 在node的静态子节点中查找刚好在s结尾处的节点
+     */
+    static Node* findStatic(Node* node, StringArg s);
+
+    /**
+     * @brief 递归匹配, 失败时回溯
+     */
+    static const Node* matchNode(const Node* node, HttpMethod method, StringArg path, Params* params);
+
+    /**
+     * @brief 递归遍历, pattern为node结尾处的路由模式
+     */
+    static void forEachNode(Node* node, String& pattern,
+            const std::function<void(HttpMethod method, StringArg pattern, Handler& handler)>& cb);
+
+private:
+    std::unique_ptr<Node> root_; ///< 根节点, 对应空前缀
+    size_t size_;                ///< 路由数量
+};
+
+} // namespace http
+} // namespace net
+} // namespace nemo
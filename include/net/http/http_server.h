@@ -3,6 +3,8 @@
 #include "net/tcp_server.h"
 #include "net/http/http_session.h"
 #include "net/http/servlet.h"
+#include "net/http/http_cache.h"
+#include "net/http/rate_limiter.h"
 
 namespace nemo {
 namespace net {
@@ -36,11 +38,39 @@ public:
     void setServletDispatch(ServletDispatcher::UniquePtr&& servletDispatcher) { 
         dispatcher_ = std::move(servletDispatcher); }
 
+    /**
+     * @brief 获取响应缓存, 没有启用http.cache.enable时为空
+     */
+    HttpResponseCache* getResponseCache() const { return cache_.get(); }
+
+    /**
+     * @brief 设置限流, 为空时不限流
+     * @details 默认按http.rate_limit.rules创建, 需要在start()之前设置
+     */
+    void setRateLimiter(const HttpRateLimiter::SharedPtr& rateLimiter) { rateLimiter_ = rateLimiter; }
+
 protected:
     void handleClient(Socket::SharedPtr client) override;
 
+private:
+    /**
+     * @brief 处理h2c升级请求
+     * @return 是否已经接管连接, 返回true时调用者不能再使用连接
+     */
+    bool upgradeHttp2(Socket::SharedPtr client, HttpSession* session,
+                      HttpRequest* request);
+
+    /**
+     * @brief 请求超过限流时直接返回429, 不分发给servlet
+     * @param[out] close 响应是否要求关闭连接(带有消息体的请求不读取消息体, 连接不能继续使用)
+     * @return 是否被拒绝
+     */
+    bool rejectRequest(Socket* client, HttpSession* session, HttpRequest* request, bool& close);
+
 private:
     ServletDispatcher::UniquePtr dispatcher_; ///< Servlet分发器
+    HttpResponseCache::SharedPtr cache_;      ///< 响应缓存
+    HttpRateLimiter::SharedPtr rateLimiter_;  ///< 限流
     bool keepalive_;                          ///< 是否支持长连接
 };
 
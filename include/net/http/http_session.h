@@ -1,7 +1,13 @@
 #pragma once
 
+#include <functional>
+
 #include "net/http/http.h"
+#include "net/http/http_parser.h"
+#include "net/http/http_body.h"
 #include "net/io/socket_stream.h"
+#include "container/arena.h"
+#include "container/buffer.h"
 
 namespace nemo {
 namespace net {
@@ -9,11 +15,20 @@ namespace http {
 
 /**
  * @brief HTTPSession封装
+ * @details 每个连接持有一个可复用的读缓冲区和请求解析器,
+ *          读多了的数据(流水线请求)保留在缓冲区中供下一个请求使用.
+ *          请求的头部/参数以及响应的头部从连接持有的内存池中分配,
+ *          接收下一个请求时整体释放
  */
 class HttpSession {
+friend class HttpBodyReader;
+friend class HttpBodyWriter;
+friend class WsSession;
 public:
     typedef std::shared_ptr<HttpSession> SharedPtr; ///< 智能指针定义
     typedef std::unique_ptr<HttpSession> UniquePtr; ///< 智能指针定义
+    typedef std::function<void()> DrainCallback;
+    typedef std::function<void(DrainCallback)> DrainRegistrar;
 
     /**
      * @brief 构造函数
@@ -25,12 +40,71 @@ public:
     HttpSession(Socket::UniquePtr&& sock);
 
     /**
-     * @brief 接收HTTP请求
+     * @brief 不关联连接的会话, 用于缓存的后台刷新等没有客户端的场合
+     * @details 不占用fd, 请求没有消息体, 流式发送和切换协议都会失败
+     */
+    HttpSession();
+
+    /**
+     * @brief 连接的socket, 不关联连接时为nullptr
+     */
+    Socket* getSocket() const {
+        return sockStream_->getSocket();
+    }
+
+    /**
+     * @brief 接收HTTP请求, 包括完整的消息体
+     * @attention 返回的请求使用连接的内存池, 必须在接收下一个请求之前析构
      */
     HttpRequest::UniquePtr recvRequest();
 
+    /**
+     * @brief 只接收HTTP请求的头部, 消息体留在连接上
+     * @details 消息体可以通过getBodyReader()流式读取, 或者通过readBody()一次性读取.
+     *          上一个请求没有读完的消息体会在这里丢弃
+     */
+    HttpRequest::UniquePtr recvRequestHeader();
+
+    /**
+     * @brief 返回当前请求使用的内存池, 创建响应时传入可以避免头部的堆分配
+     * @attention 从这里分配的对象必须在接收下一个请求之前析构
+     */
+    std::pmr::memory_resource* getResource() { return &arena_; }
+
+    /**
+     * @brief 当前请求协商出的响应压缩编码
+     */
+    HttpContentCoding getContentCoding() const { return coding_; }
+
+    /**
+     * @brief 读取完整的消息体并设置到request中
+     * @param[in] request recvRequestHeader()返回的请求
+     * @return >=0 成功, <0 失败或者超过http.request.max_body_size
+     */
+    int readBody(HttpRequest* request);
+
+    /**
+     * @brief 返回当前请求的消息体读取器
+     */
+    HttpBodyReader* getBodyReader() { return &bodyReader_; }
+
+    /**
+     * @brief 以流的方式发送response, 返回消息体写入器
+     * @details 在第一次写入之前可以继续修改response的头部,
+     *          之后sendResponse()只负责结束消息体
+     * @param[in] response HTTP响应
+     */
+    HttpBodyWriter* getBodyWriter(HttpResponse* response);
+
+    /**
+     * @brief 当前响应是否已经以流的方式发送
+     */
+    bool isStreamingResponse() const { return bodyWriter_.isStreaming(); }
+
     /**
      * @brief 发送HTTP响应
+     * @details 如果缓冲区中还有未处理的流水线请求, 响应会先缓存起来,
+     *          等到没有待处理请求或者需要从socket读取时再一次性发送, 保证响应顺序与请求顺序一致
      * @param[in] response HTTP响应
      * @return >0 发送成功
      *         =0 对方关闭
@@ -38,10 +112,138 @@ public:
      */
     int sendResponse(const HttpResponse* response);
 
+    /**
+     * @brief 发送所有缓存的响应
+     * @return >0 发送成功
+     *         =0 对方关闭或者没有需要发送的数据
+     *         <0 Socket异常
+     */
+    int flush();
+
+    /**
+     * @brief 检查连接是否以HTTP/2客户端连接前言开始(prior knowledge)
+     * @details 读取到足够判断的数据为止, 读到的数据保留在读缓冲区中
+     */
+    bool isHttp2Preface();
+
+    /**
+     * @brief 发送101响应切换协议, 之后连接交给新协议处理
+     * @details 连接相关的字段(Connection/Upgrade)原样输出, 响应不能有消息体.
+     *          读缓冲区中已经收到的新协议数据通过getBufferedData()获取
+     * @param[in] response 状态码之外的响应头部
+     * @return 发送是否成功
+     */
+    bool switchProtocol(const HttpResponse* response);
+
+    /**
+     * @brief 是否已经切换到其它协议, 之后不能再发送HTTP响应
+     */
+    bool isUpgraded() const { return upgraded_; }
+
+    /**
+     * @brief 读缓冲区中还没有处理的数据, 切换协议时交给新协议
+     */
+    StringArg getBufferedData() const {
+        return StringArg(readBuffer_.data(), readBuffer_.size());
+    }
+
+    /**
+     * @brief 由服务器设置, 把连接的排空回调注册到服务器上
+     */
+    void setDrainRegistrar(DrainRegistrar registrar) { drainRegistrar_ = std::move(registrar); }
+
+    /**
+     * @brief 设置服务器优雅关闭时的回调, 供长时间占用连接的servlet(websocket)通知对端
+     * @details 回调可能在其它线程中执行, 已经开始优雅关闭时立即执行.
+     *          传入空回调取消注册, servlet返回之前必须取消. 没有关联服务器时忽略
+     */
+    void setDrainCallback(DrainCallback callback) {
+        if(drainRegistrar_) {
+            drainRegistrar_(std::move(callback));
+        }
+    }
+
+    /**
+     * @brief 读缓冲区中是否还有未处理的数据(流水线请求)
+     */
+    bool hasPendingRequest() const {
+        return bodyReader_.isFinished() && !readBuffer_.empty();
+    }
+
+private:
+    /**
+     * @brief 从socket读取数据追加到读缓冲区
+     * @details 读取之前先发送缓存的响应, 避免与等待响应的客户端互相等待
+     * @return >0 读到的字节数, <=0 缓冲区已满或者连接异常
+     */
+    int fill();
+
+    /**
+     * @brief 读取数据, 优先从读缓冲区中读取
+     */
+    ssize_t readSome(void* buff, size_t len);
+
+    /**
+     * @brief 读取一行, 不包括行尾的CRLF
+     * @return >=0 成功, <0 行超过缓冲区大小或者连接异常
+     */
+    int readLine(String& line);
+
+    /**
+     * @brief 跳过最多n个字节
+     * @return >0 跳过的字节数, <=0 连接异常
+     */
+    int skip(size_t n);
+
+    /**
+     * @brief 写入数据, 小块数据先合并到发送缓冲区中
+     * @return >=0 成功, <0 连接异常
+     */
+    ssize_t write(const void* data, size_t len);
+
+    /**
+     * @brief 先发送缓存的数据, 再发送文件的一段
+     * @return >=0 成功, <0 连接或文件异常
+     */
+    int64_t sendFile(int fd, off_t offset, size_t length);
+
+    /**
+     * @brief Unix域socket连接在建立时获取一次对端凭证
+     */
+    void initPeerCredentials();
+
+    /**
+     * @brief 丢弃读缓冲区头部n个字节, 剩余数据移动到缓冲区头部
+     */
+    void consume(size_t n);
+
+    /**
+     * @brief 发送缓存的响应后关闭连接
+     */
+    void close();
+
+private:
+    /// 缓存的响应超过该大小时立即发送
+    constexpr static size_t kMaxPendingResponseBytes = 64 * 1024;
+    /// 不经过缓冲区时每次写入的最大长度
+    constexpr static size_t kMaxWriteSize = 1 << 30;
+    /// 内存池的内联大小, 足够一般请求的头部和参数使用
+    constexpr static size_t kArenaInitialSize = 4096;
+
 private:
     io::SocketStream::UniquePtr sockStream_;
+    Arena<kArenaInitialSize> arena_;      ///< 请求级别的内存池, 必须比parser_先构造后析构
+    HttpRequestParser::UniquePtr parser_; ///< 可复用的请求解析器
+    Buffer readBuffer_;                   ///< 读缓冲区, [data(), end())为未处理数据
+    String writeBuffer_;                  ///< 待发送的响应
+    HttpBodyReader bodyReader_;           ///< 当前请求的消息体读取器
+    HttpBodyWriter bodyWriter_;           ///< 当前响应的消息体写入器
+    bool upgraded_ = false;               ///< 已经发送101切换协议
+    DrainRegistrar drainRegistrar_;       ///< 注册排空回调, 不是由服务器处理的连接时为空
+    std::optional<PeerCredentials> peerCredentials_; ///< Unix域socket的对端凭证, 设置到每个请求上
+    HttpContentCoding coding_ = HttpContentCoding::IDENTITY; ///< 当前请求接受的压缩编码
 };
 
 } // namespace http
 } // namespace net
-} // namespace nemo
\ No newline at end of file
+} // namespace nemo
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+
+#include "common/types.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+/**
+ * @brief 头部字段切片, 指向原始报文, 不拷贝数据
+ */
+struct HttpHeaderSlice {
+    StringArg name;  ///< 字段名
+    StringArg value; ///< 字段值, 已去掉首尾空白
+};
+
+/**
+ * @brief 请求行和头部的切片
+ * @details 所有切片都指向传给ParseHttpRequest的内存,
+ *          在这块内存被修改或者释放之前有效
+ */
+struct HttpRequestSlices {
+    /// 最多支持的头部字段数量
+    constexpr static size_t kMaxHeaders = 64;
+
+    StringArg method;     ///< 请求方法
+    StringArg path;       ///< 请求路径
+    StringArg query;      ///< 请求参数, 不包括'?'
+    StringArg fragment;   ///< fragment, 不包括'#'
+    int minorVersion = 0; ///< HTTP/1.x中的x
+    size_t headerCount = 0;
+    std::array<HttpHeaderSlice, kMaxHeaders> headers;
+};
+
+/**
+ * @brief 解析HTTP/1.x请求行和头部
+ * @details 在支持SSE4.2的CPU上用PCMPESTRI一次扫描16个字节查找分隔符,
+ *          否则逐字节扫描. 只解析到头部结束的空行, 不处理消息体
+ * @param[in] data 报文
+ * @param[in] len 报文长度
+ * @param[out] slices 解析结果
+ * @return >0 头部长度(包括结束的空行)
+ *         -1 格式错误
+ *         -2 头部不完整
+ */
+int ParseHttpRequest(const char* data, size_t len, HttpRequestSlices& slices);
+
+/**
+ * @brief 当前CPU是否会使用SIMD扫描
+ */
+bool IsHttpSimdParserAccelerated();
+
+} // namespace http
+} // namespace net
+} // namespace nemo
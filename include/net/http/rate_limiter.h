@@ -0,0 +1,187 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "container/lru_cache.h"
+#include "common/lexical_cast.h"
+#include "common/types.h"
+
+namespace nemo {
+namespace net {
+
+class Address;
+
+namespace http {
+
+class HttpRequest;
+
+/**
+ * @brief 限流规则(http.rate_limit.rules)
+ */
+struct RateLimitRule {
+    String key = "ip";      ///< 限流的键: ip, route(前缀下的所有请求共享), header:<字段名>
+    String prefix;          ///< 请求路径前缀, 为空时对所有请求生效
+    double rate = 0;        ///< 每秒允许的请求数
+    uint32_t burst = 1;     ///< 允许的突发请求数
+
+    bool operator==(const RateLimitRule& other) const {
+        return key == other.key && prefix == other.prefix &&
+               rate == other.rate && burst == other.burst;
+    }
+};
+
+/**
+ * @brief GCRA(通用信元速率算法)限流器
+ * @details 每个键只保存一个理论到达时间(TAT), 与令牌桶等价但不需要定时补充令牌.
+ *          键表分成若干分片, 每个分片是有容量上限的LruCache, 最久未出现的键被淘汰.
+ *          分片锁只保护键表的查找, TAT的更新在锁外通过CAS完成
+ */
+class GcraLimiter {
+public:
+    typedef std::shared_ptr<GcraLimiter> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<GcraLimiter> UniquePtr; ///< 智能指针定义
+    typedef std::shared_ptr<std::atomic<int64_t>> Bucket; ///< 一个键的TAT
+
+    /**
+     * @brief 构造函数
+     * @param[in] rate 每秒允许的请求数
+     * @param[in] burst 允许的突发请求数
+     * @param[in] maxKeys 最多记录的键数
+     * @param[in] shards 分片数
+     */
+    GcraLimiter(double rate, uint32_t burst, size_t maxKeys, size_t shards = 16);
+
+    /**
+     * @brief 尝试通过一个请求
+     * @param[in] key 限流的键
+     * @param[in] now 当前时间(纳秒, 单调时钟)
+     * @param[out] acquired 允许时返回键对应的桶, 用于之后退还, 可以为空
+     * @return 0表示允许, >0表示被拒绝并且需要等待的纳秒数
+     */
+    int64_t acquire(StringArg key, int64_t now, Bucket* acquired = nullptr);
+
+    /**
+     * @brief 退还acquire()放行的一个请求, 把TAT向前移回一个间隔
+     */
+    void refund(const Bucket& bucket) {
+        bucket->fetch_sub(interval_, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 当前记录的键数
+     */
+    size_t size();
+
+private:
+    /**
+     * @brief 键表的哈希, 支持直接用StringArg查找
+     */
+    struct KeyHash {
+        typedef void is_transparent;
+        size_t operator()(StringArg key) const { return std::hash<StringArg>()(key); }
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        LruCache<String, Bucket, KeyHash, std::equal_to<>> buckets;
+
+        explicit Shard(size_t maxKeys) : buckets(maxKeys, maxKeys) {}
+    };
+
+private:
+    int64_t interval_;      ///< 两个请求之间的间隔(纳秒)
+    int64_t tolerance_;     ///< 允许提前的时间(纳秒), burst个间隔
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+/**
+ * @brief HttpServer的限流, 在解析完请求头部之后、分发给servlet之前执行
+ */
+class HttpRateLimiter {
+public:
+    typedef std::shared_ptr<HttpRateLimiter> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<HttpRateLimiter> UniquePtr; ///< 智能指针定义
+
+    /**
+     * @brief 构造函数
+     * @param[in] rules 限流规则, 请求需要通过所有匹配的规则, 被拒绝的请求不消耗任何规则的额度
+     * @param[in] maxKeys 每条规则最多记录的键数
+     */
+    HttpRateLimiter(const std::vector<RateLimitRule>& rules, size_t maxKeys);
+
+    /**
+     * @brief 检查请求是否可以处理
+     * @param[in] request 已经解析完头部的请求
+     * @param[in] client 客户端地址
+     * @param[out] retryAfter 被拒绝时建议的重试秒数(Retry-After)
+     * @return 是否允许
+     */
+    bool allow(const HttpRequest* request, Address* client, uint32_t* retryAfter);
+
+    /**
+     * @brief 按配置创建
+     * @return 没有配置限流规则时返回nullptr
+     */
+    static SharedPtr Create();
+
+private:
+    /**
+     * @brief 依次通过从index开始的规则
+     * @param[in, out] key 生成键的缓冲区, 在规则之间复用
+     */
+    bool acquireFrom(size_t index, const HttpRequest* request, Address* client,
+                     int64_t now, String& key, uint32_t* retryAfter);
+
+private:
+    enum class KeyType {
+        IP,
+        ROUTE,
+        HEADER
+    };
+
+    struct Limiter {
+        KeyType type;
+        String prefix;
+        String header;
+        GcraLimiter::UniquePtr limiter;
+    };
+
+private:
+    std::vector<Limiter> limiters_;
+};
+
+} // namespace http
+} // namespace net
+
+template<>
+inline net::http::RateLimitRule LexicalCast<net::http::RateLimitRule, String>(const String& str) {
+    YAML::Node node = YAML::Load(str);
+    net::http::RateLimitRule rule;
+    rule.key = node["key"].as<String>(rule.key);
+    rule.prefix = node["prefix"].as<String>(rule.prefix);
+    rule.rate = node["rate"].as<double>(rule.rate);
+    rule.burst = node["burst"].as<uint32_t>(rule.burst);
+    return rule;
+}
+
+template<>
+inline String LexicalCast<String, net::http::RateLimitRule>(const net::http::RateLimitRule& rule) {
+    YAML::Node node;
+    node["key"] = rule.key;
+    node["prefix"] = rule.prefix;
+    node["rate"] = rule.rate;
+    node["burst"] = rule.burst;
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+} // namespace nemo
@@ -2,12 +2,15 @@
 
 #include <memory>
 #include <functional>
-#include <shared_mutex>
-#include <map>
+#include <atomic>
+#include <mutex>
 #include <vector>
 
+#include "net/http/http_method.h"
+#include "net/http/http_router.h"
 #include "util/util.h"
 #include "common/types.h"
+#include "container/epoch.h"
 
 namespace nemo {
 namespace net {
@@ -19,8 +22,10 @@ class HttpSession;
 
 /**
  * @brief Servlet封装
+ * @details 注册到ServletDispatcher的servlet由SharedPtr持有,
+ *          需要在路由临界区之外继续使用时通过shared_from_this()持有引用
  */
-class HttpServlet {
+class HttpServlet : public std::enable_shared_from_this<HttpServlet> {
 public:
     typedef std::shared_ptr<HttpServlet> SharedPtr; ///< 智能指针定义 
     typedef std::unique_ptr<HttpServlet> UniquePtr; ///< 智能指针定义
@@ -52,8 +57,21 @@ public:
      */
     const String& getName() const { return name_; }
 
+    /**
+     * @brief 是否由servlet自己读取请求消息体
+     * @details 为true时HttpServer不会预先读取消息体, 
+     *          servlet通过HttpSession::getBodyReader()流式读取
+     */
+    bool isStreamBody() const { return streamBody_; }
+
+    /**
+     * @brief 设置是否由servlet自己读取请求消息体
+     */
+    void setStreamBody(bool flag) { streamBody_ = flag; }
+
 protected:
     String name_; //名称
+    bool streamBody_ = false; //是否流式读取消息体
 };
 
 /**
@@ -80,6 +98,123 @@ private:
     Callback cb_; //回调函数
 };
 
+/**
+ * @brief 过滤器, 在servlet之前和之后执行的横切逻辑(鉴权、CORS、请求ID、计时等)
+ */
+class HttpFilter {
+public:
+    typedef std::shared_ptr<HttpFilter> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<HttpFilter> UniquePtr; ///< 智能指针定义
+
+    /**
+     * @brief 构造函数
+     * @param[in] name 名称
+     */
+    HttpFilter(StringArg name);
+
+    virtual ~HttpFilter() = default;
+
+    /**
+     * @brief 在servlet之前执行
+     * @return true继续执行后面的过滤器和servlet,
+     *         false表示过滤器已经生成了响应(例如401), 不再执行servlet
+     */
+    virtual bool before(HttpRequest* request, HttpResponse* response, HttpSession* session) {
+        return true;
+    }
+
+    /**
+     * @brief 在servlet之后按相反的顺序执行, 只有before()返回true的过滤器会执行
+     * @attention 流式发送的响应在这里已经发送完毕, 修改头部不再生效
+     */
+    virtual void after(HttpRequest* request, HttpResponse* response, HttpSession* session) {}
+
+    /**
+     * @brief 返回过滤器名称
+     */
+    const String& getName() const { return name_; }
+
+protected:
+    String name_; //名称
+};
+
+/**
+ * @brief 函数式过滤器
+ */
+class FunctionFilter : public HttpFilter {
+public:
+    typedef std::shared_ptr<FunctionFilter> SharedPtr; ///< 智能指针定义
+    typedef std::function<bool (HttpRequest* request,
+                    HttpResponse* response,
+                    HttpSession* session)> BeforeCallback;
+    typedef std::function<void (HttpRequest* request,
+                    HttpResponse* response,
+                    HttpSession* session)> AfterCallback;
+
+    /**
+     * @brief 构造函数
+     * @param[in] before servlet之前的回调, 可以为空
+     * @param[in] after servlet之后的回调, 可以为空
+     */
+    FunctionFilter(BeforeCallback before, AfterCallback after = nullptr);
+
+    bool before(HttpRequest* request, HttpResponse* response, HttpSession* session) override;
+    void after(HttpRequest* request, HttpResponse* response, HttpSession* session) override;
+
+private:
+    BeforeCallback before_;
+    AfterCallback after_;
+};
+
+/**
+ * @brief 挂载了过滤器的servlet
+ * @details 注册时由ServletDispatcher把匹配的过滤器展开成一个数组,
+ *          处理请求时按顺序调用, 不会逐层嵌套回调
+ */
+class FilteredServlet : public HttpServlet {
+public:
+    typedef std::shared_ptr<FilteredServlet> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<FilteredServlet> UniquePtr; ///< 智能指针定义
+    /// 代替实际servlet执行的处理阶段(例如响应缓存), 参数中的servlet为实际处理请求的servlet
+    typedef std::function<int32_t (HttpServlet* servlet,
+                    HttpRequest* request,
+                    HttpResponse* response,
+                    HttpSession* session)> Stage;
+
+    /**
+     * @brief 构造函数
+     * @param[in] servlet 实际处理请求的servlet
+     * @param[in] filters 按执行顺序排列的过滤器
+     */
+    FilteredServlet(const HttpServlet::SharedPtr& servlet,
+                    const std::vector<HttpFilter::SharedPtr>& filters);
+
+    int32_t handle(HttpRequest* request,
+            HttpResponse* response,
+            HttpSession* session) override;
+
+    /**
+     * @brief 执行过滤器, 所有before()都通过后调用stage代替直接调用servlet
+     */
+    int32_t handle(HttpRequest* request,
+            HttpResponse* response,
+            HttpSession* session,
+            const Stage& stage);
+
+    /**
+     * @brief 返回实际处理请求的servlet
+     */
+    HttpServlet* getServlet() const { return servlet_.get(); }
+
+private:
+    template<class Fn>
+    int32_t run(HttpRequest* request, HttpResponse* response, HttpSession* session, Fn&& fn);
+
+private:
+    HttpServlet::SharedPtr servlet_;
+    std::vector<HttpFilter::SharedPtr> filters_;
+};
+
 class IServletCreator {
 public:
     typedef std::shared_ptr<IServletCreator> SharedPtr; ///< 智能指针定义
@@ -89,6 +224,12 @@ public:
     virtual ~IServletCreator() = default;
     virtual HttpServlet::SharedPtr get() const = 0;
     virtual String getName() const = 0;
+
+    /**
+     * @brief 返回处理请求的servlet, 不增加引用计数
+     * @details 与get()返回同一个对象, 在创建者所在的路由快照被回收之前有效
+     */
+    virtual HttpServlet* peek() const = 0;
 };
 
 class HoldServletCreator : public IServletCreator {
@@ -103,6 +244,10 @@ public:
         return servlet_;
     }
 
+    HttpServlet* peek() const override {
+        return servlet_.get();
+    }
+
     String getName() const override {
         return servlet_->getName();
     }
@@ -111,23 +256,56 @@ private:
     HttpServlet::SharedPtr servlet_;
 };
 
+/**
+ * @brief 每个请求创建一个新的T来处理
+ */
+template<typename T>
+class PerRequestServlet : public HttpServlet {
+public:
+    PerRequestServlet() : HttpServlet(Demangle<T>()) {
+        streamBody_ = T().isStreamBody();
+    }
+
+    int32_t handle(HttpRequest* request,
+                   HttpResponse* response,
+                   HttpSession* session) override {
+        return std::make_unique<T>()->handle(request, response, session);
+    }
+};
+
 template<typename T>
 class ServletCreator : public IServletCreator {
 public:
     typedef std::shared_ptr<ServletCreator> SharedPtr; ///< 智能指针定义
     typedef std::unique_ptr<ServletCreator> UniquePtr; ///< 智能指针定义
 
+    ServletCreator() : servlet_(std::make_shared<PerRequestServlet<T>>()) {}
+
+    /**
+     * @brief 返回共享的转发servlet, 每次处理请求时才创建T
+     */
     HttpServlet::SharedPtr get() const override {
-        return HttpServlet::SharedPtr(new T);
+        return servlet_;
+    }
+
+    HttpServlet* peek() const override {
+        return servlet_.get();
     }
 
     String getName() const override {
         return Demangle<T>();
     }
+
+private:
+    HttpServlet::SharedPtr servlet_;
 };
 
 /**
  * @brief Servlet分发器
+ * @details 所有servlet都注册在一棵radix tree路由表中, 支持静态路径、
+ *          :param参数片段、*通配片段以及按方法区分的路由, 详见HttpRouter.
+ *          路由表以不可变快照的形式发布: 修改时复制一份, 改完后原子替换,
+ *          旧快照等到所有读者离开临界区后才释放. 匹配路由不加锁, 也没有原子读改写操作
  */
 class ServletDispatcher : public HttpServlet {
 public:
@@ -138,13 +316,15 @@ public:
      * @brief 构造函数
      */
     ServletDispatcher();
+    ~ServletDispatcher();
     int handle(HttpRequest* request,
             HttpResponse* response, 
             HttpSession* session) override;
 
     /**
-     * @brief 添加servlet
-     * @param[in] uri uri
+     * @brief 添加servlet, 匹配所有方法
+     * @details 路由已经存在时不覆盖, 记录错误日志. 需要替换时先调用delServlet
+     * @param[in] uri 路由模式, 例如/Nemo/xx, /users/:id
      * @param[in] servlet serlvet
      */
     void addServlet(StringArg uri, HttpServlet::UniquePtr&& servlet);
@@ -159,7 +339,7 @@ public:
 
     /**
      * @brief 添加模糊匹配servlet
-     * @param[in] uri uri 模糊匹配 /nemo_*
+     * @param[in] uri uri 模糊匹配 /nemo_*, '*'只能出现在末尾
      * @param[in] servlet servlet
      */
     void addGlobServlet(StringArg uri, HttpServlet::UniquePtr&& servlet);
@@ -185,6 +365,50 @@ public:
         addGlobServletCreator(uri, std::make_unique<ServletCreator<T> >());
     }
 
+    /**
+     * @brief 添加只匹配指定方法的路由
+     * @param[in] method HTTP方法
+     * @param[in] pattern 路由模式, 例如/users/:id, /Nemo_*file
+     * @param[in] servlet servlet
+     * @return 模式不合法、与已有路由冲突或者相同方法的路由已经存在时返回false
+     */
+    bool addRoute(HttpMethod method, StringArg pattern, HttpServlet::UniquePtr&& servlet);
+    bool addRoute(HttpMethod method, StringArg pattern, const FunctionServlet::Callback& cb);
+    bool addRoute(HttpMethod method, StringArg pattern, FunctionServlet::Callback&& cb);
+    bool addRouteCreator(HttpMethod method, StringArg pattern, IServletCreator::UniquePtr&& creator);
+
+    /**
+     * @brief 删除只匹配指定方法的路由
+     */
+    void delRoute(HttpMethod method, StringArg pattern);
+
+    /**
+     * @brief 批量修改路由, 所有修改作为一个快照发布
+     * @details 从配置热加载路由时使用, 正在处理的请求继续使用旧的快照.
+     *          有过滤器时发布前会为所有路由重新挂载过滤器
+     * @param[in] cb 在当前路由表的副本上执行修改, 返回false时放弃修改
+     */
+    bool updateRoutes(const std::function<bool(HttpRouter& router)>& cb);
+
+    /**
+     * @brief 添加对所有路由和默认servlet生效的过滤器
+     * @details 先添加的过滤器先执行before(), 后执行after().
+     *          已经注册的路由会在新的快照中重新组合
+     */
+    void addFilter(const HttpFilter::SharedPtr& filter);
+
+    /**
+     * @brief 添加只对部分路由生效的过滤器
+     * @param[in] prefix 路由模式的前缀, 例如/api/匹配/api/users/:id
+     * @param[in] filter 过滤器
+     */
+    void addFilter(StringArg prefix, const HttpFilter::SharedPtr& filter);
+
+    /**
+     * @brief 删除过滤器
+     */
+    void delFilter(const HttpFilter::SharedPtr& filter);
+
     /**
      * @brief 删除servlet
      * @param[in] uri uri
@@ -201,51 +425,147 @@ public:
      * @brief 返回默认servlet
      */
     HttpServlet* getDefault() const {
-        return defaultServlet_.get(); 
+        return defaultServlet_.load(std::memory_order_acquire)->get();
     }
 
     /**
      * @brief 设置默认servlet
      * @param[in] servlet 默认servlet
      */
-    void setDefault(HttpServlet::UniquePtr&& servlet) { 
-        defaultServlet_ = std::move(servlet); 
-    }
+    void setDefault(HttpServlet::UniquePtr&& servlet);
 
     /**
-     * @brief 通过uri获取servlet
+     * @brief 通过注册时的uri获取servlet(不做模式匹配)
      * @param[in] uri uri
      * @return 返回对应的servlet
      */
     HttpServlet::SharedPtr getServlet(const String& uri);
 
     /**
-     * @brief 通过uri获取模糊匹配servlet
+     * @brief 通过uri匹配servlet
      * @param[in] uri uri
      * @return 返回对应的servlet
      */
     HttpServlet::SharedPtr getGlobServlet(const String& uri);
 
+    /**
+     * @brief 返回能匹配path的路由允许的方法, 以", "分隔
+     */
+    String getAllowedMethods(StringArg path);
+
     /**
      * @brief 通过uri获取servlet
      * @param[in] uri uri
-     * @return 优先精准匹配,其次模糊匹配,最后返回默认
+     * @return 优先静态片段,其次参数片段,再次通配片段,最后返回默认
      */
     HttpServlet::SharedPtr getMatchedServlet(const String& uri);
 
+    /**
+     * @brief 按请求的方法和路径匹配servlet, 并把路径参数设置到request中
+     * @param[in] request HTTP请求
+     * @return 路径只对其它方法有路由时返回405的servlet, 否则匹配不到时返回默认servlet
+     */
+    HttpServlet::SharedPtr getMatchedServlet(HttpRequest* request);
+
+    /**
+     * @brief 请求处理热路径上的路由匹配, 不增加servlet的引用计数
+     * @details 返回的servlet在离开临界区之前有效, 需要更久时通过shared_from_this()持有引用
+     * @attention 调用者必须在reader的临界区内调用
+     * @param[in] request HTTP请求, 路径参数会设置到其中
+     * @return 匹配不到时同getMatchedServlet(HttpRequest*)
+     */
+    HttpServlet* route(HttpRequest* request);
+
+    /**
+     * @brief 返回路由快照的回收域, 每个连接在上面注册一个读者
+     */
+    EpochDomain* getEpochDomain() { return &epoch_; }
+
 private:
-    typedef std::map<String, IServletCreator::UniquePtr> ServletMap;
-    typedef std::pair<String, IServletCreator::UniquePtr> ServletPair;
-    typedef std::vector<ServletPair> ServletVector;
+    /**
+     * @brief 在临界区内按方法和路径查找
+     */
+    IServletCreator* match(HttpMethod method, StringArg path, HttpRouter::Params* params = nullptr) const {
+        return router_.load(std::memory_order_acquire)->match(method, path, params);
+    }
+
+    /**
+     * @brief 在临界区内匹配请求, 并把路径参数设置到request中
+     */
+    IServletCreator* matchRequest(HttpRequest* request) const;
+
+    /**
+     * @brief 在临界区内返回匹配不到时使用的servlet
+     * @return 路径只对其它方法有路由时返回405的servlet, 否则返回默认servlet
+     */
+    const HttpServlet::SharedPtr& fallback(HttpRequest* request) const;
+
+    /**
+     * @brief 过滤器规则
+     */
+    struct FilterRule {
+        String prefix;                      ///< 路由模式前缀, 为空时对所有路由生效
+        HttpFilter::SharedPtr filter;
+    };
+
+    /**
+     * @brief 把匹配pattern的过滤器和处理器组合在一起
+     * @pre 持有mutex_
+     */
+    HttpRouter::Handler compose(StringArg pattern, HttpRouter::Handler&& handler) const;
+
+    /**
+     * @brief 重新组合所有路由
+     * @pre 持有mutex_
+     */
+    void recompose(HttpRouter& router);
+
+    /**
+     * @brief 替换默认servlet和405的servlet, 旧的等到读者离开临界区后释放
+     * @pre 持有mutex_
+     */
+    void publishDefault();
+
+    /**
+     * @brief 为servlet挂载全局过滤器后原子替换target, 旧的等到读者离开临界区后释放
+     * @pre 持有mutex_
+     */
+    void publish(std::atomic<const HttpServlet::SharedPtr*>& target,
+                 const HttpServlet::SharedPtr& servlet,
+                 const std::vector<HttpFilter::SharedPtr>& filters);
 
 private:
-    ServletVector::iterator getGlobServletIter(StringArg uri);
+    std::mutex mutex_;                      ///< 写者互斥量
+    std::vector<FilterRule> filters_;       ///< 按添加顺序排列的过滤器, 由mutex_保护
+    HttpServlet::SharedPtr rawDefault_;     ///< 没有挂载过滤器的默认servlet
+    HttpServlet::SharedPtr rawMethodNotAllowed_; ///< 没有挂载过滤器的405的servlet
+    EpochDomain epoch_;                     ///< 旧快照的回收域
+    std::atomic<const HttpRouter*> router_; ///< 当前的路由表快照
+    std::atomic<const HttpServlet::SharedPtr*> defaultServlet_; ///< 默认servlet(已挂载全局过滤器)，所有路径都没匹配到时使用
+    std::atomic<const HttpServlet::SharedPtr*> methodNotAllowed_; ///< 405的servlet(已挂载全局过滤器), 路径只对其它方法有路由时使用
+};
+
+/**
+ * @brief 路径存在但不允许请求的方法时返回405, Allow头部列出允许的方法
+ */
+class MethodNotAllowedServlet : public HttpServlet {
+public:
+    typedef std::shared_ptr<MethodNotAllowedServlet> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<MethodNotAllowedServlet> UniquePtr; ///< 智能指针定义
+
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] dispatcher 用来查询允许的方法
+     */
+    explicit MethodNotAllowedServlet(ServletDispatcher* dispatcher);
+
+    int handle(HttpRequest* request,
+               HttpResponse* response,
+               HttpSession* session) override;
 
 private:
-    std::shared_mutex mutex_;               ///< 读写互斥量
-    ServletMap servlets_;                   ///< 精准匹配servlet MAP, uri(/Nemo/xxx) -> servlet
-    ServletVector globServlets_;            ///< 模糊匹配servlet 数组, uri(/Nemo/*) -> servlet
-    HttpServlet::SharedPtr defaultServlet_; ///< 默认servlet，所有路径都没匹配到时使用
+    ServletDispatcher* dispatcher_;
 };
 
 /**
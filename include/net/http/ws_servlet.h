@@ -0,0 +1,86 @@
+#pragma once
+
+#include <functional>
+
+#include "net/http/servlet.h"
+#include "net/http/ws_session.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+/**
+ * @brief WebSocket Servlet
+ * @details handle()完成握手后在当前协程中循环接收消息, 每个连接一个协程.
+ *          握手失败时返回400/426的HTTP响应, 连接保持HTTP/1.1.
+ *          通过HTTP/2到达的请求会被要求改用HTTP/1.1(不支持RFC 8441)
+ */
+class WsServlet : public HttpServlet {
+public:
+    typedef std::shared_ptr<WsServlet> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<WsServlet> UniquePtr; ///< 智能指针定义
+
+    /**
+     * @brief 构造函数
+     * @param[in] name 名称
+     */
+    WsServlet(StringArg name);
+
+    /**
+     * @brief 握手完成
+     * @return <0 立即关闭连接
+     */
+    virtual int32_t onConnect(HttpRequest* request, WsSession* session) = 0;
+
+    /**
+     * @brief 收到一条完整的消息
+     * @return <0 关闭连接
+     */
+    virtual int32_t onMessage(HttpRequest* request, WsMessage* message, WsSession* session) = 0;
+
+    /**
+     * @brief 连接关闭, 关闭原因通过session->getCloseCode()获取
+     */
+    virtual int32_t onClose(HttpRequest* request, WsSession* session) = 0;
+
+    int32_t handle(HttpRequest* request,
+                   HttpResponse* response,
+                   HttpSession* session) override;
+};
+
+/**
+ * @brief 函数式WebSocket Servlet
+ */
+class FunctionWsServlet : public WsServlet {
+public:
+    typedef std::shared_ptr<FunctionWsServlet> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<FunctionWsServlet> UniquePtr; ///< 智能指针定义
+    typedef std::function<int32_t (HttpRequest* request,
+                    WsSession* session)> ConnectCallback; ///< 握手完成/关闭回调
+    typedef std::function<int32_t (HttpRequest* request,
+                    WsMessage* message,
+                    WsSession* session)> MessageCallback; ///< 消息回调
+
+    /**
+     * @brief 构造函数
+     * @param[in] onMessage 消息回调
+     * @param[in] onConnect 握手完成回调, 可以为空
+     * @param[in] onClose 关闭回调, 可以为空
+     */
+    FunctionWsServlet(MessageCallback onMessage,
+                      ConnectCallback onConnect = nullptr,
+                      ConnectCallback onClose = nullptr);
+
+    int32_t onConnect(HttpRequest* request, WsSession* session) override;
+    int32_t onMessage(HttpRequest* request, WsMessage* message, WsSession* session) override;
+    int32_t onClose(HttpRequest* request, WsSession* session) override;
+
+private:
+    MessageCallback onMessage_;
+    ConnectCallback onConnect_;
+    ConnectCallback onClose_;
+};
+
+} // namespace http
+} // namespace net
+} // namespace nemo
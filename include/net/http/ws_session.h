@@ -0,0 +1,228 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "net/http/http.h"
+#include "coroutine/processor.h"
+#include "common/types.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+/**
+ * @brief 帧类型(RFC 6455 5.2)
+ */
+enum class WsOpcode : uint8_t {
+    CONTINUATION = 0x0,
+    TEXT = 0x1,
+    BINARY = 0x2,
+    CLOSE = 0x8,
+    PING = 0x9,
+    PONG = 0xA
+};
+
+/**
+ * @brief 关闭状态码(RFC 6455 7.4.1)
+ */
+struct WsCloseCode {
+    constexpr static uint16_t NORMAL = 1000;
+    constexpr static uint16_t GOING_AWAY = 1001;
+    constexpr static uint16_t PROTOCOL_ERROR = 1002;
+    constexpr static uint16_t UNSUPPORTED_DATA = 1003;
+    constexpr static uint16_t NO_STATUS = 1005;         ///< 只在本地使用, 不能出现在CLOSE帧中
+    constexpr static uint16_t ABNORMAL = 1006;          ///< 只在本地使用, 连接异常断开
+    constexpr static uint16_t INVALID_PAYLOAD = 1007;
+    constexpr static uint16_t POLICY_VIOLATION = 1008;
+    constexpr static uint16_t MESSAGE_TOO_BIG = 1009;
+    constexpr static uint16_t INTERNAL_ERROR = 1011;
+};
+
+/**
+ * @brief 一条完整的消息, 分片已经合并, 压缩的消息已经解压
+ */
+struct WsMessage {
+    typedef std::shared_ptr<WsMessage> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<WsMessage> UniquePtr; ///< 智能指针定义
+
+    WsOpcode opcode = WsOpcode::TEXT; ///< TEXT或者BINARY
+    String data;
+};
+
+/**
+ * @brief 对数据做掩码运算(异或), 掩码和去掩码是同一个操作
+ * @details 每次处理16字节(SSE2)或者8字节, 剩余部分逐字节处理
+ * @param[in, out] data 数据
+ * @param[in] len 数据长度
+ * @param[in] key 4字节掩码
+ */
+void WsMask(void* data, size_t len, const uint8_t key[4]);
+
+/**
+ * @brief WebSocket服务端连接
+ * @details 建立在HttpSession之上, 握手之后继续使用它的读缓冲区和socket.
+ *          连接上不常驻任何收发缓冲区: 消息只在收发期间占用内存. 协商时要求双方
+ *          都不保留压缩上下文, 压缩和解压使用的zlib状态都是线程共享的.
+ *          文本消息不是合法的UTF-8时以1007关闭连接.
+ *          recvMessage()只能在一个协程中调用, sendMessage()/ping()/close()
+ *          可以在任意协程中调用, 帧的写入是串行的(等待时挂起协程, 不能在协程外调用)
+ */
+class WsSession {
+public:
+    typedef std::shared_ptr<WsSession> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<WsSession> UniquePtr; ///< 智能指针定义
+
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] session 握手所在的HTTP连接, 生命周期需要长于WsSession
+     */
+    WsSession(HttpSession* session);
+
+    ~WsSession();
+
+    /**
+     * @brief 校验升级请求并发送101响应, 同时协商permessage-deflate
+     * @param[in] request 升级请求
+     * @param[in, out] response 失败时设置为400/426, 由调用者正常发送
+     * @return 是否完成握手
+     */
+    bool handshake(const HttpRequest* request, HttpResponse* response);
+
+    /**
+     * @brief 接收一条消息
+     * @details PING自动回复PONG, 收到CLOSE时回复CLOSE.
+     *          读超时时先发送一个PING, 连续两次超时没有收到任何数据才关闭连接
+     * @return 连接关闭或者出错时返回nullptr, 原因通过getCloseCode()获取
+     */
+    WsMessage::UniquePtr recvMessage();
+
+    /**
+     * @brief 发送一条消息或者消息的一个分片
+     * @param[in] data 数据
+     * @param[in] opcode 第一个分片为TEXT/BINARY, 后续分片为CONTINUATION
+     * @param[in] fin 是否是最后一个分片
+     * @return >0 发送成功, <=0 连接已经关闭或者异常
+     */
+    int sendMessage(StringArg data, WsOpcode opcode = WsOpcode::TEXT, bool fin = true);
+    int sendMessage(const WsMessage* message) {
+        return sendMessage(message->data, message->opcode);
+    }
+
+    /**
+     * @brief 发送PING
+     */
+    int ping(StringArg data = StringArg());
+
+    /**
+     * @brief 发送CLOSE, 之后recvMessage()丢弃数据消息直到对端回复CLOSE
+     * @param[in] code 状态码
+     * @param[in] reason 原因, 不超过123字节
+     */
+    int close(uint16_t code = WsCloseCode::NORMAL, StringArg reason = StringArg());
+
+    /**
+     * @brief 是否协商了permessage-deflate
+     */
+    bool isDeflate() const { return deflate_; }
+
+    /**
+     * @brief 关闭状态码, 连接还没有关闭时为0
+     */
+    uint16_t getCloseCode() const { return closeCode_; }
+
+    /**
+     * @brief 是否已经发送过CLOSE
+     */
+    bool isCloseSent() const { return closeSent_; }
+
+    /**
+     * @brief 协商permessage-deflate, 生成响应中的扩展字段
+     * @details 总是要求client_no_context_takeover(RFC 7692 7.1.1.1允许服务端主动要求),
+     *          连接上不需要保留解压状态
+     * @param[in] offers Sec-WebSocket-Extensions字段
+     * @param[out] accepted 接受的扩展, 没有可接受的offer时为空
+     * @param[out] serverWindowBits 服务端压缩可以使用的窗口大小
+     */
+    static void NegotiateDeflate(StringArg offers, String& accepted, int& serverWindowBits);
+
+    /**
+     * @brief 计算Sec-WebSocket-Accept
+     */
+    static String AcceptKey(StringArg key);
+
+private:
+    struct FrameHeader {
+        bool fin = false;
+        bool rsv1 = false;
+        WsOpcode opcode = WsOpcode::CONTINUATION;
+        uint64_t length = 0;
+        uint8_t key[4] = {0};
+    };
+
+    /**
+     * @brief 读取并校验帧头
+     * @param[in] idle 是否在消息之间等待, 这时读超时会发送PING
+     */
+    bool readFrameHeader(FrameHeader& header, bool idle);
+
+    /**
+     * @brief 读取帧负载并去掉掩码, 追加到out
+     */
+    bool readPayload(const FrameHeader& header, String& out);
+
+    /**
+     * @brief 处理控制帧
+     * @return 是否继续读取
+     */
+    bool onControlFrame(const FrameHeader& header);
+
+    /**
+     * @brief 记录关闭原因并发送CLOSE
+     */
+    void fail(uint16_t code);
+
+    /**
+     * @brief 确保读缓冲区中至少有n个字节
+     */
+    bool ensure(size_t n, bool idle);
+
+    /**
+     * @brief 编码并发送一个帧
+     */
+    int sendFrame(WsOpcode opcode, StringArg payload, bool fin, bool rsv1);
+
+    /**
+     * @brief 解压一条消息的负载
+     * @return 0表示成功, 否则为关闭状态码
+     */
+    uint16_t inflate(String& data);
+
+    /**
+     * @brief 串行化写入
+     */
+    void lockWrite();
+    void unlockWrite();
+
+private:
+    HttpSession* session_;
+    uint16_t closeCode_;
+    bool deflate_;
+    int8_t serverWindowBits_;
+    std::atomic<bool> closeSent_;           ///< 可能在多个协程中同时发送CLOSE
+    bool closeReceived_;                    ///< 只在recvMessage()的协程中访问
+    bool pingSent_;                         ///< 空闲超时后已经发送PING
+
+    std::mutex mutex_;                      ///< 保护以下写入状态
+    bool writing_;
+    std::vector<coroutine::Processor::SuspendEntry> writeWaiters_; ///< 空闲时不占用内存
+};
+
+} // namespace http
+} // namespace net
+} // namespace nemo
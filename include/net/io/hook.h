@@ -16,6 +16,15 @@ namespace io {
 bool IsHookEnable();
 void SetHookEnable(bool flag);
 
+/**
+ * @brief 等待fd上的事件, 在开启hook的协程中只挂起当前协程
+ * @param[in] fd 文件描述符
+ * @param[in] events POLLIN/POLLOUT
+ * @param[in] timeoutMillionSeconds 超时时间(毫秒), 小于等于0表示不超时
+ * @return 事件到达返回1, 超时返回0并设置errno为EAGAIN, 出错返回-1
+ */
+int WaitFd(int fd, short events, int timeoutMillionSeconds);
+
 } // namespace io
 } // namespace net
 } // namespace nemo
@@ -77,6 +86,9 @@ extern sendto_fun sendto_f;
 typedef ssize_t (*sendmsg_fun)(int s, const struct msghdr *msg, int flags);
 extern sendmsg_fun sendmsg_f;
 
+typedef ssize_t (*sendfile_fun)(int out_fd, int in_fd, off_t *offset, size_t count);
+extern sendfile_fun sendfile_f;
+
 typedef int (*close_fun)(int fd);
 extern close_fun close_f;
 
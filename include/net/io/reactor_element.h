@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <vector>
 #include <mutex>
@@ -17,6 +18,8 @@ public:
     typedef std::shared_ptr<ReactorElement> SharedPtr;
     typedef std::unique_ptr<ReactorElement> UniquePtr;
 
+    typedef std::function<void(short int)> Callback;
+
 public:
     struct Entry {
         Entry() = default;
@@ -26,7 +29,18 @@ public:
             events(evs),
             suspendEntry(s) {
         }
+        /**
+         * @brief 不挂起协程的等待, 事件到达时在reactor线程上执行一次回调
+         * @attention 回调执行时持有ReactorElement的锁, 只能做把任务交给调度器之类的轻量操作
+         */
+        explicit Entry(Callback&& cb) :
+            index(0),
+            callback(std::make_shared<Callback>(std::move(cb))) {
+        }
         bool operator==(const Entry& other) const {
+            if (callback || other.callback) {
+                return callback == other.callback;
+            }
             return index == other.index &&
                     events == other.events && 
                     suspendEntry == other.suspendEntry;
@@ -35,6 +49,7 @@ public:
         size_t index;
         std::shared_ptr<short int[]> events;
         coroutine::Processor::SuspendEntry suspendEntry;
+        std::shared_ptr<Callback> callback;
     };
 
     typedef std::vector<Entry> EntryVector;
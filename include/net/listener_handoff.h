@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "net/socket.h"
+#include "net/address.h"
+#include "common/types.h"
+
+namespace nemo {
+namespace net {
+
+/**
+ * @brief 热重启时在新旧进程之间传递监听socket
+ * @details 旧进程在一个Unix域socket上等待新进程连接, 通过SCM_RIGHTS把所有监听socket
+ *          发送过去, 收到确认后旧进程停止接受连接并等待已有连接处理完.
+ *          新进程启动时先尝试接收, 绑定地址时优先使用接收到的socket,
+ *          监听队列中的连接不会丢失, 也不会出现端口暂时不可用的窗口
+ */
+class ListenerHandoff {
+public:
+    /**
+     * @brief 新进程: 从旧进程接收监听socket
+     * @param[in] path Unix域socket路径
+     * @return 接收到的socket数量, 没有旧进程时为0
+     */
+    static size_t Receive(StringArg path);
+
+    /**
+     * @brief 取出与地址匹配的已接收socket
+     * @return 没有匹配时返回nullptr
+     */
+    static Socket::UniquePtr Take(const Address* address);
+
+    /**
+     * @brief 旧进程: 等待新进程连接并发送监听socket
+     * @details 在协程中阻塞, 直到有新进程确认接收成功
+     * @param[in] path Unix域socket路径
+     * @param[in] listeners 需要传递的监听socket
+     * @return 是否已经交给新进程, 返回true后调用者应当停止接受连接
+     */
+    static bool Serve(StringArg path, const std::vector<Socket*>& listeners);
+};
+
+} // namespace net
+} // namespace nemo
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "coroutine/processor.h"
+#include "common/types.h"
+
+/* 状态码, 0x100以上是客户端本地产生的, 不会出现在帧中 */
+#define RPC_STATUS_MAP(XX)                                 \
+  XX(0x0,   OK,                 OK)                        \
+  XX(0x1,   NOT_FOUND,          NOT_FOUND)                 \
+  XX(0x2,   BAD_REQUEST,        BAD_REQUEST)               \
+  XX(0x3,   INTERNAL,           INTERNAL)                  \
+  XX(0x4,   UNAVAILABLE,        UNAVAILABLE)               \
+  XX(0x100, TIMEOUT,            TIMEOUT)                   \
+  XX(0x101, CONNECTION_ERROR,   CONNECTION_ERROR)          \
+  XX(0x102, BAD_RESPONSE,       BAD_RESPONSE)              \
+
+namespace nemo {
+namespace net {
+
+class Socket;
+
+namespace rpc {
+
+/**
+ * @brief 调用结果
+ */
+enum class RpcStatus : uint16_t {
+#define XX(code, name, desc) name = code,
+    RPC_STATUS_MAP(XX)
+#undef XX
+};
+
+/**
+ * @brief 帧标志位
+ */
+struct RpcFlag {
+    constexpr static uint8_t RESPONSE = 0x1;    ///< 响应帧, 否则是请求帧
+    constexpr static uint8_t ONEWAY = 0x2;      ///< 不需要响应的请求
+};
+
+/// 协议版本
+constexpr uint8_t kRpcVersion = 1;
+/// 帧头大小
+constexpr size_t kRpcHeaderSize = 20;
+
+/**
+ * @brief 帧头, 所有字段都是大端序
+ * @details | 负载长度(4) | 版本(1) | 标志位(1) | 状态(2) | 方法ID(4) | 请求ID(8) |
+ *          请求ID由客户端在连接内分配, 响应带回相同的请求ID, 同一个连接上的请求可以乱序完成
+ */
+struct RpcHeader {
+    uint32_t length = 0;        ///< 负载长度, 不包括帧头
+    uint8_t version = kRpcVersion;
+    uint8_t flags = 0;
+    RpcStatus status = RpcStatus::OK;   ///< 请求帧中为OK
+    uint32_t methodId = 0;
+    uint64_t requestId = 0;
+
+    bool hasFlag(uint8_t flag) const { return flags & flag; }
+
+    /**
+     * @brief 从kRpcHeaderSize个字节中解析帧头
+     */
+    void parse(const void* data);
+
+    /**
+     * @brief 序列化后追加到out
+     */
+    void appendTo(String& out) const;
+};
+
+/**
+ * @brief 追加一个完整的帧, header.length由payload决定
+ */
+void AppendRpcFrame(String& out, RpcHeader header, StringArg payload);
+
+const char* RpcStatus2String(RpcStatus status);
+
+/**
+ * @brief 从连接中逐帧读取, 读缓冲区在帧之间复用
+ */
+class RpcFrameReader {
+public:
+    /**
+     * @param[in] sock 连接, 生命周期需要长于RpcFrameReader
+     */
+    explicit RpcFrameReader(Socket* sock);
+
+    /**
+     * @brief 读取下一帧
+     * @param[out] payload 指向读缓冲区, 在下一次read之前有效
+     * @return 连接关闭, 读取出错, 版本不匹配或者负载超过rpc.max_frame_size时返回false
+     */
+    bool read(RpcHeader& header, StringArg& payload);
+
+    /**
+     * @brief 是否是对端正常关闭连接
+     */
+    bool isPeerClosed() const { return peerClosed_; }
+
+private:
+    bool ensure(size_t n);
+
+private:
+    Socket* sock_;
+    String buffer_;
+    size_t pos_ = 0;
+    size_t end_ = 0;
+    bool peerClosed_ = false;
+};
+
+/**
+ * @brief 连接上唯一的写协程
+ * @details 任意协程调用write把帧追加到待发送缓冲区, 写协程把缓冲区整个取出后一次发送,
+ *          并发的请求(或响应)自然合并成一次send. 发送失败时关闭连接的两端, 让读协程也结束.
+ *          对端读得慢时待发送的数据超过rpc.write_high_water, 产生新帧的一方(服务端的读循环,
+ *          客户端的调用)通过waitWritable等待写协程发送完, 不会无限制地堆积在内存中
+ */
+class RpcFrameWriter {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * @param[in] sock 连接, 生命周期需要长于写协程
+     */
+    explicit RpcFrameWriter(Socket* sock);
+
+    /**
+     * @brief 追加一帧并唤醒写协程, 不等待
+     * @return 已经close或者发送失败时返回false
+     */
+    bool write(const RpcHeader& header, StringArg payload);
+
+    /**
+     * @brief 等待待发送的数据低于高水位
+     * @param[in] deadline 最多等待到这个时间点
+     * @return 可以继续写入时返回true, 已经close/发送失败或者超时返回false
+     */
+    bool waitWritable(Clock::time_point deadline = Clock::time_point::max());
+
+    /**
+     * @brief 是否已经close或者发送失败
+     */
+    bool isClosed();
+
+    /**
+     * @brief 写协程的循环, close之后发送完剩余的数据返回
+     */
+    void run();
+
+    /**
+     * @brief 不再接受新的帧, 写协程发送完剩余的数据后结束
+     */
+    void close();
+
+private:
+    void notify();
+
+    /**
+     * @brief 唤醒等待高水位的协程, 调用者持有mutex_
+     */
+    void notifyWritable();
+
+private:
+    Socket* sock_;
+    size_t highWater_;
+    std::mutex mutex_;
+    String pending_;                                ///< 待发送的帧
+    size_t sending_ = 0;                            ///< 写协程正在发送的字节数
+    std::vector<coroutine::Processor::SuspendEntry> writableWaiters_;
+    bool closed_ = false;
+    bool failed_ = false;
+    bool waiting_ = false;                          ///< 写协程是否在等待
+    coroutine::Processor::SuspendEntry entry_;
+};
+
+} // namespace rpc
+} // namespace net
+} // namespace nemo
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "net/address.h"
+#include "net/socket.h"
+#include "net/rpc/rpc.h"
+#include "coroutine/scheduler.h"
+#include "coroutine/wait_group.h"
+
+namespace nemo {
+namespace net {
+namespace rpc {
+
+/**
+ * @brief 一个RPC连接, 多个调用复用同一个连接
+ * @details 连接上有一个读协程按请求ID把响应交给等待的调用, 一个写协程合并发送请求.
+ *          连接出错后所有等待中的调用返回CONNECTION_ERROR, 连接不再可用
+ */
+class RpcChannel : public std::enable_shared_from_this<RpcChannel> {
+public:
+    typedef std::shared_ptr<RpcChannel> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<RpcChannel> UniquePtr; ///< 智能指针定义
+
+    /**
+     * @brief 建立连接并启动读写协程
+     * @param[in] scheduler 执行读写协程的调度器, 为空时使用当前协程所在的调度器
+     * @return 连接失败时返回nullptr
+     */
+    static SharedPtr Connect(const Address* address, coroutine::Scheduler* scheduler = nullptr);
+
+    explicit RpcChannel(Socket::UniquePtr&& sock);
+
+    ~RpcChannel();
+
+    /**
+     * @brief 发送请求并等待响应, 只能在协程中调用
+     * @param[out] response 返回OK时为响应的负载
+     * @param[in] timeoutMillionSeconds 超时时间(毫秒)
+     */
+    RpcStatus call(uint32_t methodId, StringArg request, String& response,
+                   uint64_t timeoutMillionSeconds);
+
+    /**
+     * @brief 发送不需要响应的请求
+     * @return 连接已经不可用时返回false
+     */
+    bool notify(uint32_t methodId, StringArg request);
+
+    /**
+     * @brief 连接是否已经不可用
+     */
+    bool isBroken() const { return broken_; }
+
+    /**
+     * @brief 关闭连接, 等待中的调用返回CONNECTION_ERROR
+     */
+    void close();
+
+    /**
+     * @brief 等待响应的调用数
+     */
+    size_t getPendingCount();
+
+    const Socket* getSocket() const { return sock_.get(); }
+
+private:
+    /**
+     * @brief 等待响应的调用
+     */
+    struct Call {
+        RpcStatus status = RpcStatus::CONNECTION_ERROR;
+        String response;
+        coroutine::WaitGroup done{1};
+    };
+    typedef std::shared_ptr<Call> CallPtr;
+
+    void start(coroutine::Scheduler* scheduler);
+
+    void readLoop();
+
+private:
+    Socket::UniquePtr sock_;
+    RpcFrameWriter writer_;
+    std::atomic<bool> broken_{false};
+    std::mutex mutex_;
+    uint64_t nextRequestId_ = 0;
+    std::unordered_map<uint64_t, CallPtr> calls_;   ///< 等待响应的调用, 由mutex_保护
+};
+
+/**
+ * @brief 带连接池的RPC客户端
+ * @details 保持固定数量的连接, 调用轮流分配到各个连接上, 每个连接上的调用并发进行.
+ *          连接在第一次使用时建立, 出错的连接在下一次分配到时重新建立
+ */
+class RpcClient {
+public:
+    typedef std::shared_ptr<RpcClient> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<RpcClient> UniquePtr; ///< 智能指针定义
+
+    /**
+     * @param[in] address 服务端地址
+     * @param[in] connections 连接数, 为0时使用rpc.client.connections
+     * @param[in] scheduler 执行连接读写协程的调度器, 为空时使用发起调用的协程所在的调度器
+     */
+    RpcClient(const Address* address, size_t connections = 0,
+              const coroutine::Scheduler::SharedPtr& scheduler = nullptr);
+
+    /**
+     * @brief 关闭所有连接
+     */
+    ~RpcClient();
+
+    /**
+     * @brief 发送请求并等待响应, 只能在协程中调用
+     * @param[in] timeoutMillionSeconds 超时时间(毫秒), 为0时使用rpc.client.timeout
+     */
+    RpcStatus call(uint32_t methodId, StringArg request, String& response,
+                   uint64_t timeoutMillionSeconds = 0);
+
+    /**
+     * @brief 请求和响应都是protobuf消息的调用
+     * @details 请求序列化失败时返回BAD_REQUEST, 响应解析失败时返回BAD_RESPONSE
+     */
+    template<class Request, class Response>
+    RpcStatus call(uint32_t methodId, const Request& request, Response& response,
+                   uint64_t timeoutMillionSeconds = 0) {
+        String data;
+        if(!request.SerializeToString(&data)) {
+            return RpcStatus::BAD_REQUEST;
+        }
+        String out;
+        RpcStatus status = call(methodId, StringArg(data), out, timeoutMillionSeconds);
+        if(RpcStatus::OK == status && !response.ParseFromString(out)) {
+            return RpcStatus::BAD_RESPONSE;
+        }
+        return status;
+    }
+
+    /**
+     * @brief 发送不需要响应的请求
+     */
+    bool notify(uint32_t methodId, StringArg request);
+
+    /**
+     * @brief 关闭所有连接, 等待中的调用返回CONNECTION_ERROR
+     */
+    void close();
+
+private:
+    /**
+     * @brief 轮流取出一个连接, 不可用时重新建立
+     */
+    RpcChannel::SharedPtr getChannel();
+
+private:
+    Address::UniquePtr address_;
+    coroutine::Scheduler::SharedPtr scheduler_;
+    std::atomic<size_t> next_{0};
+    std::mutex mutex_;
+    std::vector<RpcChannel::SharedPtr> channels_;   ///< 由mutex_保护
+};
+
+} // namespace rpc
+} // namespace net
+} // namespace nemo
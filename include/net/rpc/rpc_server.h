@@ -0,0 +1,71 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+#include "net/tcp_server.h"
+#include "net/rpc/rpc.h"
+
+namespace nemo {
+namespace net {
+namespace rpc {
+
+/**
+ * @brief 二进制RPC服务器
+ * @details 每个连接一个读协程和一个写协程, 每个请求在handle调度器上的独立协程中执行,
+ *          同一个连接上的请求并发处理, 响应按完成的顺序发送. 每个连接同时处理的请求
+ *          超过rpc.max_concurrent_requests时直接返回UNAVAILABLE
+ */
+class RpcServer : public TcpServer {
+public:
+    typedef std::shared_ptr<RpcServer> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<RpcServer> UniquePtr; ///< 智能指针定义
+
+    /**
+     * @brief 处理请求的负载, 返回OK时response作为响应的负载
+     */
+    typedef std::function<RpcStatus(StringArg request, String& response)> Handler;
+
+public:
+    RpcServer(const coroutine::Scheduler::SharedPtr& ioScheduler = nullptr,
+        const coroutine::Scheduler::SharedPtr& acceptScheduler = nullptr,
+        const coroutine::Scheduler::SharedPtr& handleScheduler = nullptr);
+
+    /**
+     * @brief 注册方法
+     * @attention 需要在start之前注册, 运行期间不加锁查找
+     */
+    void registerHandler(uint32_t methodId, Handler handler);
+
+    /**
+     * @brief 注册请求和响应都是protobuf消息的方法
+     * @details 请求解析失败时返回BAD_REQUEST, 响应序列化失败时返回INTERNAL
+     */
+    template<class Request, class Response>
+    void registerMethod(uint32_t methodId,
+            std::function<RpcStatus(const Request&, Response&)> handler) {
+        registerHandler(methodId, [handler](StringArg data, String& out) {
+            Request request;
+            if(!request.ParseFromArray(data.data(), data.size())) {
+                return RpcStatus::BAD_REQUEST;
+            }
+            Response response;
+            RpcStatus status = handler(request, response);
+            if(RpcStatus::OK == status && !response.SerializeToString(&out)) {
+                return RpcStatus::INTERNAL;
+            }
+            return status;
+        });
+    }
+
+protected:
+    virtual void handleClient(Socket::SharedPtr client) override;
+
+private:
+    std::unordered_map<uint32_t, Handler> handlers_;
+};
+
+} // namespace rpc
+} // namespace net
+} // namespace nemo
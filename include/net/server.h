@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <stdexcept>
 #include <vector>
 
 #include <yaml-cpp/yaml.h>
@@ -10,6 +11,7 @@
 #include "common/lexical_cast.h"
 #include "coroutine/coroutine.h"
 #include "net/socket.h"
+#include "net/socket_options.h"
 
 namespace nemo {
 namespace net {
@@ -24,6 +26,7 @@ struct ServerConfig {
     int timeoutMillionSeconds = 1000 * 2 * 60; ///< 超时时间，可选
     bool keepAlive = false;                    ///< 长连接，可选
     bool ssl = 0;                              ///< 是否用ssl，可选
+    SocketOptions socketOptions;               ///< socket选项，可选
 
     bool isValid() const {
         return !addresses.empty() && !type.empty();
@@ -104,6 +107,11 @@ public:
         config_ = std::make_unique<ServerConfig>(config);
     }
 
+    /**
+     * @brief 返回监听的socket
+     */
+    const std::vector<Socket::UniquePtr>& getSockets() const { return sockets_; }
+
     /**
      * @brief 转化为字符串
      * @param prefix 前缀
@@ -136,6 +144,23 @@ inline net::ServerConfig LexicalCast<net::ServerConfig, String>(const String& st
         config.timeoutMillionSeconds = 
             node["timeout"].as<int>(config.timeoutMillionSeconds);
     }
+    if(node["socket"].IsDefined()) {
+        const YAML::Node& socket = node["socket"];
+        net::SocketOptions& options = config.socketOptions;
+        //未知的预设抛出异常, 由ConfigVar::fromString记录错误并拒绝整个配置
+        String profile = socket["profile"].as<String>(options.profile);
+        if(!net::SocketOptions::Preset(profile, options)) {
+            throw std::invalid_argument("unknown socket profile: " + profile);
+        }
+        options.backlog = socket["backlog"].as<int>(options.backlog);
+        options.noDelay = socket["tcp_nodelay"].as<bool>(options.noDelay);
+        options.deferAcceptSeconds = socket["defer_accept"].as<int>(options.deferAcceptSeconds);
+        options.fastOpenQueue = socket["fast_open"].as<int>(options.fastOpenQueue);
+        options.recvBufferBytes = socket["rcvbuf"].as<int>(options.recvBufferBytes);
+        options.sendBufferBytes = socket["sndbuf"].as<int>(options.sendBufferBytes);
+        options.notSentLowatBytes = socket["notsent_lowat"].as<int>(options.notSentLowatBytes);
+        options.busyPollMicroSeconds = socket["busy_poll"].as<int>(options.busyPollMicroSeconds);
+    }
     if(node["addresses"].IsDefined()) {
         for(size_t i = 0; i < node["addresses"].size(); ++i) {
             config.addresses.push_back(node["addresses"][i].as<String>());
@@ -157,6 +182,16 @@ inline String LexicalCast<String, net::ServerConfig>(const net::ServerConfig& co
         node["keep_alive"] = config.keepAlive;
         node["timeout"] = config.timeoutMillionSeconds;
     }
+    const net::SocketOptions& options = config.socketOptions;
+    node["socket"]["profile"] = options.profile;
+    node["socket"]["backlog"] = options.backlog;
+    node["socket"]["tcp_nodelay"] = options.noDelay;
+    node["socket"]["defer_accept"] = options.deferAcceptSeconds;
+    node["socket"]["fast_open"] = options.fastOpenQueue;
+    node["socket"]["rcvbuf"] = options.recvBufferBytes;
+    node["socket"]["sndbuf"] = options.sendBufferBytes;
+    node["socket"]["notsent_lowat"] = options.notSentLowatBytes;
+    node["socket"]["busy_poll"] = options.busyPollMicroSeconds;
     for(auto& address : config.addresses) {
         node["addresses"].push_back(address);
     }
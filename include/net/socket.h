@@ -4,6 +4,7 @@
 #include <openssl/err.h>
 
 #include <memory>
+#include <vector>
 
 #include "net/address.h"
 #include "common/noncopyable.h"
@@ -61,6 +62,14 @@ public:
      */
     static Socket::UniquePtr CreateUnixUdpSocket();
 
+    /**
+     * @brief 接管一个已经存在的socket(如从其它进程继承的监听socket)
+     * @details 协议簇、类型和协议从内核读取, 没有FdContext时注册一个
+     * @param[in] fd socket文件描述符
+     * @return 不是socket时返回nullptr
+     */
+    static Socket::UniquePtr Adopt(int fd);
+
     /**
      * @brief Socket构造函数
      * @param[in] family 协议簇
@@ -181,6 +190,18 @@ public:
      */
     virtual int send(const iovec* buffers, size_t length, int flags = 0);
 
+    /**
+     * @brief 发送文件内容, 使用sendfile, 数据不经过用户态
+     * @param[in] fd 文件描述符
+     * @param[in] offset 文件中的起始位置
+     * @param[in] length 待发送数据的长度
+     * @return
+     *      @retval >0 发送成功对应大小的数据
+     *      @retval =0 socket被关闭或者文件已经读完
+     *      @retval <0 socket出错
+     */
+    virtual int64_t sendFile(int fd, off_t offset, size_t length);
+
     /**
      * @brief 发送数据
      * @param[in] buffer 待发送数据的内存
@@ -287,6 +308,12 @@ public:
      */
     int getError();
 
+    /**
+     * @brief 获取Unix域socket对端进程的凭证(SO_PEERCRED)
+     * @return 不是Unix域socket或者获取失败时返回false
+     */
+    bool getPeerCredentials(PeerCredentials& credentials);
+
     /**
      * @brief 输出信息到流中
      */
@@ -352,6 +379,7 @@ public:
     bool close() override;
     int send(const void* buffer, size_t length, int flags = 0) override;
     int send(const iovec* buffers, size_t length, int flags = 0) override;
+    int64_t sendFile(int fd, off_t offset, size_t length) override;
     int sendTo(const void* buffer, size_t length, const Address* to, int flags = 0) override;
     int sendTo(const iovec* buffers, size_t length, const Address* to, int flags = 0) override;
     int recv(void* buffer, size_t length, int flags = 0) override;
@@ -359,8 +387,34 @@ public:
     int recvFrom(void* buffer, size_t length, Address* from, int flags = 0) override;
     int recvFrom(iovec* buffers, size_t length, Address* from, int flags = 0) override;
 
+    /**
+     * @brief 完成TLS握手, 已经完成时直接返回true
+     * @details accept出来的连接在第一次读写时握手, 需要在读写之前得到ALPN协议时先调用.
+     *          等待数据时使用socket的接收超时
+     */
+    bool handshake();
+
+    /**
+     * @brief 设置连接的服务端主机名, 在connect之前调用
+     * @details 用于SNI和会话缓存的键, 同一个地址上不同主机名的会话分开缓存
+     */
+    void setServerName(StringArg serverName) { serverName_.assign(serverName.data(), serverName.size()); }
+
+    /**
+     * @brief 握手是否复用了之前的会话
+     */
+    bool isSessionReused() const;
+
+    /**
+     * @brief 发送方向是否使用了内核TLS(kTLS)
+     * @details 开启tls.ktls且内核和加密套件都支持时, 握手之后由内核加密,
+     *          SSL_write直接写socket, sendFile使用sendfile. 否则回退到用户态加密
+     */
+    bool isKtlsSend() const;
+
     /**
      * @brief 加载证书
+     * @details 相同证书和私钥的socket共享一个SSL_CTX, 参见SslContextRegistry
      * @param[in] cert_file 证书文件
      * @param[in] key_file 秘钥文件
      * @return
@@ -369,6 +423,17 @@ public:
      */
     bool loadCertificates(StringArg certFile, StringArg keyFile);
 
+    /**
+     * @brief 设置服务端支持的ALPN协议, 按优先级从高到低排列
+     * @details 在loadCertificates之前或之后设置都可以, accept出来的连接共享同一份设置
+     */
+    void setAlpnProtocols(const std::vector<String>& protocols);
+
+    /**
+     * @brief 握手时协商出的ALPN协议, 没有协商时返回空串
+     */
+    String getAlpnProtocol() const;
+
     /**
      * @brief 输出信息到流中
      */
@@ -383,15 +448,44 @@ private:
             SSL_free(ssl);
         }
     };
-    struct SslCtxDeleter {
-        void operator()(SSL_CTX* sslCtx) {
-            SSL_CTX_free(sslCtx);
-        }
-    };
+
+    static constexpr size_t kMaxTlsRecord = 16384;  ///< TLS记录的最大明文长度
+    static constexpr size_t kMaxSendFileBytes = 1 << 30; ///< 一次SSL_sendfile的最大长度
+
+private:
+    /**
+     * @brief 把fd设置为非阻塞, SSL的读写由doSsl等待
+     */
+    bool setNonBlocking();
+
+    /**
+     * @brief 按SSL_ERROR_WANT_READ/WANT_WRITE等待fd可读或可写
+     * @param[in] timeoutType SO_RCVTIMEO或SO_SNDTIMEO, 使用对应的超时时间
+     * @return 超时或出错时返回false
+     */
+    bool waitIo(int sslError, int timeoutType);
+
+    /**
+     * @brief 执行SSL操作, 需要等待时挂起协程后重试
+     * @return 成功时返回fn的结果, 对端关闭返回0, 出错或超时返回-1
+     */
+    template<typename Fn>
+    int doSsl(const Fn& fn, int timeoutType);
+
+    int writeFully(const void* buffer, size_t length);
+
+    /**
+     * @brief 没有kTLS时读出文件内容再加密发送
+     */
+    int64_t sendFileFallback(int fd, off_t offset, size_t length);
 
 private:
     std::shared_ptr<SSL_CTX> sslCtx_;       ///< ssl 上下文
+    std::shared_ptr<String> alpnProtocols_; ///< wire格式的ALPN协议列表, accept出来的连接共享
+    String serverName_;                     ///< 服务端主机名
+    String sessionKey_;                     ///< 客户端会话缓存的键, 在ssl_之前定义以保证比ssl_后析构
     std::unique_ptr<SSL, SslDeleter> ssl_;  ///< ssl
+    String writeBuffer_;                    ///< 合并多个iovec的写缓冲
 };
 
 /**
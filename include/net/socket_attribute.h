@@ -1,5 +1,8 @@
 #pragma once
 
+#include <sys/types.h>
+#include <sys/socket.h>
+
 namespace nemo {
 namespace net {
 
@@ -28,5 +31,14 @@ struct SocketAttribute {
     int protocol{-1};
 };
 
+/**
+ * @brief Unix域socket对端进程的凭证(SO_PEERCRED), 是对端调用connect时的进程和用户
+ */
+struct PeerCredentials {
+    pid_t pid = 0;
+    uid_t uid = 0;
+    gid_t gid = 0;
+};
+
 } // namespace net
 } // namespace nemo
\ No newline at end of file
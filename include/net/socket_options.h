@@ -0,0 +1,63 @@
+#pragma once
+
+#include <sys/socket.h>
+
+#include "common/types.h"
+
+namespace nemo {
+namespace net {
+
+class Socket;
+
+/**
+ * @brief 服务端socket的选项配置
+ * @details 先按profile取得预设值, 再用配置中显式给出的字段覆盖.
+ *          除TCP_NODELAY之外的选项都在bind之后listen之前设置到监听socket上,
+ *          缓冲区大小, TCP_NOTSENT_LOWAT和SO_BUSY_POLL由accept出来的连接继承, 不用每个连接再设置;
+ *          accept出来的连接默认开启TCP_NODELAY, 关闭时在每个连接上设置.
+ *          数值为0表示使用系统默认值, 不调用setsockopt
+ *          - default: 系统默认值, 连接开启TCP_NODELAY(与之前的行为一致)
+ *          - latency: 小请求/响应, 开启TCP_FASTOPEN和TCP_DEFER_ACCEPT,
+ *                     用TCP_NOTSENT_LOWAT限制内核中未发送的数据, 用SO_BUSY_POLL减少唤醒延迟
+ *          - throughput: 大块数据, 4MB的收发缓冲区和更长的监听队列
+ */
+struct SocketOptions {
+    String profile = "default";    ///< 预设名称
+    int backlog = SOMAXCONN;       ///< listen的监听队列长度
+    bool noDelay = true;           ///< TCP_NODELAY
+    int deferAcceptSeconds = 0;    ///< TCP_DEFER_ACCEPT, 连接有数据到达时才accept
+    int fastOpenQueue = 0;         ///< TCP_FASTOPEN, 等待完成握手的TFO连接数
+    int recvBufferBytes = 0;       ///< SO_RCVBUF
+    int sendBufferBytes = 0;       ///< SO_SNDBUF
+    int notSentLowatBytes = 0;     ///< TCP_NOTSENT_LOWAT
+    int busyPollMicroSeconds = 0;  ///< SO_BUSY_POLL, 提高到系统默认值以上需要CAP_NET_ADMIN
+
+    /**
+     * @brief 取得预设的选项
+     * @param[in] profile default/latency/throughput
+     * @param[out] options 预设的选项
+     * @return 预设不存在时返回false, options不变
+     */
+    static bool Preset(StringArg profile, SocketOptions& options);
+
+    /**
+     * @brief 在监听socket上设置选项, 在bind之后listen之前调用
+     * @details 设置失败只记录日志, 不影响监听
+     */
+    void applyToListener(Socket* sock) const;
+
+    /**
+     * @brief 在accept出来的连接上设置选项
+     */
+    void applyToConnection(Socket* sock) const;
+
+    /**
+     * @brief 转化为字符串
+     */
+    String toString() const;
+
+    bool operator==(const SocketOptions& other) const = default;
+};
+
+} // namespace net
+} // namespace nemo
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <openssl/ssl.h>
+
+#include "container/lru_cache.h"
+#include "common/singleton.h"
+#include "common/types.h"
+
+namespace nemo {
+namespace net {
+
+/**
+ * @brief 进程内共享的SSL_CTX
+ * @details 服务端按证书和私钥共享一个SSL_CTX, 开启会话缓存和会话票据(tls.session_tickets),
+ *          票据密钥每tls.ticket_key_rotation秒轮换一次, 旧密钥在tls.session_timeout内仍可解密.
+ *          客户端共享一个SSL_CTX, 服务端下发的会话按"地址/主机名"缓存, 下次连接同一个服务端时复用.
+ *          ALPN协议列表保存在每个SSL的ex_data中, 共享SSL_CTX的监听socket可以有不同的ALPN设置
+ *          开启tls.ktls时新建的SSL_CTX启用kTLS, 修改配置后需要clear()才对新连接生效
+ */
+class SslContextRegistry : public Singleton<SslContextRegistry> {
+public:
+    typedef std::shared_ptr<SSL_CTX> SslCtxPtr;
+    typedef std::chrono::steady_clock Clock;
+
+    SslContextRegistry(Token);
+
+    /**
+     * @brief 取得证书和私钥对应的服务端SSL_CTX, 第一次使用时加载
+     * @return 加载失败返回nullptr
+     */
+    SslCtxPtr getServerContext(StringArg certFile, StringArg keyFile);
+
+    /**
+     * @brief 取得客户端SSL_CTX
+     */
+    SslCtxPtr getClientContext();
+
+    /**
+     * @brief 连接之前设置会话的缓存键, 有缓存的会话时设置到ssl上以便复用
+     * @param[in] ssl 客户端连接
+     * @param[in] key 缓存键, 生命周期不能短于ssl
+     * @return 是否设置了缓存的会话
+     */
+    bool prepareClientSession(SSL* ssl, const String* key);
+
+    /**
+     * @brief 删除服务端的会话缓存
+     */
+    void removeClientSession(const String& key);
+
+    /**
+     * @brief 清空SSL_CTX和会话缓存, 更换证书后调用
+     */
+    void clear();
+
+    /**
+     * @brief 设置连接可以选择的ALPN协议(wire格式), 生命周期不能短于ssl
+     */
+    static void SetAlpnProtocols(SSL* ssl, const String* protocols);
+
+private:
+    /**
+     * @brief 会话票据的密钥
+     */
+    struct TicketKey {
+        unsigned char name[16];
+        unsigned char aesKey[32];
+        unsigned char hmacKey[32];
+        Clock::time_point createdAt;
+    };
+
+    static int NewSessionCallback(SSL* ssl, SSL_SESSION* session);
+    static int TicketKeyCallback(SSL* ssl, unsigned char* name, unsigned char* iv,
+                                 EVP_CIPHER_CTX* cipherCtx, EVP_MAC_CTX* macCtx, int enc);
+
+    /**
+     * @brief 取得加密用的密钥, 到期时生成新的密钥并删除不再需要的旧密钥
+     */
+    bool currentTicketKey(TicketKey& key);
+
+    /**
+     * @brief 按名称查找解密用的密钥
+     * @param[out] current 是否是当前的密钥, 不是时要求客户端更新票据
+     */
+    bool findTicketKey(const unsigned char* name, TicketKey& key, bool& current);
+
+    void storeClientSession(const String& key, SSL_SESSION* session);
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<String, SslCtxPtr> serverContexts_;   ///< 证书\n私钥 -> SSL_CTX
+    SslCtxPtr clientContext_;
+    LruCache<String, std::shared_ptr<SSL_SESSION>> clientSessions_;
+    std::mutex ticketMutex_;
+    std::deque<TicketKey> ticketKeys_;                       ///< 第一个是当前的密钥
+};
+
+} // namespace net
+} // namespace nemo
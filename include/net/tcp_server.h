@@ -1,6 +1,12 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "net/server.h"
 
@@ -47,6 +53,22 @@ public:
      */
     virtual void stop() override;
 
+    /**
+     * @brief 优雅关闭: 停止接受连接, 等待已有连接处理完当前请求
+     * @details 关闭监听socket后, 空闲的连接直接关闭读端, 正在处理请求的连接
+     *          由子类在请求结束后关闭(HTTP响应带上Connection: close),
+     *          注册了排空回调的连接(如HTTP/2)由回调负责. 超时后强制关闭剩余的连接
+     * @param[in] timeoutMillionSeconds 等待的超时时间(毫秒)
+     * @return 是否所有连接都在超时之前结束
+     * @post 需要再调用stop()停止调度器
+     */
+    bool drain(uint64_t timeoutMillionSeconds);
+
+    /**
+     * @brief 是否正在优雅关闭
+     */
+    bool isDraining() const { return draining_; }
+
     /**
      * @brief 返回读取超时时间(毫秒)
      */
@@ -77,11 +99,51 @@ public:
      */
     bool loadCertificates(StringArg certFile, StringArg keyFile);
 
+    /**
+     * @brief 设置TLS握手时支持的ALPN协议, 按优先级从高到低排列
+     * @details 对之后加载证书的socket生效
+     */
+    void setAlpnProtocols(const std::vector<String>& protocols) { alpnProtocols_ = protocols; }
+
 protected:
-    struct HandleWrapper {
+    struct Connection;
+    typedef std::shared_ptr<Connection> ConnectionPtr;
 
+    /**
+     * @brief 正在处理的连接
+     */
+    struct Connection {
+        Socket::SharedPtr sock;
+        std::atomic<bool> idle{false};  ///< 是否在等待下一个请求, 优雅关闭时可以直接关闭
+        std::function<void()> onDrain;  ///< 优雅关闭时的回调, 由connectionsMutex_保护
+        bool parkOnReturn = false;      ///< handleClient返回后把连接交给reactor等待下一个请求
+
+        //以下由connectionsMutex_保护
+        bool parked = false;            ///< 是否在parked_中
+        std::chrono::steady_clock::time_point parkedAt;
+        std::list<ConnectionPtr>::iterator parkedIter;
     };
 
+    /**
+     * @brief 返回handleClient正在处理的连接
+     */
+    ConnectionPtr getConnection(Socket* sock);
+
+    /**
+     * @brief 设置连接的排空回调, 已经开始优雅关闭时立即执行
+     * @details 传入空回调时取消之前的回调, 空闲的连接恢复为关闭读端
+     */
+    void setDrainCallback(const ConnectionPtr& connection, std::function<void()> callback);
+
+    /**
+     * @brief 是否可以把空闲连接交给reactor等待(tcp_server.park_idle)
+     * @details 可以时handleClient在等待下一个请求之前设置parkOnReturn并返回, 协程结束,
+     *          连接只保留一个Connection记录; 收到数据后再启动协程重新调用handleClient.
+     *          等待超过tcp_server.idle_timeout或者空闲连接数超过tcp_server.max_idle_connections
+     *          (最早进入等待的连接先关闭)时关闭连接
+     */
+    bool canPark() const { return parkIdle_ && !draining_; }
+
     /**
      * @brief 处理新连接的Socket类
      * @param[in] 连接客户端的socket
@@ -97,10 +159,40 @@ protected:
 private:
     bool bindAddress(const Address* address);
 
+    /**
+     * @brief 调用handleClient, 返回后连接没有交给reactor等待时结束连接
+     */
+    void runClient(const ConnectionPtr& connection);
+
+    /**
+     * @brief 把空闲连接交给reactor等待, 可读时在handle调度器上重新执行runClient
+     * @return 是否成功
+     */
+    bool park(const ConnectionPtr& connection);
+
+    /**
+     * @brief 从parked_中移除
+     * @pre 持有connectionsMutex_
+     */
+    void unpark(Connection* connection);
+
+    /**
+     * @brief 定期关闭空闲超时的连接
+     */
+    void sweepIdle();
+
 protected:
     coroutine::Scheduler::SharedPtr acceptScheduler_;
     coroutine::Scheduler::SharedPtr handleScheduler_;
+    std::vector<String> alpnProtocols_;     ///< ALPN协议列表
     uint64_t recvTimeoutMillionSeconds_;
+    std::atomic<bool> draining_;            ///< 是否正在优雅关闭
+    bool parkIdle_;                         ///< 是否把空闲连接交给reactor等待
+    uint64_t idleTimeoutMillionSeconds_;    ///< 空闲连接的超时时间(毫秒)
+    size_t maxIdleConnections_;             ///< 最多等待的空闲连接数, 0表示不限制
+    std::mutex connectionsMutex_;
+    std::unordered_map<Socket*, ConnectionPtr> connections_;
+    std::list<ConnectionPtr> parked_;       ///< 交给reactor等待的空闲连接, 按进入等待的顺序
 };
 
 } // namespace net
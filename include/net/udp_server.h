@@ -0,0 +1,179 @@
+#pragma once
+
+#include <sys/socket.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "net/server.h"
+
+namespace nemo {
+namespace net {
+
+/**
+ * @brief 收到的一个数据报
+ * @attention 指向接收缓冲区, 只在UdpServer::handleBatch期间有效
+ */
+struct Datagram {
+    const char* data;       ///< 数据
+    size_t size;            ///< 数据长度
+    const sockaddr* peer;   ///< 发送方地址
+    socklen_t peerLen;      ///< 发送方地址长度
+};
+
+/**
+ * @brief UDP服务器
+ * @details 每个地址绑定多个SO_REUSEPORT的socket(默认与io调度器的线程数相同),
+ *          内核按四元组把数据报分散到各个socket上, 每个socket由一个协程处理.
+ *          数据报用recvmmsg批量接收到socket独占的缓冲区中(缓冲区循环复用, 不再分配),
+ *          整批交给handleBatch; 回复先缓存起来, handleBatch返回后用sendmmsg批量发送.
+ *          开启udp_server.gro时内核把同一个流的多个数据报合并成一次接收, 这里再按段长拆开,
+ *          每个socket是否开启GRO在绑定时分别决定;
+ *          开启udp_server.gso时发往同一个地址的等长回复合并成一个UDP_SEGMENT消息,
+ *          由内核(或网卡)分段, 段长不超过udp_server.mtu减去IP和UDP头部.
+ *          内核或网卡不支持GSO(EIO/ENOPROTOOPT/EOPNOTSUPP)时关闭并逐个发送
+ */
+class UdpServer : public Server {
+public:
+    typedef std::shared_ptr<UdpServer> SharedPtr; ///< 智能指针定义
+    typedef std::unique_ptr<UdpServer> UniquePtr; ///< 智能指针定义
+
+    /**
+     * @brief 一批收到的数据报和待发送的回复
+     */
+    class Batch {
+    friend class UdpServer;
+    public:
+        size_t size() const { return datagrams_.size(); }
+        bool empty() const { return datagrams_.empty(); }
+        const Datagram& operator[](size_t index) const { return datagrams_[index]; }
+        std::vector<Datagram>::const_iterator begin() const { return datagrams_.begin(); }
+        std::vector<Datagram>::const_iterator end() const { return datagrams_.end(); }
+
+        /**
+         * @brief 回复数据报的发送方
+         * @details 数据被复制, 在handleBatch返回后和其它回复一起发送
+         * @return 数据超过udp_server.max_datagram_size时返回false
+         */
+        bool reply(const Datagram& to, const void* data, size_t len) {
+            return sendTo(to.peer, to.peerLen, data, len);
+        }
+
+        /**
+         * @brief 发送数据报到指定地址, 与reply一样在handleBatch返回后发送
+         */
+        bool sendTo(const sockaddr* peer, socklen_t peerLen, const void* data, size_t len);
+
+        /**
+         * @brief 待发送的回复数
+         */
+        size_t pendingReplies() const { return replies_.size(); }
+
+    private:
+        /**
+         * @brief 待发送的回复, 数据在payload_中连续存放
+         */
+        struct Reply {
+            sockaddr_storage peer;
+            socklen_t peerLen;
+            size_t offset;
+            size_t size;
+        };
+
+        explicit Batch(size_t maxDatagramSize) : maxDatagramSize_(maxDatagramSize) {}
+
+        void clear();
+
+    private:
+        size_t maxDatagramSize_;
+        std::vector<Datagram> datagrams_;
+        std::vector<Reply> replies_;
+        String payload_;
+    };
+
+public:
+    UdpServer(const coroutine::Scheduler::SharedPtr& ioScheduler = nullptr);
+
+    virtual ~UdpServer();
+
+    /**
+     * @brief 绑定地址, 创建多个SO_REUSEPORT的socket
+     * @param[in] ssl 不支持, 必须为false
+     */
+    virtual bool bind(const Address* address, bool ssl = false) override;
+
+    virtual bool bind(const std::vector<Address::UniquePtr>& addresses,
+            std::vector<Address*>& fails, bool ssl = false) override;
+
+    /**
+     * @brief 启动服务
+     * @pre 需要bind成功后执行
+     */
+    virtual bool start() override;
+
+    /**
+     * @brief 停止服务
+     */
+    virtual void stop() override;
+
+    /**
+     * @brief 是否所有socket都使用GRO接收
+     */
+    bool isGroEnabled() const;
+
+    /**
+     * @brief 是否使用GSO发送, 内核或网卡不支持时发送失败后关闭
+     */
+    bool isGsoEnabled() const { return gso_; }
+
+    virtual String toString(StringArg prefix) const override;
+
+protected:
+    /**
+     * @brief 处理一批数据报, 在socket的协程中执行
+     * @details 数据报只在调用期间有效, 需要保留时复制出来; 回复通过batch.reply()发送
+     */
+    virtual void handleBatch(Batch& batch);
+
+private:
+    struct Ring;
+
+    /**
+     * @brief 每个socket在绑定时决定的收发参数, 与sockets_一一对应
+     */
+    struct SocketInfo {
+        bool gro;               ///< 是否开启了UDP_GRO
+        size_t maxSegment;      ///< GSO的最大段长, 由MTU减去IP和UDP头部得到
+    };
+
+    bool bindAddress(const Address* address);
+
+    /**
+     * @brief 一个socket的接收循环
+     */
+    void runSocket(Socket* sock, const SocketInfo& info);
+
+    /**
+     * @brief 接收一批数据报到ring中, GRO合并的数据报按段长拆开
+     * @return 收到的数据报数, 超时返回0, 出错返回-1
+     */
+    int receive(Socket* sock, Ring& ring, Batch& batch);
+
+    /**
+     * @brief 用sendmmsg发送batch中缓存的回复
+     */
+    void flush(Socket* sock, Ring& ring, Batch& batch);
+
+private:
+    size_t batchSize_;               ///< 一次recvmmsg/sendmmsg的最大消息数
+    size_t maxDatagramSize_;         ///< 不使用GRO时单个数据报的最大长度
+    size_t socketsPerAddress_;       ///< 每个地址的socket数
+    size_t mtu_;                     ///< 计算GSO段长上限使用的MTU
+    bool gro_;                       ///< 是否尝试开启GRO接收
+    std::atomic<bool> gso_;          ///< 是否使用GSO发送
+    std::vector<SocketInfo> socketInfos_;
+};
+
+} // namespace net
+} // namespace nemo
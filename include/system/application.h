@@ -39,6 +39,21 @@ public:
     net::TcpServer* getServer(const String& name);
 
     bool isDaemon() { return isDaemon_; }
+
+    /**
+     * @brief 优雅关闭所有服务器, 停止接受连接并等待已有连接结束
+     * @param[in] timeoutMillionSeconds 等待的超时时间(毫秒)
+     * @return 是否所有连接都在超时之前结束
+     */
+    bool shutdown(uint64_t timeoutMillionSeconds);
+
+    /**
+     * @brief 优雅关闭所有服务器, 然后停止服务器和全局调度器的线程
+     * @details 收到SIGTERM/SIGINT或者热重启交接完成后由主线程调用,
+     *          不能在调度器的协程中调用
+     * @param[in] timeoutMillionSeconds 等待连接结束的超时时间(毫秒)
+     */
+    void stop(uint64_t timeoutMillionSeconds);
     
 private:
     /**
@@ -47,7 +62,13 @@ private:
     void runTask();
 
     /**
-     * @brief 运行的函数
+     * @brief 等待新进程接管监听socket, 接管后通知主线程优雅关闭并退出
+     * @param[in] path 传递监听socket的Unix域socket路径
+     */
+    void waitHotRestart(const String& path);
+
+    /**
+     * @brief 启动调度器线程, 主线程等待退出信号后调用stop()
      */
     int main(int argc, char** argv);
 
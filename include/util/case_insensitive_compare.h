@@ -2,17 +2,25 @@
 
 #include <string.h>
 
+#include <algorithm>
+
 #include "common/types.h"
 
 namespace nemo {
 namespace string_util {
 
+/**
+ * @brief 忽略大小写的比较, 支持异构查找(不要求字符串以'\0'结尾)
+ */
 class CaseInsensitiveLess {
 public:
+    typedef void is_transparent;
+
     bool operator()(const StringArg& lhs, const StringArg& rhs) const {
-        return ::strcasecmp(lhs.data(), rhs.data()) < 0;
+        int rt = ::strncasecmp(lhs.data(), rhs.data(), std::min(lhs.size(), rhs.size()));
+        return rt < 0 || (rt == 0 && lhs.size() < rhs.size());
     }
 };
 
 } // namepace string_util
-} // namespace nemo
\ No newline at end of file
+} // namespace nemo
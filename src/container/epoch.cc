@@ -0,0 +1,138 @@
+#include "container/epoch.h"
+
+namespace nemo {
+
+namespace {
+
+/**
+ * @brief 线程缓存的空闲读者, 只缓存一个域的读者.
+ *        域析构后缓存中的指针不再使用, 其它域归还读者时清空
+ */
+struct ReaderCache {
+    uint64_t domainId = 0;
+    std::weak_ptr<void> alive;          ///< 缓存所属的域是否还存在
+    std::vector<EpochDomain::Reader*> readers;
+};
+
+thread_local ReaderCache readerCache;
+
+std::atomic<uint64_t> nextDomainId{1};
+
+} // namespace
+
+EpochDomain::Reader::Reader(EpochDomain* domain) :
+    domain_(domain),
+    slot_(nullptr) {
+    std::lock_guard<std::mutex> lockGuard(domain_->mutex_);
+    for(auto& slot : domain_->slots_) {
+        if(!slot->used) {
+            slot_ = slot.get();
+            break;
+        }
+    }
+    if(!slot_) {
+        domain_->slots_.push_back(std::make_unique<Slot>());
+        slot_ = domain_->slots_.back().get();
+    }
+    slot_->used = true;
+}
+
+EpochDomain::Reader::~Reader() {
+    std::lock_guard<std::mutex> lockGuard(domain_->mutex_);
+    slot_->epoch.store(0, std::memory_order_release);
+    slot_->used = false;
+}
+
+EpochDomain::EpochDomain() :
+    id_(nextDomainId.fetch_add(1, std::memory_order_relaxed)),
+    alive_(std::make_shared<bool>(true)) {
+}
+
+EpochDomain::~EpochDomain() {
+    //线程缓存通过id_和alive_识别, 其中的指针不会再被使用
+    alive_.reset();
+    pooledReaders_.clear();
+    for(const Retired& retired : retired_) {
+        retired.deleter(retired.ptr);
+    }
+}
+
+void EpochDomain::retire(const void* ptr, void (*deleter)(const void*)) {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    uint64_t epoch = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+    retired_.push_back(Retired{epoch, ptr, deleter});
+    reclaimUnsafe();
+}
+
+size_t EpochDomain::reclaim() {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    return reclaimUnsafe();
+}
+
+size_t EpochDomain::reclaimUnsafe() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t minEpoch = UINT64_MAX;
+    for(const auto& slot : slots_) {
+        uint64_t epoch = slot->epoch.load(std::memory_order_seq_cst);
+        if(epoch != 0 && epoch < minEpoch) {
+            minEpoch = epoch;
+        }
+    }
+
+    //所有活跃读者都是在epoch之后进入的, 它们读不到这份数据
+    size_t count = 0;
+    for(auto iter = retired_.begin(); iter != retired_.end();) {
+        if(iter->epoch <= minEpoch) {
+            iter->deleter(iter->ptr);
+            iter = retired_.erase(iter);
+            ++count;
+        } else {
+            ++iter;
+        }
+    }
+    return count;
+}
+
+EpochDomain::Reader* EpochDomain::acquire() {
+    ReaderCache& cache = readerCache;
+    if(cache.domainId == id_ && !cache.readers.empty()) {
+        Reader* reader = cache.readers.back();
+        cache.readers.pop_back();
+        return reader;
+    }
+    {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        if(!idleReaders_.empty()) {
+            Reader* reader = idleReaders_.back();
+            idleReaders_.pop_back();
+            return reader;
+        }
+    }
+    //Reader的构造函数需要加锁, 在锁外创建
+    auto reader = std::make_unique<Reader>(this);
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    pooledReaders_.push_back(std::move(reader));
+    return pooledReaders_.back().get();
+}
+
+void EpochDomain::release(Reader* reader) {
+    ReaderCache& cache = readerCache;
+    if(cache.domainId != id_ && (cache.readers.empty() || cache.alive.expired())) {
+        cache.domainId = id_;
+        cache.alive = alive_;
+        cache.readers.clear();
+    }
+    if(cache.domainId == id_) {
+        cache.readers.push_back(reader);
+        return;
+    }
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    idleReaders_.push_back(reader);
+}
+
+size_t EpochDomain::getRetiredCount() const {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    return retired_.size();
+}
+
+} // namespace nemo
@@ -79,7 +79,7 @@ bool Processor::WakeUp(const SuspendEntry& suspendEntry) {
     }
 
     Processor* processor = task->getProcessor();
-    return processor ? processor->wakeUpBySelf(task) : false;
+    return processor ? processor->wakeUpBySelf(std::move(task)) : false;
 }
 
 bool Processor::IsExpired(const SuspendEntry& suspendEntry) {
@@ -254,7 +254,7 @@ Processor::SuspendEntry Processor::suspendBySelf(Task* task) {
     return SuspendEntry(taskPtr);
 }
 
-bool Processor::wakeUpBySelf(const TaskSharedPtr& task) {
+bool Processor::wakeUpBySelf(TaskSharedPtr&& task) {
     Task* wakeUpTask = task.get();
 
     std::unique_lock<std::mutex> uniqueLock(mutex_);
@@ -266,7 +266,13 @@ bool Processor::wakeUpBySelf(const TaskSharedPtr& task) {
     }
 
     // 注意，这里不会delete task所拥有的指针
-    waitSet_.erase(task);
+    {
+        std::lock_guard<std::mutex> lockGuard(waitSetMutex_);
+        waitSet_.erase(task);
+    }
+    // 最后一个引用释放时TaskPointerDeleter才会把task放回runQue_,
+    // 必须先释放再通知, 否则processor可能在task入队前再次进入等待
+    task.reset();
     
     if (1 == runQue_.sizeUnsafe() || GetCurrentProcessor() != this) {
         uniqueLock.unlock();
@@ -278,6 +284,8 @@ bool Processor::wakeUpBySelf(const TaskSharedPtr& task) {
 
 void Processor::process() {
     SetCurrentProcessor(this);
+    //hook开关是线程局部的, 必须在运行协程的线程中打开
+    net::io::SetHookEnable(true);
     Runnable run;
 
     while (scheduler_ && !scheduler_->isStop()) {
@@ -246,13 +246,9 @@ void Scheduler::stop() {
     started_.store(false, std::memory_order::release);
 
     for (auto iter = processors_.begin(); iter != processors_.end(); ++iter) {
-        Processor::UniquePtr processor;
-        processor.swap(*iter);
-        processor->notifiNewQueCondition();
+        (*iter)->notifiNewQueCondition();
     }
 
-    processors_.clear();
-
     if (balanceThread_) {
         balanceThread_->join();
     }
@@ -261,6 +257,9 @@ void Scheduler::stop() {
         threads_[i]->join();
     }
     threads_.clear();
+
+    // 线程退出之后才能释放processor, 否则线程可能访问已经释放的processor
+    processors_.clear();
 }
 
 void Scheduler::addTask(Task&& task) {
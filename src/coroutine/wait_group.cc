@@ -0,0 +1,65 @@
+#include "coroutine/wait_group.h"
+
+#include "common/macro.h"
+
+namespace nemo {
+namespace coroutine {
+
+void WaitGroup::add(size_t n) {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    count_ += n;
+}
+
+void WaitGroup::done() {
+    std::vector<Processor::SuspendEntry> waiters;
+    {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        NEMO_ASSERT(count_ > 0);
+        if(--count_ > 0) {
+            return;
+        }
+        waiters.swap(waiters_);
+    }
+    for(auto& entry : waiters) {
+        //超时等待的协程可能已经被定时器唤醒
+        if(!Processor::IsExpired(entry)) {
+            Processor::WakeUp(entry);
+        }
+    }
+}
+
+void WaitGroup::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(count_ > 0) {
+        waiters_.push_back(Processor::Suspend());
+        lock.unlock();
+        Processor::Yield();
+        lock.lock();
+    }
+}
+
+bool WaitGroup::waitUntil(Clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(count_ > 0) {
+        if(Clock::now() >= deadline) {
+            return false;
+        }
+        waiters_.push_back(Processor::Suspend(deadline));
+        lock.unlock();
+        Processor::Yield();
+        lock.lock();
+        //被定时器唤醒时清理失效的等待项
+        std::erase_if(waiters_, [](const Processor::SuspendEntry& entry) {
+            return Processor::IsExpired(entry);
+        });
+    }
+    return true;
+}
+
+size_t WaitGroup::count() {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    return count_;
+}
+
+} // namespace coroutine
+} // namespace nemo
@@ -2,6 +2,9 @@
 
 #include <netdb.h>
 
+#include "net/dns_resolver.h"
+#include "net/io/hook.h"
+#include "coroutine/processor.h"
 #include "log/log.h"
 #include "util/util.h"
 #include "system/endian.h"
@@ -16,15 +19,11 @@ static T CreateMask(uint32_t bits) {
     return (1 << (sizeof(T) * 8 - bits)) - 1;
 }
 
-struct addrinfo* GetAddrInfo(StringArg host, const SocketAttribute& attr) {
-    struct addrinfo hints;
-    MemoryZero(&hints, sizeof hints);
-    hints.ai_family = attr.family;
-    hints.ai_socktype = attr.type;
-    hints.ai_protocol = attr.protocol;
-
-    String node;                    //主机名
-    const char* service = nullptr; //端口号
+/**
+ * @brief 把host[:port]拆分成主机名和端口, IPv6地址需要写在方括号中
+ */
+static bool SplitHost(StringArg host, String& node, const char*& service) {
+    service = nullptr;
 
     //检查ipv6 address service
     //http://[fe80::70c9:e677:9e95:d109]:8080/
@@ -38,7 +37,7 @@ struct addrinfo* GetAddrInfo(StringArg host, const SocketAttribute& attr) {
             }
             node = host.substr(1, endipv6 - host.data() - 1);
         } else {
-            return nullptr;
+            return false;
         }
     }
 
@@ -49,6 +48,8 @@ struct addrinfo* GetAddrInfo(StringArg host, const SocketAttribute& attr) {
             if(!::memchr(service + 1, ':', host.data() + host.size() - service - 1)) {
                 node = host.substr(0, service - host.data());
                 ++service;
+            } else {
+                service = nullptr;
             }
         }
     }
@@ -56,6 +57,21 @@ struct addrinfo* GetAddrInfo(StringArg host, const SocketAttribute& attr) {
     if(node.empty()) {
         node = host;
     }
+    return true;
+}
+
+struct addrinfo* GetAddrInfo(StringArg host, const SocketAttribute& attr) {
+    struct addrinfo hints;
+    MemoryZero(&hints, sizeof hints);
+    hints.ai_family = attr.family;
+    hints.ai_socktype = attr.type;
+    hints.ai_protocol = attr.protocol;
+
+    String node;                    //主机名
+    const char* service = nullptr; //端口号
+    if(!SplitHost(host, node, service)) {
+        return nullptr;
+    }
 
     addrinfo* result;
     int error = ::getaddrinfo(node.data(), service, &hints, &result);
@@ -69,6 +85,59 @@ struct addrinfo* GetAddrInfo(StringArg host, const SocketAttribute& attr) {
     return result;
 }
 
+/**
+ * @brief 是否可以交给DnsResolver解析: 在开启hook的协程中, 主机名不是数字地址, 端口是数字
+ */
+static bool UseDnsResolver(const String& node, const char* service, const SocketAttribute& attr) {
+    if(AF_INET != attr.family && AF_INET6 != attr.family && AF_UNSPEC != attr.family) {
+        return false;
+    }
+    if(!io::IsHookEnable() || !coroutine::Processor::GetCurrentProcessor() ||
+        !DnsResolver::IsEnabled()) {
+        return false;
+    }
+    if(service && (!*service || ::strspn(service, "0123456789") != ::strlen(service))) {
+        return false;
+    }
+    in6_addr buffer;
+    return ::inet_pton(AF_INET, node.c_str(), &buffer) != 1 &&
+            ::inet_pton(AF_INET6, node.c_str(), &buffer) != 1;
+}
+
+bool ResolveAddresses(StringArg host, const SocketAttribute& attr,
+                    std::vector<Address::UniquePtr>& result) {
+    String node;
+    const char* service = nullptr;
+    if(!SplitHost(host, node, service)) {
+        return false;
+    }
+
+    if(UseDnsResolver(node, service, attr)) {
+        std::vector<IpAddress::UniquePtr> addresses;
+        if(!DnsResolver::GetInstance().resolve(node, attr.family, addresses)) {
+            NEMO_LOG_DEBUG(systemLogger) << "ResolveAddresses(" << host << ", "
+                << attr.family << ", " << attr.type << ") failed";
+            return false;
+        }
+        uint16_t port = service ? static_cast<uint16_t>(::atoi(service)) : 0;
+        for(IpAddress::UniquePtr& address : addresses) {
+            address->setPort(port);
+            result.push_back(std::move(address));
+        }
+        return true;
+    }
+
+    addrinfo* info = GetAddrInfo(host, attr);
+    if(nullptr == info) {
+        return false;
+    }
+    for(addrinfo* next = info; next; next = next->ai_next) {
+        result.push_back(Address::Create(next->ai_addr, (socklen_t)next->ai_addrlen));
+    }
+    ::freeaddrinfo(info);
+    return true;
+}
+
 Address::UniquePtr Address::Create(const sockaddr* addr, socklen_t addrlen) {
     if(!addr) {
         return nullptr;
@@ -82,7 +151,7 @@ Address::UniquePtr Address::Create(const sockaddr* addr, socklen_t addrlen) {
             return std::make_unique<Ipv6Address>(*(const sockaddr_in6*)addr);
             break;
         case AF_UNIX:
-            return std::make_unique<UnixAddress>(*(const sockaddr_un*)addr);
+            return std::make_unique<UnixAddress>(*(const sockaddr_un*)addr, addrlen);
             break;
         default:
             return std::make_unique<UnknownAddress>(*addr);
@@ -92,46 +161,27 @@ Address::UniquePtr Address::Create(const sockaddr* addr, socklen_t addrlen) {
 }
 
 Address::UniquePtr Address::LookupAny(StringArg host, const SocketAttribute& attr) {
-    addrinfo* info = GetAddrInfo(host, attr);
-    if (nullptr == info) {
+    std::vector<Address::UniquePtr> addresses;
+    if(!ResolveAddresses(host, attr, addresses) || addresses.empty()) {
         return nullptr;
     }
-    addrinfo* next = info;
-    Address::UniquePtr result = Create(next->ai_addr, (socklen_t)next->ai_addrlen);
-    ::freeaddrinfo(info);
-
-    return result;
+    return std::move(addresses.front());
 }
 
 std::unique_ptr<IpAddress> Address::LookupAnyIPAddress(StringArg host, 
             const SocketAttribute& attr) {
-    struct addrinfo* info = GetAddrInfo(host, attr);
-    if (nullptr == info) {
+    std::vector<Address::UniquePtr> addresses;
+    if(!ResolveAddresses(host, attr, addresses)) {
         return nullptr;
     }
 
-    struct addrinfo* next = info;
-    std::unique_ptr<IpAddress> result;
-    while (next) {
-        switch (next->ai_addr->sa_family) {
-            case AF_INET:
-                result = std::make_unique<Ipv4Address>(*(const sockaddr_in*)next->ai_addr);
-                goto out;
-                break;
-            case AF_INET6:
-                result = std::make_unique<Ipv6Address>(*(const sockaddr_in6*)next->ai_addr);
-                goto out;
-                break;
-            default:
-                break;
+    for(Address::UniquePtr& address : addresses) {
+        int family = address->getFamily();
+        if(AF_INET == family || AF_INET6 == family) {
+            return std::unique_ptr<IpAddress>(static_cast<IpAddress*>(address.release()));
         }
-        next = next->ai_next;
     }
-
-out:
-    ::freeaddrinfo(info);
-
-    return result;
+    return nullptr;
 }
 
 std::multimap<String, std::pair<Address::UniquePtr, uint32_t>>
@@ -422,11 +472,36 @@ constexpr static size_t MAX_PATH_LEN = sizeof(((sockaddr_un*)0)->sun_path) - 1;
 UnixAddress::UnixAddress() {
     memset(&addr_, 0, sizeof(addr_));
     addr_.sun_family = AF_UNIX;
-    length_ = offsetof(sockaddr_un, sun_path) + MAX_PATH_LEN;
+    length_ = sizeof(addr_); //作为accept/getsockname的缓冲区, 要放得下占满sun_path的抽象名字
 }
 
-UnixAddress::UnixAddress(const sockaddr_un& address) {
+UnixAddress::UnixAddress(const sockaddr_un& address, socklen_t length) {
     addr_ = address;
+    length_ = std::min<socklen_t>(length, sizeof(addr_));
+}
+
+UnixAddress::UniquePtr UnixAddress::Parse(StringArg address) {
+    constexpr StringArg kPrefix = "unix:";
+    if(address.size() <= kPrefix.size() || address.substr(0, kPrefix.size()) != kPrefix) {
+        return nullptr;
+    }
+    StringArg name = address.substr(kPrefix.size());
+    std::string path;
+    //文件路径需要留出结尾的'\0', 抽象命名空间的名字不以'\0'结尾, 可以占满sun_path
+    size_t maxLength = MAX_PATH_LEN;
+    if('@' == name[0]) { //抽象命名空间的名字以'\0'开头, 长度不包括结尾的'\0'
+        path.push_back('\0');
+        name.remove_prefix(1);
+        if(name.empty()) {
+            return nullptr;
+        }
+        maxLength = sizeof(sockaddr_un::sun_path);
+    }
+    path.append(name.data(), name.size());
+    if(path.size() > maxLength) {
+        return nullptr;
+    }
+    return std::make_unique<UnixAddress>(path);
 }
 
 UnixAddress::UnixAddress(const std::string& path) {
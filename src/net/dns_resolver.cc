@@ -0,0 +1,664 @@
+#include "net/dns_resolver.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <netinet/in.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#include "net/socket.h"
+#include "util/util.h"
+#include "log/log.h"
+#include "common/config.h"
+
+namespace nemo {
+namespace net {
+
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+static ConfigVar<bool>* dnsEnableConfig =
+    Config::Lookup("dns.enable", true,
+                    "resolve host names in coroutines with the built-in resolver instead of getaddrinfo");
+
+static ConfigVar<uint32_t>* dnsCacheSizeConfig =
+    Config::Lookup("dns.cache_size", static_cast<uint32_t>(10000),
+                    "max (name, record type) entries kept by the dns cache, 0 disables the cache");
+
+static ConfigVar<uint32_t>* dnsMaxTtlConfig =
+    Config::Lookup("dns.max_ttl", static_cast<uint32_t>(300),
+                    "upper bound of the ttl(seconds) of cached dns answers");
+
+static ConfigVar<uint32_t>* dnsNegativeTtlConfig =
+    Config::Lookup("dns.negative_ttl", static_cast<uint32_t>(30),
+                    "ttl(seconds) of cached NXDOMAIN/NODATA answers without SOA record");
+
+static ConfigVar<String>* dnsResolvConfConfig =
+    Config::Lookup("dns.resolv_conf", String("/etc/resolv.conf"), "resolver configuration file");
+
+static ConfigVar<String>* dnsHostsConfig =
+    Config::Lookup("dns.hosts", String("/etc/hosts"), "static host table");
+
+static ConfigVar<std::vector<String>>* dnsNameserversConfig =
+    Config::Lookup("dns.nameservers", std::vector<String>(),
+                    "nameservers(ip or ip:port), override the nameservers in resolv.conf");
+
+static constexpr uint16_t kTypeA = 1;
+static constexpr uint16_t kTypeCname = 5;
+static constexpr uint16_t kTypeSoa = 6;
+static constexpr uint16_t kTypeAaaa = 28;
+static constexpr uint16_t kClassIn = 1;
+static constexpr uint16_t kFlagResponse = 0x8000;
+static constexpr uint16_t kFlagTruncated = 0x0200;
+static constexpr uint16_t kFlagRecursion = 0x0100;
+static constexpr uint16_t kRcodeNxDomain = 3;
+static constexpr size_t kHeaderSize = 12;
+static constexpr size_t kMaxUdpSize = 4096;
+
+static uint16_t ReadUint16(const uint8_t* data) {
+    return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+static uint32_t ReadUint32(const uint8_t* data) {
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+           (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+static void AppendUint16(String& out, uint16_t value) {
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value & 0xff));
+}
+
+static uint16_t NextId() {
+    static thread_local std::mt19937 engine(std::random_device{}());
+    return static_cast<uint16_t>(engine());
+}
+
+static String ToLower(StringArg str) {
+    String lower(str);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                    [](unsigned char c) { return static_cast<char>(::tolower(c)); });
+    return lower;
+}
+
+/**
+ * @brief 读取报文中的域名, 支持压缩指针
+ * @param[in, out] offset 域名的起始位置, 返回时指向域名之后
+ * @param[out] name 小写的域名, 为nullptr时只跳过
+ * @return 报文是否合法
+ */
+static bool ReadName(const uint8_t* msg, size_t size, size_t& offset, String* name) {
+    size_t pos = offset;
+    bool jumped = false;
+    //每次跳转都必须向前, 再加上次数限制, 构造的循环指针不会死循环
+    for(int jumps = 0; jumps < 128; ) {
+        if(pos >= size) {
+            return false;
+        }
+        uint8_t length = msg[pos];
+        if(0 == length) {
+            if(!jumped) {
+                offset = pos + 1;
+            }
+            return true;
+        }
+        if(0xc0 == (length & 0xc0)) {
+            if(pos + 1 >= size) {
+                return false;
+            }
+            size_t target = ((length & 0x3f) << 8) | msg[pos + 1];
+            if(target >= pos) {
+                return false;
+            }
+            if(!jumped) {
+                offset = pos + 2;
+                jumped = true;
+            }
+            pos = target;
+            ++jumps;
+            continue;
+        }
+        if((length & 0xc0) || pos + 1 + length > size) {
+            return false;
+        }
+        if(name) {
+            if(!name->empty()) {
+                name->push_back('.');
+            }
+            for(size_t i = 0; i < length; ++i) {
+                name->push_back(static_cast<char>(::tolower(msg[pos + 1 + i])));
+            }
+            if(name->size() > 255) {
+                return false;
+            }
+        }
+        pos += 1 + length;
+    }
+    return false;
+}
+
+/**
+ * @brief 构造查询报文
+ */
+static bool BuildQuery(const String& name, uint16_t id, uint16_t type, String& out) {
+    out.clear();
+    AppendUint16(out, id);
+    AppendUint16(out, kFlagRecursion);
+    AppendUint16(out, 1);
+    AppendUint16(out, 0);
+    AppendUint16(out, 0);
+    AppendUint16(out, 0);
+    size_t begin = 0;
+    while(begin < name.size()) {
+        size_t end = name.find('.', begin);
+        if(String::npos == end) {
+            end = name.size();
+        }
+        size_t length = end - begin;
+        if(0 == length || length > 63) {
+            return false;
+        }
+        out.push_back(static_cast<char>(length));
+        out.append(name, begin, length);
+        begin = end + 1;
+    }
+    out.push_back('\0');
+    if(out.size() - kHeaderSize > 255) {
+        return false;
+    }
+    AppendUint16(out, type);
+    AppendUint16(out, kClassIn);
+    return true;
+}
+
+/**
+ * @brief 解析响应报文
+ * @param[out] error 响应对应的问题无法回答(SERVFAIL, REFUSED等), 需要换一个nameserver
+ * @return 响应对应的问题, 不是期望的响应时返回nullptr
+ */
+template<typename Question>
+static Question* ParseResponse(const uint8_t* msg, size_t size, const String& name,
+                                std::vector<Question*>& pending, bool& error) {
+    error = false;
+    if(size < kHeaderSize) {
+        return nullptr;
+    }
+    uint16_t id = ReadUint16(msg);
+    uint16_t flags = ReadUint16(msg + 2);
+    if(!(flags & kFlagResponse) || ReadUint16(msg + 4) != 1) {
+        return nullptr;
+    }
+    auto it = std::find_if(pending.begin(), pending.end(),
+                            [id](Question* q) { return q->id == id; });
+    if(it == pending.end()) {
+        return nullptr;
+    }
+    Question* question = *it;
+
+    //问题部分必须与查询一致, 防止伪造的响应
+    size_t offset = kHeaderSize;
+    String qname;
+    if(!ReadName(msg, size, offset, &qname) || offset + 4 > size ||
+        qname != name || ReadUint16(msg + offset) != question->type) {
+        return nullptr;
+    }
+    offset += 4;
+
+    if(flags & kFlagTruncated) {
+        question->truncated = true;
+        return question;
+    }
+    uint16_t rcode = flags & 0x0f;
+    if(kRcodeNxDomain != rcode && 0 != rcode) {
+        error = true;
+        return question;
+    }
+
+    uint16_t answers = ReadUint16(msg + 6);
+    uint16_t authorities = ReadUint16(msg + 8);
+    std::vector<String> addresses;
+    uint32_t ttl = UINT32_MAX;
+    uint32_t negativeTtl = 0;
+    for(uint32_t i = 0; i < static_cast<uint32_t>(answers) + authorities; ++i) {
+        if(!ReadName(msg, size, offset, nullptr) || offset + 10 > size) {
+            return nullptr;
+        }
+        uint16_t type = ReadUint16(msg + offset);
+        uint32_t recordTtl = ReadUint32(msg + offset + 4);
+        uint16_t length = ReadUint16(msg + offset + 8);
+        offset += 10;
+        if(offset + length > size) {
+            return nullptr;
+        }
+        if(i < answers) {
+            //CNAME链上的记录都在回答部分, 地址记录的TTL不能超过链上任何一条记录
+            if(type == question->type &&
+                ((kTypeA == type && 4 == length) || (kTypeAaaa == type && 16 == length))) {
+                addresses.emplace_back(reinterpret_cast<const char*>(msg + offset), length);
+                ttl = std::min(ttl, recordTtl);
+            } else if(kTypeCname == type) {
+                ttl = std::min(ttl, recordTtl);
+            }
+        } else if(kTypeSoa == type) {
+            //否定结果的TTL取SOA记录的TTL与MINIMUM字段中较小的一个(RFC 2308)
+            size_t soa = offset;
+            if(ReadName(msg, offset + length, soa, nullptr) &&
+                ReadName(msg, offset + length, soa, nullptr) && soa + 20 <= offset + length) {
+                negativeTtl = std::min(recordTtl, ReadUint32(msg + soa + 16));
+            }
+        }
+        offset += length;
+    }
+
+    question->done = true;
+    question->negative = addresses.empty();
+    question->ttl = addresses.empty() ? negativeTtl : ttl;
+    question->addresses = std::move(addresses);
+    return question;
+}
+
+/**
+ * @brief 解析nameserver地址: ip, ip:port, [ipv6]:port
+ */
+static Address::UniquePtr ParseNameserver(StringArg server) {
+    String host(server);
+    uint16_t port = 53;
+    if(!host.empty() && '[' == host[0]) {
+        size_t end = host.find(']');
+        if(String::npos == end) {
+            return nullptr;
+        }
+        if(end + 1 < host.size() && ':' == host[end + 1]) {
+            port = static_cast<uint16_t>(::atoi(host.c_str() + end + 2));
+        }
+        host = host.substr(1, end - 1);
+    } else if(std::count(host.begin(), host.end(), ':') == 1) {
+        size_t colon = host.find(':');
+        port = static_cast<uint16_t>(::atoi(host.c_str() + colon + 1));
+        host.resize(colon);
+    }
+    return IpAddress::Create(host.c_str(), port);
+}
+
+DnsResolver::DnsResolver(Token) :
+    ndots_(1),
+    timeoutMillionSeconds_(5000),
+    attempts_(2),
+    cache_(dnsCacheSizeConfig->getValue(), 256) {
+    loadResolvConf(dnsResolvConfConfig->getValue());
+    loadHosts(dnsHostsConfig->getValue());
+
+    const std::vector<String>& servers = dnsNameserversConfig->getValue();
+    if(!servers.empty()) {
+        nameservers_.clear();
+        for(const String& server : servers) {
+            Address::UniquePtr address = ParseNameserver(server);
+            if(address) {
+                nameservers_.push_back(std::move(address));
+            } else {
+                NEMO_LOG_ERROR(systemLogger) << "invalid dns nameserver: " << server;
+            }
+        }
+    }
+    if(nameservers_.empty()) {
+        nameservers_.push_back(std::make_unique<Ipv4Address>(INADDR_LOOPBACK, 53));
+    }
+}
+
+bool DnsResolver::IsEnabled() {
+    return dnsEnableConfig->getValue();
+}
+
+void DnsResolver::loadResolvConf(StringArg path) {
+    std::ifstream in{String(path)};
+    if(!in) {
+        NEMO_LOG_DEBUG(systemLogger) << "DnsResolver open " << path << " failed";
+        return;
+    }
+    String line;
+    while(std::getline(in, line)) {
+        std::istringstream words(line);
+        String key;
+        if(!(words >> key) || '#' == key[0] || ';' == key[0]) {
+            continue;
+        }
+        String value;
+        if("nameserver" == key) {
+            if(words >> value) {
+                Address::UniquePtr address = IpAddress::Create(value.c_str(), 53);
+                if(address) {
+                    nameservers_.push_back(std::move(address));
+                }
+            }
+        } else if("search" == key || "domain" == key) {
+            //后出现的search/domain覆盖前面的
+            search_.clear();
+            while(words >> value) {
+                if('.' == value.back()) {
+                    value.pop_back();
+                }
+                if(!value.empty()) {
+                    search_.push_back(ToLower(value));
+                }
+            }
+        } else if("options" == key) {
+            while(words >> value) {
+                if(value.compare(0, 6, "ndots:") == 0) {
+                    ndots_ = std::min<uint32_t>(::atoi(value.c_str() + 6), 15);
+                } else if(value.compare(0, 8, "timeout:") == 0) {
+                    timeoutMillionSeconds_ = std::clamp<uint32_t>(::atoi(value.c_str() + 8), 1, 30) * 1000;
+                } else if(value.compare(0, 9, "attempts:") == 0) {
+                    attempts_ = std::clamp<uint32_t>(::atoi(value.c_str() + 9), 1, 5);
+                }
+            }
+        }
+    }
+}
+
+void DnsResolver::loadHosts(StringArg path) {
+    std::ifstream in{String(path)};
+    if(!in) {
+        NEMO_LOG_DEBUG(systemLogger) << "DnsResolver open " << path << " failed";
+        return;
+    }
+    String line;
+    while(std::getline(in, line)) {
+        size_t comment = line.find('#');
+        if(String::npos != comment) {
+            line.resize(comment);
+        }
+        std::istringstream words(line);
+        String ip;
+        if(!(words >> ip)) {
+            continue;
+        }
+        String raw;
+        in6_addr buffer;
+        if(::inet_pton(AF_INET, ip.c_str(), &buffer) == 1) {
+            raw.assign(reinterpret_cast<const char*>(&buffer), 4);
+        } else if(::inet_pton(AF_INET6, ip.c_str(), &buffer) == 1) {
+            raw.assign(reinterpret_cast<const char*>(&buffer), 16);
+        } else {
+            continue;
+        }
+        String name;
+        while(words >> name) {
+            hosts_.emplace(ToLower(name), raw);
+        }
+    }
+}
+
+String DnsResolver::CacheKey(const String& name, uint16_t type) {
+    String key;
+    AppendUint16(key, type);
+    key.append(name);
+    return key;
+}
+
+std::vector<String> DnsResolver::candidates(const String& name) const {
+    std::vector<String> names;
+    size_t dots = std::count(name.begin(), name.end(), '.');
+    if(dots >= ndots_) {
+        names.push_back(name);
+    }
+    for(const String& domain : search_) {
+        names.push_back(name + "." + domain);
+    }
+    if(dots < ndots_) {
+        names.push_back(name);
+    }
+    return names;
+}
+
+bool DnsResolver::resolve(StringArg host, int family, std::vector<IpAddress::UniquePtr>& result) {
+    String name = ToLower(host);
+    bool absolute = !name.empty() && '.' == name.back();
+    if(absolute) {
+        name.pop_back();
+    }
+    if(name.empty()) {
+        return false;
+    }
+
+    std::vector<uint16_t> types;
+    if(AF_INET6 == family || AF_UNSPEC == family) {
+        types.push_back(kTypeAaaa);
+    }
+    if(AF_INET == family || AF_UNSPEC == family) {
+        types.push_back(kTypeA);
+    }
+    if(types.empty()) {
+        return false;
+    }
+
+    std::vector<std::vector<String>> addresses(types.size());
+    auto range = hosts_.equal_range(name);
+    for(auto it = range.first; it != range.second; ++it) {
+        for(size_t i = 0; i < types.size(); ++i) {
+            if(it->second.size() == (kTypeA == types[i] ? 4u : 16u)) {
+                addresses[i].push_back(it->second);
+            }
+        }
+    }
+    bool found = std::any_of(addresses.begin(), addresses.end(),
+                                [](const std::vector<String>& v) { return !v.empty(); });
+    if(!found) {
+        for(const String& candidate : absolute ? std::vector<String>{name} : candidates(name)) {
+            if(lookup(candidate, types, addresses)) {
+                found = true;
+                break;
+            }
+        }
+    }
+    if(!found) {
+        return false;
+    }
+
+    //IPv6与IPv4交替排列, 调用者依次尝试连接时一个协议族不通不会等完所有该协议族的地址
+    for(size_t i = 0; ; ++i) {
+        bool more = false;
+        for(const std::vector<String>& list : addresses) {
+            if(i >= list.size()) {
+                continue;
+            }
+            more = true;
+            if(4 == list[i].size()) {
+                sockaddr_in addr;
+                MemoryZero(&addr, sizeof(addr));
+                addr.sin_family = AF_INET;
+                ::memcpy(&addr.sin_addr, list[i].data(), 4);
+                result.push_back(std::make_unique<Ipv4Address>(addr));
+            } else {
+                sockaddr_in6 addr;
+                MemoryZero(&addr, sizeof(addr));
+                addr.sin6_family = AF_INET6;
+                ::memcpy(&addr.sin6_addr, list[i].data(), 16);
+                result.push_back(std::make_unique<Ipv6Address>(addr));
+            }
+        }
+        if(!more) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool DnsResolver::lookup(const String& name, const std::vector<uint16_t>& types,
+                        std::vector<std::vector<String>>& addresses) {
+    std::vector<Question> questions;
+    std::vector<size_t> indexes;
+    Clock::time_point now = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(size_t i = 0; i < types.size(); ++i) {
+            Record record;
+            String key = CacheKey(name, types[i]);
+            if(cache_.get(key, record) && record.expires > now) {
+                addresses[i] = std::move(record.addresses);
+                continue;
+            }
+            Question question;
+            question.type = types[i];
+            questions.push_back(std::move(question));
+            indexes.push_back(i);
+        }
+    }
+
+    if(!questions.empty()) {
+        query(name, questions);
+        now = Clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(size_t i = 0; i < questions.size(); ++i) {
+            Question& question = questions[i];
+            if(!question.done) {    //超时、服务器错误不缓存
+                continue;
+            }
+            uint32_t ttl = question.negative ?
+                            (question.ttl ? question.ttl : dnsNegativeTtlConfig->getValue()) :
+                            std::min(question.ttl, dnsMaxTtlConfig->getValue());
+            addresses[indexes[i]] = question.addresses;
+            String key = CacheKey(name, question.type);
+            if(0 == ttl) {
+                cache_.erase(key);
+                continue;
+            }
+            Record record;
+            record.addresses = std::move(question.addresses);
+            record.expires = now + std::chrono::seconds(ttl);
+            cache_.put(std::move(key), std::move(record));
+        }
+    }
+
+    return std::any_of(addresses.begin(), addresses.end(),
+                        [](const std::vector<String>& v) { return !v.empty(); });
+}
+
+void DnsResolver::query(const String& name, std::vector<Question>& questions) {
+    for(uint32_t attempt = 0; attempt < attempts_; ++attempt) {
+        for(const Address::UniquePtr& server : nameservers_) {
+            for(Question& question : questions) {
+                question.truncated = false;
+            }
+            if(exchangeUdp(server.get(), name, questions)) {
+                return;
+            }
+            bool done = true;
+            for(Question& question : questions) {
+                if(!question.done && question.truncated) {
+                    exchangeTcp(server.get(), name, question);
+                }
+                done = done && question.done;
+            }
+            if(done) {
+                return;
+            }
+        }
+    }
+    NEMO_LOG_DEBUG(systemLogger) << "DnsResolver query " << name << " failed";
+}
+
+bool DnsResolver::exchangeUdp(const Address* server, const String& name,
+                            std::vector<Question>& questions) {
+    Socket::UniquePtr sock = Socket::CreateUdp(server);
+    if(!sock->connect(server)) {
+        return false;
+    }
+
+    //所有记录类型的查询同时发出, 不必等一个响应再发下一个
+    std::vector<Question*> pending;
+    String packet;
+    for(Question& question : questions) {
+        if(question.done) {
+            continue;
+        }
+        question.id = NextId();
+        if(!BuildQuery(name, question.id, question.type, packet)) {
+            return false;
+        }
+        if(sock->send(packet.data(), packet.size()) != static_cast<int>(packet.size())) {
+            return false;
+        }
+        pending.push_back(&question);
+    }
+
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMillionSeconds_);
+    uint8_t buffer[kMaxUdpSize];
+    bool failed = false;
+    while(!pending.empty()) {
+        int64_t remain = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            deadline - Clock::now()).count();
+        if(remain <= 0) {
+            break;
+        }
+        sock->setRecvTimeout(remain);
+        int n = sock->recv(buffer, sizeof(buffer));
+        if(n < 0) {
+            break;
+        }
+        bool error = false;
+        Question* question = ParseResponse(buffer, n, name, pending, error);
+        if(!question) {
+            continue;
+        }
+        failed = failed || error;
+        pending.erase(std::find(pending.begin(), pending.end(), question));
+    }
+
+    return !failed && std::all_of(questions.begin(), questions.end(),
+                                    [](const Question& q) { return q.done; });
+}
+
+bool DnsResolver::exchangeTcp(const Address* server, const String& name, Question& question) {
+    Socket::UniquePtr sock = Socket::CreateTcp(server);
+    sock->setSendTimeout(timeoutMillionSeconds_);
+    sock->setRecvTimeout(timeoutMillionSeconds_);
+    if(!sock->connect(server)) {
+        return false;
+    }
+    question.id = NextId();
+    String packet;
+    if(!BuildQuery(name, question.id, question.type, packet)) {
+        return false;
+    }
+    String request;
+    AppendUint16(request, static_cast<uint16_t>(packet.size()));
+    request.append(packet);
+    if(sock->send(request.data(), request.size()) != static_cast<int>(request.size())) {
+        return false;
+    }
+
+    auto recvAll = [&sock](uint8_t* buffer, size_t length) {
+        size_t offset = 0;
+        while(offset < length) {
+            int n = sock->recv(buffer + offset, length - offset);
+            if(n <= 0) {
+                return false;
+            }
+            offset += n;
+        }
+        return true;
+    };
+    uint8_t header[2];
+    if(!recvAll(header, sizeof(header))) {
+        return false;
+    }
+    std::vector<uint8_t> response(ReadUint16(header));
+    if(!recvAll(response.data(), response.size())) {
+        return false;
+    }
+    std::vector<Question*> pending{&question};
+    bool error = false;
+    return ParseResponse(response.data(), response.size(), name, pending, error) && !error &&
+            question.done;
+}
+
+void DnsResolver::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_.clear();
+}
+
+} // namespace net
+} // namespace nemo
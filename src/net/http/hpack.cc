@@ -0,0 +1,466 @@
+#include "net/http/hpack.h"
+
+#include <algorithm>
+#include <array>
+
+namespace nemo {
+namespace net {
+namespace http {
+
+namespace {
+
+/**
+ * @brief 静态表(RFC 7541 附录A), 下标0不使用
+ */
+static const HpackTable::Field kStaticTable[HpackTable::kStaticTableSize + 1] = {
+    {"", ""},
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+/// Huffman编码的符号数, 最后一个是EOS
+constexpr size_t kHuffmanSymbols = 257;
+constexpr size_t kHuffmanEos = 256;
+constexpr size_t kHuffmanMaxBits = 30;
+
+/**
+ * @brief 每个符号的编码长度(RFC 7541 附录B)
+ * @details 附录B中的编码是规范Huffman编码, 按(长度, 符号)排序后依次分配,
+ *          所以只需要长度就能还原出编码
+ */
+static const uint8_t kHuffmanLengths[kHuffmanSymbols] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+     6, 10, 10, 12, 13,  6,  8, 11, 10, 10,  8, 11,  8,  6,  6,  6,
+     5,  5,  5,  6,  6,  6,  6,  6,  6,  6,  7,  8, 15,  6, 12, 10,
+    13,  6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+     7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  8, 13, 19, 13, 14,  6,
+    15,  5,  6,  5,  6,  5,  6,  6,  6,  5,  7,  7,  6,  6,  6,  5,
+     6,  7,  6,  5,  5,  6,  7,  7,  7,  7,  7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+/**
+ * @brief 由编码长度生成的编解码表
+ */
+struct HuffmanTable {
+    uint32_t codes[kHuffmanSymbols];                 ///< 每个符号的编码
+    uint16_t symbols[kHuffmanSymbols];               ///< 按(长度, 符号)排序的符号
+    uint32_t firstCode[kHuffmanMaxBits + 1] = {0};   ///< 每种长度的第一个编码
+    uint16_t firstIndex[kHuffmanMaxBits + 1] = {0};  ///< 每种长度的第一个符号在symbols中的位置
+    uint16_t count[kHuffmanMaxBits + 1] = {0};       ///< 每种长度的符号数
+
+    HuffmanTable() {
+        for(size_t i = 0; i < kHuffmanSymbols; ++i) {
+            symbols[i] = i;
+            ++count[kHuffmanLengths[i]];
+        }
+        std::stable_sort(symbols, symbols + kHuffmanSymbols, [](uint16_t a, uint16_t b) {
+            return kHuffmanLengths[a] < kHuffmanLengths[b];
+        });
+
+        uint32_t code = 0;
+        uint16_t index = 0;
+        for(size_t len = 1; len <= kHuffmanMaxBits; ++len) {
+            firstCode[len] = code;
+            firstIndex[len] = index;
+            for(uint16_t i = 0; i < count[len]; ++i) {
+                codes[symbols[index + i]] = code + i;
+            }
+            code = (code + count[len]) << 1;
+            index += count[len];
+        }
+    }
+};
+
+static const HuffmanTable huffmanTable;
+
+/**
+ * @brief 读取字符串(RFC 7541 5.2)
+ * @return 消耗的字节数, 失败返回0
+ */
+static size_t DecodeString(const uint8_t* data, size_t len, String& out) {
+    if(0 == len) {
+        return 0;
+    }
+    bool huffman = data[0] & 0x80;
+    uint64_t length = 0;
+    size_t n = hpack::DecodeInteger(data, len, 7, length);
+    if(0 == n || length > len - n) {
+        return 0;
+    }
+    out.clear();
+    if(huffman) {
+        if(!hpack::HuffmanDecode(data + n, length, out)) {
+            return 0;
+        }
+    } else {
+        out.assign(reinterpret_cast<const char*>(data + n), length);
+    }
+    return n + length;
+}
+
+/**
+ * @brief 写入字符串, Huffman编码更短时使用Huffman编码
+ */
+static void EncodeString(StringArg str, String& out) {
+    size_t huffmanLength = hpack::HuffmanEncodedLength(str);
+    if(huffmanLength < str.size()) {
+        hpack::EncodeInteger(huffmanLength, 7, 0x80, out);
+        hpack::HuffmanEncode(str, out);
+    } else {
+        hpack::EncodeInteger(str.size(), 7, 0, out);
+        out.append(str.data(), str.size());
+    }
+}
+
+} // namespace
+
+namespace hpack {
+
+void EncodeInteger(uint64_t value, uint8_t prefix, uint8_t flags, String& out) {
+    uint64_t max = (1u << prefix) - 1;
+    if(value < max) {
+        out.push_back(static_cast<char>(flags | value));
+        return;
+    }
+    out.push_back(static_cast<char>(flags | max));
+    value -= max;
+    while(value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+size_t DecodeInteger(const uint8_t* data, size_t len, uint8_t prefix, uint64_t& value) {
+    if(0 == len) {
+        return 0;
+    }
+    uint64_t max = (1u << prefix) - 1;
+    value = data[0] & max;
+    if(value < max) {
+        return 1;
+    }
+    //索引/长度/表大小都不会超过32位, 最多5个后续字节, 超出时视为溢出, 避免uint64_t回绕
+    for(size_t i = 1, shift = 0; i < len && shift <= 28; ++i, shift += 7) {
+        value += static_cast<uint64_t>(data[i] & 0x7f) << shift;
+        if(!(data[i] & 0x80)) {
+            return value <= UINT32_MAX ? i + 1 : 0;
+        }
+    }
+    return 0;
+}
+
+size_t HuffmanEncodedLength(StringArg data) {
+    size_t bits = 0;
+    for(unsigned char c : data) {
+        bits += kHuffmanLengths[c];
+    }
+    return (bits + 7) / 8;
+}
+
+void HuffmanEncode(StringArg data, String& out) {
+    uint64_t bits = 0;
+    size_t count = 0;
+    for(unsigned char c : data) {
+        bits = (bits << kHuffmanLengths[c]) | huffmanTable.codes[c];
+        count += kHuffmanLengths[c];
+        while(count >= 8) {
+            count -= 8;
+            out.push_back(static_cast<char>(bits >> count));
+        }
+    }
+    if(count > 0) { //用EOS的高位(全1)填充
+        out.push_back(static_cast<char>((bits << (8 - count)) | (0xff >> count)));
+    }
+}
+
+bool HuffmanDecode(const uint8_t* data, size_t len, String& out) {
+    uint32_t code = 0;
+    size_t bits = 0;
+    for(size_t i = 0; i < len; ++i) {
+        for(int bit = 7; bit >= 0; --bit) {
+            code = (code << 1) | ((data[i] >> bit) & 1);
+            ++bits;
+            //规范编码中同一长度的编码是连续的, 落在区间内就是一个完整的符号
+            uint32_t offset = code - huffmanTable.firstCode[bits];
+            if(code >= huffmanTable.firstCode[bits] && offset < huffmanTable.count[bits]) {
+                uint16_t symbol = huffmanTable.symbols[huffmanTable.firstIndex[bits] + offset];
+                if(kHuffmanEos == symbol) {
+                    return false;
+                }
+                out.push_back(static_cast<char>(symbol));
+                code = 0;
+                bits = 0;
+            } else if(bits >= kHuffmanMaxBits) {
+                return false;
+            }
+        }
+    }
+    //填充不能超过7位, 并且必须是EOS的高位
+    return bits < 8 && code == (1u << bits) - 1;
+}
+
+} // namespace hpack
+
+const HpackTable::Field* HpackTable::get(size_t index) const {
+    if(0 == index) {
+        return nullptr;
+    }
+    if(index <= kStaticTableSize) {
+        return &kStaticTable[index];
+    }
+    index -= kStaticTableSize + 1;
+    return index < entries_.size() ? &entries_[index] : nullptr;
+}
+
+void HpackTable::add(StringArg name, StringArg value) {
+    size_t size = name.size() + value.size() + kEntryOverhead;
+    if(size > maxSize_) {
+        evict(0);
+        return;
+    }
+    evict(maxSize_ - size);
+    entries_.emplace_front(String(name), String(value));
+    size_ += size;
+}
+
+size_t HpackTable::find(StringArg name, StringArg value, size_t* nameIndex) const {
+    *nameIndex = 0;
+    for(size_t i = 1; i <= kStaticTableSize; ++i) {
+        if(kStaticTable[i].first == name) {
+            if(kStaticTable[i].second == value) {
+                return i;
+            }
+            if(0 == *nameIndex) {
+                *nameIndex = i;
+            }
+        }
+    }
+    for(size_t i = 0; i < entries_.size(); ++i) {
+        if(entries_[i].first == name) {
+            if(entries_[i].second == value) {
+                return i + kStaticTableSize + 1;
+            }
+            if(0 == *nameIndex) {
+                *nameIndex = i + kStaticTableSize + 1;
+            }
+        }
+    }
+    return 0;
+}
+
+void HpackTable::setMaxSize(size_t maxSize) {
+    maxSize_ = maxSize;
+    evict(maxSize);
+}
+
+void HpackTable::evict(size_t limit) {
+    while(size_ > limit && !entries_.empty()) {
+        const Field& field = entries_.back();
+        size_ -= field.first.size() + field.second.size() + kEntryOverhead;
+        entries_.pop_back();
+    }
+}
+
+HpackDecoder::HpackDecoder(size_t maxTableSize) :
+    table_(maxTableSize),
+    maxTableSize_(maxTableSize) {
+}
+
+bool HpackDecoder::decode(const uint8_t* data, size_t len, FieldVector& fields,
+                          size_t maxListSize, size_t* listSize) {
+    size_t pos = 0;
+    size_t total = 0;
+    bool fieldSeen = false;
+    //累计字段大小, 超过上限后丢弃已经解码的字段, 之后只更新动态表
+    auto account = [&](const HpackTable::Field& field) {
+        bool fits = total <= maxListSize;
+        total += field.first.size() + field.second.size() + HpackTable::kEntryOverhead;
+        if(fits && total > maxListSize) {
+            FieldVector().swap(fields);
+        }
+        return total <= maxListSize;
+    };
+    while(pos < len) {
+        uint8_t first = data[pos];
+        uint64_t index = 0;
+        size_t n = 0;
+        if(first & 0x80) { //索引字段
+            n = hpack::DecodeInteger(data + pos, len - pos, 7, index);
+            const HpackTable::Field* field = n ? table_.get(index) : nullptr;
+            if(!field) {
+                return false;
+            }
+            if(account(*field)) {
+                fields.push_back(*field);
+            }
+            pos += n;
+            fieldSeen = true;
+            continue;
+        }
+
+        if((first & 0xe0) == 0x20) { //动态表大小更新, 只能出现在头部块开头
+            n = hpack::DecodeInteger(data + pos, len - pos, 5, index);
+            if(0 == n || fieldSeen || index > maxTableSize_) {
+                return false;
+            }
+            table_.setMaxSize(index);
+            pos += n;
+            continue;
+        }
+
+        //字面值字段, 01为加入动态表, 0000为不加入, 0001为永不加入
+        bool indexing = (first & 0xc0) == 0x40;
+        n = hpack::DecodeInteger(data + pos, len - pos, indexing ? 6 : 4, index);
+        if(0 == n) {
+            return false;
+        }
+        pos += n;
+        HpackTable::Field field;
+        if(0 == index) {
+            n = DecodeString(data + pos, len - pos, field.first);
+            if(0 == n) {
+                return false;
+            }
+            pos += n;
+        } else {
+            const HpackTable::Field* nameField = table_.get(index);
+            if(!nameField) {
+                return false;
+            }
+            field.first = nameField->first;
+        }
+        n = DecodeString(data + pos, len - pos, field.second);
+        if(0 == n) {
+            return false;
+        }
+        pos += n;
+        if(indexing) {
+            table_.add(field.first, field.second);
+        }
+        if(account(field)) {
+            fields.push_back(std::move(field));
+        }
+        fieldSeen = true;
+    }
+    if(listSize) {
+        *listSize = total;
+    }
+    return true;
+}
+
+HpackEncoder::HpackEncoder(size_t maxTableSize) :
+    table_(maxTableSize),
+    pendingTableSize_(SIZE_MAX) {
+}
+
+void HpackEncoder::setMaxTableSize(size_t maxTableSize) {
+    //动态表不超过默认大小, 对端允许更大的表时也不用
+    maxTableSize = std::min<size_t>(maxTableSize, 4096);
+    if(maxTableSize != table_.getMaxSize()) {
+        table_.setMaxSize(maxTableSize);
+        pendingTableSize_ = maxTableSize;
+    }
+}
+
+void HpackEncoder::begin(String& out) {
+    if(SIZE_MAX != pendingTableSize_) {
+        hpack::EncodeInteger(pendingTableSize_, 5, 0x20, out);
+        pendingTableSize_ = SIZE_MAX;
+    }
+}
+
+void HpackEncoder::encode(StringArg name, StringArg value, String& out, bool indexing) {
+    size_t nameIndex = 0;
+    size_t index = table_.find(name, value, &nameIndex);
+    if(index) {
+        hpack::EncodeInteger(index, 7, 0x80, out);
+        return;
+    }
+
+    if(indexing) {
+        hpack::EncodeInteger(nameIndex, 6, 0x40, out);
+    } else {
+        hpack::EncodeInteger(nameIndex, 4, 0, out);
+    }
+    if(0 == nameIndex) {
+        EncodeString(name, out);
+    }
+    EncodeString(value, out);
+    if(indexing) {
+        table_.add(name, value);
+    }
+}
+
+} // namespace http
+} // namespace net
+} // namespace nemo
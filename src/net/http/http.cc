@@ -1,84 +1,163 @@
 #include "net/http/http.h"
 
+#include <charconv>
+
 namespace nemo {
 namespace net {
 namespace http {
 
-HttpRequest::HttpRequest(HttpVersion version, bool close) :
+/**
+ * @brief 序列化时connection字段单独输出
+ */
+static bool IsConnectionHeader(StringArg name) {
+    return name.size() == 10 && ::strncasecmp(name.data(), "connection", 10) == 0;
+}
+
+bool HasHeaderToken(StringArg value, StringArg token) {
+    while(!value.empty()) {
+        size_t end = value.find(',');
+        StringArg item = value.substr(0, end);
+        while(!item.empty() && ' ' == item.front()) {
+            item.remove_prefix(1);
+        }
+        while(!item.empty() && ' ' == item.back()) {
+            item.remove_suffix(1);
+        }
+        if(item.size() == token.size() &&
+            ::strncasecmp(item.data(), token.data(), token.size()) == 0) {
+            return true;
+        }
+        if(String::npos == end) {
+            break;
+        }
+        value.remove_prefix(end + 1);
+    }
+    return false;
+}
+
+/**
+ * @brief 设置参数/Cookie, 已经存在时覆盖
+ */
+static void SetMapValue(HttpRequest::MapType& m, StringArg key, StringArg val) {
+    auto iter = m.find(key);
+    if(m.end() == iter) {
+        m.emplace(key, val);
+    } else {
+        iter->second = val;
+    }
+}
+
+/**
+ * @brief 追加"HTTP/x.y"
+ */
+static void AppendVersion(String& out, HttpVersion version) {
+    char buff[8] = {'H', 'T', 'T', 'P', '/',
+                    static_cast<char>('0' + ((uint8_t)version >> 4)),
+                    '.',
+                    static_cast<char>('0' + ((uint8_t)version & 0x0F))};
+    out.append(buff, sizeof(buff));
+}
+
+/**
+ * @brief 追加十进制整数
+ */
+template<typename T>
+static void AppendNumber(String& out, T val) {
+    char buff[24];
+    auto result = std::to_chars(buff, buff + sizeof(buff), val);
+    out.append(buff, result.ptr - buff);
+}
+
+HttpRequest::HttpRequest(HttpVersion version, bool close, std::pmr::memory_resource* resource) :
     method_(HttpMethod::GET),
     version_(version),
     close_(close),
     webSocket_(false),
     parserParamFlag_(0),
-    path_("/") {
+    path_("/"),
+    headers_(resource),
+    params_(resource),
+    cookies_(resource),
+    routeParams_(resource) {
 }
 
 bool HttpRequest::createResponse(std::unique_ptr<HttpResponse>& response) {
-    response.reset(new HttpResponse(getVersion(), isClose()));
+    response.reset(new HttpResponse(getVersion(), isClose(), headers_.getResource()));
     return true;
 }
 
-String HttpRequest::getHeader(const String& key, const String& defaultVal) const {
-    auto iter = headers_.find(key);
-    return headers_.end() == iter ? defaultVal : iter->second;
+String HttpRequest::getHeader(StringArg key, const String& defaultVal) const {
+    StringArg val;
+    return headers_.has(key, &val) ? String(val) : defaultVal;
 }
 
 String HttpRequest::getParam(const String& key, const String& defaultVal) {
     initQueryParam();
     initBodyParam();
     auto iter = params_.find(key);
-    return params_.end() == iter ? defaultVal : iter->second;
+    return params_.end() == iter ? defaultVal : String(iter->second);
 }
 
 String HttpRequest::getCookie(const String& key, const String& defaultVal) {
     initCookies();
     auto iter = cookies_.find(key);
-    return cookies_.end() == iter ? defaultVal : iter->second;
+    return cookies_.end() == iter ? defaultVal : String(iter->second);
+}
+
+String HttpRequest::getRouteParam(StringArg key, const String& defaultVal) const {
+    auto iter = routeParams_.find(key);
+    return routeParams_.end() == iter ? defaultVal : String(iter->second);
 }
 
-void HttpRequest::setHeader(const String& key, const String& val) {
-    headers_[key] = val;
+void HttpRequest::setRouteParam(StringArg key, StringArg val) {
+    SetMapValue(routeParams_, key, val);
 }
 
-void HttpRequest::setHeader(const String& key, String&& val) {
-    headers_[key] = std::move(val);
+void HttpRequest::setHeader(StringArg key, StringArg val) {
+    headers_.set(key, val);
 }
 
 void HttpRequest::setParam(const String& key, const String& val) {
-    params_[key] = val;
+    SetMapValue(params_, key, val);
 }
 
 void HttpRequest::setParam(const String& key, String&& val) {
-    params_[key] = std::move(val);
+    SetMapValue(params_, key, val);
 }
 
 void HttpRequest::setCookie(const String& key, const String& val) {
-    cookies_[key] = val;
+    SetMapValue(cookies_, key, val);
 }
 
 void HttpRequest::setCookie(const String& key, String&& val) {
-    cookies_[key] = std::move(val);
+    SetMapValue(cookies_, key, val);
 }
 
-void HttpRequest::delHeader(const String& key) {
+void HttpRequest::delHeader(StringArg key) {
     headers_.erase(key);
 }
 
 void HttpRequest::delParam(const String& key) {
-    params_.erase(key);
+    auto iter = params_.find(key);
+    if(params_.end() != iter) {
+        params_.erase(iter);
+    }
 }
 
 void HttpRequest::delCookie(const String& key) {
-    cookies_.erase(key);
+    auto iter = cookies_.find(key);
+    if(cookies_.end() != iter) {
+        cookies_.erase(iter);
+    }
 }
 
-bool HttpRequest::hasHeader(const String& key, String* val) {
-    auto iter = headers_.find(key);
-    if(headers_.end() == iter) {
+bool HttpRequest::hasHeader(StringArg key, String* val) const {
+    StringArg str;
+    if(!headers_.has(key, &str)) {
         return false;
     }
     if(val) {
-        *val = iter->second;
+        *val = str;
     }
     return true;
 }
@@ -128,10 +207,8 @@ std::ostream& HttpRequest::dump(std::ostream& os) const {
     if(!webSocket_) {
         os << "connection: " << (close_ ? "close" : "keep-alive") << "\r\n";
     }
-    for(auto& header : headers_) {
-        if(!webSocket_ && 
-            ::strncasecmp(header.first.data(), 
-                "connection", header.first.size()) == 0) {
+    for(const auto& header : headers_) {
+        if(!webSocket_ && IsConnectionHeader(header.first)) {
             continue;
         }
         os << header.first << ": " << header.second << "\r\n";
@@ -154,13 +231,16 @@ String HttpRequest::toString() const {
 }
 
 void HttpRequest::init() {
-    String connection = getHeader("connection");
+    StringArg connection = getHeader(HttpHeaderId::CONNECTION);
     if(!connection.empty()) {
-        if(strcasecmp(connection.c_str(), "keep-alive") == 0) {
+        if(connection.size() == 10 && ::strncasecmp(connection.data(), "keep-alive", 10) == 0) {
             close_ = false;
         } else {
             close_ = true;
         }
+    } else {
+        //HTTP/1.1默认为长连接
+        close_ = (version_ != HttpVersion::HTTP11);
     }
 }
 
@@ -181,72 +261,84 @@ void HttpRequest::initCookies() {
 }
 
 
-HttpResponse::HttpResponse(HttpVersion version, bool close) :
+HttpResponse::HttpResponse(HttpVersion version, bool close, std::pmr::memory_resource* resource) :
     status_(HttpStatus::OK),
     version_(version),
     close_(close),
-    webSocket_(false)  {
-}
-
-String HttpResponse::getHeader(const String& key, const String& defaultVal) const {
-    auto iter = headers_.find(key);
-    return headers_.end() == iter ? defaultVal : iter->second;
+    webSocket_(false),
+    headers_(resource) {
 }
 
-void HttpResponse::setHeader(const String& key, const String& val) {
-    headers_[key] = val;
+String HttpResponse::getHeader(StringArg key, const String& defaultVal) const {
+    StringArg val;
+    return headers_.has(key, &val) ? String(val) : defaultVal;
 }
 
-void HttpResponse::setHeader(const String& key, String&& val) {
-    headers_[key] = std::move(val);
+void HttpResponse::setHeader(StringArg key, StringArg val) {
+    headers_.set(key, val);
 }
 
-void HttpResponse::delHeader(const String& key) {
+void HttpResponse::delHeader(StringArg key) {
     headers_.erase(key);
 }
 
 std::ostream& HttpResponse::dump(std::ostream& os) const {
+    String str;
+    appendTo(str);
+    return os << str;
+}
+
+std::ostream& HttpResponse::dumpHeader(std::ostream& os) const {
+    String str;
+    appendHeaderTo(str);
+    return os << str;
+}
+
+void HttpResponse::appendTo(String& out) const {
+    appendHeaderTo(out);
+    //1xx/204/304没有消息体, 不能带上Content-Length: 0
+    int status = static_cast<int>(status_);
+    bool bodyless = status < 200 || 204 == status || 304 == status;
+    if(!webSocket_ && !bodyless && !headers_.has(HttpHeaderId::CONTENT_LENGTH)) {
+        //长连接上必须带上长度, 对方才能知道响应在哪里结束
+        out.append("content-length: ");
+        AppendNumber(out, body_.size());
+        out.append("\r\n");
+    }
+    out.append("\r\n");
+    out.append(body_);
+}
+
+void HttpResponse::appendHeaderTo(String& out) const {
     /**
      * HTTP1.1 200 OK
      *
      */
-    os << "HTTP/"
-       << ((uint32_t)((uint8_t)version_ >> 4))
-       << "."
-       << ((uint32_t)((uint8_t)version_ & 0x0F))
-       << " "
-       << (uint32_t)status_
-       << " "
-       << (reason_.empty() ? HttpStatus2String(status_) : reason_)
-       << "\r\n";
-
-    for(auto& header : headers_) {
-        if(!webSocket_ && strcasecmp(header.first.c_str(), "connection") == 0) {
+    AppendVersion(out, version_);
+    out.push_back(' ');
+    AppendNumber(out, (uint32_t)status_);
+    out.push_back(' ');
+    out.append(reason_.empty() ? HttpStatus2String(status_) : reason_.c_str());
+    out.append("\r\n");
+
+    for(const auto& header : headers_) {
+        if(!webSocket_ && IsConnectionHeader(header.first)) {
             continue;
         }
-        os << header.first << ": " << header.second << "\r\n";
+        out.append(header.first).append(": ").append(header.second).append("\r\n");
     }
     for(auto& cookie : cookies_) {
-        os << "Set-Cookie: " << cookie << "\r\n";
+        out.append("Set-Cookie: ").append(cookie).append("\r\n");
     }
     if(!webSocket_) {
-        os << "connection: " << (close_ ? "close" : "keep-alive") << "\r\n";
+        out.append(close_ ? "connection: close\r\n" : "connection: keep-alive\r\n");
     }
-    if(!body_.empty()) {
-        os << "content-length: " << body_.size() << "\r\n\r\n"
-           << body_;
-    } else {
-        os << "\r\n";
-    }
-    
-    return os;
 }
 
 String HttpResponse::toString() const {
-    std::stringstream ss;
-    dump(ss);
-
-    return ss.str();
+    String str;
+    appendTo(str);
+    return str;
 }
 
 void HttpResponse::setRedirect(const String& uri) {
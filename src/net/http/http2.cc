@@ -0,0 +1,66 @@
+#include "net/http/http2.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+void Http2FrameHeader::parse(const void* data) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    length = (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+    type = static_cast<Http2FrameType>(p[3]);
+    flags = p[4];
+    streamId = ReadHttp2Uint32(p + 5) & 0x7fffffff;
+}
+
+void Http2FrameHeader::appendTo(String& out) const {
+    char buff[kHttp2FrameHeaderSize] = {
+        static_cast<char>(length >> 16),
+        static_cast<char>(length >> 8),
+        static_cast<char>(length),
+        static_cast<char>(type),
+        static_cast<char>(flags),
+        static_cast<char>((streamId >> 24) & 0x7f),
+        static_cast<char>(streamId >> 16),
+        static_cast<char>(streamId >> 8),
+        static_cast<char>(streamId)
+    };
+    out.append(buff, sizeof(buff));
+}
+
+void AppendHttp2Frame(String& out, Http2FrameType type, uint8_t flags,
+                      uint32_t streamId, StringArg payload) {
+    Http2FrameHeader header;
+    header.length = payload.size();
+    header.type = type;
+    header.flags = flags;
+    header.streamId = streamId;
+    header.appendTo(out);
+    out.append(payload.data(), payload.size());
+}
+
+void AppendHttp2Uint32(String& out, uint32_t value) {
+    char buff[4] = {
+        static_cast<char>(value >> 24),
+        static_cast<char>(value >> 16),
+        static_cast<char>(value >> 8),
+        static_cast<char>(value)
+    };
+    out.append(buff, sizeof(buff));
+}
+
+const char* Http2Error2String(Http2Error error) {
+    switch(error) {
+#define XX(code, name, desc) \
+        case Http2Error::name: \
+            return #desc;
+        HTTP2_ERROR_MAP(XX);
+#undef XX
+        default:
+            return "<unknown>";
+    }
+    return "<unknown>";
+}
+
+} // namespace http
+} // namespace net
+} // namespace nemo
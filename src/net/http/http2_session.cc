@@ -0,0 +1,1029 @@
+#include "net/http/http2_session.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+
+#include "net/http/http_parser.h"
+#include "net/http/http_compress.h"
+#include "log/log.h"
+#include "common/config.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+static ConfigVar<bool>* http2EnableConfig =
+    Config::Lookup("http.http2.enable", true,
+                    "enable http/2 (prior knowledge, h2c upgrade and alpn h2)");
+
+static ConfigVar<uint32_t>* http2MaxConcurrentStreamsConfig =
+    Config::Lookup("http.http2.max_concurrent_streams",
+                    static_cast<uint32_t>(100),
+                    "http/2 max concurrent streams per connection");
+
+static ConfigVar<uint32_t>* http2InitialWindowSizeConfig =
+    Config::Lookup("http.http2.initial_window_size",
+                    static_cast<uint32_t>(kHttp2DefaultWindowSize),
+                    "http/2 initial flow control window of each stream");
+
+static ConfigVar<uint32_t>* http2MaxHeaderListSizeConfig =
+    Config::Lookup("http.http2.max_header_list_size",
+                    static_cast<uint32_t>(64 * 1024),
+                    "http/2 max header list size of a request");
+
+static ConfigVar<uint32_t>* http2MaxResetStreamsConfig =
+    Config::Lookup("http.http2.max_reset_streams",
+                    static_cast<uint32_t>(200),
+                    "http/2 max RST_STREAM frames a client may send per second, "
+                    "the connection is closed with ENHANCE_YOUR_CALM above it");
+
+static bool http2Enable = true;
+static uint32_t http2MaxConcurrentStreams = 0;
+static uint32_t http2InitialWindowSize = 0;
+static uint32_t http2MaxHeaderListSize = 0;
+static uint32_t http2MaxResetStreams = 0;
+
+namespace {
+struct Http2ConfigIniter {
+    Http2ConfigIniter() {
+        http2Enable = http2EnableConfig->getValue();
+        http2MaxConcurrentStreams = http2MaxConcurrentStreamsConfig->getValue();
+        http2InitialWindowSize = std::min<uint32_t>(http2InitialWindowSizeConfig->getValue(),
+                                                    kHttp2MaxWindowSize);
+        http2MaxHeaderListSize = http2MaxHeaderListSizeConfig->getValue();
+        http2MaxResetStreams = http2MaxResetStreamsConfig->getValue();
+
+        http2EnableConfig->addListener([](const bool& oldVal, const bool& newVal) {
+            static_cast<void>(oldVal);
+            http2Enable = newVal;
+        });
+        http2MaxConcurrentStreamsConfig->addListener([](const uint32_t& oldVal, const uint32_t& newVal) {
+            static_cast<void>(oldVal);
+            http2MaxConcurrentStreams = newVal;
+        });
+        http2InitialWindowSizeConfig->addListener([](const uint32_t& oldVal, const uint32_t& newVal) {
+            static_cast<void>(oldVal);
+            http2InitialWindowSize = std::min<uint32_t>(newVal, kHttp2MaxWindowSize);
+        });
+        http2MaxHeaderListSizeConfig->addListener([](const uint32_t& oldVal, const uint32_t& newVal) {
+            static_cast<void>(oldVal);
+            http2MaxHeaderListSize = newVal;
+        });
+        http2MaxResetStreamsConfig->addListener([](const uint32_t& oldVal, const uint32_t& newVal) {
+            static_cast<void>(oldVal);
+            http2MaxResetStreams = newVal;
+        });
+    }
+};
+
+static Http2ConfigIniter http2ConfigIniter;
+
+/// 写协程每次最多编码的字节数, 避免一个大响应长时间占用锁
+constexpr size_t kMaxWriteBytes = 64 * 1024;
+
+/**
+ * @brief HTTP/2中禁止出现的连接相关字段(RFC 7540 8.1.2.2)
+ */
+static bool IsConnectionSpecificHeader(StringArg name) {
+    static const StringArg kHeaders[] = {
+        "connection", "keep-alive", "proxy-connection", "transfer-encoding", "upgrade"
+    };
+    for(StringArg header : kHeaders) {
+        if(name.size() == header.size() &&
+            ::strncasecmp(name.data(), header.data(), name.size()) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool HasUpperCase(StringArg name) {
+    return std::any_of(name.begin(), name.end(), [](char c) { return c >= 'A' && c <= 'Z'; });
+}
+
+static void AppendSetting(String& out, Http2Setting id, uint32_t value) {
+    out.push_back(static_cast<char>(static_cast<uint16_t>(id) >> 8));
+    out.push_back(static_cast<char>(static_cast<uint16_t>(id)));
+    AppendHttp2Uint32(out, value);
+}
+
+static void AppendWindowUpdate(String& out, uint32_t streamId, uint32_t increment) {
+    String payload;
+    AppendHttp2Uint32(payload, increment);
+    AppendHttp2Frame(out, Http2FrameType::WINDOW_UPDATE, 0, streamId, payload);
+}
+
+static bool SendAll(Socket* sock, const String& data) {
+    size_t offset = 0;
+    while(offset < data.size()) {
+        int len = sock->send(data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+        if(len <= 0) {
+            return false;
+        }
+        offset += len;
+    }
+    return true;
+}
+
+} // namespace
+
+/**
+ * @brief 流的状态
+ */
+struct Http2Session::Stream {
+    uint32_t id;
+    HttpRequest::UniquePtr request;
+    String body;                        ///< 正在接收的消息体
+    HttpResponse::UniquePtr response;   ///< 处理完成后的响应
+    size_t dataOffset = 0;              ///< 消息体已经发送的字节数
+    int64_t sendWindow;                 ///< 发送窗口
+    int64_t recvConsumed = 0;           ///< 已经消费还没有通告的字节数
+    int64_t recvWindow;                 ///< 接收窗口
+    bool remoteClosed = false;          ///< 已经收到END_STREAM
+    bool headersSent = false;           ///< 响应头部已经发送
+    bool localClosed = false;           ///< 已经发送END_STREAM
+    bool reset = false;                 ///< 已经被重置, 处理结果直接丢弃
+    bool handling = false;              ///< 处理协程正在执行servlet
+};
+
+bool Http2Session::IsEnabled() {
+    return http2Enable;
+}
+
+bool Http2Session::DecodeSettingsHeader(StringArg value, String& settings) {
+    //base64url, 没有填充
+    settings.clear();
+    uint32_t bits = 0;
+    int count = 0;
+    for(char c : value) {
+        int v = -1;
+        if(c >= 'A' && c <= 'Z') {
+            v = c - 'A';
+        } else if(c >= 'a' && c <= 'z') {
+            v = c - 'a' + 26;
+        } else if(c >= '0' && c <= '9') {
+            v = c - '0' + 52;
+        } else if('-' == c || '+' == c) {
+            v = 62;
+        } else if('_' == c || '/' == c) {
+            v = 63;
+        } else if('=' == c) {
+            break;
+        } else {
+            return false;
+        }
+        bits = (bits << 6) | v;
+        count += 6;
+        if(count >= 8) {
+            count -= 8;
+            settings.push_back(static_cast<char>(bits >> count));
+        }
+    }
+    return settings.size() % 6 == 0;
+}
+
+Http2Session::Http2Session(Socket::SharedPtr sock, ServletDispatcher* dispatcher,
+                           coroutine::Scheduler* scheduler, StringArg serverName) :
+    sock_(std::move(sock)),
+    dispatcher_(dispatcher),
+    scheduler_(scheduler),
+    serverName_(serverName),
+    routeReader_(nullptr),
+    readPos_(0),
+    readEnd_(0),
+    headerStreamId_(0),
+    headerEndStream_(false),
+    lastStreamId_(0),
+    goawayReceived_(false),
+    peerClosed_(false),
+    resetCount_(0),
+    peerMaxFrameSize_(kHttp2DefaultMaxFrameSize),
+    peerInitialWindow_(kHttp2DefaultWindowSize),
+    sendWindow_(kHttp2DefaultWindowSize),
+    recvWindow_(kHttp2DefaultWindowSize),
+    recvConsumed_(0),
+    activeHandlers_(0),
+    resetHandlers_(0),
+    closing_(false),
+    goawaySent_(false),
+    goawayStreamId_(0),
+    readShutdown_(false),
+    writerDone_(false),
+    writeError_(false),
+    writerWaiting_(false),
+    doneWaiting_(false) {
+    PeerCredentials credentials;
+    if(sock_->getPeerCredentials(credentials)) {
+        peerCredentials_ = credentials;
+    }
+}
+
+Http2Session::~Http2Session() {
+}
+
+void Http2Session::run(StringArg data) {
+    runUpgrade(nullptr, StringArg(), data);
+}
+
+void Http2Session::runUpgrade(const HttpRequest* request, StringArg settings, StringArg data) {
+    routeReader_ = dispatcher_->getEpochDomain()->acquire();
+    {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        //服务端连接前言
+        String payload;
+        AppendSetting(payload, Http2Setting::ENABLE_PUSH, 0);
+        AppendSetting(payload, Http2Setting::MAX_CONCURRENT_STREAMS, http2MaxConcurrentStreams);
+        AppendSetting(payload, Http2Setting::INITIAL_WINDOW_SIZE, http2InitialWindowSize);
+        AppendSetting(payload, Http2Setting::MAX_HEADER_LIST_SIZE, http2MaxHeaderListSize);
+        AppendHttp2Frame(controlFrames_, Http2FrameType::SETTINGS, 0, 0, payload);
+        //连接窗口没有对应的SETTINGS参数, 和流的初始窗口保持一致
+        if(http2InitialWindowSize > static_cast<uint32_t>(recvWindow_)) {
+            AppendWindowUpdate(controlFrames_, 0, http2InitialWindowSize - recvWindow_);
+            recvWindow_ = http2InitialWindowSize;
+        }
+
+        if(request) {
+            //HTTP2-Settings相当于客户端的第一个SETTINGS帧, 不需要确认
+            applySettings(reinterpret_cast<const uint8_t*>(settings.data()), settings.size());
+            auto stream = std::make_shared<Stream>();
+            stream->id = 1;
+            stream->body = request->getBody();
+            //升级请求使用HTTP/1.1连接的内存池, 拷贝一份使用默认内存资源的请求,
+            //处理协程可能在连接结束之后才释放它
+            stream->request = std::make_unique<HttpRequest>(*request);
+            stream->request->setVersion(HttpVersion::HTTP20);
+            stream->sendWindow = peerInitialWindow_;
+            stream->recvWindow = http2InitialWindowSize;
+            stream->remoteClosed = true;
+            streams_[1] = stream;
+            lastStreamId_ = 1;
+            dispatch(stream);
+        }
+    }
+
+    auto self = shared_from_this();
+    scheduler_->addTask([self]() {
+        self->writeLoop();
+    });
+
+    readLoop(data);
+
+    //等待写协程和所有处理协程结束
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(!writerDone_ || activeHandlers_ > 0) {
+        doneWaiting_ = true;
+        doneEntry_ = coroutine::Processor::Suspend();
+        lock.unlock();
+        coroutine::Processor::Yield();
+        lock.lock();
+    }
+    lock.unlock();
+    dispatcher_->getEpochDomain()->release(routeReader_);
+    routeReader_ = nullptr;
+    sock_->close();
+}
+
+bool Http2Session::ensure(size_t n) {
+    while(readEnd_ - readPos_ < n) {
+        if(readPos_ > 0) {
+            ::memmove(&readBuffer_[0], readBuffer_.data() + readPos_, readEnd_ - readPos_);
+            readEnd_ -= readPos_;
+            readPos_ = 0;
+        }
+        if(readBuffer_.size() < n) {
+            readBuffer_.resize(n);
+        }
+        int len = sock_->recv(&readBuffer_[readEnd_], readBuffer_.size() - readEnd_);
+        if(len <= 0) {
+            peerClosed_ = (0 == len);
+            return false;
+        }
+        readEnd_ += len;
+    }
+    return true;
+}
+
+void Http2Session::readLoop(StringArg data) {
+    readBuffer_.resize(std::max(data.size(), kHttp2FrameHeaderSize + kHttp2DefaultMaxFrameSize));
+    ::memcpy(&readBuffer_[0], data.data(), data.size());
+    readEnd_ = data.size();
+
+    Http2Error error = Http2Error::NO_ERROR;
+    if(!ensure(kHttp2Preface.size()) ||
+        ::memcmp(readBuffer_.data(), kHttp2Preface.data(), kHttp2Preface.size()) != 0) {
+        NEMO_LOG_WARN(systemLogger) << "invalid http2 preface " << *sock_;
+        error = Http2Error::PROTOCOL_ERROR;
+    } else {
+        readPos_ += kHttp2Preface.size();
+    }
+
+    while(Http2Error::NO_ERROR == error && !goawayReceived_) {
+        if(!ensure(kHttp2FrameHeaderSize)) {
+            break;
+        }
+        Http2FrameHeader header;
+        header.parse(readBuffer_.data() + readPos_);
+        if(header.length > kHttp2DefaultMaxFrameSize) {
+            error = Http2Error::FRAME_SIZE_ERROR;
+            break;
+        }
+        if(!ensure(kHttp2FrameHeaderSize + header.length)) {
+            break;
+        }
+        const uint8_t* payload = reinterpret_cast<const uint8_t*>(readBuffer_.data())
+                                    + readPos_ + kHttp2FrameHeaderSize;
+        error = onFrame(header, payload);
+        readPos_ += kHttp2FrameHeaderSize + header.length;
+    }
+
+    if(Http2Error::NO_ERROR != error) {
+        NEMO_LOG_WARN(systemLogger) << "http2 connection error " << Http2Error2String(error)
+            << " last_stream_id=" << lastStreamId_ << " " << *sock_;
+    }
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    //对端已经关闭时不需要GOAWAY, shutdown()已经发送过时只在出错时再发送一次
+    if(!peerClosed_ && (!goawaySent_ || Http2Error::NO_ERROR != error)) {
+        String payload;
+        AppendHttp2Uint32(payload, goawaySent_ ? goawayStreamId_ : lastStreamId_);
+        AppendHttp2Uint32(payload, static_cast<uint32_t>(error));
+        AppendHttp2Frame(controlFrames_, Http2FrameType::GOAWAY, 0, 0, payload);
+    }
+    closing_ = true;
+    notifyWriter();
+}
+
+Http2Error Http2Session::onFrame(const Http2FrameHeader& header, const uint8_t* payload) {
+    //头部块必须连续, 中间不能插入其它帧
+    if(headerStreamId_ && (header.type != Http2FrameType::CONTINUATION ||
+                           header.streamId != headerStreamId_)) {
+        return Http2Error::PROTOCOL_ERROR;
+    }
+
+    switch(header.type) {
+        case Http2FrameType::DATA:
+            return onData(header, payload);
+        case Http2FrameType::HEADERS:
+            return onHeaders(header, payload);
+        case Http2FrameType::CONTINUATION:
+            if(0 == headerStreamId_) {
+                return Http2Error::PROTOCOL_ERROR;
+            }
+            return onContinuation(header, payload);
+        case Http2FrameType::PRIORITY:
+            //不支持优先级, 只做校验
+            if(0 == header.streamId) {
+                return Http2Error::PROTOCOL_ERROR;
+            }
+            if(header.length != 5) {
+                std::lock_guard<std::mutex> lockGuard(mutex_);
+                resetStream(header.streamId, Http2Error::FRAME_SIZE_ERROR);
+            }
+            return Http2Error::NO_ERROR;
+        case Http2FrameType::RST_STREAM: {
+            if(0 == header.streamId || header.streamId > lastStreamId_) {
+                return Http2Error::PROTOCOL_ERROR;
+            }
+            if(header.length != 4) {
+                return Http2Error::FRAME_SIZE_ERROR;
+            }
+            //客户端不断打开并重置流时处理协程仍在执行(rapid reset), 超过频率限制时关闭连接
+            auto now = std::chrono::steady_clock::now();
+            if(now - resetWindowStart_ >= std::chrono::seconds(1)) {
+                resetWindowStart_ = now;
+                resetCount_ = 0;
+            }
+            if(++resetCount_ > http2MaxResetStreams) {
+                return Http2Error::ENHANCE_YOUR_CALM;
+            }
+            std::lock_guard<std::mutex> lockGuard(mutex_);
+            removeStream(header.streamId);
+            return Http2Error::NO_ERROR;
+        }
+        case Http2FrameType::SETTINGS:
+            return onSettings(header, payload);
+        case Http2FrameType::PUSH_PROMISE:
+            return Http2Error::PROTOCOL_ERROR;
+        case Http2FrameType::PING: {
+            if(0 != header.streamId) {
+                return Http2Error::PROTOCOL_ERROR;
+            }
+            if(header.length != 8) {
+                return Http2Error::FRAME_SIZE_ERROR;
+            }
+            if(!header.hasFlag(Http2Flag::ACK)) {
+                std::lock_guard<std::mutex> lockGuard(mutex_);
+                AppendHttp2Frame(controlFrames_, Http2FrameType::PING, Http2Flag::ACK, 0,
+                    StringArg(reinterpret_cast<const char*>(payload), 8));
+                notifyWriter();
+            }
+            return Http2Error::NO_ERROR;
+        }
+        case Http2FrameType::GOAWAY:
+            if(0 != header.streamId) {
+                return Http2Error::PROTOCOL_ERROR;
+            }
+            //不再读取新的流, 已经收到的请求处理完再关闭
+            goawayReceived_ = true;
+            return Http2Error::NO_ERROR;
+        case Http2FrameType::WINDOW_UPDATE:
+            return onWindowUpdate(header, payload);
+        default:
+            //未知类型的帧直接忽略
+            return Http2Error::NO_ERROR;
+    }
+}
+
+Http2Error Http2Session::onData(const Http2FrameHeader& header, const uint8_t* payload) {
+    if(0 == header.streamId) {
+        return Http2Error::PROTOCOL_ERROR;
+    }
+    size_t len = header.length;
+    if(header.hasFlag(Http2Flag::PADDED)) {
+        if(0 == len || payload[0] >= len) {
+            return Http2Error::PROTOCOL_ERROR;
+        }
+        len -= payload[0] + 1;
+        ++payload;
+    }
+
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    //流量控制计算整个帧的长度, 包括填充
+    recvWindow_ -= header.length;
+    if(recvWindow_ < 0) {
+        return Http2Error::FLOW_CONTROL_ERROR;
+    }
+    auto iter = streams_.find(header.streamId);
+    if(streams_.end() == iter) {
+        if(header.streamId > lastStreamId_) {
+            return Http2Error::PROTOCOL_ERROR;
+        }
+        //已经关闭的流, 数据直接丢弃
+        consumeWindow(nullptr, header.length);
+        return Http2Error::NO_ERROR;
+    }
+
+    StreamPtr stream = iter->second;
+    if(stream->response) { //已经提前响应, 剩余的消息体丢弃
+        consumeWindow(nullptr, header.length);
+        return Http2Error::NO_ERROR;
+    }
+    if(stream->remoteClosed) {
+        consumeWindow(nullptr, header.length);
+        resetStream(stream->id, Http2Error::STREAM_CLOSED);
+        return Http2Error::NO_ERROR;
+    }
+    stream->recvWindow -= header.length;
+    if(stream->recvWindow < 0) {
+        consumeWindow(nullptr, header.length);
+        resetStream(stream->id, Http2Error::FLOW_CONTROL_ERROR);
+        return Http2Error::NO_ERROR;
+    }
+    if(stream->body.size() + len > HttpRequestParser::GetHttpRequestMaxBodySize()) {
+        consumeWindow(nullptr, header.length);
+        respondError(stream, HttpStatus::PAYLOAD_TOO_LARGE);
+        return Http2Error::NO_ERROR;
+    }
+
+    stream->body.append(reinterpret_cast<const char*>(payload), len);
+    bool endStream = header.hasFlag(Http2Flag::END_STREAM);
+    consumeWindow(endStream ? nullptr : stream.get(), header.length);
+    if(endStream) {
+        stream->remoteClosed = true;
+        dispatch(stream);
+    }
+    return Http2Error::NO_ERROR;
+}
+
+Http2Error Http2Session::onHeaders(const Http2FrameHeader& header, const uint8_t* payload) {
+    if(0 == header.streamId || 0 == (header.streamId & 1)) {
+        return Http2Error::PROTOCOL_ERROR;
+    }
+    size_t len = header.length;
+    size_t padding = 0;
+    if(header.hasFlag(Http2Flag::PADDED)) {
+        if(0 == len) {
+            return Http2Error::PROTOCOL_ERROR;
+        }
+        padding = payload[0];
+        ++payload;
+        --len;
+    }
+    if(header.hasFlag(Http2Flag::PRIORITY)) {
+        if(len < 5) {
+            return Http2Error::PROTOCOL_ERROR;
+        }
+        payload += 5;
+        len -= 5;
+    }
+    if(padding > len) {
+        return Http2Error::PROTOCOL_ERROR;
+    }
+    len -= padding;
+
+    headerBlock_.assign(reinterpret_cast<const char*>(payload), len);
+    headerStreamId_ = header.streamId;
+    headerEndStream_ = header.hasFlag(Http2Flag::END_STREAM);
+    if(header.hasFlag(Http2Flag::END_HEADERS)) {
+        return onHeaderBlock();
+    }
+    return Http2Error::NO_ERROR;
+}
+
+Http2Error Http2Session::onContinuation(const Http2FrameHeader& header, const uint8_t* payload) {
+    if(headerBlock_.size() + header.length > http2MaxHeaderListSize) {
+        return Http2Error::ENHANCE_YOUR_CALM;
+    }
+    headerBlock_.append(reinterpret_cast<const char*>(payload), header.length);
+    if(header.hasFlag(Http2Flag::END_HEADERS)) {
+        return onHeaderBlock();
+    }
+    return Http2Error::NO_ERROR;
+}
+
+Http2Error Http2Session::onHeaderBlock() {
+    uint32_t streamId = headerStreamId_;
+    headerStreamId_ = 0;
+    //无论流是否有效都要解码, 保持动态表与对端一致
+    //解码时限制头部列表的大小, 超过时不再生成字段, 之后响应431
+    HpackDecoder::FieldVector fields;
+    size_t listSize = 0;
+    if(!decoder_.decode(reinterpret_cast<const uint8_t*>(headerBlock_.data()),
+                        headerBlock_.size(), fields, http2MaxHeaderListSize, &listSize)) {
+        return Http2Error::COMPRESSION_ERROR;
+    }
+    headerBlock_.clear();
+    bool tooLarge = listSize > http2MaxHeaderListSize;
+
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    auto iter = streams_.find(streamId);
+    if(streams_.end() != iter) { //trailer, 必须结束流
+        StreamPtr stream = iter->second;
+        if(stream->remoteClosed || !headerEndStream_) {
+            resetStream(streamId, Http2Error::PROTOCOL_ERROR);
+            return Http2Error::NO_ERROR;
+        }
+        stream->remoteClosed = true;
+        if(stream->response) {
+            return Http2Error::NO_ERROR;
+        }
+        if(tooLarge) {
+            respondError(stream, HttpStatus::REQUEST_HEADER_FIELDS_TOO_LARGE);
+            return Http2Error::NO_ERROR;
+        }
+        for(const auto& field : fields) {
+            if(!field.first.empty() && field.first[0] != ':') {
+                stream->request->setHeader(field.first, field.second);
+            }
+        }
+        dispatch(stream);
+        return Http2Error::NO_ERROR;
+    }
+    if(streamId <= lastStreamId_) {
+        return Http2Error::STREAM_CLOSED;
+    }
+    lastStreamId_ = streamId;
+    //被重置的流在处理协程结束之前仍然占用并发数
+    if(goawaySent_ || streams_.size() + resetHandlers_ >= http2MaxConcurrentStreams) {
+        resetStream(streamId, Http2Error::REFUSED_STREAM);
+        return Http2Error::NO_ERROR;
+    }
+
+    auto stream = std::make_shared<Stream>();
+    stream->id = streamId;
+    stream->request = std::make_unique<HttpRequest>(HttpVersion::HTTP20, false);
+    if(peerCredentials_) {
+        stream->request->setPeerCredentials(*peerCredentials_);
+    }
+    stream->sendWindow = peerInitialWindow_;
+    stream->recvWindow = http2InitialWindowSize;
+    stream->remoteClosed = headerEndStream_;
+
+    //伪头部必须在普通字段之前, 字段名必须是小写
+    HttpRequest* request = stream->request.get();
+    bool regular = false;
+    bool malformed = false;
+    bool hasMethod = false;
+    bool hasPath = false;
+    bool hasScheme = false;
+    String cookie;
+    for(const auto& field : fields) {
+        const String& name = field.first;
+        const String& value = field.second;
+        if(name.empty() || HasUpperCase(name)) {
+            malformed = true;
+        } else if(':' == name[0]) {
+            if(regular) {
+                malformed = true;
+            } else if(":method" == name) {
+                request->setMethod(String2HttpMethod(value));
+                hasMethod = true;
+            } else if(":path" == name) {
+                size_t end = value.find('#');
+                StringArg path = StringArg(value).substr(0, end);
+                if(String::npos != end) {
+                    request->setFragment(StringArg(value).substr(end + 1));
+                }
+                size_t query = path.find('?');
+                request->setPath(path.substr(0, query));
+                if(String::npos != query) {
+                    request->setQuery(path.substr(query + 1));
+                }
+                hasPath = !value.empty();
+            } else if(":scheme" == name) {
+                hasScheme = true;
+            } else if(":authority" == name) {
+                request->setHeader("host", value);
+            } else {
+                malformed = true;
+            }
+        } else if(IsConnectionSpecificHeader(name)) {
+            malformed = true;
+        } else if("cookie" == name) { //cookie可以拆分成多个字段, 合并后交给servlet
+            if(!cookie.empty()) {
+                cookie.append("; ");
+            }
+            cookie.append(value);
+            regular = true;
+        } else {
+            request->setHeader(name, value);
+            regular = true;
+        }
+    }
+    if(!tooLarge && (malformed || !hasMethod || !hasPath || !hasScheme)) {
+        resetStream(streamId, Http2Error::PROTOCOL_ERROR);
+        return Http2Error::NO_ERROR;
+    }
+    if(!cookie.empty()) {
+        request->setHeader("cookie", cookie);
+    }
+
+    streams_[streamId] = stream;
+    uint32_t retryAfter = 0;
+    if(tooLarge) {
+        respondError(stream, HttpStatus::REQUEST_HEADER_FIELDS_TOO_LARGE);
+    } else if(rateLimiter_ && !rateLimiter_->allow(request, sock_->getRemoteAddress(), &retryAfter)) {
+        respondError(stream, HttpStatus::TOO_MANY_REQUESTS, retryAfter);
+    } else if(stream->remoteClosed) {
+        dispatch(stream);
+    }
+    return Http2Error::NO_ERROR;
+}
+
+Http2Error Http2Session::onSettings(const Http2FrameHeader& header, const uint8_t* payload) {
+    if(0 != header.streamId) {
+        return Http2Error::PROTOCOL_ERROR;
+    }
+    if(header.hasFlag(Http2Flag::ACK)) {
+        return header.length ? Http2Error::FRAME_SIZE_ERROR : Http2Error::NO_ERROR;
+    }
+    if(header.length % 6) {
+        return Http2Error::FRAME_SIZE_ERROR;
+    }
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    Http2Error error = applySettings(payload, header.length);
+    if(Http2Error::NO_ERROR == error) {
+        AppendHttp2Frame(controlFrames_, Http2FrameType::SETTINGS, Http2Flag::ACK, 0);
+        notifyWriter();
+    }
+    return error;
+}
+
+Http2Error Http2Session::applySettings(const uint8_t* payload, size_t len) {
+    for(size_t i = 0; i + 6 <= len; i += 6) {
+        uint16_t id = (static_cast<uint16_t>(payload[i]) << 8) | payload[i + 1];
+        uint32_t value = ReadHttp2Uint32(payload + i + 2);
+        switch(static_cast<Http2Setting>(id)) {
+            case Http2Setting::HEADER_TABLE_SIZE:
+                encoder_.setMaxTableSize(value);
+                break;
+            case Http2Setting::ENABLE_PUSH:
+                if(value > 1) {
+                    return Http2Error::PROTOCOL_ERROR;
+                }
+                break;
+            case Http2Setting::INITIAL_WINDOW_SIZE: {
+                if(value > kHttp2MaxWindowSize) {
+                    return Http2Error::FLOW_CONTROL_ERROR;
+                }
+                //已经存在的流按差值调整发送窗口
+                int64_t delta = static_cast<int64_t>(value) - peerInitialWindow_;
+                for(auto& item : streams_) {
+                    item.second->sendWindow += delta;
+                    if(item.second->sendWindow > kHttp2MaxWindowSize) {
+                        return Http2Error::FLOW_CONTROL_ERROR;
+                    }
+                }
+                peerInitialWindow_ = value;
+                break;
+            }
+            case Http2Setting::MAX_FRAME_SIZE:
+                if(value < kHttp2DefaultMaxFrameSize || value > kHttp2MaxFrameSizeLimit) {
+                    return Http2Error::PROTOCOL_ERROR;
+                }
+                peerMaxFrameSize_ = value;
+                break;
+            default:
+                break;
+        }
+    }
+    notifyWriter();
+    return Http2Error::NO_ERROR;
+}
+
+Http2Error Http2Session::onWindowUpdate(const Http2FrameHeader& header, const uint8_t* payload) {
+    if(header.length != 4) {
+        return Http2Error::FRAME_SIZE_ERROR;
+    }
+    uint32_t increment = ReadHttp2Uint32(payload) & 0x7fffffff;
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    if(0 == header.streamId) {
+        sendWindow_ += increment;
+        if(0 == increment || sendWindow_ > kHttp2MaxWindowSize) {
+            return 0 == increment ? Http2Error::PROTOCOL_ERROR : Http2Error::FLOW_CONTROL_ERROR;
+        }
+    } else {
+        if(header.streamId > lastStreamId_) {
+            return Http2Error::PROTOCOL_ERROR;
+        }
+        auto iter = streams_.find(header.streamId);
+        if(streams_.end() == iter) {
+            return Http2Error::NO_ERROR;
+        }
+        iter->second->sendWindow += increment;
+        if(0 == increment) {
+            resetStream(header.streamId, Http2Error::PROTOCOL_ERROR);
+        } else if(iter->second->sendWindow > kHttp2MaxWindowSize) {
+            resetStream(header.streamId, Http2Error::FLOW_CONTROL_ERROR);
+        }
+    }
+    notifyWriter();
+    return Http2Error::NO_ERROR;
+}
+
+void Http2Session::consumeWindow(Stream* stream, uint32_t len) {
+    //消息体已经拷贝出来, 马上归还窗口, 窗口消耗过半时再通告以减少WINDOW_UPDATE帧
+    recvConsumed_ += len;
+    if(recvConsumed_ >= std::max<int64_t>(http2InitialWindowSize, kHttp2DefaultWindowSize) / 2) {
+        AppendWindowUpdate(controlFrames_, 0, recvConsumed_);
+        recvWindow_ += recvConsumed_;
+        recvConsumed_ = 0;
+        notifyWriter();
+    }
+    if(stream) {
+        stream->recvConsumed += len;
+        if(stream->recvConsumed >= http2InitialWindowSize / 2) {
+            AppendWindowUpdate(controlFrames_, stream->id, stream->recvConsumed);
+            stream->recvWindow += stream->recvConsumed;
+            stream->recvConsumed = 0;
+            notifyWriter();
+        }
+    }
+}
+
+void Http2Session::dispatch(const StreamPtr& stream) {
+    HttpRequest* request = stream->request.get();
+    request->setBody(std::move(stream->body));
+    //有处理协程在执行时连接的读者一直在临界区内, 最后一个处理协程结束时离开,
+    //servlet不需要持有引用计数
+    if(0 == activeHandlers_) {
+        routeReader_->enter();
+    }
+    HttpServlet* servlet = dispatcher_->route(request);
+    if(servlet->isStreamBody()) {
+        if(0 == activeHandlers_) {
+            routeReader_->exit();
+        }
+        resetStream(stream->id, Http2Error::HTTP_1_1_REQUIRED);
+        return;
+    }
+
+    ++activeHandlers_;
+    stream->handling = true;
+    auto self = shared_from_this();
+    scheduler_->addTask([self, stream, servlet]() {
+        self->handle(stream, servlet);
+    });
+}
+
+void Http2Session::handle(const StreamPtr& stream, HttpServlet* servlet) {
+    auto response = std::make_unique<HttpResponse>(HttpVersion::HTTP20, false);
+    response->setHeader("Server", serverName_);
+    if(cache_) {
+        cache_->handle(dispatcher_, servlet, stream->request.get(), response.get(), nullptr);
+    } else {
+        servlet->handle(stream->request.get(), response.get(), nullptr);
+    }
+    if(HttpCompression::IsEnabled()) {
+        HttpCompression::Apply(NegotiateContentCoding(
+                stream->request->getHeader(HttpHeaderId::ACCEPT_ENCODING)), response.get());
+    }
+
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    if(0 == --activeHandlers_) {
+        routeReader_->exit();
+    }
+    stream->handling = false;
+    if(stream->reset) {
+        --resetHandlers_;
+    } else if(!writeError_) {
+        stream->response = std::move(response);
+        sendQueue_.push_back(stream);
+    }
+    notifyWriter();
+    notifyDone();
+}
+
+void Http2Session::respondError(const StreamPtr& stream, HttpStatus status, uint32_t retryAfter) {
+    stream->response = std::make_unique<HttpResponse>(HttpVersion::HTTP20, false);
+    stream->response->setStatus(status);
+    stream->response->setHeader("Server", serverName_);
+    if(retryAfter) {
+        stream->response->setHeader("Retry-After", std::to_string(retryAfter));
+    }
+    sendQueue_.push_back(stream);
+    notifyWriter();
+}
+
+void Http2Session::resetStream(uint32_t streamId, Http2Error error) {
+    String payload;
+    AppendHttp2Uint32(payload, static_cast<uint32_t>(error));
+    AppendHttp2Frame(controlFrames_, Http2FrameType::RST_STREAM, 0, streamId, payload);
+    removeStream(streamId);
+    notifyWriter();
+}
+
+void Http2Session::removeStream(uint32_t streamId) {
+    auto iter = streams_.find(streamId);
+    if(streams_.end() == iter) {
+        return;
+    }
+    iter->second->reset = true;
+    if(iter->second->handling) {
+        ++resetHandlers_;
+    }
+    streams_.erase(iter);
+}
+
+void Http2Session::tryClose(const StreamPtr& stream) {
+    if(!stream->localClosed) {
+        return;
+    }
+    if(!stream->remoteClosed) { //响应已经结束, 让对端停止发送消息体
+        String payload;
+        AppendHttp2Uint32(payload, static_cast<uint32_t>(Http2Error::NO_ERROR));
+        AppendHttp2Frame(controlFrames_, Http2FrameType::RST_STREAM, 0, stream->id, payload);
+        stream->reset = true;
+    }
+    streams_.erase(stream->id);
+}
+
+void Http2Session::encodeHeaders(Stream* stream, String& out) {
+    const HttpResponse* response = stream->response.get();
+    String block;
+    encoder_.begin(block);
+    char status[8];
+    int len = ::snprintf(status, sizeof(status), "%d", static_cast<int>(response->getStatus()));
+    encoder_.encode(":status", StringArg(status, len), block);
+    String name;
+    for(const auto& header : response->getHeaders()) {
+        if(IsConnectionSpecificHeader(header.first) ||
+            (header.first.size() == 14 &&
+             ::strncasecmp(header.first.data(), "content-length", 14) == 0)) {
+            continue;
+        }
+        name.assign(header.first.data(), header.first.size());
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        encoder_.encode(name, header.second, block);
+    }
+    //长度每次都不同, 不加入动态表
+    const String& body = response->getBody();
+    encoder_.encode("content-length", std::to_string(body.size()), block, false);
+
+    size_t offset = 0;
+    bool first = true;
+    do {
+        size_t n = std::min<size_t>(block.size() - offset, peerMaxFrameSize_);
+        uint8_t flags = offset + n == block.size() ? Http2Flag::END_HEADERS : 0;
+        if(first && body.empty()) {
+            flags |= Http2Flag::END_STREAM;
+        }
+        AppendHttp2Frame(out, first ? Http2FrameType::HEADERS : Http2FrameType::CONTINUATION,
+            flags, stream->id, StringArg(block.data() + offset, n));
+        offset += n;
+        first = false;
+    } while(offset < block.size());
+    stream->headersSent = true;
+    stream->localClosed = body.empty();
+}
+
+void Http2Session::collectFrames(String& out) {
+    out.append(controlFrames_);
+    controlFrames_.clear();
+    for(auto iter = sendQueue_.begin(); iter != sendQueue_.end() && out.size() < kMaxWriteBytes;) {
+        StreamPtr stream = *iter;
+        if(stream->reset) {
+            iter = sendQueue_.erase(iter);
+            continue;
+        }
+        if(!stream->headersSent) {
+            encodeHeaders(stream.get(), out);
+        }
+        const String& body = stream->response->getBody();
+        while(!stream->localClosed && sendWindow_ > 0 && stream->sendWindow > 0 &&
+                out.size() < kMaxWriteBytes) {
+            size_t n = std::min<int64_t>({static_cast<int64_t>(body.size() - stream->dataOffset),
+                        peerMaxFrameSize_, sendWindow_, stream->sendWindow});
+            stream->localClosed = stream->dataOffset + n == body.size();
+            AppendHttp2Frame(out, Http2FrameType::DATA,
+                stream->localClosed ? Http2Flag::END_STREAM : 0, stream->id,
+                StringArg(body.data() + stream->dataOffset, n));
+            stream->dataOffset += n;
+            sendWindow_ -= n;
+            stream->sendWindow -= n;
+        }
+        if(stream->localClosed) {
+            iter = sendQueue_.erase(iter);
+            tryClose(stream);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+void Http2Session::writeLoop() {
+    String out;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(true) {
+        out.clear();
+        if(!writeError_) {
+            collectFrames(out);
+        }
+        if(!out.empty()) {
+            lock.unlock();
+            bool result = SendAll(sock_.get(), out);
+            lock.lock();
+            if(!result) {
+                NEMO_LOG_WARN(systemLogger) << "http2 send fail, errno=" << errno
+                    << " errstr=" << strerror(errno) << " " << *sock_;
+                writeError_ = true;
+                sendQueue_.clear();
+                controlFrames_.clear();
+            }
+            continue;
+        }
+        //读循环结束之后不会再有窗口更新, 被流量控制阻塞的流也无法继续发送
+        if(closing_ && 0 == activeHandlers_) {
+            break;
+        }
+        //优雅关闭时所有的流都已经结束, 关闭读端让读循环结束
+        if(goawaySent_ && !closing_ && !readShutdown_ && streams_.empty() && 0 == activeHandlers_) {
+            readShutdown_ = true;
+            ::shutdown(sock_->getSocketFd(), SHUT_RD);
+        }
+        writerWaiting_ = true;
+        writerEntry_ = coroutine::Processor::Suspend();
+        lock.unlock();
+        coroutine::Processor::Yield();
+        lock.lock();
+    }
+    writerDone_ = true;
+    notifyDone();
+}
+
+void Http2Session::shutdown() {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    if(goawaySent_ || closing_) {
+        return;
+    }
+    goawaySent_ = true;
+    goawayStreamId_ = lastStreamId_;
+    String payload;
+    AppendHttp2Uint32(payload, goawayStreamId_);
+    AppendHttp2Uint32(payload, static_cast<uint32_t>(Http2Error::NO_ERROR));
+    AppendHttp2Frame(controlFrames_, Http2FrameType::GOAWAY, 0, 0, payload);
+    notifyWriter();
+}
+
+void Http2Session::notifyWriter() {
+    if(writerWaiting_) {
+        writerWaiting_ = false;
+        coroutine::Processor::WakeUp(writerEntry_);
+    }
+}
+
+void Http2Session::notifyDone() {
+    if(doneWaiting_) {
+        doneWaiting_ = false;
+        coroutine::Processor::WakeUp(doneEntry_);
+    }
+}
+
+} // namespace http
+} // namespace net
+} // namespace nemo
@@ -0,0 +1,310 @@
+#include "net/http/http_body.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "net/http/http_session.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+HttpBodyReader::HttpBodyReader(HttpSession* session) :
+    session_(session),
+    state_(State::DONE),
+    chunked_(false),
+    contentLength_(0),
+    remaining_(0),
+    readBytes_(0) {
+}
+
+bool HttpBodyReader::reset(HttpRequest* request) {
+    remaining_ = 0;
+    readBytes_ = 0;
+
+    //同时存在时Transfer-Encoding优先于Content-Length
+    String encoding(request->getHeader(HttpHeaderId::TRANSFER_ENCODING));
+    if(!encoding.empty() && ::strcasestr(encoding.c_str(), "chunked")) {
+        chunked_ = true;
+        contentLength_ = -1;
+        state_ = State::CHUNK_SIZE;
+        return true;
+    }
+
+    chunked_ = false;
+    contentLength_ = 0;
+    if(!request->getHeader(HttpHeaderId::CONTENT_LENGTH).empty() &&
+        (!request->checkGetHeaderAs<int64_t>("content-length", contentLength_) ||
+        contentLength_ < 0)) {
+        state_ = State::ERROR;
+        return false;
+    }
+    remaining_ = contentLength_;
+    state_ = remaining_ > 0 ? State::DATA : State::DONE;
+    return true;
+}
+
+int HttpBodyReader::advance() {
+    String line;
+    while(true) {
+        switch(state_) {
+            case State::CHUNK_SIZE: {
+                if(session_->readLine(line) < 0) {
+                    state_ = State::ERROR;
+                    return -1;
+                }
+                //chunk-size [; chunk-ext] CRLF
+                char* end = nullptr;
+                uint64_t size = ::strtoull(line.c_str(), &end, 16);
+                if(end == line.c_str() || (*end && *end != ';' && *end != ' ' && *end != '\t')
+                    || size > (UINT64_MAX >> 2)) {
+                    state_ = State::ERROR;
+                    return -1;
+                }
+                remaining_ = size;
+                state_ = size > 0 ? State::DATA : State::TRAILER;
+                break;
+            }
+            case State::CHUNK_END:
+                if(session_->readLine(line) < 0 || !line.empty()) {
+                    state_ = State::ERROR;
+                    return -1;
+                }
+                state_ = State::CHUNK_SIZE;
+                break;
+            case State::TRAILER:
+                //trailer字段直接忽略, 空行表示结束
+                if(session_->readLine(line) < 0) {
+                    state_ = State::ERROR;
+                    return -1;
+                }
+                if(line.empty()) {
+                    state_ = State::DONE;
+                }
+                break;
+            case State::ERROR:
+                return -1;
+            default:
+                return 0;
+        }
+    }
+}
+
+void HttpBodyReader::onData(size_t n) {
+    remaining_ -= n;
+    readBytes_ += n;
+    if(remaining_ == 0) {
+        state_ = chunked_ ? State::CHUNK_END : State::DONE;
+    }
+}
+
+ssize_t HttpBodyReader::read(void* buff, size_t len) {
+    if(advance() < 0) {
+        return -1;
+    }
+    if(state_ == State::DONE || len == 0) {
+        return 0;
+    }
+
+    size_t n = std::min<uint64_t>(len, remaining_);
+    ssize_t rt = session_->readSome(buff, n);
+    if(rt <= 0) {
+        state_ = State::ERROR;
+        return -1;
+    }
+    onData(rt);
+    return rt;
+}
+
+int HttpBodyReader::readAll(String& body, size_t maxSize) {
+    if(!chunked_ && body.size() + remaining_ > maxSize) {
+        return -1;
+    }
+
+    while(true) {
+        if(advance() < 0) {
+            return -1;
+        }
+        if(state_ == State::DONE) {
+            return 0;
+        }
+        if(body.size() + remaining_ > maxSize) {
+            return -1;
+        }
+        //每次读取完整的chunk(或者定长消息体的剩余部分)
+        size_t offset = body.size();
+        body.resize(offset + remaining_);
+        while(state_ == State::DATA) {
+            ssize_t rt = read(&body[offset], body.size() - offset);
+            if(rt <= 0) {
+                return -1;
+            }
+            offset += rt;
+        }
+    }
+}
+
+int HttpBodyReader::discard() {
+    while(true) {
+        if(advance() < 0) {
+            return -1;
+        }
+        if(state_ == State::DONE) {
+            return 0;
+        }
+        int rt = session_->skip(remaining_);
+        if(rt <= 0) {
+            state_ = State::ERROR;
+            return -1;
+        }
+        onData(rt);
+    }
+}
+
+HttpBodyWriter::HttpBodyWriter(HttpSession* session) :
+    session_(session),
+    response_(nullptr),
+    started_(false),
+    finished_(false),
+    chunked_(false),
+    remaining_(-1) {
+}
+
+void HttpBodyWriter::reset(HttpResponse* response) {
+    response_ = response;
+    started_ = false;
+    finished_ = false;
+    chunked_ = false;
+    remaining_ = -1;
+    compressor_.reset();
+}
+
+int HttpBodyWriter::start() {
+    if(HttpCompression::IsEnabled()) { //压缩后长度未知, 必须在确定传输编码之前处理
+        compressor_ = HttpCompression::Start(session_->getContentCoding(), response_);
+    }
+    if(!response_->checkGetHeaderAs<int64_t>("content-length", remaining_) || remaining_ < 0) {
+        remaining_ = -1;
+        if(response_->getVersion() == HttpVersion::HTTP11) {
+            chunked_ = true;
+            response_->setHeader("Transfer-Encoding", "chunked");
+        } else {
+            //HTTP/1.0不支持chunked, 只能以关闭连接表示消息体结束
+            response_->setClose(true);
+        }
+    }
+    started_ = true;
+
+    String header;
+    response_->appendHeaderTo(header);
+    header.append("\r\n");
+    return session_->write(header.data(), header.size());
+}
+
+ssize_t HttpBodyWriter::write(const void* data, size_t len) {
+    if(finished_) {
+        return -1;
+    }
+    if(!started_ && start() < 0) {
+        return -1;
+    }
+    if(len == 0) { //长度为0的chunk表示结束, 这里不能发送
+        return 0;
+    }
+    if(compressor_) {
+        String out;
+        if(!compressor_->compress(data, len, out, false) ||
+            (!out.empty() && writeRaw(out.data(), out.size()) < 0)) {
+            return -1;
+        }
+        return len;
+    }
+    return writeRaw(data, len);
+}
+
+template<class Send>
+int64_t HttpBodyWriter::writeFramed(size_t len, Send&& send) {
+    if(chunked_) {
+        char size[24];
+        int n = ::snprintf(size, sizeof(size), "%zx\r\n", len);
+        if(session_->write(size, n) < 0 || send() < 0 || session_->write("\r\n", 2) < 0) {
+            return -1;
+        }
+        return len;
+    }
+
+    if(remaining_ >= 0) {
+        if(static_cast<uint64_t>(remaining_) < len) {
+            return -1;
+        }
+        remaining_ -= len;
+    }
+    return send() < 0 ? -1 : static_cast<int64_t>(len);
+}
+
+int64_t HttpBodyWriter::sendFile(int fd, off_t offset, size_t length) {
+    if(finished_) {
+        return -1;
+    }
+    if(!started_ && start() < 0) {
+        return -1;
+    }
+    if(length == 0) {
+        return 0;
+    }
+    if(compressor_) {
+        String buffer(kFileReadSize, '\0');
+        size_t sent = 0;
+        while(sent < length) {
+            ssize_t n = ::pread(fd, &buffer[0], std::min(length - sent, kFileReadSize), offset + sent);
+            if(n <= 0 || write(buffer.data(), n) < 0) {
+                return -1;
+            }
+            sent += n;
+        }
+        return sent;
+    }
+
+    return writeFramed(length, [this, fd, offset, length]() {
+        return session_->sendFile(fd, offset, length);
+    });
+}
+
+int64_t HttpBodyWriter::writeRaw(const void* data, size_t len) {
+    if(len == 0) {
+        return 0;
+    }
+    return writeFramed(len, [this, data, len]() {
+        return session_->write(data, len);
+    });
+}
+
+int HttpBodyWriter::finish() {
+    if(finished_) {
+        return 0;
+    }
+    if(!started_ && start() < 0) {
+        return -1;
+    }
+    finished_ = true;
+
+    if(compressor_) {
+        String out;
+        if(!compressor_->compress(nullptr, 0, out, true) || writeRaw(out.data(), out.size()) < 0) {
+            return -1;
+        }
+    }
+    if(chunked_ && session_->write("0\r\n\r\n", 5) < 0) {
+        return -1;
+    }
+    if(session_->flush() < 0 || remaining_ > 0) {
+        return -1;
+    }
+    return 0;
+}
+
+} // namespace http
+} // namespace net
+} // namespace nemo
@@ -0,0 +1,503 @@
+#include "net/http/http_cache.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include "net/http/http_session.h"
+#include "log/log.h"
+#include "common/config.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+static ConfigVar<bool>* cacheEnableConfig =
+    Config::Lookup("http.cache.enable", false,
+                    "cache GET responses with Cache-Control max-age/s-maxage in front of servlets");
+
+static ConfigVar<uint64_t>* cacheMaxSizeConfig =
+    Config::Lookup("http.cache.max_size", static_cast<uint64_t>(64 * 1024 * 1024),
+                    "max bytes of cached responses");
+
+static ConfigVar<uint32_t>* cacheShardsConfig =
+    Config::Lookup("http.cache.shards", static_cast<uint32_t>(16),
+                    "number of independently locked cache shards");
+
+static ConfigVar<uint32_t>* cacheMaxEntrySizeConfig =
+    Config::Lookup("http.cache.max_entry_size", static_cast<uint32_t>(1024 * 1024),
+                    "responses larger than this are not cached");
+
+static bool cacheEnable = false;
+static uint32_t cacheMaxEntrySize = 0;
+
+namespace {
+struct CacheConfigIniter {
+    CacheConfigIniter() {
+        cacheEnable = cacheEnableConfig->getValue();
+        cacheMaxEntrySize = cacheMaxEntrySizeConfig->getValue();
+
+        cacheEnableConfig->addListener([](const bool& oldVal, const bool& newVal) {
+            static_cast<void>(oldVal);
+            cacheEnable = newVal;
+        });
+        cacheMaxEntrySizeConfig->addListener([](const uint32_t& oldVal, const uint32_t& newVal) {
+            static_cast<void>(oldVal);
+            cacheMaxEntrySize = newVal;
+        });
+    }
+};
+
+static CacheConfigIniter cacheConfigIniter;
+
+/// 一个资源最多缓存的Vary变体数
+constexpr size_t kMaxVariants = 8;
+/// 估算每个条目除了头部和消息体之外的开销
+constexpr size_t kEntryOverhead = 256;
+
+/**
+ * @brief 缓存时不保存的字段, 发送时由连接重新生成
+ */
+static bool IsHopHeader(StringArg name) {
+    static const StringArg kHeaders[] = {
+        "connection", "keep-alive", "transfer-encoding", "content-length", "age"
+    };
+    for(const StringArg& header : kHeaders) {
+        if(name.size() == header.size() &&
+            ::strncasecmp(name.data(), header.data(), header.size()) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 304响应中保留的字段(RFC 9110 15.4.5)
+ */
+static bool IsNotModifiedHeader(StringArg name) {
+    static const StringArg kHeaders[] = {
+        "cache-control", "content-location", "date", "etag", "expires", "vary"
+    };
+    for(const StringArg& header : kHeaders) {
+        if(name.size() == header.size() &&
+            ::strncasecmp(name.data(), header.data(), header.size()) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 解析秒数, 不合法时返回-1
+ */
+static int64_t ParseSeconds(StringArg value) {
+    if(value.size() >= 2 && '"' == value.front() && '"' == value.back()) {
+        value = value.substr(1, value.size() - 2);
+    }
+    if(value.empty()) {
+        return -1;
+    }
+    int64_t seconds = 0;
+    for(char c : value) {
+        if(!isdigit(static_cast<unsigned char>(c))) {
+            return -1;
+        }
+        seconds = std::min<int64_t>(seconds * 10 + (c - '0'), INT32_MAX);
+    }
+    return seconds;
+}
+
+} // namespace
+
+/**
+ * @brief 缓存的响应
+ */
+struct HttpResponseCache::Entry {
+    String varyKey;
+    HttpStatus status;
+    std::vector<std::pair<String, String>> headers;
+    String body;
+    String etag;
+    Clock::time_point storedAt;
+    Clock::duration ttl;
+    Clock::duration staleWhileRevalidate;
+    size_t bytes = 0;
+    std::atomic<bool> refreshing{false};    ///< 已经有协程在刷新
+};
+
+/**
+ * @brief 一个资源的所有变体
+ */
+struct HttpResponseCache::Resource {
+    std::vector<String> vary;               ///< 小写的Vary字段名
+    std::vector<EntryPtr> variants;
+    size_t bytes = 0;
+};
+
+void HttpCacheControl::parse(StringArg value) {
+    while(!value.empty()) {
+        size_t end = value.find(',');
+        StringArg item = value.substr(0, end);
+        value = (String::npos == end) ? StringArg() : value.substr(end + 1);
+
+        size_t eq = item.find('=');
+        StringArg name = item.substr(0, eq);
+        while(!name.empty() && ' ' == name.front()) {
+            name.remove_prefix(1);
+        }
+        while(!name.empty() && ' ' == name.back()) {
+            name.remove_suffix(1);
+        }
+        StringArg arg = (String::npos == eq) ? StringArg() : item.substr(eq + 1);
+        while(!arg.empty() && ' ' == arg.front()) {
+            arg.remove_prefix(1);
+        }
+        while(!arg.empty() && ' ' == arg.back()) {
+            arg.remove_suffix(1);
+        }
+        auto is = [&name](StringArg directive) {
+            return name.size() == directive.size() &&
+                   ::strncasecmp(name.data(), directive.data(), directive.size()) == 0;
+        };
+        if(is("no-store")) {
+            noStore = true;
+        } else if(is("no-cache")) {
+            noCache = true;
+        } else if(is("private")) {
+            isPrivate = true;
+        } else if(is("max-age")) {
+            maxAge = ParseSeconds(arg);
+        } else if(is("s-maxage")) {
+            sMaxAge = ParseSeconds(arg);
+        } else if(is("stale-while-revalidate")) {
+            staleWhileRevalidate = std::max<int64_t>(ParseSeconds(arg), 0);
+        }
+    }
+}
+
+HttpResponseCache::Shard::Shard(size_t maxEntries, size_t maxBytes) :
+    resources(maxEntries, maxEntries),
+    maxBytes(maxBytes) {
+}
+
+HttpResponseCache::HttpResponseCache(coroutine::Scheduler* scheduler) :
+    scheduler_(scheduler) {
+    size_t count = std::max<uint32_t>(cacheShardsConfig->getValue(), 1);
+    size_t shardBytes = std::max<size_t>(cacheMaxSizeConfig->getValue() / count, 1);
+    //按每个条目至少1KB估算数量上限, 实际由字节数淘汰
+    size_t shardEntries = std::max<size_t>(shardBytes / 1024, 16);
+    for(size_t i = 0; i < count; ++i) {
+        shards_.emplace_back(std::make_unique<Shard>(shardEntries, shardBytes));
+    }
+}
+
+bool HttpResponseCache::IsEnabled() {
+    return cacheEnable;
+}
+
+bool HttpResponseCache::MatchETag(StringArg ifNoneMatch, StringArg etag) {
+    if(etag.substr(0, 2) == "W/") {
+        etag.remove_prefix(2);
+    }
+    if(etag.empty()) {
+        return false;
+    }
+    while(!ifNoneMatch.empty()) {
+        size_t end = ifNoneMatch.find(',');
+        StringArg item = ifNoneMatch.substr(0, end);
+        ifNoneMatch = (String::npos == end) ? StringArg() : ifNoneMatch.substr(end + 1);
+        while(!item.empty() && ' ' == item.front()) {
+            item.remove_prefix(1);
+        }
+        while(!item.empty() && ' ' == item.back()) {
+            item.remove_suffix(1);
+        }
+        if(item == "*") {
+            return true;
+        }
+        if(item.substr(0, 2) == "W/") {
+            item.remove_prefix(2);
+        }
+        if(item == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+String HttpResponseCache::BaseKey(StringArg path, StringArg query) {
+    String key;
+    key.reserve(path.size() + query.size() + 1);
+    key.append(path);
+    if(!query.empty()) {
+        key.push_back('?');
+        key.append(query);
+    }
+    return key;
+}
+
+String HttpResponseCache::VaryKey(const std::vector<String>& vary, const HttpRequest* request) {
+    String key;
+    for(const String& name : vary) {
+        key.append(request->getHeaders().get(name)).push_back('\n');
+    }
+    return key;
+}
+
+HttpResponseCache::Shard& HttpResponseCache::getShard(const String& baseKey) {
+    return *shards_[std::hash<String>()(baseKey) % shards_.size()];
+}
+
+HttpResponseCache::EntryPtr HttpResponseCache::lookup(const String& baseKey,
+                                                      const HttpRequest* request) {
+    Shard& shard = getShard(baseKey);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ResourcePtr resource;
+    if(!shard.resources.get(baseKey, resource)) {
+        return nullptr;
+    }
+    String varyKey = VaryKey(resource->vary, request);
+    for(const EntryPtr& entry : resource->variants) {
+        if(entry->varyKey == varyKey) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+void HttpResponseCache::store(const String& baseKey, const HttpRequest* request,
+                              const HttpResponse* response) {
+    HttpStatus status = response->getStatus();
+    //只缓存可以启发式缓存的状态码中常见的几个
+    if(status != HttpStatus::OK && status != HttpStatus::MOVED_PERMANENTLY &&
+        status != HttpStatus::NOT_FOUND && status != HttpStatus::GONE) {
+        return;
+    }
+    if(!response->getCookies().empty() || response->getHeaders().has(HttpHeaderId::SET_COOKIE) ||
+        response->getBody().size() > cacheMaxEntrySize) {
+        return;
+    }
+    HttpCacheControl control;
+    control.parse(response->getHeader(HttpHeaderId::CACHE_CONTROL));
+    if(control.noStore || control.noCache || control.isPrivate || control.getTtl() <= 0) {
+        return;
+    }
+
+    std::vector<String> vary;
+    StringArg varyHeader = response->getHeader(HttpHeaderId::VARY);
+    while(!varyHeader.empty()) {
+        size_t end = varyHeader.find(',');
+        StringArg name = varyHeader.substr(0, end);
+        varyHeader = (String::npos == end) ? StringArg() : varyHeader.substr(end + 1);
+        while(!name.empty() && ' ' == name.front()) {
+            name.remove_prefix(1);
+        }
+        while(!name.empty() && ' ' == name.back()) {
+            name.remove_suffix(1);
+        }
+        if("*" == name) { //每个请求都可能不同, 不能缓存
+            return;
+        }
+        if(!name.empty()) {
+            vary.emplace_back(name);
+            std::transform(vary.back().begin(), vary.back().end(), vary.back().begin(), ::tolower);
+        }
+    }
+
+    EntryPtr entry = std::make_shared<Entry>();
+    entry->varyKey = VaryKey(vary, request);
+    entry->status = status;
+    entry->body = response->getBody();
+    entry->bytes = kEntryOverhead + entry->varyKey.size() + entry->body.size();
+    for(const auto& header : response->getHeaders()) {
+        if(IsHopHeader(header.first)) {
+            continue;
+        }
+        entry->headers.emplace_back(header.first, header.second);
+        entry->bytes += header.first.size() + header.second.size();
+    }
+    entry->etag = response->getHeader(HttpHeaderId::ETAG);
+    entry->storedAt = Clock::now();
+    entry->ttl = std::chrono::seconds(control.getTtl());
+    entry->staleWhileRevalidate = std::chrono::seconds(control.staleWhileRevalidate);
+
+    Shard& shard = getShard(baseKey);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ResourcePtr resource;
+    if(!shard.resources.get(baseKey, resource) || resource->vary != vary) {
+        if(resource) { //Vary字段变化后旧的变体都不再可用
+            shard.bytes -= resource->bytes;
+            shard.resources.erase(baseKey);
+        }
+        resource = std::make_shared<Resource>();
+        resource->vary = std::move(vary);
+        if(shard.resources.size() >= shard.resources.limit()) {
+            ResourcePtr evicted;
+            shard.resources.evict(&evicted);
+            shard.bytes -= evicted->bytes;
+        }
+        shard.resources.put(baseKey, resource);
+    }
+
+    auto iter = std::find_if(resource->variants.begin(), resource->variants.end(),
+            [&entry](const EntryPtr& variant) { return variant->varyKey == entry->varyKey; });
+    if(iter != resource->variants.end()) {
+        resource->bytes -= (*iter)->bytes;
+        shard.bytes -= (*iter)->bytes;
+        *iter = entry;
+    } else {
+        if(resource->variants.size() >= kMaxVariants) {
+            resource->bytes -= resource->variants.front()->bytes;
+            shard.bytes -= resource->variants.front()->bytes;
+            resource->variants.erase(resource->variants.begin());
+        }
+        resource->variants.push_back(entry);
+    }
+    resource->bytes += entry->bytes;
+    shard.bytes += entry->bytes;
+
+    //刚放入的资源在LRU的最前面, 超出容量时从最后面淘汰
+    while(shard.bytes > shard.maxBytes && shard.resources.size() > 1) {
+        ResourcePtr evicted;
+        shard.resources.evict(&evicted);
+        shard.bytes -= evicted->bytes;
+    }
+}
+
+void HttpResponseCache::Serve(const Entry& entry, const HttpRequest* request,
+                              HttpResponse* response, Clock::time_point now) {
+    int64_t age = std::chrono::duration_cast<std::chrono::seconds>(now - entry.storedAt).count();
+    bool notModified = HttpStatus::OK == entry.status && !entry.etag.empty() &&
+        MatchETag(request->getHeader(HttpHeaderId::IF_NONE_MATCH), entry.etag);
+    response->setStatus(notModified ? HttpStatus::NOT_MODIFIED : entry.status);
+    for(const auto& header : entry.headers) {
+        if(!notModified || IsNotModifiedHeader(header.first)) {
+            response->setHeader(header.first, header.second);
+        }
+    }
+    response->setHeader("Age", std::to_string(std::max<int64_t>(age, 0)));
+    if(!notModified) {
+        response->setBody(entry.body);
+    }
+}
+
+void HttpResponseCache::refresh(ServletDispatcher* dispatcher, const String& baseKey,
+                                const HttpRequest* request, const EntryPtr& entry) {
+    //复制的请求使用默认的内存资源, 不依赖连接的内存池
+    std::shared_ptr<HttpRequest> copy = std::make_shared<HttpRequest>(*request);
+    copy->delHeader("If-None-Match");
+    copy->delHeader("If-Modified-Since");
+    SharedPtr self = shared_from_this();
+    scheduler_->addTask([self, dispatcher, baseKey, copy, entry]() {
+        HttpResponse response(copy->getVersion(), false);
+        HttpSession session; //不关联连接, 后台刷新不占用fd
+        {
+            EpochDomain::ReaderLease reader(dispatcher->getEpochDomain());
+            EpochDomain::Guard guard(reader.get());
+            HttpServlet* servlet = dispatcher->route(copy.get());
+            //过滤器已经在触发刷新的请求上执行过, 这里只重新生成内容
+            FilteredServlet* filtered = dynamic_cast<FilteredServlet*>(servlet);
+            (filtered ? filtered->getServlet() : servlet)->handle(copy.get(), &response, &session);
+        }
+        if(!session.isStreamingResponse() && !session.isUpgraded()) {
+            self->store(baseKey, copy.get(), &response);
+        }
+        entry->refreshing.store(false, std::memory_order_release);
+        NEMO_LOG_DEBUG(systemLogger) << "http cache refreshed " << baseKey
+            << " status=" << static_cast<int>(response.getStatus());
+    });
+}
+
+int32_t HttpResponseCache::handle(ServletDispatcher* dispatcher, HttpServlet* servlet,
+                                  HttpRequest* request, HttpResponse* response,
+                                  HttpSession* session) {
+    if(FilteredServlet* filtered = dynamic_cast<FilteredServlet*>(servlet)) {
+        return filtered->handle(request, response, session,
+                [this, dispatcher](HttpServlet* servlet, HttpRequest* request,
+                                   HttpResponse* response, HttpSession* session) {
+            return serveOrHandle(dispatcher, servlet, request, response, session);
+        });
+    }
+    return serveOrHandle(dispatcher, servlet, request, response, session);
+}
+
+int32_t HttpResponseCache::serveOrHandle(ServletDispatcher* dispatcher, HttpServlet* servlet,
+                                         HttpRequest* request, HttpResponse* response,
+                                         HttpSession* session) {
+    if(!cacheEnable || request->getMethod() != HttpMethod::GET || servlet->isStreamBody() ||
+        request->getHeaders().has(HttpHeaderId::AUTHORIZATION)) {
+        return servlet->handle(request, response, session);
+    }
+
+    String baseKey = BaseKey(request->getPath(), request->getQuery());
+    HttpCacheControl requestControl;
+    requestControl.parse(request->getHeader(HttpHeaderId::CACHE_CONTROL));
+    if(!requestControl.noCache && !requestControl.noStore) {
+        EntryPtr entry = lookup(baseKey, request);
+        Clock::time_point now = Clock::now();
+        if(entry && now < entry->storedAt + entry->ttl) {
+            Serve(*entry, request, response, now);
+            return 0;
+        }
+        if(entry && now < entry->storedAt + entry->ttl + entry->staleWhileRevalidate) {
+            bool expected = false;
+            if(entry->refreshing.compare_exchange_strong(expected, true)) {
+                refresh(dispatcher, baseKey, request, entry);
+            }
+            Serve(*entry, request, response, now);
+            return 0;
+        }
+    }
+
+    int32_t rt = servlet->handle(request, response, session);
+    if(session && (session->isStreamingResponse() || session->isUpgraded())) { //流式发送的响应无法缓存
+        return rt;
+    }
+    if(!requestControl.noStore) {
+        store(baseKey, request, response);
+    }
+    if(HttpStatus::OK == response->getStatus()) {
+        StringArg etag = response->getHeader(HttpHeaderId::ETAG);
+        if(!etag.empty() && MatchETag(request->getHeader(HttpHeaderId::IF_NONE_MATCH), etag)) {
+            response->setStatus(HttpStatus::NOT_MODIFIED);
+            response->setBody(StringArg());
+        }
+    }
+    return rt;
+}
+
+void HttpResponseCache::invalidate(StringArg path, StringArg query) {
+    String baseKey = BaseKey(path, query);
+    Shard& shard = getShard(baseKey);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ResourcePtr resource;
+    if(shard.resources.get(baseKey, resource)) {
+        shard.bytes -= resource->bytes;
+        shard.resources.erase(baseKey);
+    }
+}
+
+void HttpResponseCache::clear() {
+    for(auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->resources.clear();
+        shard->bytes = 0;
+    }
+}
+
+size_t HttpResponseCache::getBytes() {
+    size_t bytes = 0;
+    for(auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        bytes += shard->bytes;
+    }
+    return bytes;
+}
+
+} // namespace http
+} // namespace net
+} // namespace nemo
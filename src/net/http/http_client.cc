@@ -0,0 +1,262 @@
+#include "net/http/http_client.h"
+
+#include <sys/socket.h>
+
+#include <algorithm>
+
+#include "coroutine/coroutine.h"
+#include "log/log.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+/**
+ * @brief 在当前协程所在的调度器中启动协程, 不在协程中时使用全局调度器
+ */
+static void Spawn(coroutine::Scheduler::Callback&& cb) {
+    coroutine::Processor* processor = coroutine::Processor::GetCurrentProcessor();
+    if(processor && processor->getScheduler()) {
+        processor->getScheduler()->addTask(std::move(cb));
+    } else {
+        coroutine_async std::move(cb);
+    }
+}
+
+static String OriginKey(const Uri* uri) {
+    return uri->getScheme() + "://" + uri->getHost() + ":" + std::to_string(uri->getPort());
+}
+
+static String RequestPath(const Uri* uri) {
+    return uri->getQuery().empty() ? uri->getPath() : uri->getPath() + "?" + uri->getQuery();
+}
+
+HttpFuture::HttpFuture() {
+}
+
+bool HttpFuture::isReady() {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    return finished_;
+}
+
+HttpResult::UniquePtr HttpFuture::get() {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    return finished_ ? std::move(result_) : nullptr;
+}
+
+void HttpFuture::cancel() {
+    complete(std::make_unique<HttpResult>(HttpResult::ErrorCode::CANCELLED, nullptr, "cancelled"));
+}
+
+bool HttpFuture::complete(HttpResult::UniquePtr&& result) {
+    {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        if(finished_) {
+            return false;
+        }
+        finished_ = true;
+        result_ = std::move(result);
+        //关闭其他请求的连接, 阻塞在读写上的协程立即返回
+        for(Socket* sock : sockets_) {
+            ::shutdown(sock->getSocketFd(), SHUT_RDWR);
+        }
+    }
+    done_.done();
+    return true;
+}
+
+bool HttpFuture::attach(Socket* sock) {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    if(finished_) {
+        return false;
+    }
+    sockets_.push_back(sock);
+    return true;
+}
+
+void HttpFuture::detach(Socket* sock) {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    std::erase(sockets_, sock);
+}
+
+void HttpClient::LatencyTracker::add(uint32_t millionSeconds) {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    samples_[count_++ % kSamples] = millionSeconds;
+}
+
+int64_t HttpClient::LatencyTracker::percentile(double p) {
+    std::vector<uint32_t> samples;
+    {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        if(count_ < kMinSamples) {
+            return -1;
+        }
+        samples.assign(samples_, samples_ + std::min(count_, kSamples));
+    }
+    size_t index = std::min(samples.size() - 1,
+                            static_cast<size_t>(samples.size() * std::clamp(p, 0.0, 100.0) / 100));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+HttpClient::HttpClient(const HttpClientOptions& options) :
+    options_(options) {
+}
+
+HttpClient::OriginPtr HttpClient::getOrigin(const Uri* uri) {
+    String key = OriginKey(uri);
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    OriginPtr& origin = origins_[key];
+    if(!origin) {
+        origin = std::make_shared<Origin>();
+        origin->pool = std::make_shared<HttpConnectionPool>(uri->getHost(), "", uri->getPort(),
+                            options_.maxIdlePerHost, options_.maxAliveTime,
+                            options_.maxRequestPerConnection,
+                            ::strcasecmp(uri->getScheme().c_str(), "https") == 0);
+    }
+    return origin;
+}
+
+HttpConnectionPool::SharedPtr HttpClient::getPool(const Uri* uri) {
+    return getOrigin(uri)->pool;
+}
+
+void HttpClient::RunAttempt(HttpFuture::SharedPtr future, OriginPtr origin,
+                            std::shared_ptr<HttpRequest> request, Clock::time_point deadline) {
+    HttpConnectionPool::Lease connection = origin->pool->acquire();
+    if(!connection) {
+        future->complete(std::make_unique<HttpResult>(HttpResult::ErrorCode::POOL_GET_CONNECTION,
+                            nullptr, "get connection fail"));
+        return;
+    }
+    Socket* sock = connection->getSocket();
+    if(!future->attach(sock)) {
+        return;
+    }
+    Clock::time_point start = Clock::now();
+    int64_t remain = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - start).count();
+    HttpResult::UniquePtr result = origin->pool->doRequest(connection, request.get(),
+                                                            std::max<int64_t>(remain, 1));
+    future->detach(sock);
+    if(HttpResult::ErrorCode::OK == result->errorCode) {
+        origin->latency.add(static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count()));
+    }
+    future->complete(std::move(result));
+}
+
+HttpFuture::SharedPtr HttpClient::async(const HttpClientRequest& request,
+                                        uint64_t timeoutMillionSeconds) {
+    HttpFuture::SharedPtr future = std::make_shared<HttpFuture>();
+    Uri::UniquePtr uri = Uri::Create(request.url);
+    if(!uri) {
+        future->complete(std::make_unique<HttpResult>(HttpResult::ErrorCode::INVALID_URL,
+                            nullptr, "invalid url: " + request.url));
+        return future;
+    }
+    OriginPtr origin = getOrigin(uri.get());
+    std::shared_ptr<HttpRequest> httpRequest = origin->pool->createRequest(request.method,
+                                    RequestPath(uri.get()), request.headers, request.body);
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMillionSeconds);
+
+    //只有幂等的请求可以对冲
+    int64_t hedgeDelay = -1;
+    if(request.hedge && (HttpMethod::GET == request.method || HttpMethod::HEAD == request.method)) {
+        hedgeDelay = origin->latency.percentile(options_.hedgePercentile);
+        if(hedgeDelay < 0) {
+            hedgeDelay = options_.hedgeDefaultDelay;
+        }
+        hedgeDelay = std::max<int64_t>(hedgeDelay, options_.hedgeMinDelay);
+    }
+
+    Spawn([future, origin, httpRequest, deadline, hedgeDelay]() {
+        Spawn([future, origin, httpRequest, deadline]() {
+            RunAttempt(future, origin, httpRequest, deadline);
+        });
+        if(hedgeDelay >= 0) {
+            Clock::time_point hedgeAt = Clock::now() + std::chrono::milliseconds(hedgeDelay);
+            if(hedgeAt < deadline && !future->waitUntil(hedgeAt)) {
+                NEMO_LOG_DEBUG(systemLogger) << "hedge request " << httpRequest->getPath()
+                    << " after " << hedgeDelay << "ms";
+                Spawn([future, origin, httpRequest, deadline]() {
+                    RunAttempt(future, origin, httpRequest, deadline);
+                });
+            }
+        }
+        if(!future->waitUntil(deadline)) {
+            future->complete(std::make_unique<HttpResult>(HttpResult::ErrorCode::TIMEOUT,
+                                nullptr, "deadline exceeded"));
+        }
+    });
+    return future;
+}
+
+std::vector<HttpResult::UniquePtr> HttpClient::fanOut(const std::vector<HttpClientRequest>& requests,
+                                                    uint64_t timeoutMillionSeconds) {
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMillionSeconds);
+    std::vector<HttpFuture::SharedPtr> futures;
+    futures.reserve(requests.size());
+    for(const HttpClientRequest& request : requests) {
+        futures.push_back(async(request, timeoutMillionSeconds));
+    }
+
+    std::vector<HttpResult::UniquePtr> results;
+    results.reserve(futures.size());
+    for(HttpFuture::SharedPtr& future : futures) {
+        if(!future->waitUntil(deadline)) {
+            future->complete(std::make_unique<HttpResult>(HttpResult::ErrorCode::TIMEOUT,
+                                nullptr, "deadline exceeded"));
+        }
+        results.push_back(future->get());
+    }
+    return results;
+}
+
+std::vector<HttpResult::UniquePtr> HttpClient::pipeline(const std::vector<HttpClientRequest>& requests,
+                                                    uint64_t timeoutMillionSeconds) {
+    std::vector<HttpResult::UniquePtr> results(requests.size());
+    std::vector<HttpRequest::UniquePtr> httpRequests(requests.size());
+    //同一个主机的请求按原来的顺序放在一组
+    std::vector<std::pair<OriginPtr, std::vector<size_t>>> groups;
+    std::unordered_map<String, size_t> groupIndex;
+    for(size_t i = 0; i < requests.size(); ++i) {
+        Uri::UniquePtr uri = Uri::Create(requests[i].url);
+        if(!uri) {
+            results[i] = std::make_unique<HttpResult>(HttpResult::ErrorCode::INVALID_URL,
+                            nullptr, "invalid url: " + requests[i].url);
+            continue;
+        }
+        OriginPtr origin = getOrigin(uri.get());
+        httpRequests[i] = origin->pool->createRequest(requests[i].method, RequestPath(uri.get()),
+                                                    requests[i].headers, requests[i].body);
+        auto it = groupIndex.emplace(OriginKey(uri.get()), groups.size()).first;
+        if(it->second == groups.size()) {
+            groups.emplace_back(origin, std::vector<size_t>());
+        }
+        groups[it->second].second.push_back(i);
+    }
+
+    coroutine::WaitGroup waitGroup(groups.size());
+    for(auto& group : groups) {
+        Spawn([&group, &httpRequests, &results, &waitGroup, timeoutMillionSeconds]() {
+            std::vector<const HttpRequest*> batch;
+            for(size_t index : group.second) {
+                batch.push_back(httpRequests[index].get());
+            }
+            std::vector<HttpResult::UniquePtr> groupResults =
+                group.first->pool->doPipeline(batch, timeoutMillionSeconds);
+            for(size_t i = 0; i < groupResults.size(); ++i) {
+                results[group.second[i]] = std::move(groupResults[i]);
+            }
+            waitGroup.done();
+        });
+    }
+    waitGroup.wait();
+    return results;
+}
+
+} // namespace http
+} // namespace net
+} // namespace nemo
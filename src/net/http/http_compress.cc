@@ -0,0 +1,572 @@
+#include "net/http/http_compress.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#ifdef NEMO_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include "net/http/http.h"
+#include "container/epoch.h"
+#include "container/lru_cache.h"
+#include "log/log.h"
+#include "common/config.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+static ConfigVar<bool>* compressEnableConfig =
+    Config::Lookup("http.compress.enable", false, "enable http response compression");
+
+static ConfigVar<uint32_t>* compressMinSizeConfig =
+    Config::Lookup("http.compress.min_size", static_cast<uint32_t>(1024),
+                    "responses smaller than this are sent uncompressed");
+
+static ConfigVar<int32_t>* compressLevelConfig =
+    Config::Lookup("http.compress.level", static_cast<int32_t>(6),
+                    "gzip/deflate compression level (1-9)");
+
+static ConfigVar<int32_t>* compressBrotliQualityConfig =
+    Config::Lookup("http.compress.brotli_quality", static_cast<int32_t>(5),
+                    "brotli compression quality (0-11)");
+
+static ConfigVar<std::vector<String>>* compressTypesConfig =
+    Config::Lookup("http.compress.types", std::vector<String>{
+                        "text/", "application/json", "application/javascript",
+                        "application/xml", "image/svg+xml", "+json", "+xml"},
+                    "compressible content types, 'x/' matches a prefix and '+x' a suffix");
+
+static ConfigVar<uint32_t>* compressCacheSizeConfig =
+    Config::Lookup("http.compress.cache_size", static_cast<uint32_t>(1024),
+                    "max precompressed responses kept in the lru cache, 0 disables it");
+
+static ConfigVar<uint32_t>* compressCacheMaxBodySizeConfig =
+    Config::Lookup("http.compress.cache_max_body_size", static_cast<uint32_t>(256 * 1024),
+                    "responses larger than this are compressed without caching");
+
+static bool compressEnable = false;
+static uint32_t compressMinSize = 0;
+static int32_t compressLevel = 6;
+static int32_t compressBrotliQuality = 5;
+static uint32_t compressCacheMaxBodySize = 0;
+
+namespace {
+
+/**
+ * @brief 缓存的键, 消息体用64位摘要加长度表示
+ * @attention 摘要可能冲突, 命中后还要比较原始的消息体
+ */
+struct CacheKey {
+    uint64_t digest;
+    uint64_t size;
+    HttpContentCoding coding;
+
+    bool operator==(const CacheKey& other) const {
+        return digest == other.digest && size == other.size && coding == other.coding;
+    }
+};
+
+struct CacheKeyHash {
+    size_t operator()(const CacheKey& key) const {
+        return key.digest ^ (key.size << 2) ^ static_cast<size_t>(key.coding);
+    }
+};
+
+/**
+ * @brief 缓存的压缩结果, 同时保存原始消息体用来确认命中
+ */
+struct CompressedBody {
+    String original;
+    String compressed;
+};
+
+typedef std::shared_ptr<const CompressedBody> CacheValue;
+
+/**
+ * @brief 压缩结果缓存, 所有连接共享
+ * @details seen只记录见过的键, 第二次见到时才压缩结果放入cache
+ */
+struct CompressCache {
+    std::mutex mutex;
+    std::unique_ptr<LruCache<CacheKey, CacheValue, CacheKeyHash>> cache;
+    std::unique_ptr<LruCache<CacheKey, bool, CacheKeyHash>> seen;
+    //每个响应都要检查类型, 读者不加锁, 配置变化时整体替换, 旧列表没有读者后释放
+    EpochDomain typesEpoch;
+    std::atomic<const std::vector<String>*> types{nullptr};
+
+    void setTypes(const std::vector<String>& newTypes) {
+        const std::vector<String>* old = types.exchange(new std::vector<String>(newTypes),
+                                                        std::memory_order_acq_rel);
+        if(old) {
+            typesEpoch.retire(old);
+        }
+    }
+
+    void resize(uint32_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(0 == size) {
+            cache.reset();
+            seen.reset();
+            return;
+        }
+        cache = std::make_unique<LruCache<CacheKey, CacheValue, CacheKeyHash>>(size, size);
+        seen = std::make_unique<LruCache<CacheKey, bool, CacheKeyHash>>(size * 4, size * 4);
+    }
+};
+
+static CompressCache& GetCache() {
+    static CompressCache* cache = new CompressCache; //不析构, 退出时其它线程可能还在使用
+    return *cache;
+}
+
+struct CompressConfigIniter {
+    CompressConfigIniter() {
+        compressEnable = compressEnableConfig->getValue();
+        compressMinSize = compressMinSizeConfig->getValue();
+        compressLevel = std::clamp(compressLevelConfig->getValue(), 1, 9);
+        compressBrotliQuality = std::clamp(compressBrotliQualityConfig->getValue(), 0, 11);
+        compressCacheMaxBodySize = compressCacheMaxBodySizeConfig->getValue();
+        GetCache().setTypes(compressTypesConfig->getValue());
+        GetCache().resize(compressCacheSizeConfig->getValue());
+
+        compressEnableConfig->addListener([](const bool& oldVal, const bool& newVal) {
+            static_cast<void>(oldVal);
+            compressEnable = newVal;
+        });
+        compressMinSizeConfig->addListener([](const uint32_t& oldVal, const uint32_t& newVal) {
+            static_cast<void>(oldVal);
+            compressMinSize = newVal;
+        });
+        compressLevelConfig->addListener([](const int32_t& oldVal, const int32_t& newVal) {
+            static_cast<void>(oldVal);
+            compressLevel = std::clamp(newVal, 1, 9);
+            HttpCompression::ClearCache();
+        });
+        compressBrotliQualityConfig->addListener([](const int32_t& oldVal, const int32_t& newVal) {
+            static_cast<void>(oldVal);
+            compressBrotliQuality = std::clamp(newVal, 0, 11);
+            HttpCompression::ClearCache();
+        });
+        compressTypesConfig->addListener([](const std::vector<String>& oldVal,
+                                            const std::vector<String>& newVal) {
+            static_cast<void>(oldVal);
+            GetCache().setTypes(newVal);
+        });
+        compressCacheSizeConfig->addListener([](const uint32_t& oldVal, const uint32_t& newVal) {
+            static_cast<void>(oldVal);
+            GetCache().resize(newVal);
+        });
+        compressCacheMaxBodySizeConfig->addListener([](const uint32_t& oldVal, const uint32_t& newVal) {
+            static_cast<void>(oldVal);
+            compressCacheMaxBodySize = newVal;
+        });
+    }
+};
+
+static CompressConfigIniter compressConfigIniter;
+
+/**
+ * @brief gzip/deflate压缩器
+ */
+class ZlibCompressor : public HttpCompressor {
+public:
+    /**
+     * @param[in] windowBits 15为zlib格式(HTTP的deflate), 31为gzip格式
+     */
+    ZlibCompressor(int windowBits) {
+        ::memset(&zs_, 0, sizeof(zs_));
+        inited_ = ::deflateInit2(&zs_, compressLevel, Z_DEFLATED, windowBits,
+                                 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+
+    ~ZlibCompressor() {
+        if(inited_) {
+            ::deflateEnd(&zs_);
+        }
+    }
+
+    bool compress(const void* data, size_t len, String& out, bool finish) override {
+        if(!inited_) {
+            return false;
+        }
+        zs_.next_in = static_cast<Bytef*>(const_cast<void*>(data));
+        zs_.avail_in = len;
+        //流式响应每次写入都同步刷新, 客户端可以立即解码已经发送的数据(SSE等)
+        int flush = finish ? Z_FINISH : Z_SYNC_FLUSH;
+        size_t chunk = std::max<size_t>(::deflateBound(&zs_, len), 64);
+        while(true) {
+            size_t offset = out.size();
+            out.resize(offset + chunk);
+            zs_.next_out = reinterpret_cast<Bytef*>(&out[offset]);
+            zs_.avail_out = chunk;
+            int rt = ::deflate(&zs_, flush);
+            out.resize(offset + chunk - zs_.avail_out);
+            if(Z_STREAM_END == rt) {
+                return true;
+            }
+            if(rt != Z_OK && rt != Z_BUF_ERROR) {
+                return false;
+            }
+            if(!finish && 0 == zs_.avail_in && zs_.avail_out > 0) {
+                return true;
+            }
+        }
+    }
+
+private:
+    z_stream zs_;
+    bool inited_;
+};
+
+#ifdef NEMO_HAVE_BROTLI
+/**
+ * @brief brotli压缩器
+ */
+class BrotliCompressor : public HttpCompressor {
+public:
+    BrotliCompressor() :
+        state_(::BrotliEncoderCreateInstance(nullptr, nullptr, nullptr)) {
+        if(state_) {
+            ::BrotliEncoderSetParameter(state_, BROTLI_PARAM_QUALITY, compressBrotliQuality);
+            ::BrotliEncoderSetParameter(state_, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+        }
+    }
+
+    ~BrotliCompressor() {
+        if(state_) {
+            ::BrotliEncoderDestroyInstance(state_);
+        }
+    }
+
+    bool compress(const void* data, size_t len, String& out, bool finish) override {
+        if(!state_) {
+            return false;
+        }
+        const uint8_t* next = static_cast<const uint8_t*>(data);
+        size_t avail = len;
+        BrotliEncoderOperation op = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH;
+        while(true) {
+            size_t availOut = 0; //输出留在编码器内部, 通过BrotliEncoderTakeOutput取出
+            if(!::BrotliEncoderCompressStream(state_, op, &avail, &next,
+                                              &availOut, nullptr, nullptr)) {
+                return false;
+            }
+            size_t size = 0;
+            const uint8_t* output = ::BrotliEncoderTakeOutput(state_, &size);
+            out.append(reinterpret_cast<const char*>(output), size);
+            if(::BrotliEncoderHasMoreOutput(state_)) {
+                continue;
+            }
+            if(finish ? ::BrotliEncoderIsFinished(state_) : 0 == avail) {
+                return true;
+            }
+        }
+    }
+
+private:
+    BrotliEncoderState* state_;
+};
+#endif
+
+/**
+ * @brief 解析q值, 不合法时返回-1
+ */
+static int ParseQValue(StringArg params) {
+    while(!params.empty()) {
+        size_t semi = params.find(';');
+        StringArg param = params.substr(0, semi);
+        params = (String::npos == semi) ? StringArg() : params.substr(semi + 1);
+        while(!param.empty() && ' ' == param.front()) {
+            param.remove_prefix(1);
+        }
+        if(param.size() < 2 || (param[0] != 'q' && param[0] != 'Q') || param[1] != '=') {
+            continue;
+        }
+        //q值最多3位小数, 放大1000倍比较
+        param.remove_prefix(2);
+        int q = 0;
+        size_t i = 0;
+        if(i < param.size() && (param[i] == '0' || param[i] == '1')) {
+            q = (param[i++] - '0') * 1000;
+        } else {
+            return -1;
+        }
+        if(i < param.size() && '.' == param[i]) {
+            ++i;
+            for(int scale = 100; i < param.size() && isdigit(param[i]) && scale > 0; scale /= 10) {
+                q += (param[i++] - '0') * scale;
+            }
+        }
+        return std::min(q, 1000);
+    }
+    return 1000;
+}
+
+} // namespace
+
+const char* HttpContentCoding2String(HttpContentCoding coding) {
+    switch(coding) {
+#define XX(num, name, string) \
+        case HttpContentCoding::name: \
+            return #string;
+        HTTP_CONTENT_CODING_MAP(XX);
+#undef XX
+        default:
+            return "<unknown>";
+    }
+    return "<unknown>";
+}
+
+HttpContentCoding NegotiateContentCoding(StringArg acceptEncoding) {
+    constexpr int kCount = static_cast<int>(HttpContentCoding::BROTLI) + 1;
+    int qvalues[kCount];
+    std::fill(qvalues, qvalues + kCount, -1); //-1表示没有列出
+    int wildcard = -1;
+    while(!acceptEncoding.empty()) {
+        size_t end = acceptEncoding.find(',');
+        StringArg item = acceptEncoding.substr(0, end);
+        acceptEncoding = (String::npos == end) ? StringArg() : acceptEncoding.substr(end + 1);
+
+        size_t semi = item.find(';');
+        StringArg name = item.substr(0, semi);
+        while(!name.empty() && ' ' == name.front()) {
+            name.remove_prefix(1);
+        }
+        while(!name.empty() && ' ' == name.back()) {
+            name.remove_suffix(1);
+        }
+        int q = (String::npos == semi) ? 1000 : ParseQValue(item.substr(semi + 1));
+        if(q < 0) {
+            continue;
+        }
+        if("*" == name) {
+            wildcard = q;
+            continue;
+        }
+#define XX(num, coding, string) \
+        if(name.size() == sizeof(#string) - 1 && \
+            ::strncasecmp(name.data(), #string, name.size()) == 0) { \
+            qvalues[num] = q; \
+            continue; \
+        }
+        HTTP_CONTENT_CODING_MAP(XX);
+#undef XX
+        if(name.size() == 6 && ::strncasecmp(name.data(), "x-gzip", 6) == 0) {
+            qvalues[static_cast<int>(HttpContentCoding::GZIP)] = q;
+        }
+    }
+
+    HttpContentCoding best = HttpContentCoding::IDENTITY;
+    int bestQ = 0;
+    for(int i = static_cast<int>(HttpContentCoding::DEFLATE); i < kCount; ++i) {
+#ifndef NEMO_HAVE_BROTLI
+        if(static_cast<int>(HttpContentCoding::BROTLI) == i) {
+            continue;
+        }
+#endif
+        int q = qvalues[i] >= 0 ? qvalues[i] : wildcard;
+        if(q > 0 && q >= bestQ) { //q值相同时后面的编码优先
+            best = static_cast<HttpContentCoding>(i);
+            bestQ = q;
+        }
+    }
+    return best;
+}
+
+HttpCompressor::UniquePtr HttpCompressor::Create(HttpContentCoding coding) {
+    switch(coding) {
+        case HttpContentCoding::GZIP:
+            return std::make_unique<ZlibCompressor>(15 + 16);
+        case HttpContentCoding::DEFLATE:
+            return std::make_unique<ZlibCompressor>(15);
+#ifdef NEMO_HAVE_BROTLI
+        case HttpContentCoding::BROTLI:
+            return std::make_unique<BrotliCompressor>();
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+bool HttpCompression::IsEnabled() {
+    return compressEnable;
+}
+
+bool HttpCompression::IsCompressibleType(StringArg contentType) {
+    size_t semi = contentType.find(';');
+    if(String::npos != semi) {
+        contentType = contentType.substr(0, semi);
+    }
+    while(!contentType.empty() && ' ' == contentType.back()) {
+        contentType.remove_suffix(1);
+    }
+    if(contentType.empty()) {
+        return false;
+    }
+    CompressCache& cache = GetCache();
+    EpochDomain::ReaderLease reader(&cache.typesEpoch);
+    EpochDomain::Guard guard(reader.get());
+    const std::vector<String>* types = cache.types.load(std::memory_order_acquire);
+    if(!types) {
+        return false;
+    }
+    for(const String& type : *types) {
+        if(type.empty()) {
+            continue;
+        }
+        if('/' == type.back()) {
+            if(contentType.size() >= type.size() &&
+                ::strncasecmp(contentType.data(), type.data(), type.size()) == 0) {
+                return true;
+            }
+        } else if('+' == type.front()) {
+            if(contentType.size() >= type.size() &&
+                ::strncasecmp(contentType.data() + contentType.size() - type.size(),
+                              type.data(), type.size()) == 0) {
+                return true;
+            }
+        } else if(contentType.size() == type.size() &&
+                  ::strncasecmp(contentType.data(), type.data(), type.size()) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HttpCompression::IsCompressible(const HttpResponse* response) {
+    int status = static_cast<int>(response->getStatus());
+    //没有消息体的响应, 以及范围请求的响应(Content-Range针对未压缩的数据)
+    if(status < 200 || 204 == status || 206 == status || 304 == status) {
+        return false;
+    }
+    if(response->getHeaders().has(HttpHeaderId::CONTENT_ENCODING)) {
+        return false;
+    }
+    return IsCompressibleType(response->getHeader(HttpHeaderId::CONTENT_TYPE));
+}
+
+void HttpCompression::SetEncodingHeaders(HttpContentCoding coding, HttpResponse* response) {
+    response->setHeader("Content-Encoding", HttpContentCoding2String(coding));
+    //压缩后的表示与原始表示不同, 强ETag不能再使用
+    StringArg etag = response->getHeader(HttpHeaderId::ETAG);
+    if(!etag.empty() && etag.substr(0, 2) != "W/") {
+        String weak = "W/";
+        weak.append(etag);
+        response->setHeader("ETag", weak);
+    }
+}
+
+/**
+ * @brief 添加Vary: Accept-Encoding, 没有协商压缩时同样需要, 避免缓存把未压缩的版本返回给所有客户端
+ */
+static void AddVary(HttpResponse* response) {
+    StringArg vary = response->getHeader(HttpHeaderId::VARY);
+    if(vary.empty()) {
+        response->setHeader("Vary", "Accept-Encoding");
+    } else if(!HasHeaderToken(vary, "Accept-Encoding") && !HasHeaderToken(vary, "*")) {
+        String value(vary);
+        value.append(", Accept-Encoding");
+        response->setHeader("Vary", value);
+    }
+}
+
+bool HttpCompression::Apply(HttpContentCoding coding, HttpResponse* response) {
+    const String& body = response->getBody();
+    //流式发送的响应消息体为空, 在HttpBodyWriter中压缩
+    if(!compressEnable || body.empty() || body.size() < compressMinSize ||
+        !IsCompressible(response)) {
+        return false;
+    }
+    AddVary(response);
+    if(HttpContentCoding::IDENTITY == coding) {
+        return false;
+    }
+
+    CompressCache& cache = GetCache();
+    bool cacheable = body.size() <= compressCacheMaxBodySize;
+    CacheKey key{0, body.size(), coding};
+    CacheValue compressed;
+    bool admit = false;
+    if(cacheable) {
+        key.digest = std::hash<StringArg>()(body);
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        if(cache.cache && cache.cache->get(key, compressed) && compressed->original != body) {
+            compressed.reset(); //摘要冲突, 不能把其它响应的消息体发送出去
+        } else if(cache.cache && !compressed) {
+            bool seen = false;
+            admit = cache.seen->get(key, seen);
+            if(!admit) {
+                cache.seen->put(key, true);
+            }
+        }
+    }
+
+    if(!compressed) {
+        HttpCompressor::UniquePtr compressor = HttpCompressor::Create(coding);
+        String out;
+        out.reserve(body.size() / 4);
+        if(!compressor || !compressor->compress(body.data(), body.size(), out, true)) {
+            NEMO_LOG_WARN(systemLogger) << "compress response fail, coding="
+                << HttpContentCoding2String(coding);
+            return false;
+        }
+        auto value = std::make_shared<CompressedBody>();
+        if(admit) {
+            value->original = body;
+        }
+        value->compressed = std::move(out);
+        compressed = std::move(value);
+        if(admit) {
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            if(cache.cache) {
+                cache.cache->put(key, compressed);
+            }
+        }
+    }
+    if(compressed->compressed.size() >= body.size()) { //不可压缩的数据, 原样发送
+        return false;
+    }
+
+    SetEncodingHeaders(coding, response);
+    response->setBody(StringArg(compressed->compressed));
+    if(response->getHeaders().has(HttpHeaderId::CONTENT_LENGTH)) {
+        response->setHeader("Content-Length", std::to_string(compressed->compressed.size()));
+    }
+    return true;
+}
+
+HttpCompressor::UniquePtr HttpCompression::Start(HttpContentCoding coding, HttpResponse* response) {
+    if(!compressEnable || !IsCompressible(response)) {
+        return nullptr;
+    }
+    int64_t length = -1;
+    if(response->checkGetHeaderAs<int64_t>("content-length", length) &&
+        length >= 0 && static_cast<uint64_t>(length) < compressMinSize) {
+        return nullptr;
+    }
+    AddVary(response);
+    HttpCompressor::UniquePtr compressor = HttpCompressor::Create(coding);
+    if(compressor) {
+        SetEncodingHeaders(coding, response);
+        response->delHeader("Content-Length");
+    }
+    return compressor;
+}
+
+void HttpCompression::ClearCache() {
+    GetCache().resize(compressCacheSizeConfig->getValue());
+}
+
+} // namespace http
+} // namespace net
+} // namespace nemo
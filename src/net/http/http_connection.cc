@@ -1,7 +1,15 @@
 #include "net/http/http_connection.h"
 
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
 #include "common/lexical_cast.h"
 #include "net/http/http_parser.h"
+#include "net/io/hook.h"
+#include "coroutine/coroutine.h"
 #include "log/log.h"
 #include "container/buffer.h"
 
@@ -45,16 +53,24 @@ HttpResponse::UniquePtr HttpConnection::recvResponse() {
     //uint64_t buffSize = 100;
     Buffer buffer(buffSize + 1, true);
     char* data = buffer.data();
-    off_t offset = 0; //下一次读取data的偏移量
+    //先解析上一个响应之后剩下的数据
+    off_t offset = std::min(pending_.size(), buffSize); //下一次读取data的偏移量
+    ::memcpy(data, pending_.data(), offset);
+    pending_.clear();
+    bool hasPending = offset > 0;
     do {
-		//len为成功读取的字节数
-        int len = sockStream_->read(data + offset, buffSize - offset);
-        if(len <= 0) { //读取失败
-            sockStream_->close();
-            return nullptr;
+        int len = offset;
+        if(!hasPending) {
+            //len为成功读取的字节数
+            len = sockStream_->read(data + offset, buffSize - offset);
+            if(len <= 0) { //读取失败
+                sockStream_->close();
+                return nullptr;
+            }
+            //得到总的读取的字节数
+            len += offset;
         }
-        //得到总的读取的字节数
-        len += offset;
+        hasPending = false;
         data[len] = '\0';
         size_t nparse = parser->execute(data, len, false); 
         if(parser->hasError()) { //解析失败
@@ -126,8 +142,12 @@ HttpResponse::UniquePtr HttpConnection::recvResponse() {
                 len = 0;
             }
         } while(!clientParser.chunks_done);
+        pending_.assign(data, len);
     } else { //不分块解析
         int64_t bodyLen = static_cast<int64_t>(parser->getContentLength());
+        if(offset > bodyLen) {
+            pending_.assign(data + bodyLen, offset - bodyLen);
+        }
         if(bodyLen > 0) {
             body.resize(bodyLen);
             int64_t len = std::min(static_cast<int64_t>(offset), bodyLen);
@@ -243,7 +263,68 @@ HttpResult::UniquePtr HttpConnection::DoRequest(HttpRequest* request,
             nullptr, "ok");
 }
 
-HttpConnectionPool::UniquePtr HttpConnectionPool::Create(StringArg uriStr,
+static constexpr size_t kPoolShards = 8;
+
+/**
+ * @brief 空闲连接上是否没有可读的数据, 对端关闭或者发来意外的数据时连接不能再使用
+ */
+static bool IsIdleHealthy(Socket* sock) {
+    char c;
+    return recv_f(sock->getSocketFd(), &c, sizeof(c), MSG_PEEK | MSG_DONTWAIT) < 0 &&
+            (EAGAIN == errno || EWOULDBLOCK == errno);
+}
+
+/**
+ * @brief 响应之后连接是否保持
+ */
+static bool IsKeepAlive(const HttpResponse* response) {
+    String connection = response->getHeader("connection");
+    if(!connection.empty()) {
+        return ::strcasecmp(connection.c_str(), "keep-alive") == 0;
+    }
+    return HttpVersion::HTTP11 == response->getVersion();
+}
+
+HttpConnectionPool::Lease::Lease(HttpConnectionPool* pool, HttpConnection::UniquePtr&& connection,
+                                bool reused) :
+    pool_(pool),
+    connection_(std::move(connection)),
+    reused_(reused) {
+    ++pool_->leasedCount_;
+}
+
+HttpConnectionPool::Lease::Lease(Lease&& other) noexcept :
+    pool_(other.pool_),
+    connection_(std::move(other.connection_)),
+    reused_(other.reused_),
+    discarded_(other.discarded_) {
+    other.pool_ = nullptr;
+}
+
+HttpConnectionPool::Lease& HttpConnectionPool::Lease::operator=(Lease&& other) noexcept {
+    if(this != &other) {
+        Lease released(std::move(*this));
+        pool_ = other.pool_;
+        connection_ = std::move(other.connection_);
+        reused_ = other.reused_;
+        discarded_ = other.discarded_;
+        other.pool_ = nullptr;
+    }
+    return *this;
+}
+
+HttpConnectionPool::Lease::~Lease() {
+    if(!pool_) {
+        return;
+    }
+    --pool_->leasedCount_;
+    if(connection_ && !discarded_) {
+        pool_->release(std::move(connection_));
+    }
+    pool_ = nullptr;
+}
+
+HttpConnectionPool::SharedPtr HttpConnectionPool::Create(StringArg uriStr,
         StringArg vhost,
         uint32_t maxSize,
         uint32_t maxAliveTime,
@@ -253,11 +334,10 @@ HttpConnectionPool::UniquePtr HttpConnectionPool::Create(StringArg uriStr,
         NEMO_LOG_ERROR(systemLogger) << "invalid uri=" << uriStr;
         return nullptr;
     }
-    return std::make_unique<HttpConnectionPool>(uri->getHost(), 
+    return std::make_shared<HttpConnectionPool>(uri->getHost(), 
             vhost, uri->getPort(), maxSize, 
             maxAliveTime, maxRequest,
-            ::strncasecmp(uri->getScheme().data(), 
-                "https", uri->getScheme().size()) == 0);
+            ::strcasecmp(uri->getScheme().c_str(), "https") == 0);
 }
 
 HttpConnectionPool::HttpConnectionPool(StringArg host,
@@ -274,82 +354,171 @@ HttpConnectionPool::HttpConnectionPool(StringArg host,
     maxAliveTime_(maxAliveTime),
     maxRequest_(maxRequest),
     isHttps_(isHttps) {
+    for(size_t i = 0; i < kPoolShards; ++i) {
+        shards_.emplace_back(std::make_unique<Shard>());
+    }
 }
 
-HttpConnection* HttpConnectionPool::getConnection() {
-    uint64_t nowMillionSeconds = nemo::GetCurrentMillionSeconds();
-    HttpConnection* validConnection = nullptr;
-    {
-        std::lock_guard<std::mutex> lockGuard(mutex_);
-        for (auto iter = connections_.begin();
-            iter != connections_.end();) {
-            HttpConnection* connection = iter->get();
-            if (!connection->isConnect() || 
-                connection->createTime_ + maxAliveTime_ > nowMillionSeconds) {
-                connections_.erase(iter++);
-            } else {
-                validConnection = connection;
-                break;
+size_t HttpConnectionPool::shardIndex() const {
+    return std::hash<std::thread::id>()(std::this_thread::get_id()) % shards_.size();
+}
+
+bool HttpConnectionPool::isReusable(const HttpConnection* connection, uint64_t idleSince,
+                                    uint64_t now) const {
+    if(!connection->isConnect()) {
+        return false;
+    }
+    if(maxAliveTime_ && connection->createTime_ + maxAliveTime_ <= now) {
+        return false;
+    }
+    if(maxRequest_ && connection->request_ >= maxRequest_) {
+        return false;
+    }
+    uint32_t idleTimeout = idleTimeoutMillionSeconds_;
+    if(idleTimeout && idleSince + idleTimeout <= now) {
+        return false;
+    }
+    return IsIdleHealthy(connection->getSocket());
+}
+
+HttpConnection::UniquePtr HttpConnectionPool::connect() {
+    IpAddress::UniquePtr addr = Address::LookupAnyIPAddress(host_);
+    if(!addr) {
+        NEMO_LOG_ERROR(systemLogger) << "get addr fail: " << host_;
+        return nullptr;
+    }
+    addr->setPort(port_);
+    Socket::UniquePtr sock;
+    if(isHttps_) {
+        SecureSocket::UniquePtr secure = SecureSocket::CreateTcp(addr.get());
+        secure->setServerName(host_);
+        sock = std::move(secure);
+    } else {
+        sock = Socket::CreateTcp(addr.get());
+    } 
+    if(!sock) {
+        NEMO_LOG_ERROR(systemLogger) << "create sock fail: " << *addr;
+        return nullptr;
+    }
+    if(!sock->connect(addr.get())) {
+        NEMO_LOG_ERROR(systemLogger) << "sock connect fail: " << *addr;
+        return nullptr;
+    }
+
+    HttpConnection::UniquePtr connection = std::make_unique<HttpConnection>(std::move(sock));
+    connection->createTime_ = nemo::GetCurrentMillionSeconds();
+    return connection;
+}
+
+HttpConnectionPool::Lease HttpConnectionPool::acquire() {
+    uint64_t now = nemo::GetCurrentMillionSeconds();
+    //失效的连接在锁外析构
+    std::vector<HttpConnection::UniquePtr> expired;
+    size_t index = shardIndex();
+    for(size_t i = 0; i < shards_.size(); ++i) {
+        Shard& shard = *shards_[(index + i) % shards_.size()];
+        std::lock_guard<std::mutex> lockGuard(shard.mutex);
+        while(!shard.idle.empty()) {
+            IdleConnection idle = std::move(shard.idle.back());
+            shard.idle.pop_back();
+            --idleCount_;
+            if(isReusable(idle.connection.get(), idle.idleSince, now)) {
+                return Lease(this, std::move(idle.connection), true);
             }
+            expired.push_back(std::move(idle.connection));
         }
     }
 
-    if(!validConnection) {
-        IpAddress::UniquePtr addr = Address::LookupAnyIPAddress(host_);
-        if(!addr) {
-            NEMO_LOG_ERROR(systemLogger) << "get addr fail: " << host_;
-            return nullptr;
-        }
-        addr->setPort(port_);
-        Socket::UniquePtr sock;
-        if(isHttps_) {
-            sock = SecureSocket::CreateTcp(addr.get());
-        } else {
-            sock = Socket::CreateTcp(addr.get());
-        } 
-        if(!sock) {
-            NEMO_LOG_ERROR(systemLogger) << "create sock fail: " << *addr;
-            return nullptr;
-        }
-        if(!sock->connect(addr.get())) {
-            NEMO_LOG_ERROR(systemLogger) << "sock connect fail: " << *addr;
-            return nullptr;
-        }
+    HttpConnection::UniquePtr connection = connect();
+    if(!connection) {
+        return Lease();
+    }
+    return Lease(this, std::move(connection), false);
+}
+
+void HttpConnectionPool::release(HttpConnection::UniquePtr&& connection) {
+    uint64_t now = nemo::GetCurrentMillionSeconds();
+    if(!isReusable(connection.get(), now, now) || (maxSize_ && idleCount_ >= maxSize_)) {
+        return;
+    }
+    Shard& shard = *shards_[shardIndex()];
+    std::lock_guard<std::mutex> lockGuard(shard.mutex);
+    shard.idle.push_back(IdleConnection{std::move(connection), now});
+    ++idleCount_;
+}
 
-        HttpConnection::UniquePtr newConnection = 
-            std::make_unique<HttpConnection>(std::move(sock));
+void HttpConnectionPool::maintain() {
+    uint64_t now = nemo::GetCurrentMillionSeconds();
+    std::vector<HttpConnection::UniquePtr> expired;
+    for(auto& shard : shards_) {
+        std::lock_guard<std::mutex> lockGuard(shard->mutex);
+        auto& idle = shard->idle;
+        for(auto iter = idle.begin(); iter != idle.end(); ) {
+            if(isReusable(iter->connection.get(), iter->idleSince, now)) {
+                ++iter;
+            } else {
+                expired.push_back(std::move(iter->connection));
+                iter = idle.erase(iter);
+                --idleCount_;
+            }
+        }
+    }
 
-        validConnection = newConnection.get();
-        connections_.emplace_back(std::move(newConnection));
+    uint32_t minIdle = minIdle_;
+    if(maxSize_) {
+        minIdle = std::min(minIdle, maxSize_);
+    }
+    for(size_t i = 0; idleCount_ < minIdle; ++i) {
+        HttpConnection::UniquePtr connection = connect();
+        if(!connection) {
+            break;
+        }
+        //预先建立的连接分散到各个分片
+        Shard& shard = *shards_[i % shards_.size()];
+        std::lock_guard<std::mutex> lockGuard(shard.mutex);
+        shard.idle.push_back(IdleConnection{std::move(connection), now});
+        ++idleCount_;
     }
-    return validConnection;
 }
 
-HttpResult::UniquePtr HttpConnectionPool::doRequest(HttpMethod method, 
-        StringArg uriStr, 
-        uint64_t timeoutMillionSeconds, 
-        const std::map<String, String>& headers, 
+void HttpConnectionPool::startMaintenance(uint32_t intervalMillionSeconds) {
+    std::weak_ptr<HttpConnectionPool> weakPool = shared_from_this();
+    coroutine_async [weakPool, intervalMillionSeconds]() {
+        while(true) {
+            ::usleep(intervalMillionSeconds * 1000);
+            HttpConnectionPool::SharedPtr pool = weakPool.lock();
+            if(!pool) {
+                return;
+            }
+            pool->maintain();
+        }
+    };
+}
+
+HttpRequest::UniquePtr HttpConnectionPool::createRequest(HttpMethod method,
+        StringArg path,
+        const std::map<String, String>& headers,
         StringArg body) {
     HttpRequest::UniquePtr request = std::make_unique<HttpRequest>();
-    request->setPath(uriStr);
+    request->setPath(path);
     request->setMethod(method);
-    request->setClose(true);
+    request->setClose(false);
     bool hasHost = false;
     for(const auto& i : headers) {
-        if(::strncasecmp(i.first.data(), "connection", i.first.size()) == 0) {
-            if(::strncasecmp(i.second.data(), "keep-alive", i.first.size()) == 0) {
-                request->setClose(false);
+        if(::strcasecmp(i.first.data(), "connection") == 0) {
+            if(::strcasecmp(i.second.data(), "close") == 0) {
+                request->setClose(true);
             }
             continue;
         }
 
-        if(!hasHost && ::strncasecmp(i.first.data(), "host", i.first.size()) == 0) {
+        if(!hasHost && ::strcasecmp(i.first.data(), "host") == 0) {
             hasHost = !i.second.empty();
         }
 
         request->setHeader(i.first, i.second);
     }
-    if(!request) {
+    if(!hasHost) {
         if(vhost_.empty()) {
             request->setHeader("Host", host_);
         } else {
@@ -357,6 +526,15 @@ HttpResult::UniquePtr HttpConnectionPool::doRequest(HttpMethod method,
         }
     }
     request->setBody(body);
+    return request;
+}
+
+HttpResult::UniquePtr HttpConnectionPool::doRequest(HttpMethod method, 
+        StringArg uriStr, 
+        uint64_t timeoutMillionSeconds, 
+        const std::map<String, String>& headers, 
+        StringArg body) {
+    HttpRequest::UniquePtr request = createRequest(method, uriStr, headers, body);
     return doRequest(request.get(), timeoutMillionSeconds);
 }
 
@@ -376,26 +554,36 @@ HttpResult::UniquePtr HttpConnectionPool::doRequest(HttpMethod method,
 
 HttpResult::UniquePtr HttpConnectionPool::doRequest(HttpRequest* request, 
                                 uint64_t timeoutMillionSeconds) {
-    HttpConnection* connection = getConnection();
+    Lease connection = acquire();
     if(!connection) {
-        String errMsg = " port:" + LexicalCast<String>(port_);
+        String errMsg = "pool host:" + host_ + " port:" + LexicalCast<String>(port_);
         return std::make_unique<HttpResult>(HttpResult::ErrorCode::POOL_GET_CONNECTION, 
             nullptr, errMsg);
     }
+    return doRequest(connection, request, timeoutMillionSeconds);
+}
+
+HttpResult::UniquePtr HttpConnectionPool::doRequest(Lease& connection,
+                                const HttpRequest* request,
+                                uint64_t timeoutMillionSeconds) {
     Socket* sock = connection->getSocket();
     if(!sock) {
+        connection.discard();
         String errMsg = "pool host:" + host_ + " port:" + LexicalCast<String>(port_);
         return std::make_unique<HttpResult>(HttpResult::ErrorCode::POOL_INVALID_CONNECTION, 
             nullptr, errMsg);
     }
+    String remote = sock->getRemoteAddress()->toString();
     sock->setRecvTimeout(timeoutMillionSeconds);
     int ret = connection->sendRequest(request);
     if(ret == 0) {
-        String errMsg = "send request closed by peer: " + sock->getRemoteAddress()->toString();
+        connection.discard();
+        String errMsg = "send request closed by peer: " + remote;
         return std::make_unique<HttpResult>(HttpResult::ErrorCode::SEND_CLOSE_BY_PEER, 
             nullptr, errMsg);
     }
     if(ret < 0) {
+        connection.discard();
         String errMsg = "send request socket error errno=" + 
                         LexicalCast<String>(errno) + 
                         " errstr=" + String(strerror(errno));
@@ -404,16 +592,99 @@ HttpResult::UniquePtr HttpConnectionPool::doRequest(HttpRequest* request,
     }
     HttpResponse::UniquePtr response = connection->recvResponse();
     if(!response) {
-        String errMsg = "recv response timeout: " + 
-                        sock->getRemoteAddress()->toString() + 
+        connection.discard();
+        String errMsg = "recv response timeout: " + remote + 
                         " timeout_ms:" + std::to_string(timeoutMillionSeconds);
         return std::make_unique<HttpResult>(HttpResult::ErrorCode::TIMEOUT, 
             nullptr, errMsg);
     }
+    ++connection->request_;
+    if(request->isClose() || !IsKeepAlive(response.get())) {
+        connection.discard();
+    } else if(HttpVersion::HTTP11 == response->getVersion()) {
+        //HTTP/1.0的keep-alive服务器不一定能处理流水线请求, 只在HTTP/1.1的持久连接上开启
+        pipelining_ = true;
+    }
 
     return std::make_unique<HttpResult>(HttpResult::ErrorCode::OK, std::move(response), "ok");
 }
 
+std::vector<HttpResult::UniquePtr> HttpConnectionPool::doPipeline(
+        const std::vector<const HttpRequest*>& requests,
+        uint64_t timeoutMillionSeconds) {
+    std::vector<HttpResult::UniquePtr> results(requests.size());
+    size_t next = 0;
+    while(next < requests.size()) {
+        Lease connection = acquire();
+        if(!connection) {
+            for(; next < requests.size(); ++next) {
+                String errMsg = "pool host:" + host_ + " port:" + LexicalCast<String>(port_);
+                results[next] = std::make_unique<HttpResult>(
+                    HttpResult::ErrorCode::POOL_GET_CONNECTION, nullptr, errMsg);
+            }
+            break;
+        }
+
+        //连续的GET请求一起发送, 不超过连接剩余的请求数
+        size_t batch = 1;
+        if(pipelining_ && HttpMethod::GET == requests[next]->getMethod()) {
+            size_t limit = maxRequest_ ? maxRequest_ - connection->request_ : requests.size();
+            while(next + batch < requests.size() && batch < limit &&
+                    HttpMethod::GET == requests[next + batch]->getMethod() &&
+                    !requests[next + batch - 1]->isClose()) {
+                ++batch;
+            }
+        }
+        if(1 == batch) {
+            results[next] = doRequest(connection, requests[next], timeoutMillionSeconds);
+            ++next;
+            continue;
+        }
+
+        Socket* sock = connection->getSocket();
+        sock->setRecvTimeout(timeoutMillionSeconds);
+        String data;
+        for(size_t i = next; i < next + batch; ++i) {
+            data.append(requests[i]->toString());
+        }
+        if(connection->sockStream_->writeFixSize(data.data(), data.size()) <= 0) {
+            //可能是复用的连接已经被对端关闭, 在新连接上单独发送第一个请求
+            connection.discard();
+            pipelining_ = false;
+            continue;
+        }
+        size_t end = next + batch;
+        for(; next < end; ++next) {
+            HttpResponse::UniquePtr response = connection->recvResponse();
+            if(!response) {
+                //第一个响应就失败时报告错误, 否则剩下的请求重新发送
+                connection.discard();
+                if(next + batch == end) {
+                    String errMsg = "recv response timeout: " + sock->getRemoteAddress()->toString()
+                                    + " timeout_ms:" + std::to_string(timeoutMillionSeconds);
+                    results[next++] = std::make_unique<HttpResult>(
+                        HttpResult::ErrorCode::TIMEOUT, nullptr, errMsg);
+                }
+                pipelining_ = false;
+                break;
+            }
+            ++connection->request_;
+            if(HttpVersion::HTTP11 != response->getVersion()) {
+                pipelining_ = false;
+            }
+            bool keepAlive = !requests[next]->isClose() && IsKeepAlive(response.get());
+            results[next] = std::make_unique<HttpResult>(HttpResult::ErrorCode::OK,
+                                std::move(response), "ok");
+            if(!keepAlive) {
+                connection.discard();
+                ++next;
+                break;
+            }
+        }
+    }
+    return results;
+}
+
 } // namespace io
 } // namespace net
 } // namespace nemo
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "net/http/http_header.h"
+
+#include <string.h>
+
+namespace nemo {
+namespace net {
+namespace http {
+
+static const char* headerNames[] = {
+    "",
+#define XX(num, name, string) #string,
+    HTTP_HEADER_MAP(XX)
+#undef XX
+};
+
+namespace {
+
+/**
+ * @brief 忽略大小写的FNV-1a哈希, 字段名中只有字母受大小写影响
+ */
+uint32_t HashHeaderName(StringArg name) {
+    uint32_t hash = 2166136261u;
+    for(char c : name) {
+        hash ^= static_cast<unsigned char>(c) | 0x20;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief 常用字段名到编号的开放寻址哈希表
+ */
+struct HeaderIdTable {
+    constexpr static size_t kSize = 128;
+    uint8_t slots[kSize] = {0};
+
+    HeaderIdTable() {
+        for(size_t id = 1; id < static_cast<size_t>(HttpHeaderId::COUNT); ++id) {
+            size_t slot = HashHeaderName(headerNames[id]) & (kSize - 1);
+            while(slots[slot]) {
+                slot = (slot + 1) & (kSize - 1);
+            }
+            slots[slot] = id;
+        }
+    }
+};
+
+const HeaderIdTable& GetHeaderIdTable() {
+    static HeaderIdTable table;
+    return table;
+}
+
+} // namespace
+
+HttpHeaderId String2HttpHeaderId(StringArg name) {
+    const HeaderIdTable& table = GetHeaderIdTable();
+    size_t slot = HashHeaderName(name) & (HeaderIdTable::kSize - 1);
+    while(uint8_t id = table.slots[slot]) {
+        const char* candidate = headerNames[id];
+        if(::strlen(candidate) == name.size() &&
+            ::strncasecmp(candidate, name.data(), name.size()) == 0) {
+            return static_cast<HttpHeaderId>(id);
+        }
+        slot = (slot + 1) & (HeaderIdTable::kSize - 1);
+    }
+    return HttpHeaderId::UNKNOWN;
+}
+
+const char* HttpHeaderId2String(HttpHeaderId id) {
+    return id < HttpHeaderId::COUNT ? headerNames[static_cast<size_t>(id)] : "";
+}
+
+HttpHeaders::HttpHeaders(std::pmr::memory_resource* resource) :
+    storage_(resource) {
+    ::memset(known_, -1, sizeof(known_));
+}
+
+int HttpHeaders::find(StringArg name, HttpHeaderId id) const {
+    if(id != HttpHeaderId::UNKNOWN) {
+        return known_[static_cast<size_t>(id)];
+    }
+    for(size_t i = 0; i < entries_.size(); ++i) {
+        const Entry& entry = entries_[i];
+        if(entry.id == HttpHeaderId::UNKNOWN && entry.nameLength == name.size() &&
+            ::strncasecmp(storage_.data() + entry.nameOffset, name.data(), name.size()) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+StringArg HttpHeaders::get(StringArg name, StringArg defaultVal) const {
+    int index = find(name, String2HttpHeaderId(name));
+    return index < 0 ? defaultVal : valueOf(entries_[index]);
+}
+
+StringArg HttpHeaders::get(HttpHeaderId id, StringArg defaultVal) const {
+    int index = known_[static_cast<size_t>(id)];
+    return index < 0 ? defaultVal : valueOf(entries_[index]);
+}
+
+bool HttpHeaders::has(StringArg name, StringArg* val) const {
+    int index = find(name, String2HttpHeaderId(name));
+    if(index < 0) {
+        return false;
+    }
+    if(val) {
+        *val = valueOf(entries_[index]);
+    }
+    return true;
+}
+
+uint32_t HttpHeaders::store(StringArg data) {
+    if(storage_.capacity() < 512) { //一次分配足够大部分请求使用的内存
+        storage_.reserve(512);
+    }
+    uint32_t offset = storage_.size();
+    storage_.append(data.data(), data.size());
+    return offset;
+}
+
+void HttpHeaders::set(StringArg name, StringArg value) {
+    if(name.size() > UINT16_MAX) {
+        return;
+    }
+    HttpHeaderId id = String2HttpHeaderId(name);
+    int index = find(name, id);
+    if(index >= 0) {
+        Entry& entry = entries_[index];
+        if(value.size() <= entry.valueCapacity) { //原来的位置放得下就直接覆盖
+            ::memmove(storage_.data() + entry.valueOffset, value.data(), value.size());
+            entry.valueLength = value.size();
+            return;
+        }
+        if(entry.valueOffset + entry.valueCapacity == storage_.size()) { //旧值在末尾, 原地扩展
+            storage_.replace(entry.valueOffset, entry.valueCapacity, value.data(), value.size());
+        } else {
+            uint32_t offset = store(value);
+            release(entry.valueOffset, entry.valueCapacity);
+            entry.valueOffset = offset;
+        }
+        entry.valueLength = value.size();
+        entry.valueCapacity = value.size();
+        compact();
+        return;
+    }
+
+    Entry entry;
+    entry.id = id;
+    entry.nameOffset = store(name);
+    entry.nameLength = name.size();
+    entry.valueOffset = store(value);
+    entry.valueLength = value.size();
+    entry.valueCapacity = value.size();
+    if(id != HttpHeaderId::UNKNOWN) {
+        known_[static_cast<size_t>(id)] = entries_.size();
+    }
+    entries_.push_back(entry);
+}
+
+void HttpHeaders::release(uint32_t offset, uint32_t length) {
+    if(offset + length == storage_.size()) {
+        storage_.resize(offset);
+    } else {
+        holes_ += length;
+    }
+}
+
+void HttpHeaders::compact() {
+    if(holes_ * 2 <= storage_.size()) {
+        return;
+    }
+    std::pmr::string storage(storage_.get_allocator());
+    storage.reserve(storage_.capacity());
+    for(Entry& entry : entries_) {
+        uint32_t nameOffset = storage.size();
+        storage.append(storage_, entry.nameOffset, entry.nameLength);
+        uint32_t valueOffset = storage.size();
+        storage.append(storage_, entry.valueOffset, entry.valueLength);
+        entry.nameOffset = nameOffset;
+        entry.valueOffset = valueOffset;
+        entry.valueCapacity = entry.valueLength;
+    }
+    storage_.swap(storage);
+    holes_ = 0;
+}
+
+void HttpHeaders::eraseAt(int index) {
+    Entry entry = entries_[index];
+    release(entry.valueOffset, entry.valueCapacity);
+    release(entry.nameOffset, entry.nameLength);
+    if(entry.id != HttpHeaderId::UNKNOWN) {
+        known_[static_cast<size_t>(entries_[index].id)] = -1;
+    }
+    entries_.erase(index);
+    for(size_t i = index; i < entries_.size(); ++i) {
+        if(entries_[i].id != HttpHeaderId::UNKNOWN) {
+            known_[static_cast<size_t>(entries_[i].id)] = i;
+        }
+    }
+    compact();
+}
+
+void HttpHeaders::erase(StringArg name) {
+    int index = find(name, String2HttpHeaderId(name));
+    if(index >= 0) {
+        eraseAt(index);
+    }
+}
+
+void HttpHeaders::clear() {
+    storage_.clear();
+    holes_ = 0;
+    entries_.clear();
+    ::memset(known_, -1, sizeof(known_));
+}
+
+HttpHeaders::value_type HttpHeaders::at(size_t index) const {
+    const Entry& entry = entries_[index];
+    return value_type(StringArg(storage_.data() + entry.nameOffset, entry.nameLength),
+                    valueOf(entry));
+}
+
+} // namespace http
+} // namespace net
+} // namespace nemo
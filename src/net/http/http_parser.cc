@@ -32,10 +32,16 @@ static ConfigVar<size_t>* httpResponseMaxBodySizeConfig =
                     static_cast<size_t>(64 * 1024 * 1024), 
                     "http response max body size");
 
+static ConfigVar<String>* httpRequestParserConfig =
+    Config::Lookup("http.request.parser",
+                    String("ragel"),
+                    "http request parser, ragel or simd");
+
 static size_t httpRequestBufferSize = 0;     //request最大大小
 static size_t httpRequestMaxBodySize = 0;    //request body最大大小
 static size_t httpResponseBufferSize = 0;    //response 最大大小
 static size_t httpResponseMaxBodySize = 0;   //response body最大大小
+static bool httpRequestSimdParser = false;   //是否使用SIMD解析request
 
 size_t HttpRequestParser::GetHttpRequestBufferSize() {
     return httpRequestBufferSize;
@@ -45,6 +51,10 @@ size_t HttpRequestParser::GetHttpRequestMaxBodySize() {
     return httpRequestMaxBodySize;
 }
 
+bool HttpRequestParser::IsSimdParserEnabled() {
+    return httpRequestSimdParser;
+}
+
 size_t HttpResponseParser::GetHttpResponseBufferSize() {
     return httpResponseBufferSize;
 }
@@ -61,6 +71,7 @@ struct RequestSizeIniter {
         httpRequestMaxBodySize = httpRequestMaxBodySizeConfig->getValue();
         httpResponseBufferSize = httpResponseBufferSizeConfig->getValue();
         httpResponseMaxBodySize = httpResponseMaxBodySizeConfig->getValue();
+        httpRequestSimdParser = httpRequestParserConfig->getValue() == "simd";
 
         httpRequestBufferSizeConfig->addListener([](const size_t& oldVal, const size_t& newVal) {
             static_cast<void>(oldVal);
@@ -81,6 +92,11 @@ struct RequestSizeIniter {
             static_cast<void>(oldVal);
             httpResponseMaxBodySize = newVal;
         });
+
+        httpRequestParserConfig->addListener([](const String& oldVal, const String& newVal) {
+            static_cast<void>(oldVal);
+            httpRequestSimdParser = newVal == "simd";
+        });
     }
 };
 
@@ -157,13 +173,15 @@ static void OnRequestHttpField(void *data, const char *field, size_t flen
         //parser->setError(1002);
         return;
     }
-    parser->getRequest()->setHeader(String(field, flen),
-        String(value, vlen));
+    parser->getRequest()->setHeader(StringArg(field, flen),
+        StringArg(value, vlen));
 }
 
 HttpRequestParser::HttpRequestParser() :
     request_(std::make_unique<HttpRequest>()),
-    error_(HttpParserError::OK) {
+    error_(HttpParserError::OK),
+    simd_(httpRequestSimdParser),
+    simdFinished_(false) {
     http_parser_init(&parser_);
     parser_.request_method = OnRequestMethod;
     parser_.request_uri = OnRequestUri;
@@ -176,6 +194,18 @@ HttpRequestParser::HttpRequestParser() :
     parser_.data = this;
 }
 
+void HttpRequestParser::reset(std::pmr::memory_resource* resource) {
+    http_parser_init(&parser_);
+    error_ = HttpParserError::OK;
+    simd_ = httpRequestSimdParser;
+    simdFinished_ = false;
+    if(request_ && request_->getResource() == resource) {
+        *request_ = HttpRequest(HttpVersion::HTTP11, true, resource);
+    } else {
+        request_ = std::make_unique<HttpRequest>(HttpVersion::HTTP11, true, resource);
+    }
+}
+
 uint64_t HttpRequestParser::getContentLength() {
     return request_->getHeaderAs<size_t>("content-length", 0);
 }
@@ -184,14 +214,49 @@ uint64_t HttpRequestParser::getContentLength() {
 //-1: 有错误
 //>0: 已处理的字节数，且data有效数据为len - v;
 size_t HttpRequestParser::execute(char* data, size_t len) {
+    if(simd_) {
+        return executeSimd(data, len);
+    }
     size_t offset = http_parser_execute(&parser_, data, len, 0);
     //把已经解析的覆盖掉，这样下次继续解析的时候传data就行了，不必传data + offset
     ::memmove(data, data + offset, (len - offset));
     return offset;
 }
 
+size_t HttpRequestParser::executeSimd(char* data, size_t len) {
+    int offset = ParseHttpRequest(data, len, slices_);
+    if(-2 == offset) { //头部不完整, 等待更多数据
+        return 0;
+    } else if(offset < 0) {
+        NEMO_LOG_WARN(systemLogger) << "invalid http request: "
+            << StringArg(data, std::min<size_t>(len, 64));
+        error_ = HttpParserError::INVALID_FIELD;
+        return 0;
+    }
+
+    OnRequestMethod(this, slices_.method.data(), slices_.method.size());
+    if(slices_.minorVersion > 1) {
+        NEMO_LOG_WARN(systemLogger) << "invalid http request version: HTTP/1."
+            << slices_.minorVersion;
+        error_ = HttpParserError::INVALID_VERSION;
+        return 0;
+    }
+    request_->setVersion(slices_.minorVersion == 1 ? HttpVersion::HTTP11 : HttpVersion::HTTP10);
+    request_->setPath(slices_.path);
+    request_->setQuery(slices_.query);
+    request_->setFragment(slices_.fragment);
+    for(size_t i = 0; i < slices_.headerCount; ++i) {
+        const HttpHeaderSlice& header = slices_.headers[i];
+        request_->setHeader(header.name, header.value);
+    }
+    simdFinished_ = true;
+
+    ::memmove(data, data + offset, (len - offset));
+    return offset;
+}
+
 int HttpRequestParser::isFinished() {
-    return http_parser_finish(&parser_);
+    return simd_ ? simdFinished_ : http_parser_finish(&parser_);
 }
 
 static void OnResponseReason(void *data, const char *at, size_t length) {
@@ -248,8 +313,8 @@ static void OnResponseHttpField(void *data, const char *field, size_t flen
         NEMO_LOG_WARN(systemLogger) << "invalid http response field length == 0";
         return;
     }
-    parser->getResponse()->setHeader(String(field, flen),
-        String(value, vlen));
+    parser->getResponse()->setHeader(StringArg(field, flen),
+        StringArg(value, vlen));
 }
 
 HttpResponseParser::HttpResponseParser() :
@@ -0,0 +1,320 @@
+#include "net/http/http_router.h"
+
+#include <string.h>
+
+#include "net/http/servlet.h"
+#include "log/log.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+/**
+ * @brief 路由树节点
+ * @details 静态子节点按前缀首字符索引, 每个节点最多一个参数子节点和一个通配子节点
+ */
+struct HttpRouter::Node {
+    String prefix;                                          ///< 静态节点为边上的字符串, 参数/通配节点为名称
+    String indices;                                         ///< 静态子节点前缀的首字符, 与children一一对应
+    std::vector<std::unique_ptr<Node>> children;            ///< 静态子节点
+    std::unique_ptr<Node> paramChild;                       ///< 参数子节点
+    std::unique_ptr<Node> wildcardChild;                    ///< 通配子节点
+    std::vector<std::pair<HttpMethod, Handler>> handlers;   ///< 在该节点结束的路由
+
+    /**
+     * @brief 查找处理器, 优先相同方法, 其次kAnyMethod
+     */
+    IServletCreator* getHandler(HttpMethod method) const {
+        IServletCreator* any = nullptr;
+        for(const auto& handler : handlers) {
+            if(handler.first == method) {
+                return handler.second.get();
+            }
+            if(handler.first == kAnyMethod) {
+                any = handler.second.get();
+            }
+        }
+        return any;
+    }
+
+    /**
+     * @brief 深拷贝整棵子树
+     */
+    std::unique_ptr<Node> clone() const {
+        auto node = std::make_unique<Node>();
+        node->prefix = prefix;
+        node->indices = indices;
+        node->children.reserve(children.size());
+        for(const auto& child : children) {
+            node->children.push_back(child->clone());
+        }
+        if(paramChild) {
+            node->paramChild = paramChild->clone();
+        }
+        if(wildcardChild) {
+            node->wildcardChild = wildcardChild->clone();
+        }
+        node->handlers = handlers;
+        return node;
+    }
+};
+
+HttpRouter::HttpRouter() :
+    root_(std::make_unique<Node>()),
+    size_(0) {
+}
+
+HttpRouter::HttpRouter(const HttpRouter& other) :
+    root_(other.root_->clone()),
+    size_(other.size_) {
+}
+
+HttpRouter::~HttpRouter() = default;
+
+HttpRouter::Node* HttpRouter::insertStatic(Node* node, StringArg s) {
+    while(!s.empty()) {
+        size_t idx = node->indices.find(s[0]);
+        if(String::npos == idx) {
+            auto child = std::make_unique<Node>();
+            child->prefix = s;
+            node->indices.push_back(s[0]);
+            node->children.push_back(std::move(child));
+            return node->children.back().get();
+        }
+
+        Node* child = node->children[idx].get();
+        size_t common = 0;
+        size_t limit = std::min(child->prefix.size(), s.size());
+        while(common < limit && child->prefix[common] == s[common]) {
+            ++common;
+        }
+        if(common < child->prefix.size()) { //拆分公共前缀, 原来的节点挂到新节点下面
+            auto middle = std::make_unique<Node>();
+            middle->prefix = child->prefix.substr(0, common);
+            child->prefix.erase(0, common);
+            middle->indices.push_back(child->prefix[0]);
+            middle->children.push_back(std::move(node->children[idx]));
+            node->children[idx] = std::move(middle);
+            child = node->children[idx].get();
+        }
+        s.remove_prefix(common);
+        node = child;
+    }
+    return node;
+}
+
+HttpRouter::Node* HttpRouter::findStatic(Node* node, StringArg s) {
+    while(!s.empty()) {
+        size_t idx = node->indices.find(s[0]);
+        if(String::npos == idx) {
+            return nullptr;
+        }
+        Node* child = node->children[idx].get();
+        if(s.size() < child->prefix.size() ||
+            s.compare(0, child->prefix.size(), child->prefix) != 0) {
+            return nullptr;
+        }
+        s.remove_prefix(child->prefix.size());
+        node = child;
+    }
+    return node;
+}
+
+HttpRouter::Node* HttpRouter::locate(StringArg pattern, bool create) {
+    Node* node = root_.get();
+    size_t pos = 0;
+    while(node && pos < pattern.size()) {
+        char c = pattern[pos];
+        if(':' == c || '*' == c) {
+            //参数片段必须从'/'之后开始, 通配片段必须在末尾
+            size_t end = ':' == c ? pattern.find('/', pos) : pattern.size();
+            if(String::npos == end) {
+                end = pattern.size();
+            }
+            StringArg name = pattern.substr(pos + 1, end - pos - 1);
+            if((':' == c && (name.empty() || 0 == pos || pattern[pos - 1] != '/')) ||
+                String::npos != name.find_first_of(":*/")) {
+                return nullptr;
+            }
+            std::unique_ptr<Node>& child = ':' == c ? node->paramChild : node->wildcardChild;
+            if(!child) {
+                if(!create) {
+                    return nullptr;
+                }
+                child = std::make_unique<Node>();
+                child->prefix = name;
+            } else if(child->prefix != name) { //同一位置只能有一个名称
+                return nullptr;
+            }
+            node = child.get();
+            pos = end;
+        } else {
+            size_t end = pattern.find_first_of(":*", pos);
+            if(String::npos == end) {
+                end = pattern.size();
+            }
+            StringArg s = pattern.substr(pos, end - pos);
+            node = create ? insertStatic(node, s) : findStatic(node, s);
+            pos = end;
+        }
+    }
+    return node;
+}
+
+bool HttpRouter::add(HttpMethod method, StringArg pattern, Handler&& handler) {
+    Node* node = locate(pattern, true);
+    if(!node) {
+        NEMO_LOG_ERROR(systemLogger) << "invalid or conflicting route pattern: " << pattern
+            << " method=" << HttpMethod2String(method);
+        return false;
+    }
+    for(auto& item : node->handlers) {
+        if(item.first == method) {
+            item.second = std::move(handler);
+            return true;
+        }
+    }
+    node->handlers.emplace_back(method, std::move(handler));
+    ++size_;
+    return true;
+}
+
+bool HttpRouter::remove(HttpMethod method, StringArg pattern) {
+    //空节点不回收, 匹配时没有处理器的节点不会命中
+    Node* node = locate(pattern, false);
+    if(!node) {
+        return false;
+    }
+    for(auto iter = node->handlers.begin(); iter != node->handlers.end(); ++iter) {
+        if(iter->first == method) {
+            node->handlers.erase(iter);
+            --size_;
+            return true;
+        }
+    }
+    return false;
+}
+
+IServletCreator* HttpRouter::find(HttpMethod method, StringArg pattern) const {
+    Node* node = const_cast<HttpRouter*>(this)->locate(pattern, false);
+    if(!node) {
+        return nullptr;
+    }
+    for(const auto& item : node->handlers) {
+        if(item.first == method) {
+            return item.second.get();
+        }
+    }
+    return nullptr;
+}
+
+const HttpRouter::Node* HttpRouter::matchNode(const Node* node, HttpMethod method,
+                                            StringArg path, Params* params) {
+    if(path.empty()) {
+        if(node->getHandler(method)) {
+            return node;
+        }
+    } else {
+        //1. 静态片段
+        size_t idx = node->indices.find(path[0]);
+        if(String::npos != idx) {
+            const Node* child = node->children[idx].get();
+            if(path.size() >= child->prefix.size() &&
+                ::memcmp(path.data(), child->prefix.data(), child->prefix.size()) == 0) {
+                const Node* result = matchNode(child, method,
+                                        path.substr(child->prefix.size()), params);
+                if(result) {
+                    return result;
+                }
+            }
+        }
+
+        //2. 参数片段
+        if(node->paramChild) {
+            StringArg value = path.substr(0, path.find('/'));
+            if(!value.empty()) {
+                size_t count = params ? params->size() : 0;
+                if(params) {
+                    params->push_back(Param{node->paramChild->prefix, value});
+                }
+                const Node* result = matchNode(node->paramChild.get(), method,
+                                        path.substr(value.size()), params);
+                if(result) {
+                    return result;
+                }
+                while(params && params->size() > count) {
+                    params->pop_back();
+                }
+            }
+        }
+    }
+
+    //3. 通配片段
+    const Node* wildcard = node->wildcardChild.get();
+    if(wildcard && wildcard->getHandler(method)) {
+        if(params && !wildcard->prefix.empty()) {
+            params->push_back(Param{wildcard->prefix, path});
+        }
+        return wildcard;
+    }
+    return nullptr;
+}
+
+IServletCreator* HttpRouter::match(HttpMethod method, StringArg path, Params* params) const {
+    const Node* node = matchNode(root_.get(), method, path, params);
+    return node ? node->getHandler(method) : nullptr;
+}
+
+String HttpRouter::getAllowedMethods(StringArg path) const {
+    String allow;
+    for(int8_t i = 0; i < static_cast<int8_t>(HttpMethod::INVALID_METHOD); ++i) {
+        HttpMethod method = static_cast<HttpMethod>(i);
+        if(matchNode(root_.get(), method, path, nullptr)) {
+            if(!allow.empty()) {
+                allow.append(", ");
+            }
+            allow.append(HttpMethod2String(method));
+        }
+    }
+    return allow;
+}
+
+void HttpRouter::forEach(const std::function<void(HttpMethod method, StringArg pattern,
+                                                  Handler& handler)>& cb) {
+    String pattern;
+    forEachNode(root_.get(), pattern, cb);
+}
+
+void HttpRouter::forEachNode(Node* node, String& pattern,
+        const std::function<void(HttpMethod method, StringArg pattern, Handler& handler)>& cb) {
+    for(auto& handler : node->handlers) {
+        cb(handler.first, pattern, handler.second);
+    }
+    size_t size = pattern.size();
+    for(auto& child : node->children) {
+        pattern.append(child->prefix);
+        forEachNode(child.get(), pattern, cb);
+        pattern.resize(size);
+    }
+    if(node->paramChild) {
+        pattern.append(":").append(node->paramChild->prefix);
+        forEachNode(node->paramChild.get(), pattern, cb);
+        pattern.resize(size);
+    }
+    if(node->wildcardChild) {
+        pattern.append("*").append(node->wildcardChild->prefix);
+        forEachNode(node->wildcardChild.get(), pattern, cb);
+        pattern.resize(size);
+    }
+}
+
+void HttpRouter::clear() {
+    root_ = std::make_unique<Node>();
+    size_ = 0;
+}
+
+} // namespace http
+} // namespace net
+} // namespace nemo
@@ -1,5 +1,13 @@
 #include "net/http/http_server.h"
 
+#include <string.h>
+
+#include <optional>
+
+
+#include "net/http/http2_session.h"
+#include "net/http/http_compress.h"
+#include "net/io/hook.h"
 #include "log/log.h"
 #include "common/macro.h"
 
@@ -15,32 +23,186 @@ HttpServer::HttpServer(bool keepalive,
         const coroutine::Scheduler::SharedPtr&  handleScheduler) :
     TcpServer(ioScheduler, acceptScheduler, handleScheduler),
     dispatcher_(std::make_unique<ServletDispatcher>()),
+    rateLimiter_(HttpRateLimiter::Create()),
     keepalive_(keepalive) {
     config_->type = "http";
+    if(Http2Session::IsEnabled()) {
+        setAlpnProtocols({"h2", "http/1.1"});
+    }
+    if(HttpResponseCache::IsEnabled()) {
+        cache_ = std::make_shared<HttpResponseCache>(handleScheduler_.get());
+    }
+}
+
+/**
+ * @brief socket是否已经有可读的数据, 不阻塞
+ */
+static bool HasPendingData(Socket* sock) {
+    char c;
+    return recv_f(sock->getSocketFd(), &c, sizeof(c), MSG_PEEK | MSG_DONTWAIT) > 0;
+}
+
+bool HttpServer::upgradeHttp2(Socket::SharedPtr client, HttpSession* session,
+                              HttpRequest* request) {
+    String settings;
+    if(dynamic_cast<SecureSocket*>(client.get()) ||
+        !HasHeaderToken(request->getHeader(HttpHeaderId::UPGRADE), "h2c") ||
+        !Http2Session::DecodeSettingsHeader(request->getHeader("HTTP2-Settings"), settings)) {
+        return false;
+    }
+    if(session->readBody(request) < 0) {
+        return true;
+    }
+
+    HttpResponse response(HttpVersion::HTTP11, false);
+    response.setHeader("Connection", "Upgrade");
+    response.setHeader("Upgrade", "h2c");
+    if(session->switchProtocol(&response)) {
+        auto http2 = std::make_shared<Http2Session>(client, dispatcher_.get(),
+                                                    handleScheduler_.get(), getName());
+        http2->setResponseCache(cache_);
+        http2->setRateLimiter(rateLimiter_);
+        http2->runUpgrade(request, settings, session->getBufferedData());
+    }
+    return true;
+}
+
+bool HttpServer::rejectRequest(Socket* client, HttpSession* session, HttpRequest* request,
+                               bool& close) {
+    uint32_t retryAfter = 0;
+    if(!rateLimiter_ || rateLimiter_->allow(request, client->getRemoteAddress(), &retryAfter)) {
+        return false;
+    }
+    //被拒绝的请求不读取消息体, 带有消息体时发送响应后关闭连接
+    StringArg contentLength = request->getHeader(HttpHeaderId::CONTENT_LENGTH);
+    bool hasBody = request->getHeaders().has(HttpHeaderId::TRANSFER_ENCODING) ||
+                   (!contentLength.empty() && contentLength != "0");
+    close = request->isClose() || !keepalive_ || hasBody;
+    HttpResponse response(request->getVersion(), close);
+    response.setStatus(HttpStatus::TOO_MANY_REQUESTS);
+    response.setHeader("Server", getName());
+    response.setHeader("Retry-After", std::to_string(retryAfter));
+    session->sendResponse(&response);
+    NEMO_LOG_DEBUG(systemLogger) << "rate limited " << request->getPath()
+        << " client:" << *client << " retry_after=" << retryAfter;
+    return true;
 }
 
 void HttpServer::handleClient(Socket::SharedPtr client) {
     NEMO_LOG_DEBUG(systemLogger) << "handleClient " << *client;
     HttpSession::UniquePtr session = std::make_unique<HttpSession>(client.get());
+    //从线程缓存中借用已经注册的读者, 停放的连接被唤醒时不需要重新注册
+    EpochDomain::ReaderLease routeReader(dispatcher_->getEpochDomain());
+    ConnectionPtr connection = getConnection(client.get());
+    if(Http2Session::IsEnabled()) {
+        //TLS上通过ALPN协商, 明文连接上客户端可以直接发送连接前言(prior knowledge)
+        SecureSocket* secure = dynamic_cast<SecureSocket*>(client.get());
+        if(secure && !secure->handshake()) {
+            NEMO_LOG_DEBUG(systemLogger) << "tls handshake fail " << *client;
+            return;
+        }
+        if(secure ? secure->getAlpnProtocol() == "h2" : session->isHttp2Preface()) {
+            auto http2 = std::make_shared<Http2Session>(client, dispatcher_.get(),
+                                                        handleScheduler_.get(), getName());
+            http2->setResponseCache(cache_);
+            http2->setRateLimiter(rateLimiter_);
+            if(connection) { //优雅关闭时发送GOAWAY, 已经打开的流处理完后关闭连接
+                setDrainCallback(connection, [http2]() {
+                    http2->shutdown();
+                });
+            }
+            http2->run(session->getBufferedData());
+            return;
+        }
+    }
+    if(connection) { //websocket等长时间占用连接的servlet通过会话注册排空回调
+        session->setDrainRegistrar([this, connection](HttpSession::DrainCallback callback) {
+            setDrainCallback(connection, std::move(callback));
+        });
+    }
+    bool served = false;
     do {
-        HttpRequest::UniquePtr request = session->recvRequest();
+        //先标记空闲再检查是否正在关闭, 与drain()的顺序相反, 两边至少有一方能看到对方.
+        //已经收到的流水线请求仍然处理, 最后一个响应带上Connection: close
+        if(connection) {
+            connection->idle = true;
+            if(isDraining() && !session->hasPendingRequest()) {
+                break;
+            }
+            //下一个请求还没有到达时结束协程, 由reactor等待数据
+            if(served && canPark() && session->getBufferedData().empty() &&
+                !dynamic_cast<SecureSocket*>(client.get()) && !HasPendingData(client.get())) {
+                connection->parkOnReturn = true;
+                break;
+            }
+        }
+        HttpRequest::UniquePtr request = session->recvRequestHeader();
+        if(connection) {
+            connection->idle = false;
+        }
         if(!request) {
             NEMO_LOG_WARN(systemLogger) << "recv http request fail, errno="
                 << errno << " errstr=" << strerror(errno)
                 << " cliet:" << *client << " keep_alive=" << keepalive_;
             break;
         }
+        bool close = false;
+        if(rejectRequest(client.get(), session.get(), request.get(), close)) {
+            //没有读取的消息体留在连接上, 不能当作下一个请求解析
+            if(close || !client->isConnect()) {
+                break;
+            }
+            served = true;
+            continue;
+        }
+        if(request->getHeaders().has(HttpHeaderId::UPGRADE) && Http2Session::IsEnabled() &&
+            upgradeHttp2(client, session.get(), request.get())) {
+            break;
+        }
+
+        //servlet在临界区内执行, 每个请求进出临界区都没有原子读改写操作.
+        //流式servlet(websocket等)可能长时间占用连接, 持有引用后离开临界区, 不阻止旧路由表的回收
+        std::optional<EpochDomain::Guard> routeGuard(std::in_place, routeReader.get());
+        HttpServlet* servlet = dispatcher_->route(request.get());
+        HttpServlet::SharedPtr holder;
+        if(servlet->isStreamBody()) {
+            holder = servlet->shared_from_this();
+            routeGuard.reset();
+        }
+        //流式servlet自己读取消息体, 其余的servlet在处理前读取完整的消息体
+        if(!servlet->isStreamBody() && session->readBody(request.get()) < 0) {
+            NEMO_LOG_WARN(systemLogger) << "recv http body fail, errno="
+                << errno << " errstr=" << strerror(errno)
+                << " cliet:" << *client;
+            break;
+        }
 
         HttpResponse::UniquePtr response = std::make_unique<HttpResponse>(request->getVersion(),
-                        request->isClose() || !keepalive_);
+                        request->isClose() || !keepalive_, session->getResource());
         response->setHeader("Server", getName());
-        dispatcher_->handle(request.get(), response.get(), session.get());
+        if(cache_) {
+            cache_->handle(dispatcher_.get(), servlet, request.get(), response.get(), session.get());
+        } else {
+            servlet->handle(request.get(), response.get(), session.get());
+        }
+        routeGuard.reset();
+        if(session->isUpgraded()) { //servlet已经把连接切换到其它协议(websocket)并处理完
+            break;
+        }
+        //处理请求期间开始优雅关闭, 通知客户端不要在这个连接上继续发送请求
+        if(isDraining() && !session->hasPendingRequest()) {
+            response->setClose(true);
+        }
+        HttpCompression::Apply(session->getContentCoding(), response.get());
         session->sendResponse(response.get());
+        served = true;
 
-        if(!keepalive_ || request->isClose() || !client->isConnect()) {
+        if(!keepalive_ || request->isClose() || response->isClose() || !client->isConnect()) {
             break;
         }
     } while(true);
+    //流水线请求的响应可能还缓存在会话中, 退出前发送
+    session->flush();
 }
 
 } // namespace http
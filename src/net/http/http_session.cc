@@ -1,77 +1,318 @@
 #include "net/http/http_session.h"
 
-#include "net/http/http_parser.h"
-#include "container/buffer.h"
+#include "net/http/http2.h"
 
 namespace nemo {
 namespace net {
 namespace http {
 
+/**
+ * @brief 检查data中是否已经包含完整的头部(以空行结束)
+ * @param[in] data 数据
+ * @param[in] len 数据长度
+ * @param[in, out] scanned 已经检查过的字节数, 避免重复扫描
+ */
+static bool HasHeaderEnd(const char* data, size_t len, size_t& scanned) {
+    size_t pos = scanned > 3 ? scanned - 3 : 0;
+    scanned = len;
+    while(pos < len) {
+        const char* lf = static_cast<const char*>(::memchr(data + pos, '\n', len - pos));
+        if(!lf) {
+            return false;
+        }
+        size_t idx = lf - data;
+        if(idx >= 1 && data[idx - 1] == '\n') {
+            return true;
+        }
+        if(idx >= 2 && data[idx - 1] == '\r' && data[idx - 2] == '\n') {
+            return true;
+        }
+        pos = idx + 1;
+    }
+    return false;
+}
+
 HttpSession::HttpSession(Socket* sock) :
-    sockStream_(std::make_unique<io::SocketStream>(sock)) {
+    sockStream_(std::make_unique<io::SocketStream>(sock)),
+    parser_(std::make_unique<HttpRequestParser>()),
+    readBuffer_(HttpRequestParser::GetHttpRequestBufferSize(), true),
+    bodyReader_(this),
+    bodyWriter_(this) {
+    initPeerCredentials();
 }
 
 HttpSession::HttpSession(Socket::UniquePtr&& sock) :
-    sockStream_(std::make_unique<io::SocketStream>(std::move(sock))) {
+    sockStream_(std::make_unique<io::SocketStream>(std::move(sock))),
+    parser_(std::make_unique<HttpRequestParser>()),
+    readBuffer_(HttpRequestParser::GetHttpRequestBufferSize(), true),
+    bodyReader_(this),
+    bodyWriter_(this) {
+    initPeerCredentials();
 }
 
-HttpRequest::UniquePtr HttpSession::recvRequest() {
-    HttpRequestParser::UniquePtr parser = std::make_unique<HttpRequestParser>();
-    const size_t buffSize = HttpRequestParser::GetHttpRequestBufferSize();
-    Buffer buffer(buffSize, true);
-    char* data = buffer.data();
-    off_t offset = 0;
-
-    do {
-        int len = sockStream_->read(data + offset, buffSize - offset);
-        if(len <= 0) {
-            sockStream_->close();
-            return nullptr;
+HttpSession::HttpSession() :
+    HttpSession(static_cast<Socket*>(nullptr)) {
+}
+
+void HttpSession::initPeerCredentials() {
+    PeerCredentials credentials;
+    Socket* sock = sockStream_->getSocket();
+    if(sock && sock->getPeerCredentials(credentials)) {
+        peerCredentials_ = credentials;
+    }
+}
+
+void HttpSession::consume(size_t n) {
+    size_t left = readBuffer_.size() - n;
+    if(left > 0) {
+        ::memmove(readBuffer_.data(), readBuffer_.data() + n, left);
+    }
+    readBuffer_.resize(left);
+}
+
+void HttpSession::close() {
+    flush();
+    sockStream_->close();
+}
+
+int HttpSession::fill() {
+    if(readBuffer_.filled()) {
+        return -1;
+    }
+    //阻塞读取之前先发送缓存的响应, 客户端可能要收到响应才会发送剩下的数据
+    if(!writeBuffer_.empty() && flush() <= 0) {
+        return -1;
+    }
+    int len = sockStream_->read(readBuffer_.current(), readBuffer_.avail());
+    if(len > 0) {
+        readBuffer_.seek(len);
+    }
+    return len;
+}
+
+ssize_t HttpSession::readSome(void* buff, size_t len) {
+    if(readBuffer_.empty()) { //缓冲区为空时直接读到调用者的内存中, 避免多拷贝一次
+        if(!writeBuffer_.empty() && flush() <= 0) {
+            return -1;
         }
-        len += offset; //因为上一次可能没解析完，所以要加上上一次的offset
-        size_t nparse = parser->execute(data, len);
-        if(parser->hasError()) {
-            sockStream_->close();
-            return nullptr;
+        return sockStream_->read(buff, len);
+    }
+    len = std::min(len, readBuffer_.size());
+    ::memcpy(buff, readBuffer_.data(), len);
+    consume(len);
+    return len;
+}
+
+int HttpSession::readLine(String& line) {
+    size_t scanned = 0;
+    while(true) {
+        const char* lf = static_cast<const char*>(::memchr(readBuffer_.data() + scanned,
+                    '\n', readBuffer_.size() - scanned));
+        if(lf) {
+            size_t n = lf - readBuffer_.data();
+            line.assign(readBuffer_.data(), (n > 0 && lf[-1] == '\r') ? n - 1 : n);
+            consume(n + 1);
+            return line.size();
         }
-        offset = len - nparse; //剩余未解析的
-        if(offset == (int)buffSize) { //根本就没有解析
-            sockStream_->close();
-            return nullptr;
+        scanned = readBuffer_.size();
+        if(fill() <= 0) {
+            return -1;
+        }
+    }
+}
+
+int HttpSession::skip(size_t n) {
+    if(readBuffer_.empty() && fill() <= 0) {
+        return -1;
+    }
+    n = std::min(n, readBuffer_.size());
+    consume(n);
+    return n;
+}
+
+ssize_t HttpSession::write(const void* data, size_t len) {
+    if(writeBuffer_.size() + len <= kMaxPendingResponseBytes) {
+        writeBuffer_.append(static_cast<const char*>(data), len);
+        return len;
+    }
+    //大块数据不经过缓冲区, 协程会阻塞到数据写入socket为止
+    if(flush() < 0) {
+        return -1;
+    }
+    //writeFixSize返回int, 分段写入避免长度溢出
+    const char* p = static_cast<const char*>(data);
+    for(size_t offset = 0; offset < len; offset += kMaxWriteSize) {
+        if(sockStream_->writeFixSize(p + offset, std::min(len - offset, kMaxWriteSize)) <= 0) {
+            return -1;
+        }
+    }
+    return len;
+}
+
+int64_t HttpSession::sendFile(int fd, off_t offset, size_t length) {
+    if(flush() < 0) {
+        return -1;
+    }
+    Socket* sock = sockStream_->getSocket();
+    if(!sock) {
+        return -1;
+    }
+    size_t sent = 0;
+    while(sent < length) {
+        int64_t n = sock->sendFile(fd, offset + sent, length - sent);
+        if(n <= 0) { //文件比length短时也作为失败, 否则会破坏消息体的长度
+            return -1;
         }
-        if(parser->isFinished()) {
+        sent += n;
+    }
+    return sent;
+}
+
+HttpRequest::UniquePtr HttpSession::recvRequestHeader() {
+    //servlet没有读完的消息体要先丢弃掉, 才能读到下一个请求
+    if(!bodyReader_.isFinished() && bodyReader_.discard() < 0) {
+        close();
+        return nullptr;
+    }
+    bodyWriter_.reset(nullptr);
+    //上一个请求已经析构(包括解析器内部的), 内存池可以整体释放
+    parser_->request_.reset();
+    arena_.reset();
+    parser_->reset(&arena_);
+
+    //RFC 7230 3.5: 忽略请求行之前的空行, 例如客户端在消息体之后多发送的CRLF
+    while(true) {
+        size_t blank = 0;
+        while(blank < readBuffer_.size() && ('\r' == readBuffer_.data()[blank] ||
+                    '\n' == readBuffer_.data()[blank])) {
+            ++blank;
+        }
+        consume(blank);
+        if(!readBuffer_.empty()) {
             break;
         }
-    } while(true);
-    
-    int64_t bodyLen = parser->getContentLength();
-    if(bodyLen > 0) {
-        String body;
-        body.resize(bodyLen);
+        if(fill() <= 0) {
+            close();
+            return nullptr;
+        }
+    }
 
-        int64_t len = std::min(static_cast<int64_t>(offset), bodyLen);
-        //把data里剩余的数据拷贝到body中
-        ::memcpy(body.data(), data, len);
-        bodyLen -= offset;
-        if(bodyLen > 0) { //证明在read的时候并没有读取到所有数据
-            if(sockStream_->readFixSize(&body[len], bodyLen) <= 0) { //把剩余的数据读取出来
-                sockStream_->close();
-                return nullptr;
-            }
+    //先确认头部已经完整, 再交给解析器一次性解析
+    size_t scanned = 0;
+    while(!HasHeaderEnd(readBuffer_.data(), readBuffer_.size(), scanned)) {
+        if(fill() <= 0) { //头部超过了缓冲区大小或者连接关闭
+            close();
+            return nullptr;
         }
-        parser->getRequest()->setBody(std::move(body));
     }
 
-    parser->getRequest()->init();
-    HttpRequest::UniquePtr request = std::move(parser->request_);
+    //execute会把已解析的数据移除, 剩下的是消息体和后续的流水线请求
+    size_t nparse = parser_->execute(readBuffer_.data(), readBuffer_.size());
+    readBuffer_.resize(readBuffer_.size() - nparse);
+    if(parser_->hasError() || !parser_->isFinished()) {
+        close();
+        return nullptr;
+    }
+
+    HttpRequest* request = parser_->getRequest();
+    if(!bodyReader_.reset(request)) {
+        close();
+        return nullptr;
+    }
+    request->init();
+    if(peerCredentials_) {
+        request->setPeerCredentials(*peerCredentials_);
+    }
+    coding_ = HttpCompression::IsEnabled() ?
+        NegotiateContentCoding(request->getHeader(HttpHeaderId::ACCEPT_ENCODING)) :
+        HttpContentCoding::IDENTITY;
+    return std::move(parser_->request_);
+}
+
+int HttpSession::readBody(HttpRequest* request) {
+    String body;
+    if(bodyReader_.readAll(body, HttpRequestParser::GetHttpRequestMaxBodySize()) < 0) {
+        close();
+        return -1;
+    }
+    int len = body.size();
+    request->setBody(std::move(body));
+    return len;
+}
+
+HttpRequest::UniquePtr HttpSession::recvRequest() {
+    HttpRequest::UniquePtr request = recvRequestHeader();
+    if(request && readBody(request.get()) < 0) {
+        return nullptr;
+    }
     return request;
 }
 
+bool HttpSession::isHttp2Preface() {
+    while(true) {
+        size_t len = std::min(readBuffer_.size(), kHttp2Preface.size());
+        if(::memcmp(readBuffer_.data(), kHttp2Preface.data(), len) != 0) {
+            return false;
+        }
+        if(len == kHttp2Preface.size()) {
+            return true;
+        }
+        if(fill() <= 0) {
+            return false;
+        }
+    }
+}
+
+bool HttpSession::switchProtocol(const HttpResponse* response) {
+    String out = "HTTP/1.1 101 Switching Protocols\r\n";
+    for(const auto& header : response->getHeaders()) {
+        out.append(header.first).append(": ").append(header.second).append("\r\n");
+    }
+    out.append("\r\n");
+    upgraded_ = true;
+    bool result = flush() >= 0 && sockStream_->writeFixSize(out.data(), out.size()) > 0;
+    String().swap(writeBuffer_); //新协议不再使用发送缓冲区
+    return result;
+}
+
+HttpBodyWriter* HttpSession::getBodyWriter(HttpResponse* response) {
+    if(!bodyWriter_.isStreaming()) {
+        bodyWriter_.reset(response);
+    }
+    return &bodyWriter_;
+}
+
 int HttpSession::sendResponse(const HttpResponse* response) {
-    String msg = response->toString();
-    return sockStream_->writeFixSize(msg.data(), msg.size());
+    if(upgraded_) {
+        return 0;
+    }
+    if(bodyWriter_.isStreaming()) { //消息体已经流式发送, 这里只需要结束它
+        int rt = bodyWriter_.finish();
+        if(rt < 0 || response->isClose()) {
+            close();
+        }
+        return rt;
+    }
+
+    //直接序列化到写缓冲区, 不产生临时字符串
+    size_t offset = writeBuffer_.size();
+    response->appendTo(writeBuffer_);
+    if(hasPendingRequest() && !response->isClose() &&
+        writeBuffer_.size() < kMaxPendingResponseBytes) {
+        return writeBuffer_.size() - offset;
+    }
+    return flush();
+}
+
+int HttpSession::flush() {
+    if(writeBuffer_.empty()) {
+        return 0;
+    }
+    int result = sockStream_->writeFixSize(writeBuffer_.data(), writeBuffer_.size());
+    writeBuffer_.clear();
+    return result;
 }
 
 } // namespace http
 } // namespace net
-} // namespace nemo
\ No newline at end of file
+} // namespace nemo
@@ -0,0 +1,270 @@
+#include "net/http/http_simd_parser.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define NEMO_HTTP_PARSER_SSE42 1
+#endif
+
+namespace nemo {
+namespace net {
+namespace http {
+
+namespace {
+
+/**
+ * @brief RFC 7230中的tchar, 用于校验方法名和头部字段名
+ */
+constexpr std::array<bool, 256> MakeTokenTable() {
+    std::array<bool, 256> table{};
+    for(int c = '0'; c <= '9'; ++c) {
+        table[c] = true;
+    }
+    for(int c = 'a'; c <= 'z'; ++c) {
+        table[c] = true;
+        table[c - 'a' + 'A'] = true;
+    }
+    for(char c : StringArg("!#$%&'*+-.^_`|~")) {
+        table[static_cast<unsigned char>(c)] = true;
+    }
+    return table;
+}
+
+constexpr std::array<bool, 256> kTokenTable = MakeTokenTable();
+
+/// 字符区间[lo, hi]两两一组, PCMPESTRI一次读取16个字节, 所以补齐到16个字节
+struct CharRanges {
+    alignas(16) char ranges[16];
+    int size;
+};
+
+/// 请求目标在空格和控制字符处结束
+constexpr CharRanges kTargetStop = {"\000\040\177\177", 4};
+
+/// 头部值在控制字符处结束(HT除外)
+constexpr CharRanges kValueStop = {"\000\010\012\037\177\177", 6};
+
+bool InRanges(unsigned char c, const CharRanges& stop) {
+    for(int i = 0; i < stop.size; i += 2) {
+        if(c >= static_cast<unsigned char>(stop.ranges[i]) &&
+            c <= static_cast<unsigned char>(stop.ranges[i + 1])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef NEMO_HTTP_PARSER_SSE42
+__attribute__((target("sse4.2")))
+const char* FindCharSse42(const char* p, const char* end, const CharRanges& stop) {
+    __m128i ranges16 = _mm_load_si128(reinterpret_cast<const __m128i*>(stop.ranges));
+    while(end - p >= 16) {
+        __m128i b16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int r = _mm_cmpestri(ranges16, stop.size, b16, 16,
+                    _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES | _SIDD_UBYTE_OPS);
+        if(r != 16) {
+            return p + r;
+        }
+        p += 16;
+    }
+    return p;
+}
+
+bool HasSse42() {
+    static const bool hasSse42 = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2") != 0;
+    }();
+    return hasSse42;
+}
+#endif
+
+/**
+ * @brief 查找第一个落在stop区间中的字符
+ * @return 找到的位置, 没找到返回end
+ */
+const char* FindChar(const char* p, const char* end, const CharRanges& stop) {
+#ifdef NEMO_HTTP_PARSER_SSE42
+    if(HasSse42()) {
+        p = FindCharSse42(p, end, stop);
+    }
+#endif
+    while(p < end && !InRanges(*p, stop)) {
+        ++p;
+    }
+    return p;
+}
+
+const char* SkipToken(const char* p, const char* end) {
+    while(p < end && kTokenTable[static_cast<unsigned char>(*p)]) {
+        ++p;
+    }
+    return p;
+}
+
+/**
+ * @brief 解析行尾, 兼容只有LF的情况
+ * @return 0 成功并跳过行尾, -1 格式错误, -2 数据不完整
+ */
+int ParseEol(const char*& p, const char* end) {
+    if(p == end) {
+        return -2;
+    }
+    if(*p == '\r') {
+        if(end - p < 2) {
+            return -2;
+        }
+        if(p[1] != '\n') {
+            return -1;
+        }
+        p += 2;
+        return 0;
+    }
+    if(*p == '\n') {
+        ++p;
+        return 0;
+    }
+    return -1;
+}
+
+/**
+ * @brief 把请求目标拆分成path, query和fragment
+ */
+void SplitTarget(const char* begin, const char* end, HttpRequestSlices& slices) {
+    StringArg target(begin, end - begin);
+    //absolute-form: http://host[:port]/path, 只保留path部分
+    if(target.front() != '/') {
+        size_t scheme = target.find("://");
+        if(scheme != StringArg::npos) {
+            size_t path = target.find('/', scheme + 3);
+            target = path == StringArg::npos ? StringArg("/") : target.substr(path);
+        }
+    }
+
+    slices.fragment = StringArg();
+    size_t pos = target.find('#');
+    if(pos != StringArg::npos) {
+        slices.fragment = target.substr(pos + 1);
+        target = target.substr(0, pos);
+    }
+
+    slices.query = StringArg();
+    pos = target.find('?');
+    if(pos != StringArg::npos) {
+        slices.query = target.substr(pos + 1);
+        target = target.substr(0, pos);
+    }
+    slices.path = target;
+}
+
+} // namespace
+
+bool IsHttpSimdParserAccelerated() {
+#ifdef NEMO_HTTP_PARSER_SSE42
+    return HasSse42();
+#else
+    return false;
+#endif
+}
+
+int ParseHttpRequest(const char* data, size_t len, HttpRequestSlices& slices) {
+    const char* p = data;
+    const char* end = data + len;
+    slices.headerCount = 0;
+
+    //请求之前的空行需要忽略(RFC 7230 3.5)
+    while(p < end && (*p == '\r' || *p == '\n')) {
+        ++p;
+    }
+
+    //method SP
+    const char* tok = p;
+    p = SkipToken(p, end);
+    if(p == end) {
+        return -2;
+    }
+    if(p == tok || *p != ' ') {
+        return -1;
+    }
+    slices.method = StringArg(tok, p - tok);
+    ++p;
+
+    //request-target SP
+    tok = p;
+    p = FindChar(p, end, kTargetStop);
+    if(p == end) {
+        return -2;
+    }
+    if(p == tok || *p != ' ') {
+        return -1;
+    }
+    SplitTarget(tok, p, slices);
+    ++p;
+
+    //HTTP-version CRLF
+    static constexpr StringArg kVersionPrefix = "HTTP/1.";
+    size_t avail = end - p;
+    if(::memcmp(p, kVersionPrefix.data(), std::min(avail, kVersionPrefix.size())) != 0) {
+        return -1;
+    }
+    if(avail <= kVersionPrefix.size()) {
+        return -2;
+    }
+    p += kVersionPrefix.size();
+    if(*p < '0' || *p > '9') {
+        return -1;
+    }
+    slices.minorVersion = *p++ - '0';
+    if(int rt = ParseEol(p, end); rt != 0) {
+        return rt;
+    }
+
+    //*(field-name ":" OWS field-value OWS CRLF) CRLF
+    while(true) {
+        if(p == end) {
+            return -2;
+        }
+        if(*p == '\r' || *p == '\n') {
+            if(int rt = ParseEol(p, end); rt != 0) {
+                return rt;
+            }
+            break;
+        }
+        if(slices.headerCount == HttpRequestSlices::kMaxHeaders) {
+            return -1;
+        }
+
+        tok = p;
+        p = SkipToken(p, end);
+        if(p == end) {
+            return -2;
+        }
+        //以空白开头的obs-fold也在这里被拒绝
+        if(p == tok || *p != ':') {
+            return -1;
+        }
+        StringArg name(tok, p - tok);
+        ++p;
+
+        while(p < end && (*p == ' ' || *p == '\t')) {
+            ++p;
+        }
+        tok = p;
+        p = FindChar(p, end, kValueStop);
+        const char* valueEnd = p;
+        if(int rt = ParseEol(p, end); rt != 0) {
+            return rt;
+        }
+        while(valueEnd > tok && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t')) {
+            --valueEnd;
+        }
+        slices.headers[slices.headerCount++] = {name, StringArg(tok, valueEnd - tok)};
+    }
+
+    return p - data;
+}
+
+} // namespace http
+} // namespace net
+} // namespace nemo
@@ -0,0 +1,177 @@
+#include "net/http/rate_limiter.h"
+
+#include <netinet/in.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "net/http/http.h"
+#include "net/address.h"
+#include "log/log.h"
+#include "common/config.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+static ConfigVar<std::vector<RateLimitRule>>* rateLimitRulesConfig =
+    Config::Lookup("http.rate_limit.rules", std::vector<RateLimitRule>(),
+                    "rate limit rules: key(ip, route, header:<name>), prefix, rate(per second), burst");
+
+static ConfigVar<uint32_t>* rateLimitMaxKeysConfig =
+    Config::Lookup("http.rate_limit.max_keys", static_cast<uint32_t>(65536),
+                    "max keys tracked by each rate limit rule, least recently seen keys are evicted");
+
+GcraLimiter::GcraLimiter(double rate, uint32_t burst, size_t maxKeys, size_t shards) :
+    interval_(static_cast<int64_t>(1e9 / std::max(rate, 1e-3))),
+    tolerance_(interval_ * std::max<uint32_t>(burst, 1)) {
+    shards = std::max<size_t>(shards, 1);
+    size_t shardKeys = std::max<size_t>(maxKeys / shards, 1);
+    for(size_t i = 0; i < shards; ++i) {
+        shards_.emplace_back(std::make_unique<Shard>(shardKeys));
+    }
+}
+
+int64_t GcraLimiter::acquire(StringArg key, int64_t now, Bucket* acquired) {
+    Shard& shard = *shards_[KeyHash()(key) % shards_.size()];
+    Bucket bucket;
+    {
+        //已经记录的键直接用StringArg查找, 只有新键需要分配
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if(!shard.buckets.get(key, bucket)) {
+            bucket = std::make_shared<std::atomic<int64_t>>(0);
+            shard.buckets.put(String(key), bucket);
+        }
+    }
+
+    //TAT不早于当前时间, 每个请求把它向后推一个间隔, 超出当前时间burst个间隔时拒绝
+    int64_t tat = bucket->load(std::memory_order_relaxed);
+    while(true) {
+        int64_t next = std::max(tat, now) + interval_;
+        if(next - now > tolerance_) {
+            return next - tolerance_ - now;
+        }
+        if(bucket->compare_exchange_weak(tat, next, std::memory_order_relaxed)) {
+            if(acquired) {
+                *acquired = std::move(bucket);
+            }
+            return 0;
+        }
+    }
+}
+
+size_t GcraLimiter::size() {
+    size_t size = 0;
+    for(auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        size += shard->buckets.size();
+    }
+    return size;
+}
+
+HttpRateLimiter::HttpRateLimiter(const std::vector<RateLimitRule>& rules, size_t maxKeys) {
+    for(const RateLimitRule& rule : rules) {
+        Limiter limiter;
+        if("ip" == rule.key) {
+            limiter.type = KeyType::IP;
+        } else if("route" == rule.key) {
+            limiter.type = KeyType::ROUTE;
+        } else if(rule.key.compare(0, 7, "header:") == 0 && rule.key.size() > 7) {
+            limiter.type = KeyType::HEADER;
+            limiter.header = rule.key.substr(7);
+        } else {
+            NEMO_LOG_ERROR(systemLogger) << "invalid rate limit key: " << rule.key;
+            continue;
+        }
+        if(rule.rate <= 0) {
+            NEMO_LOG_ERROR(systemLogger) << "invalid rate limit rate: " << rule.rate
+                << " key=" << rule.key << " prefix=" << rule.prefix;
+            continue;
+        }
+        limiter.prefix = rule.prefix;
+        //同一前缀共享的规则只有一个键
+        limiter.limiter = std::make_unique<GcraLimiter>(rule.rate, rule.burst,
+                            KeyType::ROUTE == limiter.type ? 1 : maxKeys,
+                            KeyType::ROUTE == limiter.type ? 1 : 16);
+        limiters_.push_back(std::move(limiter));
+    }
+}
+
+/**
+ * @brief 客户端地址作为键, IP地址只取地址部分的原始字节
+ */
+static void AppendClientKey(Address* client, String& key) {
+    if(!client) {
+        return;
+    }
+    const sockaddr* addr = client->getAddr();
+    if(AF_INET == addr->sa_family) {
+        const in_addr& ip = reinterpret_cast<const sockaddr_in*>(addr)->sin_addr;
+        key.append(reinterpret_cast<const char*>(&ip), sizeof(ip));
+    } else if(AF_INET6 == addr->sa_family) {
+        const in6_addr& ip = reinterpret_cast<const sockaddr_in6*>(addr)->sin6_addr;
+        key.append(reinterpret_cast<const char*>(&ip), sizeof(ip));
+    } else {
+        key.append(client->toString());
+    }
+}
+
+bool HttpRateLimiter::allow(const HttpRequest* request, Address* client, uint32_t* retryAfter) {
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+    String key;
+    return acquireFrom(0, request, client, now, key, retryAfter);
+}
+
+bool HttpRateLimiter::acquireFrom(size_t index, const HttpRequest* request, Address* client,
+                                  int64_t now, String& key, uint32_t* retryAfter) {
+    const String& path = request->getPath();
+    for(; index < limiters_.size(); ++index) {
+        Limiter& limiter = limiters_[index];
+        if(path.compare(0, limiter.prefix.size(), limiter.prefix) != 0) {
+            continue;
+        }
+        key.clear();
+        if(KeyType::HEADER == limiter.type) {
+            StringArg value = request->getHeaders().get(limiter.header);
+            if(!value.empty()) {
+                key.push_back('h');
+                key.append(value);
+            }
+        }
+        if(key.empty() && KeyType::ROUTE != limiter.type) { //没有对应字段时按客户端地址限流
+            AppendClientKey(client, key);
+        }
+        GcraLimiter::Bucket bucket;
+        int64_t wait = limiter.limiter->acquire(key, now, &bucket);
+        if(wait > 0) {
+            if(retryAfter) {
+                *retryAfter = static_cast<uint32_t>((wait + 999999999) / 1000000000);
+            }
+            return false;
+        }
+        //后面的规则拒绝时退还这条规则的额度, 被拒绝的请求不消耗任何规则.
+        //已经通过的桶保存在调用栈上, 不需要为每个请求分配列表
+        if(!acquireFrom(index + 1, request, client, now, key, retryAfter)) {
+            limiter.limiter->refund(bucket);
+            return false;
+        }
+        return true;
+    }
+    return true;
+}
+
+HttpRateLimiter::SharedPtr HttpRateLimiter::Create() {
+    std::vector<RateLimitRule> rules = rateLimitRulesConfig->getValue();
+    if(rules.empty()) {
+        return nullptr;
+    }
+    return std::make_shared<HttpRateLimiter>(rules, rateLimitMaxKeysConfig->getValue());
+}
+
+} // namespace http
+} // namespace net
+} // namespace nemo
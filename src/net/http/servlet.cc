@@ -1,11 +1,16 @@
 #include "net/http/servlet.h"
 
+#include <algorithm>
+
 #include "net/http/http.h"
+#include "log/log.h"
 
 namespace nemo {
 namespace net {
 namespace http {
 
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
 HttpServlet::HttpServlet(StringArg name) :
     name_(name) {
 }
@@ -26,28 +31,130 @@ int FunctionServlet::handle(HttpRequest* request,
     return cb_(request, response, session);
 }
 
-HoldServletCreator::HoldServletCreator(const HttpServlet::SharedPtr& servlet) :
-    servlet_(servlet) {
+HttpFilter::HttpFilter(StringArg name) :
+    name_(name) {
+}
+
+FunctionFilter::FunctionFilter(BeforeCallback before, AfterCallback after) :
+    HttpFilter("FunctionFilter"),
+    before_(std::move(before)),
+    after_(std::move(after)) {
 }
 
-ServletDispatcher::ServletVector::iterator 
-ServletDispatcher::getGlobServletIter(StringArg uri) {
-    return std::find_if(globServlets_.begin(), 
-        globServlets_.end(), 
-        [&uri](const ServletPair& servletPair) {
-            return uri == servletPair.second->getName();
+bool FunctionFilter::before(HttpRequest* request, HttpResponse* response, HttpSession* session) {
+    return before_ ? before_(request, response, session) : true;
+}
+
+void FunctionFilter::after(HttpRequest* request, HttpResponse* response, HttpSession* session) {
+    if(after_) {
+        after_(request, response, session);
+    }
+}
+
+FilteredServlet::FilteredServlet(const HttpServlet::SharedPtr& servlet,
+                                 const std::vector<HttpFilter::SharedPtr>& filters) :
+    HttpServlet(servlet->getName()),
+    servlet_(servlet),
+    filters_(filters) {
+    streamBody_ = servlet->isStreamBody();
+}
+
+template<class Fn>
+int32_t FilteredServlet::run(HttpRequest* request, HttpResponse* response,
+                             HttpSession* session, Fn&& fn) {
+    int32_t rt = 0;
+    size_t passed = 0;
+    while(passed < filters_.size() && filters_[passed]->before(request, response, session)) {
+        ++passed;
+    }
+    if(passed == filters_.size()) {
+        rt = fn();
+    }
+    while(passed > 0) {
+        filters_[--passed]->after(request, response, session);
+    }
+    return rt;
+}
+
+int32_t FilteredServlet::handle(HttpRequest* request,
+                                HttpResponse* response,
+                                HttpSession* session) {
+    return run(request, response, session, [&]() {
+        return servlet_->handle(request, response, session);
     });
 }
 
+int32_t FilteredServlet::handle(HttpRequest* request,
+                                HttpResponse* response,
+                                HttpSession* session,
+                                const Stage& stage) {
+    return run(request, response, session, [&]() {
+        return stage(servlet_.get(), request, response, session);
+    });
+}
+
+namespace {
+
+/**
+ * @brief 在路由表中代替原来的处理器, 挂载了过滤器的servlet在注册时就组合好
+ */
+class FilteredServletCreator : public IServletCreator {
+public:
+    FilteredServletCreator(HttpRouter::Handler&& creator,
+                           std::vector<HttpFilter::SharedPtr>&& filters) :
+        creator_(std::move(creator)),
+        filters_(std::move(filters)),
+        servlet_(std::make_shared<FilteredServlet>(creator_->get(), filters_)) {
+    }
+
+    HttpServlet::SharedPtr get() const override {
+        return servlet_;
+    }
+
+    HttpServlet* peek() const override {
+        return servlet_.get();
+    }
+
+    String getName() const override {
+        return creator_->getName();
+    }
+
+    /**
+     * @brief 返回注册时的处理器
+     */
+    const HttpRouter::Handler& getCreator() const { return creator_; }
+
+private:
+    HttpRouter::Handler creator_;
+    std::vector<HttpFilter::SharedPtr> filters_;
+    HttpServlet::SharedPtr servlet_;
+};
+
+} // namespace
+
+HoldServletCreator::HoldServletCreator(const HttpServlet::SharedPtr& servlet) :
+    servlet_(servlet) {
+}
+
 ServletDispatcher::ServletDispatcher() :
     HttpServlet("ServletDispatcher"),
-    defaultServlet_(new NotFoundServlet) {
+    rawDefault_(new NotFoundServlet),
+    rawMethodNotAllowed_(new MethodNotAllowedServlet(this)),
+    router_(new HttpRouter),
+    defaultServlet_(new HttpServlet::SharedPtr(rawDefault_)),
+    methodNotAllowed_(new HttpServlet::SharedPtr(rawMethodNotAllowed_)) {
+}
+
+ServletDispatcher::~ServletDispatcher() {
+    delete router_.load(std::memory_order_acquire);
+    delete defaultServlet_.load(std::memory_order_acquire);
+    delete methodNotAllowed_.load(std::memory_order_acquire);
 }
 
 int ServletDispatcher::handle(HttpRequest* request, 
                 HttpResponse* response, 
                 HttpSession* session) {
-    HttpServlet::SharedPtr servlet = getMatchedServlet(request->getPath());
+    HttpServlet::SharedPtr servlet = getMatchedServlet(request);
     if(servlet) {
         servlet->handle(request, response, session);
         return 0;
@@ -56,32 +163,20 @@ int ServletDispatcher::handle(HttpRequest* request,
 }
 
 void ServletDispatcher::addServlet(StringArg uri, HttpServlet::UniquePtr&& servlet) {
-    std::lock_guard<std::shared_mutex> lockGuard(mutex_);
-    servlets_.emplace(String(uri), IServletCreator::UniquePtr(new 
+    addServletCreator(uri, IServletCreator::UniquePtr(new 
         HoldServletCreator(std::move(servlet))));
 }
 
 void ServletDispatcher::addServlet(StringArg uri, const FunctionServlet::Callback& cb) {
-    std::lock_guard<std::shared_mutex> lockGuard(mutex_);
-    HttpServlet::SharedPtr servlet(new FunctionServlet(cb));
-    servlets_.emplace(String(uri), IServletCreator::UniquePtr(new HoldServletCreator(servlet)));
+    addServlet(uri, HttpServlet::UniquePtr(new FunctionServlet(cb)));
 }
 
 void ServletDispatcher::addServlet(StringArg uri, FunctionServlet::Callback&& cb) {
-    std::lock_guard<std::shared_mutex> lockGuard(mutex_);
-    HttpServlet::SharedPtr servlet(new FunctionServlet(std::move(cb)));
-    servlets_.emplace(String(uri), IServletCreator::UniquePtr(new HoldServletCreator(servlet)));
+    addServlet(uri, HttpServlet::UniquePtr(new FunctionServlet(std::move(cb))));
 }
 
 void ServletDispatcher::addGlobServlet(StringArg uri, HttpServlet::UniquePtr&& servlet) {
-    std::lock_guard<std::shared_mutex> lockGuard(mutex_);
-    auto iter = getGlobServletIter(uri);
-    if (iter != globServlets_.end()) {
-        iter->second.reset(new HoldServletCreator(std::move(servlet)));
-    } else {
-        globServlets_.emplace_back(String(uri), 
-            IServletCreator::UniquePtr(new HoldServletCreator(std::move(servlet))));
-    }
+    addServlet(uri, std::move(servlet));
 }
 
 void ServletDispatcher::addGlobServlet(StringArg uri, const FunctionServlet::Callback& cb) {
@@ -93,55 +188,218 @@ void ServletDispatcher::addGlobServlet(StringArg uri, FunctionServlet::Callback&
 }
 
 void ServletDispatcher::addServletCreator(StringArg uri, IServletCreator::UniquePtr&& creator) {
-    std::lock_guard<std::shared_mutex> lockGuard(mutex_);
-    servlets_.emplace(String(uri), std::move(creator));
+    addRouteCreator(HttpRouter::kAnyMethod, uri, std::move(creator));
 }
 
 void ServletDispatcher::addGlobServletCreator(StringArg uri, IServletCreator::UniquePtr&& creator) {
-    std::lock_guard<std::shared_mutex> lockGuard(mutex_);
-    auto iter = getGlobServletIter(uri);
-    if (iter != globServlets_.end()) {
-        iter->second = std::move(creator);
-    } else {
-        globServlets_.emplace_back(String(uri), std::move(creator));
+    addServletCreator(uri, std::move(creator));
+}
+
+bool ServletDispatcher::addRoute(HttpMethod method, StringArg pattern,
+                            HttpServlet::UniquePtr&& servlet) {
+    return addRouteCreator(method, pattern, IServletCreator::UniquePtr(new
+        HoldServletCreator(std::move(servlet))));
+}
+
+bool ServletDispatcher::addRoute(HttpMethod method, StringArg pattern,
+                            const FunctionServlet::Callback& cb) {
+    return addRoute(method, pattern, HttpServlet::UniquePtr(new FunctionServlet(cb)));
+}
+
+bool ServletDispatcher::addRoute(HttpMethod method, StringArg pattern,
+                            FunctionServlet::Callback&& cb) {
+    return addRoute(method, pattern, HttpServlet::UniquePtr(new FunctionServlet(std::move(cb))));
+}
+
+bool ServletDispatcher::addRouteCreator(HttpMethod method, StringArg pattern,
+                            IServletCreator::UniquePtr&& creator) {
+    return updateRoutes([&](HttpRouter& router) {
+        if(router.find(method, pattern)) { //静默覆盖会让先注册的servlet失效, 很难排查
+            NEMO_LOG_ERROR(systemLogger) << "duplicate route: " << pattern
+                << " method=" << (HttpRouter::kAnyMethod == method ? "*" : HttpMethod2String(method))
+                << " servlet=" << creator->getName();
+            return false;
+        }
+        return router.add(method, pattern, std::move(creator));
+    });
+}
+
+void ServletDispatcher::delRoute(HttpMethod method, StringArg pattern) {
+    updateRoutes([&](HttpRouter& router) {
+        return router.remove(method, pattern);
+    });
+}
+
+bool ServletDispatcher::updateRoutes(const std::function<bool(HttpRouter& router)>& cb) {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    const HttpRouter* current = router_.load(std::memory_order_relaxed);
+    std::unique_ptr<HttpRouter> next = std::make_unique<HttpRouter>(*current);
+    if(!cb(*next)) {
+        return false;
+    }
+    if(!filters_.empty()) { //新增的路由也要挂载过滤器
+        recompose(*next);
     }
+    router_.store(next.release(), std::memory_order_seq_cst);
+    epoch_.retire(current);
+    return true;
+}
+
+void ServletDispatcher::addFilter(const HttpFilter::SharedPtr& filter) {
+    addFilter(StringArg(), filter);
+}
+
+void ServletDispatcher::addFilter(StringArg prefix, const HttpFilter::SharedPtr& filter) {
+    updateRoutes([&](HttpRouter& router) {
+        filters_.push_back(FilterRule{String(prefix), filter});
+        publishDefault();
+        return true;
+    });
+}
+
+void ServletDispatcher::delFilter(const HttpFilter::SharedPtr& filter) {
+    updateRoutes([&](HttpRouter& router) {
+        auto iter = std::remove_if(filters_.begin(), filters_.end(),
+                [&filter](const FilterRule& rule) { return rule.filter == filter; });
+        if(iter == filters_.end()) {
+            return false;
+        }
+        filters_.erase(iter, filters_.end());
+        recompose(router);
+        publishDefault();
+        return true;
+    });
+}
+
+void ServletDispatcher::setDefault(HttpServlet::UniquePtr&& servlet) {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    rawDefault_ = std::move(servlet);
+    publishDefault();
+}
+
+HttpRouter::Handler ServletDispatcher::compose(StringArg pattern, HttpRouter::Handler&& handler) const {
+    if(FilteredServletCreator* filtered = dynamic_cast<FilteredServletCreator*>(handler.get())) {
+        HttpRouter::Handler creator = filtered->getCreator();
+        handler = std::move(creator);
+    }
+    std::vector<HttpFilter::SharedPtr> filters;
+    for(const FilterRule& rule : filters_) {
+        if(pattern.substr(0, rule.prefix.size()) == rule.prefix) {
+            filters.push_back(rule.filter);
+        }
+    }
+    if(filters.empty()) { //没有过滤器的路由不增加任何开销
+        return std::move(handler);
+    }
+    return std::make_shared<FilteredServletCreator>(std::move(handler), std::move(filters));
+}
+
+void ServletDispatcher::recompose(HttpRouter& router) {
+    router.forEach([this](HttpMethod method, StringArg pattern, HttpRouter::Handler& handler) {
+        handler = compose(pattern, std::move(handler));
+    });
+}
+
+void ServletDispatcher::publishDefault() {
+    std::vector<HttpFilter::SharedPtr> filters;
+    for(const FilterRule& rule : filters_) {
+        if(rule.prefix.empty()) {
+            filters.push_back(rule.filter);
+        }
+    }
+    publish(defaultServlet_, rawDefault_, filters);
+    publish(methodNotAllowed_, rawMethodNotAllowed_, filters);
+}
+
+void ServletDispatcher::publish(std::atomic<const HttpServlet::SharedPtr*>& target,
+                                const HttpServlet::SharedPtr& servlet,
+                                const std::vector<HttpFilter::SharedPtr>& filters) {
+    HttpServlet::SharedPtr* next = new HttpServlet::SharedPtr(servlet);
+    if(!filters.empty()) {
+        *next = std::make_shared<FilteredServlet>(servlet, filters);
+    }
+    const HttpServlet::SharedPtr* current = target.exchange(next, std::memory_order_seq_cst);
+    epoch_.retire(current);
 }
 
 void ServletDispatcher::delServlet(const String& uri) {
-    std::lock_guard<std::shared_mutex> lockGuard(mutex_);
-    servlets_.erase(uri);
+    delRoute(HttpRouter::kAnyMethod, uri);
 }
 
 void ServletDispatcher::delGlobServlet(StringArg uri) {
-    std::lock_guard<std::shared_mutex> lockGuard(mutex_);
-    auto iter = getGlobServletIter(uri);
-    if (iter != globServlets_.end()) {
-        globServlets_.erase(iter);
-    }
+    delRoute(HttpRouter::kAnyMethod, uri);
 }
 
 HttpServlet::SharedPtr ServletDispatcher::getServlet(const String& uri) {
-    std::shared_lock<std::shared_mutex> sharedLock(mutex_);
-    auto iter = servlets_.find(uri);
-    return iter == servlets_.end() ? nullptr : iter->second->get();
+    EpochDomain::Reader reader(&epoch_);
+    EpochDomain::Guard guard(reader);
+    IServletCreator* creator = router_.load(std::memory_order_acquire)->find(HttpRouter::kAnyMethod, uri);
+    return creator ? creator->get() : nullptr;
 }
 
 HttpServlet::SharedPtr ServletDispatcher::getGlobServlet(const String& uri) {
-    std::shared_lock<std::shared_mutex> sharedLock(mutex_);
-    auto iter = getGlobServletIter(uri);
-    return iter == globServlets_.end() ? nullptr : iter->second->get();
+    EpochDomain::Reader reader(&epoch_);
+    EpochDomain::Guard guard(reader);
+    IServletCreator* creator = match(HttpRouter::kAnyMethod, uri);
+    return creator ? creator->get() : nullptr;
 }
 
 HttpServlet::SharedPtr ServletDispatcher::getMatchedServlet(const String& uri) {
-    std::shared_lock<std::shared_mutex> sharedLock(mutex_);
-    HttpServlet::SharedPtr result = getServlet(uri);
-    if (nullptr == result) {
-        result = getGlobServlet(uri);
+    EpochDomain::Reader reader(&epoch_);
+    EpochDomain::Guard guard(reader);
+    IServletCreator* creator = match(HttpRouter::kAnyMethod, uri);
+    return creator ? creator->get() : *defaultServlet_.load(std::memory_order_acquire);
+}
+
+HttpServlet::SharedPtr ServletDispatcher::getMatchedServlet(HttpRequest* request) {
+    //不在请求热路径上, 临时注册一个读者, 返回的引用计数保证servlet在离开临界区后仍然有效
+    EpochDomain::Reader reader(&epoch_);
+    EpochDomain::Guard guard(reader);
+    IServletCreator* creator = matchRequest(request);
+    return creator ? creator->get() : fallback(request);
+}
+
+String ServletDispatcher::getAllowedMethods(StringArg path) {
+    EpochDomain::Reader reader(&epoch_);
+    EpochDomain::Guard guard(reader);
+    return router_.load(std::memory_order_acquire)->getAllowedMethods(path);
+}
+
+HttpServlet* ServletDispatcher::route(HttpRequest* request) {
+    IServletCreator* creator = matchRequest(request);
+    return creator ? creator->peek() : fallback(request).get();
+}
+
+IServletCreator* ServletDispatcher::matchRequest(HttpRequest* request) const {
+    HttpRouter::Params params;
+    IServletCreator* creator = match(request->getMethod(), request->getPath(), &params);
+    //参数名指向路由快照, 需要在临界区内拷贝
+    for(const auto& param : params) {
+        request->setRouteParam(param.name, param.value);
     }
-    if (nullptr == result) {
-        result = defaultServlet_;
+    return creator;
+}
+
+const HttpServlet::SharedPtr& ServletDispatcher::fallback(HttpRequest* request) const {
+    //只在匹配失败时检查其它方法, 不影响命中路由的请求
+    if(!router_.load(std::memory_order_acquire)->getAllowedMethods(request->getPath()).empty()) {
+        return *methodNotAllowed_.load(std::memory_order_acquire);
     }
-    return result;
+    return *defaultServlet_.load(std::memory_order_acquire);
+}
+
+MethodNotAllowedServlet::MethodNotAllowedServlet(ServletDispatcher* dispatcher) :
+    HttpServlet("MethodNotAllowedServlet"),
+    dispatcher_(dispatcher) {
+}
+
+int MethodNotAllowedServlet::handle(HttpRequest* request,
+                    HttpResponse* response,
+                    HttpSession* session) {
+    response->setStatus(HttpStatus::METHOD_NOT_ALLOWED);
+    response->setHeader("Server", "nemo/1.0.0");
+    response->setHeader("Allow", dispatcher_->getAllowedMethods(request->getPath()));
+    return 0;
 }
 
 NotFoundServlet::NotFoundServlet() : 
@@ -0,0 +1,99 @@
+#include "net/http/ws_servlet.h"
+
+#include <sys/socket.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "net/http/http_session.h"
+#include "log/log.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+/**
+ * @brief 排空回调与websocket会话之间的共享状态
+ */
+struct DrainHook {
+    std::mutex mutex;
+    int fd = -1;                        ///< 会话结束后置为-1, 由mutex保护
+    std::atomic<bool> draining{false};
+};
+
+WsServlet::WsServlet(StringArg name) :
+    HttpServlet(name) {
+    //升级请求没有消息体, 也不能让HttpServer预先读取握手之后的数据
+    streamBody_ = true;
+}
+
+int32_t WsServlet::handle(HttpRequest* request,
+        HttpResponse* response,
+        HttpSession* session) {
+    if(!session) {
+        response->setStatus(HttpStatus::BAD_REQUEST);
+        return -1;
+    }
+    WsSession ws(session);
+    if(!ws.handshake(request, response)) {
+        return -1;
+    }
+    //服务器优雅关闭时关闭读端, recvMessage()读到EOF返回后由本协程发送1001.
+    //回调在drain()的线程中执行, 不能在那里写帧(写入串行化需要挂起协程),
+    //通过hook与返回之前的取消注册互斥, 不会关闭已经被复用的fd
+    auto hook = std::make_shared<DrainHook>();
+    hook->fd = session->getSocket()->getSocketFd();
+    session->setDrainCallback([hook]() {
+        std::lock_guard<std::mutex> lockGuard(hook->mutex);
+        if(hook->fd >= 0) {
+            hook->draining = true;
+            ::shutdown(hook->fd, SHUT_RD);
+        }
+    });
+    if(onConnect(request, &ws) < 0) {
+        ws.close(WsCloseCode::POLICY_VIOLATION);
+    }
+    while(WsMessage::UniquePtr message = ws.recvMessage()) {
+        if(onMessage(request, message.get(), &ws) < 0) {
+            ws.close(WsCloseCode::NORMAL);
+        }
+    }
+    session->setDrainCallback(nullptr);
+    {
+        std::lock_guard<std::mutex> lockGuard(hook->mutex);
+        hook->fd = -1;
+    }
+    if(hook->draining) {
+        ws.close(WsCloseCode::GOING_AWAY);
+    }
+    NEMO_LOG_DEBUG(systemLogger) << "websocket closed, code=" << ws.getCloseCode()
+        << " path=" << request->getPath();
+    onClose(request, &ws);
+    return 0;
+}
+
+FunctionWsServlet::FunctionWsServlet(MessageCallback onMessage,
+        ConnectCallback onConnect, ConnectCallback onClose) :
+    WsServlet("FunctionWsServlet"),
+    onMessage_(std::move(onMessage)),
+    onConnect_(std::move(onConnect)),
+    onClose_(std::move(onClose)) {
+}
+
+int32_t FunctionWsServlet::onConnect(HttpRequest* request, WsSession* session) {
+    return onConnect_ ? onConnect_(request, session) : 0;
+}
+
+int32_t FunctionWsServlet::onMessage(HttpRequest* request, WsMessage* message, WsSession* session) {
+    return onMessage_(request, message, session);
+}
+
+int32_t FunctionWsServlet::onClose(HttpRequest* request, WsSession* session) {
+    return onClose_ ? onClose_(request, session) : 0;
+}
+
+} // namespace http
+} // namespace net
+} // namespace nemo
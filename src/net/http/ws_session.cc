@@ -0,0 +1,705 @@
+#include "net/http/ws_session.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <zlib.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "net/http/http_session.h"
+#include "log/log.h"
+#include "common/config.h"
+
+namespace nemo {
+namespace net {
+namespace http {
+
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+static ConfigVar<uint64_t>* wsMaxMessageSizeConfig =
+    Config::Lookup("http.websocket.max_message_size",
+                    static_cast<uint64_t>(4 * 1024 * 1024),
+                    "websocket max message size after decompression");
+
+static ConfigVar<bool>* wsDeflateConfig =
+    Config::Lookup("http.websocket.permessage_deflate", true,
+                    "enable websocket permessage-deflate");
+
+static uint64_t wsMaxMessageSize = 0;
+static bool wsDeflate = true;
+
+namespace {
+struct WsConfigIniter {
+    WsConfigIniter() {
+        wsMaxMessageSize = wsMaxMessageSizeConfig->getValue();
+        wsDeflate = wsDeflateConfig->getValue();
+
+        wsMaxMessageSizeConfig->addListener([](const uint64_t& oldVal, const uint64_t& newVal) {
+            static_cast<void>(oldVal);
+            wsMaxMessageSize = newVal;
+        });
+        wsDeflateConfig->addListener([](const bool& oldVal, const bool& newVal) {
+            static_cast<void>(oldVal);
+            wsDeflate = newVal;
+        });
+    }
+};
+
+static WsConfigIniter wsConfigIniter;
+
+/// RFC 6455 4.2.2中固定的GUID
+constexpr StringArg kWsGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+/// 不超过该大小的帧把帧头和负载拼接后一次发送
+constexpr size_t kSmallFrameSize = 1024;
+/// 小于该大小的消息不压缩
+constexpr size_t kMinDeflateSize = 64;
+/// 压缩数据以Z_SYNC_FLUSH结束时的尾部(RFC 7692 7.2.1)
+constexpr StringArg kDeflateTail = StringArg("\x00\x00\xff\xff", 4);
+
+static bool SendAll(Socket* sock, const void* data, size_t len) {
+    const char* p = static_cast<const char*>(data);
+    while(len > 0) {
+        int n = sock->send(p, len, MSG_NOSIGNAL);
+        if(n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+/**
+ * @brief 线程共享的zlib状态, 每条消息开始前重置, 所以不需要跟随连接
+ */
+struct ZStream {
+    z_stream zs;
+    bool deflater = false;
+    bool inited = false;
+
+    ~ZStream() {
+        if(inited) {
+            deflater ? ::deflateEnd(&zs) : ::inflateEnd(&zs);
+        }
+    }
+};
+
+/**
+ * @brief 压缩一条消息, 服务端总是不保留上下文(server_no_context_takeover)
+ * @param[in] windowBits 对端允许的窗口大小, 9-15
+ */
+static bool Deflate(StringArg in, int windowBits, String& out) {
+    static thread_local ZStream deflaters[16];
+    ZStream& z = deflaters[windowBits];
+    if(!z.inited) {
+        ::memset(&z.zs, 0, sizeof(z.zs));
+        if(::deflateInit2(&z.zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -windowBits,
+                          8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+        }
+        z.deflater = true;
+        z.inited = true;
+    } else {
+        ::deflateReset(&z.zs);
+    }
+
+    z.zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    z.zs.avail_in = in.size();
+    size_t chunk = in.size() / 2 + 64;
+    out.clear();
+    do {
+        size_t offset = out.size();
+        out.resize(offset + chunk);
+        z.zs.next_out = reinterpret_cast<Bytef*>(&out[offset]);
+        z.zs.avail_out = chunk;
+        int rt = ::deflate(&z.zs, Z_SYNC_FLUSH);
+        if(rt != Z_OK && rt != Z_BUF_ERROR) {
+            return false;
+        }
+        out.resize(offset + chunk - z.zs.avail_out);
+    } while(0 == z.zs.avail_out);
+
+    if(out.size() < kDeflateTail.size() ||
+        StringArg(out).substr(out.size() - kDeflateTail.size()) != kDeflateTail) {
+        return false;
+    }
+    out.resize(out.size() - kDeflateTail.size());
+    return true;
+}
+
+/**
+ * @brief 去掉首尾空格和引号
+ */
+static StringArg TrimParam(StringArg value) {
+    while(!value.empty() && (' ' == value.front() || '\t' == value.front())) {
+        value.remove_prefix(1);
+    }
+    while(!value.empty() && (' ' == value.back() || '\t' == value.back())) {
+        value.remove_suffix(1);
+    }
+    if(value.size() >= 2 && '"' == value.front() && '"' == value.back()) {
+        value = value.substr(1, value.size() - 2);
+    }
+    return value;
+}
+
+/**
+ * @brief 解析窗口大小参数
+ * @return 不合法时返回0
+ */
+static int ParseWindowBits(StringArg value) {
+    if(value.size() == 1 && value[0] >= '8' && value[0] <= '9') {
+        return value[0] - '0';
+    }
+    if(value.size() == 2 && '1' == value[0] && value[1] >= '0' && value[1] <= '5') {
+        return 10 + value[1] - '0';
+    }
+    return 0;
+}
+
+/**
+ * @brief 检查是否为合法的UTF-8(RFC 3629), 拒绝过长编码, 代理区和超过U+10FFFF的码点
+ */
+static bool IsValidUtf8(StringArg data) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data());
+    const uint8_t* end = p + data.size();
+    while(p < end) {
+        //一次跳过8个ASCII字节
+        if(end - p >= 8) {
+            uint64_t word;
+            ::memcpy(&word, p, sizeof(word));
+            if(0 == (word & 0x8080808080808080ULL)) {
+                p += 8;
+                continue;
+            }
+        }
+        uint8_t c = *p;
+        if(c < 0x80) {
+            ++p;
+            continue;
+        }
+        size_t n;
+        uint8_t lo = 0x80;
+        uint8_t hi = 0xbf;
+        if(c >= 0xc2 && c <= 0xdf) {
+            n = 1;
+        } else if(c >= 0xe0 && c <= 0xef) {
+            n = 2;
+            if(0xe0 == c) {
+                lo = 0xa0;
+            } else if(0xed == c) {
+                hi = 0x9f;
+            }
+        } else if(c >= 0xf0 && c <= 0xf4) {
+            n = 3;
+            if(0xf0 == c) {
+                lo = 0x90;
+            } else if(0xf4 == c) {
+                hi = 0x8f;
+            }
+        } else {
+            return false;
+        }
+        if(static_cast<size_t>(end - p) <= n || p[1] < lo || p[1] > hi) {
+            return false;
+        }
+        for(size_t i = 2; i <= n; ++i) {
+            if((p[i] & 0xc0) != 0x80) {
+                return false;
+            }
+        }
+        p += n + 1;
+    }
+    return true;
+}
+
+} // namespace
+
+void WsMask(void* data, size_t len, const uint8_t key[4]) {
+    uint8_t* p = static_cast<uint8_t*>(data);
+    size_t i = 0;
+    uint32_t key32;
+    ::memcpy(&key32, key, sizeof(key32));
+#if defined(__SSE2__)
+    __m128i key128 = _mm_set1_epi32(static_cast<int>(key32));
+    for(; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), _mm_xor_si128(v, key128));
+    }
+#endif
+    //16和8都是4的倍数, 分块处理后掩码的相位不变
+    uint64_t key64 = (static_cast<uint64_t>(key32) << 32) | key32;
+    for(; i + 8 <= len; i += 8) {
+        uint64_t v;
+        ::memcpy(&v, p + i, sizeof(v));
+        v ^= key64;
+        ::memcpy(p + i, &v, sizeof(v));
+    }
+    for(; i < len; ++i) {
+        p[i] ^= key[i & 3];
+    }
+}
+
+WsSession::WsSession(HttpSession* session) :
+    session_(session),
+    closeCode_(0),
+    deflate_(false),
+    serverWindowBits_(15),
+    closeSent_(false),
+    closeReceived_(false),
+    pingSent_(false),
+    writing_(false) {
+}
+
+WsSession::~WsSession() {
+}
+
+String WsSession::AcceptKey(StringArg key) {
+    String input;
+    input.reserve(key.size() + kWsGuid.size());
+    input.append(key).append(kWsGuid);
+    unsigned char digest[SHA_DIGEST_LENGTH];
+    ::SHA1(reinterpret_cast<const unsigned char*>(input.data()), input.size(), digest);
+    char encoded[4 * ((SHA_DIGEST_LENGTH + 2) / 3) + 1];
+    int len = ::EVP_EncodeBlock(reinterpret_cast<unsigned char*>(encoded), digest, SHA_DIGEST_LENGTH);
+    return String(encoded, len);
+}
+
+void WsSession::NegotiateDeflate(StringArg offers, String& accepted, int& serverWindowBits) {
+    accepted.clear();
+    while(!offers.empty()) {
+        size_t end = offers.find(',');
+        StringArg offer = offers.substr(0, end);
+        offers = (String::npos == end) ? StringArg() : offers.substr(end + 1);
+
+        size_t semi = offer.find(';');
+        StringArg name = TrimParam(offer.substr(0, semi));
+        if(name.size() != 18 || ::strncasecmp(name.data(), "permessage-deflate", 18) != 0) {
+            continue;
+        }
+        bool valid = true;
+        int serverBits = 0;
+        while(valid && String::npos != semi) {
+            offer.remove_prefix(semi + 1);
+            semi = offer.find(';');
+            StringArg param = offer.substr(0, semi);
+            size_t eq = param.find('=');
+            StringArg key = TrimParam(param.substr(0, eq));
+            StringArg value = (String::npos == eq) ? StringArg() : TrimParam(param.substr(eq + 1));
+            if(key == "server_no_context_takeover") {
+                valid = value.empty();
+            } else if(key == "client_no_context_takeover") {
+                valid = value.empty();
+            } else if(key == "server_max_window_bits") {
+                //zlib的raw deflate不支持8位窗口, 只能拒绝这个offer
+                serverBits = ParseWindowBits(value);
+                valid = serverBits >= 9;
+            } else if(key == "client_max_window_bits") {
+                valid = value.empty() || ParseWindowBits(value) > 0;
+            } else {
+                valid = false;
+            }
+        }
+        if(!valid) {
+            continue;
+        }
+
+        //客户端的窗口不超过15位, 共享的解压状态总是使用15位窗口, 不需要限制
+        accepted = "permessage-deflate; server_no_context_takeover";
+        if(serverBits > 0) {
+            accepted.append("; server_max_window_bits=").append(std::to_string(serverBits));
+        }
+        accepted.append("; client_no_context_takeover");
+        serverWindowBits = serverBits > 0 ? serverBits : 15;
+        return;
+    }
+}
+
+bool WsSession::handshake(const HttpRequest* request, HttpResponse* response) {
+    StringArg key = request->getHeader(HttpHeaderId::SEC_WEBSOCKET_KEY);
+    if(request->getMethod() != HttpMethod::GET ||
+        request->getVersion() != HttpVersion::HTTP11 ||
+        !HasHeaderToken(request->getHeader(HttpHeaderId::UPGRADE), "websocket") ||
+        !HasHeaderToken(request->getHeader(HttpHeaderId::CONNECTION), "upgrade") ||
+        key.size() != 24) {
+        response->setStatus(HttpStatus::BAD_REQUEST);
+        return false;
+    }
+    if(request->getHeader(HttpHeaderId::SEC_WEBSOCKET_VERSION) != "13") {
+        response->setStatus(HttpStatus::UPGRADE_REQUIRED);
+        response->setHeader("Sec-WebSocket-Version", "13");
+        return false;
+    }
+
+    HttpResponse upgrade(HttpVersion::HTTP11, false);
+    upgrade.setHeader("Upgrade", "websocket");
+    upgrade.setHeader("Connection", "Upgrade");
+    upgrade.setHeader("Sec-WebSocket-Accept", AcceptKey(key));
+    if(wsDeflate) {
+        String accepted;
+        int serverBits = 15;
+        NegotiateDeflate(request->getHeader("Sec-WebSocket-Extensions"), accepted, serverBits);
+        if(!accepted.empty()) {
+            upgrade.setHeader("Sec-WebSocket-Extensions", accepted);
+            deflate_ = true;
+            serverWindowBits_ = serverBits;
+        }
+    }
+    if(!session_->switchProtocol(&upgrade)) {
+        closeCode_ = WsCloseCode::ABNORMAL;
+        return false;
+    }
+    return true;
+}
+
+bool WsSession::ensure(size_t n, bool idle) {
+    Buffer& buffer = session_->readBuffer_;
+    while(buffer.size() < n) {
+        if(session_->fill() > 0) {
+            continue;
+        }
+        //空闲连接读超时, 先探测一次对端是否还在
+        if(idle && buffer.empty() && EAGAIN == errno && !pingSent_ && !closeSent_) {
+            pingSent_ = true;
+            if(ping() > 0) {
+                continue;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+bool WsSession::readFrameHeader(FrameHeader& header, bool idle) {
+    if(!ensure(2, idle)) {
+        return false;
+    }
+    pingSent_ = false;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(session_->readBuffer_.data());
+    header.fin = p[0] & 0x80;
+    header.rsv1 = p[0] & 0x40;
+    header.opcode = static_cast<WsOpcode>(p[0] & 0x0f);
+    uint8_t len7 = p[1] & 0x7f;
+    if((p[0] & 0x30) || !(p[1] & 0x80)) { //RSV2/RSV3必须为0, 客户端的帧必须带掩码
+        fail(WsCloseCode::PROTOCOL_ERROR);
+        return false;
+    }
+    switch(header.opcode) {
+        case WsOpcode::CONTINUATION:
+        case WsOpcode::TEXT:
+        case WsOpcode::BINARY:
+            break;
+        case WsOpcode::CLOSE:
+        case WsOpcode::PING:
+        case WsOpcode::PONG:
+            if(!header.fin || len7 > 125 || header.rsv1) {
+                fail(WsCloseCode::PROTOCOL_ERROR);
+                return false;
+            }
+            break;
+        default:
+            fail(WsCloseCode::PROTOCOL_ERROR);
+            return false;
+    }
+
+    size_t extLen = (126 == len7) ? 2 : (127 == len7 ? 8 : 0);
+    size_t headerLen = 2 + extLen + 4;
+    if(!ensure(headerLen, false)) {
+        return false;
+    }
+    p = reinterpret_cast<const uint8_t*>(session_->readBuffer_.data());
+    header.length = len7;
+    if(extLen > 0) {
+        header.length = 0;
+        for(size_t i = 0; i < extLen; ++i) {
+            header.length = (header.length << 8) | p[2 + i];
+        }
+        if(header.length >> 63) {
+            fail(WsCloseCode::PROTOCOL_ERROR);
+            return false;
+        }
+    }
+    ::memcpy(header.key, p + 2 + extLen, 4);
+    session_->consume(headerLen);
+    return true;
+}
+
+bool WsSession::readPayload(const FrameHeader& header, String& out) {
+    if(0 == header.length) {
+        return true;
+    }
+    size_t offset = out.size();
+    out.resize(offset + header.length);
+    char* p = &out[offset];
+    size_t got = 0;
+    while(got < header.length) {
+        ssize_t len = session_->readSome(p + got, header.length - got);
+        if(len <= 0) {
+            return false;
+        }
+        got += len;
+    }
+    WsMask(p, header.length, header.key);
+    return true;
+}
+
+void WsSession::fail(uint16_t code) {
+    if(0 == closeCode_) {
+        closeCode_ = code;
+    }
+    if(!closeSent_) {
+        close(code);
+    }
+}
+
+bool WsSession::onControlFrame(const FrameHeader& header) {
+    String payload;
+    if(!readPayload(header, payload)) {
+        return false;
+    }
+    switch(header.opcode) {
+        case WsOpcode::PING:
+            if(!closeSent_) {
+                sendFrame(WsOpcode::PONG, payload, true, false);
+            }
+            return true;
+        case WsOpcode::PONG:
+            return true;
+        default:
+            break;
+    }
+
+    closeReceived_ = true;
+    uint16_t code = WsCloseCode::NO_STATUS;
+    if(1 == payload.size()) {
+        fail(WsCloseCode::PROTOCOL_ERROR);
+        return false;
+    }
+    if(payload.size() >= 2) {
+        code = (static_cast<uint8_t>(payload[0]) << 8) | static_cast<uint8_t>(payload[1]);
+        //1004-1006和1015保留, 1016-2999未分配
+        if(code < 1000 || (code >= 1004 && code <= 1006) || (code >= 1015 && code < 3000) ||
+            code >= 5000) {
+            fail(WsCloseCode::PROTOCOL_ERROR);
+            return false;
+        }
+    }
+    if(0 == closeCode_) {
+        closeCode_ = code;
+    }
+    if(!closeSent_) {
+        close(WsCloseCode::NO_STATUS == code ? WsCloseCode::NORMAL : code);
+    }
+    return false;
+}
+
+uint16_t WsSession::inflate(String& data) {
+    //协商时要求了client_no_context_takeover, 每条消息独立压缩, 使用线程共享的状态
+    static thread_local ZStream shared;
+    if(!shared.inited) {
+        ::memset(&shared.zs, 0, sizeof(shared.zs));
+        if(::inflateInit2(&shared.zs, -15) != Z_OK) {
+            return WsCloseCode::INTERNAL_ERROR;
+        }
+        shared.inited = true;
+    } else {
+        ::inflateReset(&shared.zs);
+    }
+    z_stream* zs = &shared.zs;
+
+    data.append(kDeflateTail);
+    String out;
+    zs->next_in = reinterpret_cast<Bytef*>(data.data());
+    zs->avail_in = data.size();
+    size_t chunk = std::max<size_t>(data.size() * 2, 256);
+    do {
+        size_t offset = out.size();
+        out.resize(offset + chunk);
+        zs->next_out = reinterpret_cast<Bytef*>(&out[offset]);
+        zs->avail_out = chunk;
+        int rt = ::inflate(zs, Z_SYNC_FLUSH);
+        out.resize(offset + chunk - zs->avail_out);
+        if(Z_STREAM_END == rt) { //对端用BFINAL结束了压缩流, 下一条消息重新开始
+            ::inflateReset(zs);
+            break;
+        }
+        if(rt != Z_OK && rt != Z_BUF_ERROR) {
+            return WsCloseCode::INVALID_PAYLOAD;
+        }
+        if(out.size() > wsMaxMessageSize) {
+            return WsCloseCode::MESSAGE_TOO_BIG;
+        }
+        if(Z_BUF_ERROR == rt && zs->avail_out > 0) {
+            break;
+        }
+    } while(zs->avail_in > 0 || 0 == zs->avail_out);
+    data.swap(out);
+    return 0;
+}
+
+WsMessage::UniquePtr WsSession::recvMessage() {
+    WsMessage::UniquePtr message;
+    bool compressed = false;
+    while(!closeReceived_) {
+        FrameHeader header;
+        if(!readFrameHeader(header, !message)) {
+            break;
+        }
+        if(header.opcode >= WsOpcode::CLOSE) {
+            if(!onControlFrame(header)) {
+                break;
+            }
+            continue;
+        }
+
+        if(WsOpcode::CONTINUATION == header.opcode) {
+            if(!message || header.rsv1) {
+                fail(WsCloseCode::PROTOCOL_ERROR);
+                break;
+            }
+        } else {
+            if(message || (header.rsv1 && !deflate_)) {
+                fail(WsCloseCode::PROTOCOL_ERROR);
+                break;
+            }
+            message = std::make_unique<WsMessage>();
+            message->opcode = header.opcode;
+            compressed = header.rsv1;
+        }
+        if(message->data.size() + header.length > wsMaxMessageSize) {
+            fail(WsCloseCode::MESSAGE_TOO_BIG);
+            break;
+        }
+        if(!readPayload(header, message->data)) {
+            break;
+        }
+        if(!header.fin) {
+            continue;
+        }
+
+        if(compressed) {
+            uint16_t code = inflate(message->data);
+            if(code != 0) {
+                fail(code);
+                break;
+            }
+        }
+        if(WsOpcode::TEXT == message->opcode && !IsValidUtf8(message->data)) {
+            fail(WsCloseCode::INVALID_PAYLOAD);
+            break;
+        }
+        if(closeSent_) { //已经发送CLOSE, 丢弃数据直到对端回复
+            message.reset();
+            continue;
+        }
+        return message;
+    }
+    if(0 == closeCode_) {
+        closeCode_ = WsCloseCode::ABNORMAL;
+    }
+    return nullptr;
+}
+
+void WsSession::lockWrite() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(!writing_) {
+        writing_ = true;
+        return;
+    }
+    //写入权由unlockWrite()直接转交, 醒来时writing_仍然为true
+    writeWaiters_.push_back(coroutine::Processor::Suspend());
+    lock.unlock();
+    coroutine::Processor::Yield();
+}
+
+void WsSession::unlockWrite() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(writeWaiters_.empty()) {
+        writing_ = false;
+        return;
+    }
+    coroutine::Processor::SuspendEntry entry = writeWaiters_.front();
+    writeWaiters_.erase(writeWaiters_.begin());
+    lock.unlock();
+    coroutine::Processor::WakeUp(entry);
+}
+
+int WsSession::sendFrame(WsOpcode opcode, StringArg payload, bool fin, bool rsv1) {
+    char buff[14 + kSmallFrameSize];
+    size_t n = 0;
+    buff[n++] = (fin ? 0x80 : 0) | (rsv1 ? 0x40 : 0) | static_cast<uint8_t>(opcode);
+    uint64_t len = payload.size();
+    if(len < 126) {
+        buff[n++] = len;
+    } else if(len <= 0xffff) {
+        buff[n++] = 126;
+        buff[n++] = len >> 8;
+        buff[n++] = len;
+    } else {
+        buff[n++] = 127;
+        for(int i = 7; i >= 0; --i) {
+            buff[n++] = len >> (i * 8);
+        }
+    }
+
+    Socket* sock = session_->sockStream_->getSocket();
+    bool result;
+    lockWrite();
+    if(len <= kSmallFrameSize) {
+        ::memcpy(buff + n, payload.data(), len);
+        result = SendAll(sock, buff, n + len);
+    } else {
+        result = SendAll(sock, buff, n) && SendAll(sock, payload.data(), len);
+    }
+    unlockWrite();
+    if(!result) {
+        NEMO_LOG_DEBUG(systemLogger) << "websocket send fail, errno=" << errno
+            << " errstr=" << strerror(errno) << " " << *sock;
+        return -1;
+    }
+    return n + len;
+}
+
+int WsSession::sendMessage(StringArg data, WsOpcode opcode, bool fin) {
+    if(closeSent_) {
+        return 0;
+    }
+    //只压缩不分片的消息, 分片消息的第一个分片决定了整条消息是否压缩
+    if(deflate_ && fin && opcode != WsOpcode::CONTINUATION && data.size() >= kMinDeflateSize) {
+        String compressed;
+        if(Deflate(data, serverWindowBits_, compressed) && compressed.size() < data.size()) {
+            return sendFrame(opcode, compressed, true, true);
+        }
+    }
+    return sendFrame(opcode, data, fin, false);
+}
+
+int WsSession::ping(StringArg data) {
+    if(closeSent_) {
+        return 0;
+    }
+    return sendFrame(WsOpcode::PING, data.substr(0, 125), true, false);
+}
+
+int WsSession::close(uint16_t code, StringArg reason) {
+    if(closeSent_.exchange(true)) {
+        return 0;
+    }
+    char payload[125];
+    payload[0] = code >> 8;
+    payload[1] = code;
+    reason = reason.substr(0, sizeof(payload) - 2);
+    ::memcpy(payload + 2, reason.data(), reason.size());
+    return sendFrame(WsOpcode::CLOSE, StringArg(payload, 2 + reason.size()), true, false);
+}
+
+} // namespace http
+} // namespace net
+} // namespace nemo
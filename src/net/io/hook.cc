@@ -3,6 +3,7 @@
 #include <dlfcn.h>
 #include <sys/epoll.h>
 #include <sys/poll.h>
+#include <sys/sendfile.h>
 
 #include <memory>
 
@@ -50,6 +51,7 @@ void SetHookEnable(bool flag) {
     XX(send) \
     XX(sendto) \
     XX(sendmsg) \
+    XX(sendfile) \
     XX(close) \
     XX(fcntl) \
     XX(ioctl) \
@@ -234,6 +236,25 @@ static ssize_t DoIo(int fd, const Fn& f, const char* hookedFnName,
     return result;
 }
 
+int WaitFd(int fd, short events, int timeoutMillionSeconds) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    int triggers = -1;
+    do {
+        if (coroutine::Processor::GetCurrentRunningTask() && IsHookEnable()) {
+            triggers = Poll(&pfd, 1, timeoutMillionSeconds > 0 ? timeoutMillionSeconds : -1, true);
+        } else {
+            triggers = ::poll(&pfd, 1, timeoutMillionSeconds > 0 ? timeoutMillionSeconds : -1);
+        }
+    } while (-1 == triggers && EINTR == errno);
+    if (0 == triggers) {
+        errno = EAGAIN;
+    }
+    return triggers > 0 ? 1 : triggers;
+}
+
 } // namespace io
 } // namespace net
 } // namespace nemo
@@ -256,7 +277,7 @@ unsigned int sleep(unsigned int seconds) {
 
 int usleep(useconds_t usecond) {
     if (nemo::coroutine::Processor::GetCurrentRunningTask() && nemo::net::io::IsHookEnable()) {
-        nemo::coroutine::Processor::Suspend(std::chrono::milliseconds(usecond));
+        nemo::coroutine::Processor::Suspend(std::chrono::microseconds(usecond));
         nemo::coroutine::Processor::Yield();
         return 0;
     }
@@ -489,6 +510,15 @@ ssize_t sendmsg(int s, const struct msghdr *msg, int flags) {
         msg, flags);
 }
 
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+    if (!nemo::net::io::IsHookEnable() || !nemo::coroutine::Processor::GetCurrentRunningTask()) {
+        return sendfile_f(out_fd, in_fd, offset, count);
+    }
+
+    return nemo::net::io::DoIo(out_fd, sendfile_f, "sendfile", POLLOUT, SO_SNDTIMEO, 
+        count, in_fd, offset, count);
+}
+
 int close(int fd) {
     if (!nemo::net::io::IsHookEnable()) {
         return close_f(fd);
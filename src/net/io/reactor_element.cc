@@ -33,6 +33,10 @@ ReactorElement::EntryVector& ReactorElement::select(short int pollEvent) {
 
 void ReactorElement::trigger(short int revent, EntryVector& entries) {
     for (Entry& entry : entries) {
+        if (entry.callback) {
+            (*entry.callback)(revent);
+            continue;
+        }
         entry.events[entry.index] = revent;
         coroutine::Processor::WakeUp(entry.suspendEntry);
     }
@@ -48,7 +52,7 @@ void ReactorElement::rollback(EntryVector& entries, const Entry& entry) {
 
 void ReactorElement::removeExpired(EntryVector& entries) {
     auto expiredBegin = std::remove_if(entries.begin(), entries.end(), [](const Entry& entry) {
-        return entry.suspendEntry.isExpired();
+        return !entry.callback && entry.suspendEntry.isExpired();
     });
     entries.erase(expiredBegin, entries.end());
 }
@@ -0,0 +1,177 @@
+#include "net/listener_handoff.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <mutex>
+
+#include "net/io/hook.h"
+#include "log/log.h"
+
+namespace nemo {
+namespace net {
+
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+static constexpr size_t kMaxHandoffFds = 253;           ///< 一条消息最多携带的描述符(SCM_MAX_FD)
+static constexpr int64_t kHandoffTimeout = 5000;        ///< 等待对端的超时时间(毫秒)
+
+/**
+ * @brief 已经接收还没有被绑定使用的socket
+ */
+static std::mutex& GetPoolMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<Socket::UniquePtr>& GetPool() {
+    static std::vector<Socket::UniquePtr> pool;
+    return pool;
+}
+
+size_t ListenerHandoff::Receive(StringArg path) {
+    String name(path);
+    if(name.empty() || ::access(name.c_str(), F_OK) != 0) {
+        return 0;
+    }
+    UnixAddress address(name);
+    Socket::UniquePtr sock = Socket::CreateUnixTcpSocket();
+    if(!sock->connect(&address)) {
+        NEMO_LOG_WARN(systemLogger) << "no listener handoff on " << name;
+        return 0;
+    }
+    sock->setRecvTimeout(kHandoffTimeout);
+
+    uint8_t count = 0;
+    char control[CMSG_SPACE(sizeof(int) * kMaxHandoffFds)];
+    iovec iov{&count, sizeof(count)};
+    msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t len = ::recvmsg(sock->getSocketFd(), &msg, MSG_CMSG_CLOEXEC);
+    if(len <= 0) {
+        NEMO_LOG_ERROR(systemLogger) << "recv listeners from " << name << " fail, errno="
+            << errno << " errstr=" << strerror(errno);
+        return 0;
+    }
+
+    std::vector<Socket::UniquePtr> sockets;
+    for(cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if(SOL_SOCKET != cmsg->cmsg_level || SCM_RIGHTS != cmsg->cmsg_type) {
+            continue;
+        }
+        size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for(size_t i = 0; i < n; ++i) {
+            int fd = -1;
+            ::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            Socket::UniquePtr listener = Socket::Adopt(fd);
+            if(listener) {
+                sockets.emplace_back(std::move(listener));
+            } else {
+                ::close(fd);
+            }
+        }
+    }
+    if(sockets.size() != count) {
+        NEMO_LOG_WARN(systemLogger) << "recv listeners from " << name << " expect="
+            << static_cast<uint32_t>(count) << " actual=" << sockets.size();
+    }
+    //确认之后旧进程才停止接受连接, 确认失败时两个进程共同接受连接
+    if(sock->send("1", 1) != 1) {
+        NEMO_LOG_WARN(systemLogger) << "ack listener handoff fail, errno="
+            << errno << " errstr=" << strerror(errno);
+    }
+
+    size_t size = sockets.size();
+    std::lock_guard<std::mutex> lockGuard(GetPoolMutex());
+    for(auto& listener : sockets) {
+        NEMO_LOG_INFO(systemLogger) << "take over listener " << *listener;
+        GetPool().emplace_back(std::move(listener));
+    }
+    return size;
+}
+
+Socket::UniquePtr ListenerHandoff::Take(const Address* address) {
+    std::lock_guard<std::mutex> lockGuard(GetPoolMutex());
+    std::vector<Socket::UniquePtr>& pool = GetPool();
+    for(auto iter = pool.begin(); iter != pool.end(); ++iter) {
+        Address* local = (*iter)->getLocalAddress();
+        if(local && *local == *address) {
+            Socket::UniquePtr sock = std::move(*iter);
+            pool.erase(iter);
+            return sock;
+        }
+    }
+    return nullptr;
+}
+
+bool ListenerHandoff::Serve(StringArg path, const std::vector<Socket*>& listeners) {
+    String name(path);
+    if(listeners.empty() || listeners.size() > kMaxHandoffFds) {
+        NEMO_LOG_ERROR(systemLogger) << "listener handoff unsupported, listeners="
+            << listeners.size();
+        return false;
+    }
+    //两个进程共享监听socket期间, 连接被另一个进程取走时accept返回EAGAIN而不是阻塞线程
+    std::vector<int> fds;
+    for(Socket* listener : listeners) {
+        int fd = listener->getSocketFd();
+        fcntl_f(fd, F_SETFL, fcntl_f(fd, F_GETFL, 0) | O_NONBLOCK);
+        fds.push_back(fd);
+    }
+
+    UnixAddress address(name);
+    ::unlink(name.c_str());
+    Socket::UniquePtr server = Socket::CreateUnixTcpSocket();
+    if(!server->bind(&address) || !server->listen()) {
+        NEMO_LOG_ERROR(systemLogger) << "listen on " << name << " fail, errno="
+            << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+
+    while(true) {
+        Socket::UniquePtr peer = server->accept();
+        if(!peer) {
+            return false;
+        }
+        uint8_t count = static_cast<uint8_t>(fds.size());
+        char control[CMSG_SPACE(sizeof(int) * kMaxHandoffFds)];
+        ::memset(control, 0, sizeof(control));
+        iovec iov{&count, sizeof(count)};
+        msghdr msg;
+        ::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        ::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+        if(::sendmsg(peer->getSocketFd(), &msg, 0) != sizeof(count)) {
+            NEMO_LOG_WARN(systemLogger) << "send listeners fail, errno="
+                << errno << " errstr=" << strerror(errno);
+            continue;
+        }
+
+        peer->setRecvTimeout(kHandoffTimeout);
+        char ack = 0;
+        if(peer->recv(&ack, sizeof(ack)) == sizeof(ack)) {
+            //路径留给新进程重新绑定, 不需要删除
+            NEMO_LOG_INFO(systemLogger) << "handed off " << fds.size()
+                << " listeners on " << name;
+            return true;
+        }
+        NEMO_LOG_WARN(systemLogger) << "listener handoff not acked, errno="
+            << errno << " errstr=" << strerror(errno);
+    }
+}
+
+} // namespace net
+} // namespace nemo
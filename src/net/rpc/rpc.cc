@@ -0,0 +1,232 @@
+#include "net/rpc/rpc.h"
+
+#include <string.h>
+#include <sys/socket.h>
+
+#include "net/socket.h"
+#include "log/log.h"
+#include "common/config.h"
+
+namespace nemo {
+namespace net {
+namespace rpc {
+
+static ConfigVar<uint32_t>* rpcMaxFrameSize =
+   Config::Lookup("rpc.max_frame_size", (uint32_t)(16 * 1024 * 1024),
+            "max rpc frame payload size, larger frames close the connection");
+static ConfigVar<uint32_t>* rpcWriteHighWater =
+   Config::Lookup("rpc.write_high_water", (uint32_t)(4 * 1024 * 1024),
+            "bytes queued for sending on one rpc connection above which new requests wait");
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+static uint64_t ReadUint(const uint8_t* p, size_t n) {
+    uint64_t value = 0;
+    for(size_t i = 0; i < n; ++i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static void WriteUint(char* p, uint64_t value, size_t n) {
+    for(size_t i = n; i > 0; --i) {
+        p[i - 1] = static_cast<char>(value);
+        value >>= 8;
+    }
+}
+
+void RpcHeader::parse(const void* data) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    length = ReadUint(p, 4);
+    version = p[4];
+    flags = p[5];
+    status = static_cast<RpcStatus>(ReadUint(p + 6, 2));
+    methodId = ReadUint(p + 8, 4);
+    requestId = ReadUint(p + 12, 8);
+}
+
+void RpcHeader::appendTo(String& out) const {
+    char buff[kRpcHeaderSize];
+    WriteUint(buff, length, 4);
+    buff[4] = static_cast<char>(version);
+    buff[5] = static_cast<char>(flags);
+    WriteUint(buff + 6, static_cast<uint16_t>(status), 2);
+    WriteUint(buff + 8, methodId, 4);
+    WriteUint(buff + 12, requestId, 8);
+    out.append(buff, sizeof(buff));
+}
+
+void AppendRpcFrame(String& out, RpcHeader header, StringArg payload) {
+    header.length = payload.size();
+    header.appendTo(out);
+    out.append(payload.data(), payload.size());
+}
+
+const char* RpcStatus2String(RpcStatus status) {
+    switch(status) {
+#define XX(code, name, desc) \
+        case RpcStatus::name: \
+            return #desc;
+        RPC_STATUS_MAP(XX);
+#undef XX
+        default:
+            return "<unknown>";
+    }
+    return "<unknown>";
+}
+
+RpcFrameReader::RpcFrameReader(Socket* sock)
+    : sock_(sock),
+      buffer_(16 * 1024, '\0') {
+}
+
+bool RpcFrameReader::read(RpcHeader& header, StringArg& payload) {
+    //上一帧的数据已经用完, 移到缓冲区开头
+    if(pos_ == end_) {
+        pos_ = end_ = 0;
+    }
+    if(!ensure(kRpcHeaderSize)) {
+        return false;
+    }
+    header.parse(buffer_.data() + pos_);
+    if(kRpcVersion != header.version || header.length > rpcMaxFrameSize->getValue()) {
+        NEMO_LOG_WARN(systemLogger) << "invalid rpc frame, version=" << (int)header.version
+            << " length=" << header.length << " " << *sock_;
+        return false;
+    }
+    if(!ensure(kRpcHeaderSize + header.length)) {
+        return false;
+    }
+    payload = StringArg(buffer_.data() + pos_ + kRpcHeaderSize, header.length);
+    pos_ += kRpcHeaderSize + header.length;
+    return true;
+}
+
+bool RpcFrameReader::ensure(size_t n) {
+    while(end_ - pos_ < n) {
+        if(pos_ > 0) {
+            ::memmove(&buffer_[0], buffer_.data() + pos_, end_ - pos_);
+            end_ -= pos_;
+            pos_ = 0;
+        }
+        if(buffer_.size() < n) {
+            buffer_.resize(n);
+        }
+        int len = sock_->recv(&buffer_[end_], buffer_.size() - end_);
+        if(len <= 0) {
+            peerClosed_ = (0 == len);
+            return false;
+        }
+        end_ += len;
+    }
+    return true;
+}
+
+RpcFrameWriter::RpcFrameWriter(Socket* sock) :
+    sock_(sock),
+    highWater_(rpcWriteHighWater->getValue()) {
+}
+
+bool RpcFrameWriter::write(const RpcHeader& header, StringArg payload) {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    if(closed_ || failed_) {
+        return false;
+    }
+    AppendRpcFrame(pending_, header, payload);
+    notify();
+    return true;
+}
+
+void RpcFrameWriter::run() {
+    String out;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(true) {
+        if(!pending_.empty()) {
+            out.clear();
+            out.swap(pending_);
+            sending_ = out.size();
+            lock.unlock();
+            size_t offset = 0;
+            while(offset < out.size()) {
+                int len = sock_->send(out.data() + offset, out.size() - offset, MSG_NOSIGNAL);
+                if(len <= 0) {
+                    break;
+                }
+                offset += len;
+            }
+            lock.lock();
+            sending_ = 0;
+            if(offset < out.size()) {
+                NEMO_LOG_WARN(systemLogger) << "rpc send fail, errno=" << errno
+                    << " errstr=" << strerror(errno) << " " << *sock_;
+                failed_ = true;
+                pending_.clear();
+                ::shutdown(sock_->getSocketFd(), SHUT_RDWR);
+            }
+            //发送完一批之后才放行等待的协程, 对端不读时等待会一直传导到产生新帧的一方
+            notifyWritable();
+            continue;
+        }
+        if(closed_ || failed_) {
+            break;
+        }
+        waiting_ = true;
+        entry_ = coroutine::Processor::Suspend();
+        lock.unlock();
+        coroutine::Processor::Yield();
+        lock.lock();
+    }
+}
+
+bool RpcFrameWriter::waitWritable(Clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(!closed_ && !failed_ && pending_.size() + sending_ >= highWater_) {
+        if(Clock::now() >= deadline) {
+            return false;
+        }
+        if(Clock::time_point::max() == deadline) {
+            writableWaiters_.push_back(coroutine::Processor::Suspend());
+        } else {
+            writableWaiters_.push_back(coroutine::Processor::Suspend(deadline));
+        }
+        lock.unlock();
+        coroutine::Processor::Yield();
+        lock.lock();
+        //被定时器唤醒时清理失效的等待项
+        std::erase_if(writableWaiters_, [](const coroutine::Processor::SuspendEntry& entry) {
+            return coroutine::Processor::IsExpired(entry);
+        });
+    }
+    return !closed_ && !failed_;
+}
+
+bool RpcFrameWriter::isClosed() {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    return closed_ || failed_;
+}
+
+void RpcFrameWriter::close() {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    closed_ = true;
+    notify();
+    notifyWritable();
+}
+
+void RpcFrameWriter::notify() {
+    if(waiting_) {
+        waiting_ = false;
+        coroutine::Processor::WakeUp(entry_);
+    }
+}
+
+void RpcFrameWriter::notifyWritable() {
+    for(auto& entry : writableWaiters_) {
+        if(!coroutine::Processor::IsExpired(entry)) {
+            coroutine::Processor::WakeUp(entry);
+        }
+    }
+    writableWaiters_.clear();
+}
+
+} // namespace rpc
+} // namespace net
+} // namespace nemo
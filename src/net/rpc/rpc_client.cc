@@ -0,0 +1,243 @@
+#include "net/rpc/rpc_client.h"
+
+#include <sys/socket.h>
+
+#include "coroutine/coroutine.h"
+#include "log/log.h"
+#include "common/config.h"
+
+namespace nemo {
+namespace net {
+namespace rpc {
+
+static ConfigVar<uint32_t>* rpcClientConnections =
+   Config::Lookup("rpc.client.connections", (uint32_t)2,
+            "connections kept by one rpc client");
+static ConfigVar<uint64_t>* rpcClientTimeout =
+   Config::Lookup("rpc.client.timeout", (uint64_t)(5 * 1000),
+            "default rpc call timeout");
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+/**
+ * @brief 在指定的调度器中启动协程, 为空时使用当前协程所在的调度器, 不在协程中时使用全局调度器
+ */
+static void Spawn(coroutine::Scheduler* scheduler, coroutine::Scheduler::Callback&& cb) {
+    coroutine::Processor* processor = coroutine::Processor::GetCurrentProcessor();
+    if(!scheduler && processor) {
+        scheduler = processor->getScheduler();
+    }
+    if(scheduler) {
+        scheduler->addTask(std::move(cb));
+    } else {
+        coroutine_async std::move(cb);
+    }
+}
+
+RpcChannel::SharedPtr RpcChannel::Connect(const Address* address, coroutine::Scheduler* scheduler) {
+    Socket::UniquePtr sock = Socket::CreateTcp(address);
+    if(!sock->connect(address)) {
+        NEMO_LOG_ERROR(systemLogger) << "rpc connect fail: " << *address
+            << " errno=" << errno << " errstr=" << strerror(errno);
+        return nullptr;
+    }
+    auto channel = std::make_shared<RpcChannel>(std::move(sock));
+    channel->start(scheduler);
+    return channel;
+}
+
+RpcChannel::RpcChannel(Socket::UniquePtr&& sock)
+    : sock_(std::move(sock)),
+      writer_(sock_.get()) {
+}
+
+RpcChannel::~RpcChannel() {
+    sock_->close();
+}
+
+void RpcChannel::start(coroutine::Scheduler* scheduler) {
+    auto self = shared_from_this();
+    Spawn(scheduler, [self]() {
+        self->writer_.run();
+    });
+    Spawn(scheduler, [self]() {
+        self->readLoop();
+    });
+}
+
+RpcStatus RpcChannel::call(uint32_t methodId, StringArg request, String& response,
+                           uint64_t timeoutMillionSeconds) {
+    auto deadline = coroutine::WaitGroup::Clock::now()
+                        + std::chrono::milliseconds(timeoutMillionSeconds);
+    //连接上积压的请求超过高水位时等待发送, 等待的时间也计入超时
+    if(!writer_.waitWritable(deadline)) {
+        return writer_.isClosed() ? RpcStatus::CONNECTION_ERROR : RpcStatus::TIMEOUT;
+    }
+    auto call = std::make_shared<Call>();
+    RpcHeader header;
+    header.methodId = methodId;
+    {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        if(broken_) {
+            return RpcStatus::CONNECTION_ERROR;
+        }
+        header.requestId = ++nextRequestId_;
+        calls_.emplace(header.requestId, call);
+    }
+    bool written = writer_.write(header, request);
+    if(!written || !call->done.waitUntil(deadline)) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(calls_.erase(header.requestId) > 0) {
+            return written ? RpcStatus::TIMEOUT : RpcStatus::CONNECTION_ERROR;
+        }
+        //读协程已经取走了这个调用, 马上就会完成
+        lock.unlock();
+        call->done.wait();
+    }
+    if(RpcStatus::OK == call->status) {
+        response.swap(call->response);
+    }
+    return call->status;
+}
+
+bool RpcChannel::notify(uint32_t methodId, StringArg request) {
+    RpcHeader header;
+    header.flags = RpcFlag::ONEWAY;
+    header.methodId = methodId;
+    if(!writer_.waitWritable()) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        if(broken_) {
+            return false;
+        }
+        header.requestId = ++nextRequestId_;
+    }
+    return writer_.write(header, request);
+}
+
+void RpcChannel::close() {
+    ::shutdown(sock_->getSocketFd(), SHUT_RDWR);
+}
+
+size_t RpcChannel::getPendingCount() {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    return calls_.size();
+}
+
+void RpcChannel::readLoop() {
+    RpcFrameReader reader(sock_.get());
+    RpcHeader header;
+    StringArg payload;
+    while(reader.read(header, payload)) {
+        if(!header.hasFlag(RpcFlag::RESPONSE)) {
+            NEMO_LOG_WARN(systemLogger) << "unexpected rpc request, request_id="
+                << header.requestId << " " << *sock_;
+            break;
+        }
+        CallPtr call;
+        {
+            std::lock_guard<std::mutex> lockGuard(mutex_);
+            auto iter = calls_.find(header.requestId);
+            if(calls_.end() == iter) { //已经超时
+                continue;
+            }
+            call = std::move(iter->second);
+            calls_.erase(iter);
+        }
+        call->status = header.status;
+        call->response.assign(payload.data(), payload.size());
+        call->done.done();
+    }
+
+    std::unordered_map<uint64_t, CallPtr> calls;
+    {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        broken_ = true;
+        calls.swap(calls_);
+    }
+    if(!reader.isPeerClosed() || !calls.empty()) {
+        NEMO_LOG_WARN(systemLogger) << "rpc connection broken, pending=" << calls.size()
+            << " errno=" << errno << " " << *sock_;
+    }
+    for(auto& [id, call] : calls) {
+        call->status = RpcStatus::CONNECTION_ERROR;
+        call->done.done();
+    }
+    ::shutdown(sock_->getSocketFd(), SHUT_RDWR);
+    writer_.close();
+}
+
+RpcClient::RpcClient(const Address* address, size_t connections,
+                     const coroutine::Scheduler::SharedPtr& scheduler)
+    : address_(Address::Create(address->getAddr(), address->getAddrLen())),
+      scheduler_(scheduler),
+      channels_(connections > 0 ? connections : std::max<size_t>(rpcClientConnections->getValue(), 1)) {
+}
+
+RpcClient::~RpcClient() {
+    close();
+}
+
+RpcStatus RpcClient::call(uint32_t methodId, StringArg request, String& response,
+                          uint64_t timeoutMillionSeconds) {
+    RpcChannel::SharedPtr channel = getChannel();
+    if(!channel) {
+        return RpcStatus::CONNECTION_ERROR;
+    }
+    if(0 == timeoutMillionSeconds) {
+        timeoutMillionSeconds = rpcClientTimeout->getValue();
+    }
+    return channel->call(methodId, request, response, timeoutMillionSeconds);
+}
+
+bool RpcClient::notify(uint32_t methodId, StringArg request) {
+    RpcChannel::SharedPtr channel = getChannel();
+    return channel && channel->notify(methodId, request);
+}
+
+void RpcClient::close() {
+    std::vector<RpcChannel::SharedPtr> channels;
+    {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        channels.swap(channels_);
+        channels_.resize(channels.size());
+    }
+    for(auto& channel : channels) {
+        if(channel) {
+            channel->close();
+        }
+    }
+}
+
+RpcChannel::SharedPtr RpcClient::getChannel() {
+    size_t index = next_++;
+    RpcChannel::SharedPtr channel;
+    {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        index %= channels_.size();
+        channel = channels_[index];
+        if(channel && !channel->isBroken()) {
+            return channel;
+        }
+    }
+    //在锁外建立连接, 同时有其它协程建立了这个位置的连接时使用先建立的
+    RpcChannel::SharedPtr created = RpcChannel::Connect(address_.get(), scheduler_.get());
+    if(!created) {
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        channel = channels_[index];
+        if(!channel || channel->isBroken()) {
+            channels_[index] = created;
+            return created;
+        }
+    }
+    created->close();
+    return channel;
+}
+
+} // namespace rpc
+} // namespace net
+} // namespace nemo
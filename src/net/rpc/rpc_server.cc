@@ -0,0 +1,96 @@
+#include "net/rpc/rpc_server.h"
+
+#include <sys/socket.h>
+
+#include "coroutine/wait_group.h"
+#include "log/log.h"
+#include "common/config.h"
+
+namespace nemo {
+namespace net {
+namespace rpc {
+
+static ConfigVar<uint32_t>* rpcMaxConcurrentRequests =
+   Config::Lookup("rpc.max_concurrent_requests", (uint32_t)1024,
+            "max requests handled concurrently on one rpc connection, more are rejected with UNAVAILABLE");
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+RpcServer::RpcServer(const coroutine::Scheduler::SharedPtr& ioScheduler,
+        const coroutine::Scheduler::SharedPtr& acceptScheduler,
+        const coroutine::Scheduler::SharedPtr& handleScheduler) :
+    TcpServer(ioScheduler, acceptScheduler, handleScheduler) {
+    config_->type = "rpc";
+}
+
+void RpcServer::registerHandler(uint32_t methodId, Handler handler) {
+    handlers_[methodId] = std::move(handler);
+}
+
+void RpcServer::handleClient(Socket::SharedPtr client) {
+    //优雅关闭时关闭读端, 已经收到的请求处理完并发送响应后连接结束
+    ConnectionPtr connection = getConnection(client.get());
+    if(connection) {
+        int fd = client->getSocketFd();
+        setDrainCallback(connection, [fd]() {
+            ::shutdown(fd, SHUT_RD);
+        });
+    }
+
+    RpcFrameWriter writer(client.get());
+    coroutine::WaitGroup writerDone(1);
+    handleScheduler_->addTask([&writer, &writerDone]() {
+        writer.run();
+        writerDone.done();
+    });
+
+    size_t maxConcurrent = rpcMaxConcurrentRequests->getValue();
+    coroutine::WaitGroup handlers;
+    RpcFrameReader reader(client.get());
+    RpcHeader header;
+    StringArg payload;
+    //响应(包括UNAVAILABLE)积压超过高水位时先不读新请求, 让TCP窗口把压力传给客户端
+    while(writer.waitWritable() && reader.read(header, payload)) {
+        if(header.hasFlag(RpcFlag::RESPONSE)) {
+            NEMO_LOG_WARN(systemLogger) << "unexpected rpc response, request_id="
+                << header.requestId << " " << *client;
+            break;
+        }
+        bool oneway = header.hasFlag(RpcFlag::ONEWAY);
+        RpcHeader response;
+        response.flags = RpcFlag::RESPONSE;
+        response.methodId = header.methodId;
+        response.requestId = header.requestId;
+
+        auto iter = handlers_.find(header.methodId);
+        if(handlers_.end() == iter || handlers.count() >= maxConcurrent) {
+            if(!oneway) {
+                response.status = handlers_.end() == iter ? RpcStatus::NOT_FOUND : RpcStatus::UNAVAILABLE;
+                writer.write(response, StringArg());
+            }
+            continue;
+        }
+
+        //负载指向读缓冲区, 复制一份交给处理协程
+        handlers.add();
+        const Handler* handler = &iter->second;
+        handleScheduler_->addTask([handler, &writer, &handlers, response, oneway,
+                                   request = String(payload.data(), payload.size())]() mutable {
+            String out;
+            response.status = (*handler)(request, out);
+            if(!oneway) {
+                writer.write(response, RpcStatus::OK == response.status ? StringArg(out) : StringArg());
+            }
+            handlers.done();
+        });
+    }
+
+    //等待所有处理协程写入响应, 再等写协程发送完
+    handlers.wait();
+    writer.close();
+    writerDone.wait();
+    client->close();
+}
+
+} // namespace rpc
+} // namespace net
+} // namespace nemo
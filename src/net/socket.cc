@@ -1,8 +1,14 @@
 #include "net/socket.h"
 
+#include <arpa/inet.h>
 #include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/sendfile.h>
+
+#include <algorithm>
 
 #include "net/io/hook.h"
+#include "net/ssl_context.h"
 #include "log/log.h"
 #include "util/file_descriptor.h"
 #include "common/macro.h"
@@ -15,7 +21,7 @@ static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
 void Socket::initSock() {
     int val = 1;
     setOption(SOL_SOCKET, SO_REUSEADDR, val);
-    if(SOCK_STREAM == sockAttr_.type) {
+    if(SOCK_STREAM == sockAttr_.type && AF_UNIX != sockAttr_.family) {
         setOption(IPPROTO_TCP, TCP_NODELAY, val);
     }
 }
@@ -85,6 +91,30 @@ Socket::UniquePtr Socket::CreateUnixUdpSocket() {
     return std::make_unique<Socket>(SocketAttribute::Family::Unix, SocketAttribute::Type::Udp, 0);
 }
 
+Socket::UniquePtr Socket::Adopt(int fd) {
+    int family = 0;
+    int type = 0;
+    int protocol = 0;
+    socklen_t len = sizeof(int);
+    if(::getsockopt(fd, SOL_SOCKET, SO_DOMAIN, &family, &len) ||
+        ::getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) ||
+        ::getsockopt(fd, SOL_SOCKET, SO_PROTOCOL, &protocol, &len)) {
+        NEMO_LOG_ERROR(systemLogger) << "adopt sock=" << fd << " errno="
+            << errno << " errstr=" << strerror(errno);
+        return nullptr;
+    }
+    file_util::FdManager& fdManager = file_util::FdManager::GetInstance();
+    if(!fdManager.get(fd)) {
+        fdManager.add(std::make_unique<file_util::FdContext>(fd,
+                        file_util::FdContext::FdType::Socket, false,
+                        SocketAttribute(family, type, protocol)));
+    }
+    Socket::UniquePtr sock = std::make_unique<Socket>(family, type, protocol);
+    sock->sockFd_ = fd;
+    sock->getLocalAddress();
+    return sock;
+}
+
 Socket::Socket(int family, int type, int protocol) :
     sockAttr_(family, type, protocol),
     sockFd_(-1),
@@ -274,6 +304,13 @@ int Socket::send(const iovec* buffers, size_t length, int flags) {
     return -1;
 }
 
+int64_t Socket::sendFile(int fd, off_t offset, size_t length) {
+    if(isConnect()) {
+        return ::sendfile(sockFd_, fd, &offset, length);
+    }
+    return -1;
+}
+
 int Socket::sendTo(const void* buffer, size_t length, const Address* to, int flags) {
     if(isConnect()) {
         return ::sendto(sockFd_, buffer, length, flags, to->getAddr(), to->getAddrLen());
@@ -415,6 +452,21 @@ int Socket::getError() {
     return error;
 }
 
+bool Socket::getPeerCredentials(PeerCredentials& credentials) {
+    if(AF_UNIX != sockAttr_.family) {
+        return false;
+    }
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    if(!getOption(SOL_SOCKET, SO_PEERCRED, &cred, &len)) {
+        return false;
+    }
+    credentials.pid = cred.pid;
+    credentials.uid = cred.uid;
+    credentials.gid = cred.gid;
+    return true;
+}
+
 std::ostream& Socket::dump(std::ostream& os) const {
     os << "[Socket sock=" << sockFd_
        << " is_connected=" << isConnect_
@@ -454,13 +506,76 @@ static SslInit sslInit;
 bool SecureSocket::init(int sock) {
     bool result = Socket::init(sock);
     if(result) {
+        //握手在第一次读写或者handshake()时进行, 不阻塞accept的协程
         ssl_.reset(SSL_new(sslCtx_.get()));
         ::SSL_set_fd(ssl_.get(), sockFd_);
-        result = (SSL_accept(ssl_.get()) == 1);
+        ::SSL_set_accept_state(ssl_.get());
+        SslContextRegistry::SetAlpnProtocols(ssl_.get(), alpnProtocols_.get());
+        result = setNonBlocking();
     }
     return result;
 }
 
+bool SecureSocket::setNonBlocking() {
+    //fd非阻塞时hook直接返回EAGAIN, 由doSsl根据SSL_ERROR_WANT_READ/WANT_WRITE等待
+    int flags = ::fcntl(sockFd_, F_GETFL, 0);
+    return flags != -1 && ::fcntl(sockFd_, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+bool SecureSocket::waitIo(int sslError, int timeoutType) {
+    file_util::FdContext* fdCtx = file_util::FdManager::GetInstance().get(sockFd_);
+    long timeout = fdCtx ? fdCtx->getSocketTimeoutMicroSeconds(timeoutType) : 0;
+    int timeoutMillionSeconds = timeout <= 0 ? -1 : (timeout < 1000 ? 1 : timeout / 1000);
+    short events = (SSL_ERROR_WANT_READ == sslError) ? POLLIN : POLLOUT;
+    return io::WaitFd(sockFd_, events, timeoutMillionSeconds) > 0;
+}
+
+template<typename Fn>
+int SecureSocket::doSsl(const Fn& fn, int timeoutType) {
+    while(true) {
+        ::ERR_clear_error();
+        int result = fn();
+        if(result > 0) {
+            return result;
+        }
+        int error = ::SSL_get_error(ssl_.get(), result);
+        switch(error) {
+            case SSL_ERROR_WANT_READ:
+                [[fallthrough]];
+            case SSL_ERROR_WANT_WRITE:
+                //读的时候也可能要写(重新协商, TLS 1.3的KeyUpdate), 反之亦然
+                if(!waitIo(error, timeoutType)) {
+                    return -1;
+                }
+                break;
+            case SSL_ERROR_ZERO_RETURN:
+                return 0;
+            default:
+                NEMO_LOG_DEBUG(systemLogger) << "ssl error=" << error << " errno=" << errno
+                    << " " << ::ERR_error_string(::ERR_peek_error(), nullptr) << " " << *this;
+                return -1;
+        }
+    }
+}
+
+bool SecureSocket::handshake() {
+    if(!ssl_) {
+        return false;
+    }
+    if(::SSL_is_init_finished(ssl_.get())) {
+        return true;
+    }
+    return doSsl([this]() {
+        return ::SSL_do_handshake(ssl_.get());
+    }, SO_RCVTIMEO) > 0;
+}
+
+int SecureSocket::writeFully(const void* buffer, size_t length) {
+    return doSsl([this, buffer, length]() {
+        return ::SSL_write(ssl_.get(), buffer, length);
+    }, SO_SNDTIMEO);
+}
+
 SecureSocket::UniquePtr SecureSocket::CreateTcp(Address* address) {
     return std::make_unique<SecureSocket>(address->getFamily(), 
         SocketAttribute::Type::Tcp, 0);
@@ -496,6 +611,7 @@ Socket::UniquePtr SecureSocket::accept() {
     }
     SecureSocket* sSock = down_cast<SecureSocket*>(sock.get());
     sSock->sslCtx_ = sslCtx_;
+    sSock->alpnProtocols_ = alpnProtocols_;
     if(!sSock->init(newsock)) {
         return nullptr;
     }
@@ -509,10 +625,29 @@ bool SecureSocket::bind(const Address* addr) {
 bool SecureSocket::connect(const Address* address) {
     bool result = Socket::connect(address);
     if(result) {
-        sslCtx_.reset(::SSL_CTX_new(SSLv23_client_method()), SslCtxDeleter{});
+        SslContextRegistry& registry = SslContextRegistry::GetInstance();
+        sslCtx_ = registry.getClientContext();
+        if(!sslCtx_) {
+            return false;
+        }
         ssl_.reset(::SSL_new(sslCtx_.get()));
         ::SSL_set_fd(ssl_.get(), sockFd_);
-        result = (::SSL_connect(ssl_.get()) == 1);
+        sessionKey_ = address->toString();
+        if(!serverName_.empty()) {
+            sessionKey_.append("/").append(serverName_);
+            //SNI不能是IP地址
+            in6_addr ip;
+            if(::inet_pton(AF_INET, serverName_.c_str(), &ip) != 1 &&
+                    ::inet_pton(AF_INET6, serverName_.c_str(), &ip) != 1) {
+                ::SSL_set_tlsext_host_name(ssl_.get(), serverName_.c_str());
+            }
+        }
+        registry.prepareClientSession(ssl_.get(), &sessionKey_);
+        ::SSL_set_connect_state(ssl_.get());
+        result = setNonBlocking() && handshake();
+        if(!result) {
+            registry.removeClientSession(sessionKey_);
+        }
     }
     return result;
 }
@@ -526,30 +661,89 @@ bool SecureSocket::close() {
 }
 
 int SecureSocket::send(const void* buffer, size_t length, int flags) {
-    if(ssl_) {
-        return ::SSL_write(ssl_.get(), buffer, length);
+    if(!handshake()) {
+        return -1;
     }
-    return -1;
+    return writeFully(buffer, length);
 }
 
 int SecureSocket::send(const iovec* buffers, size_t length, int flags) {
-    if(!ssl_) {
+    if(!handshake()) {
         return -1;
     }
+    //小的数据块合并成最大16KB的TLS记录再写, 减少记录数和系统调用
     int total = 0;
+    writeBuffer_.clear();
     for(size_t i = 0; i < length; ++i) {
-        int tmp = ::SSL_write(ssl_.get(), buffers[i].iov_base, buffers[i].iov_len);
-        if(tmp <= 0) {
-            return tmp;
+        const char* data = static_cast<const char*>(buffers[i].iov_base);
+        size_t len = buffers[i].iov_len;
+        if(writeBuffer_.empty() && len >= kMaxTlsRecord) {
+            int result = writeFully(data, len);
+            if(result <= 0) {
+                return total ? total : result;
+            }
+            total += result;
+            continue;
         }
-        total += tmp;
-        if(tmp != (int)buffers[i].iov_len) {
-            break;
+        while(len > 0) {
+            size_t n = std::min(len, kMaxTlsRecord - writeBuffer_.size());
+            writeBuffer_.append(data, n);
+            data += n;
+            len -= n;
+            if(writeBuffer_.size() == kMaxTlsRecord) {
+                int result = writeFully(writeBuffer_.data(), writeBuffer_.size());
+                if(result <= 0) {
+                    return total ? total : result;
+                }
+                total += result;
+                writeBuffer_.clear();
+            }
+        }
+    }
+    if(!writeBuffer_.empty()) {
+        int result = writeFully(writeBuffer_.data(), writeBuffer_.size());
+        if(result <= 0) {
+            return total ? total : result;
         }
+        total += result;
     }
     return total;
 }
 
+int64_t SecureSocket::sendFile(int fd, off_t offset, size_t length) {
+    if(!handshake()) {
+        return -1;
+    }
+    if(!isKtlsSend()) {
+        return sendFileFallback(fd, offset, length);
+    }
+    //内核加密, socket写满时SSL_sendfile返回SSL_ERROR_WANT_WRITE
+    size_t n = std::min(length, kMaxSendFileBytes);
+    return doSsl([this, fd, offset, n]() {
+        return static_cast<int>(::SSL_sendfile(ssl_.get(), fd, offset, n, 0));
+    }, SO_SNDTIMEO);
+}
+
+int64_t SecureSocket::sendFileFallback(int fd, off_t offset, size_t length) {
+    //按TLS记录的大小读出文件内容, 在用户态加密后发送
+    int64_t total = 0;
+    writeBuffer_.resize(kMaxTlsRecord);
+    while(static_cast<size_t>(total) < length) {
+        size_t n = std::min(length - total, kMaxTlsRecord);
+        ssize_t bytes = ::pread(fd, &writeBuffer_[0], n, offset + total);
+        if(bytes <= 0) {
+            return total ? total : bytes;
+        }
+        int result = writeFully(writeBuffer_.data(), bytes);
+        if(result <= 0) {
+            return total ? total : result;
+        }
+        total += result;
+    }
+    writeBuffer_.clear();
+    return total;
+}
+
 int SecureSocket::sendTo(const void* buffer, 
     size_t length, const Address* to, int flags) {
     NEMO_LOG_WARN(systemLogger) << "Not implements the method";
@@ -563,24 +757,33 @@ int SecureSocket::sendTo(const iovec* buffers,
 }
 
 int SecureSocket::recv(void* buffer, size_t length, int flags) {
-    if(ssl_) {
-        return ::SSL_read(ssl_.get(), buffer, length);
+    if(!handshake()) {
+        return -1;
     }
-    return -1;
+    return doSsl([this, buffer, length]() {
+        return ::SSL_read(ssl_.get(), buffer, length);
+    }, SO_RCVTIMEO);
 }
 
 int SecureSocket::recv(iovec* buffers, size_t length, int flags) {
-    if(!ssl_) {
+    if(!handshake()) {
         return -1;
     }
+    //第一个缓冲区等待数据, 之后只读取已经到达的数据
     int total = 0;
     for(size_t i = 0; i < length; ++i) {
-        int tmp = ::SSL_read(ssl_.get(), buffers[i].iov_base, buffers[i].iov_len);
-        if(tmp <= 0) {
-            return tmp;
+        int result = 0;
+        if(0 == i) {
+            result = recv(buffers[i].iov_base, buffers[i].iov_len);
+        } else {
+            ::ERR_clear_error();
+            result = ::SSL_read(ssl_.get(), buffers[i].iov_base, buffers[i].iov_len);
         }
-        total += tmp;
-        if(tmp != (int)buffers[i].iov_len) {
+        if(result <= 0) {
+            return total ? total : result;
+        }
+        total += result;
+        if(result != (int)buffers[i].iov_len) {
             break;
         }
     }
@@ -597,24 +800,39 @@ int SecureSocket::recvFrom(iovec* buffers, size_t length, Address* from, int fla
     return -1;
 }
 
+bool SecureSocket::isSessionReused() const {
+    return ssl_ && ::SSL_session_reused(ssl_.get()) == 1;
+}
+
+bool SecureSocket::isKtlsSend() const {
+    return ssl_ && BIO_get_ktls_send(::SSL_get_wbio(ssl_.get()));
+}
+
 bool SecureSocket::loadCertificates(StringArg certFile, StringArg keyFile) {
-    sslCtx_.reset(::SSL_CTX_new(SSLv23_server_method()), SslCtxDeleter{});
-    if(::SSL_CTX_use_certificate_chain_file(sslCtx_.get(), certFile.data()) != 1) {
-        NEMO_LOG_ERROR(systemLogger) << "SSL_CTX_use_certificate_chain_file("
-            << certFile << ") error";
-        return false;
-    }
-    if(::SSL_CTX_use_PrivateKey_file(sslCtx_.get(), keyFile.data(), SSL_FILETYPE_PEM) != 1) {
-        NEMO_LOG_ERROR(systemLogger) << "SSL_CTX_use_PrivateKey_file("
-            << keyFile << ") error";
-        return false;
+    sslCtx_ = SslContextRegistry::GetInstance().getServerContext(certFile, keyFile);
+    return !!sslCtx_;
+}
+
+void SecureSocket::setAlpnProtocols(const std::vector<String>& protocols) {
+    auto wire = std::make_shared<String>();
+    for(const String& protocol : protocols) {
+        if(protocol.empty() || protocol.size() > 255) {
+            continue;
+        }
+        wire->push_back(static_cast<char>(protocol.size()));
+        wire->append(protocol);
     }
-    if(::SSL_CTX_check_private_key(sslCtx_.get()) != 1) {
-        NEMO_LOG_ERROR(systemLogger) << "SSL_CTX_check_private_key cert_file="
-            << certFile << " key_file=" << keyFile;
-        return false;
+    alpnProtocols_ = wire->empty() ? nullptr : wire;
+}
+
+String SecureSocket::getAlpnProtocol() const {
+    if(!ssl_) {
+        return String();
     }
-    return true;
+    const unsigned char* data = nullptr;
+    unsigned int len = 0;
+    ::SSL_get0_alpn_selected(ssl_.get(), &data, &len);
+    return String(reinterpret_cast<const char*>(data), len);
 }
 
 std::ostream& SecureSocket::dump(std::ostream& os) const {
@@ -0,0 +1,89 @@
+#include "net/socket_options.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <sstream>
+
+#include "net/socket.h"
+#include "log/log.h"
+
+namespace nemo {
+namespace net {
+
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+bool SocketOptions::Preset(StringArg profile, SocketOptions& options) {
+    SocketOptions preset;
+    if("default" == profile) {
+    } else if("latency" == profile) {
+        preset.deferAcceptSeconds = 1;
+        preset.fastOpenQueue = 256;
+        preset.notSentLowatBytes = 16 * 1024;
+        preset.busyPollMicroSeconds = 50;
+    } else if("throughput" == profile) {
+        preset.backlog = 16384; //受net.core.somaxconn限制
+        preset.deferAcceptSeconds = 1;
+        preset.recvBufferBytes = 4 * 1024 * 1024;
+        preset.sendBufferBytes = 4 * 1024 * 1024;
+    } else {
+        NEMO_LOG_ERROR(systemLogger) << "unknown socket profile: " << profile
+            << ", expect default, latency or throughput";
+        return false;
+    }
+    preset.profile.assign(profile.data(), profile.size());
+    options = preset;
+    return true;
+}
+
+void SocketOptions::applyToListener(Socket* sock) const {
+    //缓冲区大小要在listen之前设置, 否则握手时通告的窗口扩大因子不会变化
+    if(recvBufferBytes > 0) {
+        sock->setOption(SOL_SOCKET, SO_RCVBUF, recvBufferBytes);
+    }
+    if(sendBufferBytes > 0) {
+        sock->setOption(SOL_SOCKET, SO_SNDBUF, sendBufferBytes);
+    }
+    //UDP和Unix域socket只设置SOL_SOCKET级别的缓冲区大小
+    if(SOCK_STREAM != sock->getAttribute().type || AF_UNIX == sock->getAttribute().family) {
+        return;
+    }
+    if(deferAcceptSeconds > 0) {
+        sock->setOption(IPPROTO_TCP, TCP_DEFER_ACCEPT, deferAcceptSeconds);
+    }
+    if(fastOpenQueue > 0) {
+        sock->setOption(IPPROTO_TCP, TCP_FASTOPEN, fastOpenQueue);
+    }
+    if(notSentLowatBytes > 0) {
+        sock->setOption(IPPROTO_TCP, TCP_NOTSENT_LOWAT, notSentLowatBytes);
+    }
+    if(busyPollMicroSeconds > 0 &&
+            !sock->setOption(SOL_SOCKET, SO_BUSY_POLL, busyPollMicroSeconds)) {
+        NEMO_LOG_WARN(systemLogger) << "SO_BUSY_POLL needs CAP_NET_ADMIN or a larger"
+            << " net.core.busy_read, profile=" << profile;
+    }
+}
+
+void SocketOptions::applyToConnection(Socket* sock) const {
+    //Socket::init已经开启了TCP_NODELAY
+    if(!noDelay && AF_UNIX != sock->getAttribute().family) {
+        sock->setOption(IPPROTO_TCP, TCP_NODELAY, 0);
+    }
+}
+
+String SocketOptions::toString() const {
+    std::stringstream ss;
+    ss << "[profile=" << profile
+       << " backlog=" << backlog
+       << " tcp_nodelay=" << noDelay
+       << " defer_accept=" << deferAcceptSeconds
+       << " fast_open=" << fastOpenQueue
+       << " rcvbuf=" << recvBufferBytes
+       << " sndbuf=" << sendBufferBytes
+       << " notsent_lowat=" << notSentLowatBytes
+       << " busy_poll=" << busyPollMicroSeconds << "]";
+    return ss.str();
+}
+
+} // namespace net
+} // namespace nemo
@@ -0,0 +1,289 @@
+#include "net/ssl_context.h"
+
+#include <string.h>
+
+#include <openssl/core_names.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include "log/log.h"
+#include "common/config.h"
+
+namespace nemo {
+namespace net {
+
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+static ConfigVar<bool>* tlsSessionTicketsConfig =
+    Config::Lookup("tls.session_tickets", true,
+                    "issue stateless session tickets so that clients can resume tls sessions");
+
+static ConfigVar<uint32_t>* tlsSessionTimeoutConfig =
+    Config::Lookup("tls.session_timeout", static_cast<uint32_t>(7200),
+                    "lifetime(seconds) of resumable tls sessions and tickets");
+
+static ConfigVar<uint32_t>* tlsTicketKeyRotationConfig =
+    Config::Lookup("tls.ticket_key_rotation", static_cast<uint32_t>(3600),
+                    "seconds after which a new session ticket key is used for encryption");
+
+static ConfigVar<uint32_t>* tlsServerSessionCacheSizeConfig =
+    Config::Lookup("tls.server_session_cache_size", static_cast<uint32_t>(20480),
+                    "max sessions kept by the server side session id cache");
+
+static ConfigVar<uint32_t>* tlsClientSessionCacheSizeConfig =
+    Config::Lookup("tls.client_session_cache_size", static_cast<uint32_t>(1024),
+                    "max (address, server name) entries of the client side session cache, 0 disables the cache");
+
+static ConfigVar<bool>* tlsKtlsConfig =
+    Config::Lookup("tls.ktls", false,
+                    "offload record encryption to the kernel(kTLS) after the handshake when supported");
+
+static const unsigned char kSessionIdContext[] = "nemo";
+
+static int SessionKeyIndex() {
+    static int index = ::SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+static int AlpnIndex() {
+    static int index = ::SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+/**
+ * @brief 按服务端的优先级选择协议, 没有共同的协议时不使用ALPN
+ */
+static int AlpnSelectCallback(SSL* ssl, const unsigned char** out, unsigned char* outlen,
+                              const unsigned char* in, unsigned int inlen, void* arg) {
+    const String* protocols = static_cast<const String*>(::SSL_get_ex_data(ssl, AlpnIndex()));
+    if(!protocols) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    unsigned char* selected = nullptr;
+    if(::SSL_select_next_proto(&selected, outlen,
+            reinterpret_cast<const unsigned char*>(protocols->data()), protocols->size(),
+            in, inlen) != OPENSSL_NPN_NEGOTIATED) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    *out = selected;
+    return SSL_TLSEXT_ERR_OK;
+}
+
+static void LogSslError(StringArg what) {
+    char buffer[256];
+    unsigned long err = ::ERR_get_error();
+    ::ERR_error_string_n(err, buffer, sizeof(buffer));
+    NEMO_LOG_ERROR(systemLogger) << what << " error: " << buffer;
+    ::ERR_clear_error();
+}
+
+SslContextRegistry::SslContextRegistry(Token) :
+    clientSessions_(tlsClientSessionCacheSizeConfig->getValue()) {
+}
+
+SslContextRegistry::SslCtxPtr SslContextRegistry::getServerContext(StringArg certFile,
+                                                                  StringArg keyFile) {
+    String key(certFile.data(), certFile.size());
+    key.push_back('\n');
+    key.append(keyFile.data(), keyFile.size());
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    auto it = serverContexts_.find(key);
+    if(it != serverContexts_.end()) {
+        return it->second;
+    }
+
+    SslCtxPtr ctx(::SSL_CTX_new(::TLS_server_method()), ::SSL_CTX_free);
+    if(!ctx) {
+        LogSslError("SSL_CTX_new");
+        return nullptr;
+    }
+    if(::SSL_CTX_use_certificate_chain_file(ctx.get(), certFile.data()) != 1) {
+        LogSslError("SSL_CTX_use_certificate_chain_file(" + String(certFile) + ")");
+        return nullptr;
+    }
+    if(::SSL_CTX_use_PrivateKey_file(ctx.get(), keyFile.data(), SSL_FILETYPE_PEM) != 1) {
+        LogSslError("SSL_CTX_use_PrivateKey_file(" + String(keyFile) + ")");
+        return nullptr;
+    }
+    if(::SSL_CTX_check_private_key(ctx.get()) != 1) {
+        LogSslError("SSL_CTX_check_private_key cert_file=" + String(certFile)
+                    + " key_file=" + String(keyFile));
+        return nullptr;
+    }
+
+    ::SSL_CTX_set_session_id_context(ctx.get(), kSessionIdContext, sizeof(kSessionIdContext) - 1);
+    ::SSL_CTX_set_session_cache_mode(ctx.get(), SSL_SESS_CACHE_SERVER);
+    ::SSL_CTX_sess_set_cache_size(ctx.get(), tlsServerSessionCacheSizeConfig->getValue());
+    ::SSL_CTX_set_timeout(ctx.get(), tlsSessionTimeoutConfig->getValue());
+    if(tlsSessionTicketsConfig->getValue()) {
+        ::SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx.get(), TicketKeyCallback);
+    } else {
+        ::SSL_CTX_set_options(ctx.get(), SSL_OP_NO_TICKET);
+        ::SSL_CTX_set_num_tickets(ctx.get(), 0);
+    }
+    ::SSL_CTX_set_alpn_select_cb(ctx.get(), AlpnSelectCallback, nullptr);
+    //没有close_notify就关闭连接按正常结束处理, HTTP有自己的消息边界
+    ::SSL_CTX_set_options(ctx.get(), SSL_OP_IGNORE_UNEXPECTED_EOF);
+    if(tlsKtlsConfig->getValue()) {
+        //内核或加密套件不支持时OpenSSL继续在用户态加密
+        ::SSL_CTX_set_options(ctx.get(), SSL_OP_ENABLE_KTLS);
+    }
+    serverContexts_.emplace(std::move(key), ctx);
+    return ctx;
+}
+
+SslContextRegistry::SslCtxPtr SslContextRegistry::getClientContext() {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    if(!clientContext_) {
+        clientContext_.reset(::SSL_CTX_new(::TLS_client_method()), ::SSL_CTX_free);
+        if(!clientContext_) {
+            LogSslError("SSL_CTX_new");
+            return nullptr;
+        }
+        //会话由NewSessionCallback放入clientSessions_, 不使用OpenSSL内部的缓存
+        ::SSL_CTX_set_session_cache_mode(clientContext_.get(),
+                                         SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        ::SSL_CTX_sess_set_new_cb(clientContext_.get(), NewSessionCallback);
+        ::SSL_CTX_set_options(clientContext_.get(), SSL_OP_IGNORE_UNEXPECTED_EOF);
+        if(tlsKtlsConfig->getValue()) {
+            ::SSL_CTX_set_options(clientContext_.get(), SSL_OP_ENABLE_KTLS);
+        }
+    }
+    return clientContext_;
+}
+
+bool SslContextRegistry::prepareClientSession(SSL* ssl, const String* key) {
+    ::SSL_set_ex_data(ssl, SessionKeyIndex(), const_cast<String*>(key));
+    std::shared_ptr<SSL_SESSION> session;
+    {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        if(!clientSessions_.get(*key, session)) {
+            return false;
+        }
+    }
+    //连接使用副本, 缓存中的会话不受连接关闭的影响
+    SSL_SESSION* copy = ::SSL_SESSION_dup(session.get());
+    if(!copy) {
+        return false;
+    }
+    bool result = ::SSL_set_session(ssl, copy) == 1;
+    ::SSL_SESSION_free(copy);
+    return result;
+}
+
+void SslContextRegistry::removeClientSession(const String& key) {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    clientSessions_.erase(key);
+}
+
+void SslContextRegistry::storeClientSession(const String& key, SSL_SESSION* session) {
+    std::shared_ptr<SSL_SESSION> value(session, ::SSL_SESSION_free);
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    clientSessions_.put(key, std::move(value));
+}
+
+void SslContextRegistry::clear() {
+    std::lock_guard<std::mutex> lockGuard(mutex_);
+    serverContexts_.clear();
+    clientContext_.reset();
+    clientSessions_.clear();
+}
+
+void SslContextRegistry::SetAlpnProtocols(SSL* ssl, const String* protocols) {
+    ::SSL_set_ex_data(ssl, AlpnIndex(), const_cast<String*>(protocols));
+}
+
+int SslContextRegistry::NewSessionCallback(SSL* ssl, SSL_SESSION* session) {
+    const String* key = static_cast<const String*>(::SSL_get_ex_data(ssl, SessionKeyIndex()));
+    if(!key || !::SSL_SESSION_is_resumable(session)) {
+        return 0;
+    }
+    //缓存副本: 没有发送close_notify就释放的连接, OpenSSL会把它的会话标记为不可复用
+    SSL_SESSION* copy = ::SSL_SESSION_dup(session);
+    if(copy) {
+        GetInstance().storeClientSession(*key, copy);
+    }
+    return 0;
+}
+
+bool SslContextRegistry::currentTicketKey(TicketKey& key) {
+    Clock::time_point now = Clock::now();
+    std::chrono::seconds rotation(tlsTicketKeyRotationConfig->getValue());
+    std::chrono::seconds timeout(tlsSessionTimeoutConfig->getValue());
+    std::lock_guard<std::mutex> lockGuard(ticketMutex_);
+    if(ticketKeys_.empty() || ticketKeys_.front().createdAt + rotation <= now) {
+        TicketKey newKey;
+        if(::RAND_bytes(newKey.name, sizeof(newKey.name)) != 1 ||
+                ::RAND_bytes(newKey.aesKey, sizeof(newKey.aesKey)) != 1 ||
+                ::RAND_bytes(newKey.hmacKey, sizeof(newKey.hmacKey)) != 1) {
+            return false;
+        }
+        newKey.createdAt = now;
+        ticketKeys_.push_front(newKey);
+        //密钥停止加密之后, 它加密的票据最多还能使用timeout
+        while(ticketKeys_.size() > 1 && ticketKeys_.back().createdAt + rotation + timeout <= now) {
+            ticketKeys_.pop_back();
+        }
+        NEMO_LOG_INFO(systemLogger) << "session ticket key rotated, keys=" << ticketKeys_.size();
+    }
+    key = ticketKeys_.front();
+    return true;
+}
+
+bool SslContextRegistry::findTicketKey(const unsigned char* name, TicketKey& key, bool& current) {
+    Clock::time_point now = Clock::now();
+    std::chrono::seconds rotation(tlsTicketKeyRotationConfig->getValue());
+    std::chrono::seconds timeout(tlsSessionTimeoutConfig->getValue());
+    std::lock_guard<std::mutex> lockGuard(ticketMutex_);
+    for(size_t i = 0; i < ticketKeys_.size(); ++i) {
+        if(::memcmp(ticketKeys_[i].name, name, sizeof(key.name)) != 0) {
+            continue;
+        }
+        if(ticketKeys_[i].createdAt + rotation + timeout <= now) {
+            return false;
+        }
+        key = ticketKeys_[i];
+        current = (0 == i && key.createdAt + rotation > now);
+        return true;
+    }
+    return false;
+}
+
+int SslContextRegistry::TicketKeyCallback(SSL* ssl, unsigned char* name, unsigned char* iv,
+                                          EVP_CIPHER_CTX* cipherCtx, EVP_MAC_CTX* macCtx, int enc) {
+    TicketKey key;
+    bool current = true;
+    if(enc) {
+        if(!GetInstance().currentTicketKey(key) || ::RAND_bytes(iv, 16) != 1) {
+            return -1;
+        }
+        ::memcpy(name, key.name, sizeof(key.name));
+        if(::EVP_EncryptInit_ex(cipherCtx, ::EVP_aes_256_cbc(), nullptr, key.aesKey, iv) != 1) {
+            return -1;
+        }
+    } else {
+        //找不到密钥时进行完整的握手
+        if(!GetInstance().findTicketKey(name, key, current)) {
+            return 0;
+        }
+        if(::EVP_DecryptInit_ex(cipherCtx, ::EVP_aes_256_cbc(), nullptr, key.aesKey, iv) != 1) {
+            return -1;
+        }
+    }
+
+    char digest[] = "SHA256";
+    OSSL_PARAM params[] = {
+        ::OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmacKey, sizeof(key.hmacKey)),
+        ::OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+        ::OSSL_PARAM_construct_end()
+    };
+    if(::EVP_MAC_CTX_set_params(macCtx, params) != 1) {
+        return -1;
+    }
+    //用旧密钥解密成功时返回2, 让客户端换成用当前密钥加密的票据
+    return current ? 1 : 2;
+}
+
+} // namespace net
+} // namespace nemo
@@ -1,5 +1,14 @@
 #include "net/tcp_server.h"
 
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "net/listener_handoff.h"
+#include "net/io/reactor.h"
 #include "log/log.h"
 #include "common/config.h"
 #include "common/macro.h"
@@ -10,8 +19,42 @@ namespace net {
 static ConfigVar<uint64_t>* tcpServerReadTimeout =
    Config::Lookup("tcp_server.read_timeout", (uint64_t)(60 * 1000 * 2),
             "tcp server read timeout");
+static ConfigVar<bool>* tcpServerParkIdle =
+   Config::Lookup("tcp_server.park_idle", false,
+            "hand idle keep-alive connections to the reactor instead of keeping a coroutine blocked");
+static ConfigVar<uint64_t>* tcpServerIdleTimeout =
+   Config::Lookup("tcp_server.idle_timeout", (uint64_t)(60 * 1000 * 2),
+            "tcp server parked idle connection timeout");
+static ConfigVar<uint32_t>* tcpServerMaxIdleConnections =
+   Config::Lookup("tcp_server.max_idle_connections", (uint32_t)10000,
+            "max parked idle connections, the oldest are closed first, 0 means unlimited");
 static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
 
+/**
+ * @brief 删除之前的进程异常退出时留下的Unix域socket文件
+ * @details 文件存在但是没有进程在监听(connect返回ECONNREFUSED)时删除, 否则bind会返回EADDRINUSE.
+ *          正常退出时也不删除文件, 热重启时新进程继承的监听socket仍然使用这个路径
+ */
+static void RemoveStaleUnixSocket(const UnixAddress* address) {
+    if(address->isAbstract()) {
+        return;
+    }
+    String path = address->getPath();
+    struct stat st;
+    if(::lstat(path.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode)) {
+        return;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0) {
+        return;
+    }
+    if(::connect(fd, address->getAddr(), address->getAddrLen()) != 0 && ECONNREFUSED == errno) {
+        NEMO_LOG_INFO(systemLogger) << "remove stale unix socket " << path;
+        ::unlink(path.c_str());
+    }
+    ::close(fd);
+}
+
 void TcpServer::handleClient(Socket::SharedPtr client) {
     //TODO 
     // 解决使用unique_ptr传参数导致进入函数之前client先释放问题
@@ -24,19 +67,171 @@ void TcpServer::startAccept(Socket* sock) {
         Socket::UniquePtr clientSock = sock->accept();
         if(clientSock) {
             clientSock->setRecvTimeout(recvTimeoutMillionSeconds_);
+            config_->socketOptions.applyToConnection(clientSock.get());
             Socket::SharedPtr clientShared = std::move(clientSock);
             NEMO_ASSERT(clientShared->getSocketFd() != -1);
-            handleScheduler_->addTask([clientShared, this](){
-                this->handleClient(clientShared);
+            auto connection = std::make_shared<Connection>();
+            connection->sock = clientShared;
+            {
+                std::lock_guard<std::mutex> lockGuard(connectionsMutex_);
+                connections_.emplace(clientShared.get(), connection);
+            }
+            handleScheduler_->addTask([connection, this](){
+                this->runClient(connection);
             });
-        } else {
+        } else if(draining_) { //监听socket已经关闭
+            break;
+        } else if(EAGAIN != errno) { //热重启期间连接可能被另一个进程取走
             NEMO_LOG_ERROR(systemLogger) << "accept errno=" << errno
                 << " errstr=" << strerror(errno);
         }
     }
 }
 
+void TcpServer::runClient(const ConnectionPtr& connection) {
+    connection->parkOnReturn = false;
+    handleClient(connection->sock);
+    if(connection->parkOnReturn && connection->sock->isConnect() && park(connection)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lockGuard(connectionsMutex_);
+    connections_.erase(connection->sock.get());
+}
+
+bool TcpServer::park(const ConnectionPtr& connection) {
+    std::vector<ConnectionPtr> evicted;
+    {
+        std::lock_guard<std::mutex> lockGuard(connectionsMutex_);
+        if(draining_) {
+            return false;
+        }
+        connection->parked = true;
+        connection->parkedAt = std::chrono::steady_clock::now();
+        connection->parkedIter = parked_.insert(parked_.end(), connection);
+        while(maxIdleConnections_ > 0 && parked_.size() > maxIdleConnections_) {
+            evicted.push_back(parked_.front());
+            unpark(parked_.front().get());
+        }
+    }
+    //被淘汰的连接由重新启动的处理协程读到EOF后结束
+    for(auto& oldest : evicted) {
+        ::shutdown(oldest->sock->getSocketFd(), SHUT_RDWR);
+    }
+
+    int fd = connection->sock->getSocketFd();
+    bool added = io::Reactor::Select(fd)->add(fd, POLLIN, io::Reactor::Entry([this, connection](short int) {
+        handleScheduler_->addTask([this, connection]() {
+            {
+                std::lock_guard<std::mutex> lockGuard(connectionsMutex_);
+                unpark(connection.get());
+            }
+            this->runClient(connection);
+        });
+    }));
+    if(!added) {
+        std::lock_guard<std::mutex> lockGuard(connectionsMutex_);
+        unpark(connection.get());
+        return false;
+    }
+    return true;
+}
+
+void TcpServer::unpark(Connection* connection) {
+    if(connection->parked) {
+        parked_.erase(connection->parkedIter);
+        connection->parked = false;
+    }
+}
+
+void TcpServer::sweepIdle() {
+    while(!stop_) {
+        ::sleep(1);
+        std::vector<ConnectionPtr> expired;
+        auto deadline = std::chrono::steady_clock::now()
+                            - std::chrono::milliseconds(idleTimeoutMillionSeconds_);
+        {
+            std::lock_guard<std::mutex> lockGuard(connectionsMutex_);
+            while(!parked_.empty() && parked_.front()->parkedAt <= deadline) {
+                expired.push_back(parked_.front());
+                unpark(parked_.front().get());
+            }
+        }
+        for(auto& connection : expired) {
+            ::shutdown(connection->sock->getSocketFd(), SHUT_RDWR);
+        }
+    }
+}
+
+TcpServer::ConnectionPtr TcpServer::getConnection(Socket* sock) {
+    std::lock_guard<std::mutex> lockGuard(connectionsMutex_);
+    auto iter = connections_.find(sock);
+    return connections_.end() == iter ? nullptr : iter->second;
+}
+
+void TcpServer::setDrainCallback(const ConnectionPtr& connection, std::function<void()> callback) {
+    {
+        std::lock_guard<std::mutex> lockGuard(connectionsMutex_);
+        connection->onDrain = callback;
+    }
+    if(draining_ && callback) {
+        callback();
+    }
+}
+
+bool TcpServer::drain(uint64_t timeoutMillionSeconds) {
+    draining_ = true;
+    for(auto& sock : sockets_) {
+        sock->close();
+    }
+
+    std::vector<std::function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> lockGuard(connectionsMutex_);
+        NEMO_LOG_INFO(systemLogger) << "drain server " << config_->name
+            << " connections=" << connections_.size();
+        for(auto& [sock, connection] : connections_) {
+            if(connection->onDrain) {
+                callbacks.push_back(connection->onDrain);
+            } else if(connection->idle) { //唤醒等待请求的协程, 读到EOF后结束连接
+                ::shutdown(sock->getSocketFd(), SHUT_RD);
+            }
+        }
+    }
+    for(auto& callback : callbacks) {
+        callback();
+    }
+
+    auto deadline = std::chrono::steady_clock::now()
+                        + std::chrono::milliseconds(timeoutMillionSeconds);
+    while(std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard<std::mutex> lockGuard(connectionsMutex_);
+            if(connections_.empty()) {
+                return true;
+            }
+        }
+        ::usleep(10 * 1000);
+    }
+
+    std::lock_guard<std::mutex> lockGuard(connectionsMutex_);
+    NEMO_LOG_WARN(systemLogger) << "drain server " << config_->name << " timeout, close "
+        << connections_.size() << " connections";
+    for(auto& [sock, connection] : connections_) {
+        ::shutdown(sock->getSocketFd(), SHUT_RDWR);
+    }
+    return connections_.empty();
+}
+
 bool TcpServer::bindAddress(const Address* address) {
+    //热重启时直接使用从旧进程接收的监听socket
+    Socket::UniquePtr inherited = ListenerHandoff::Take(address);
+    if(inherited) {
+        sockets_.emplace_back(std::move(inherited));
+        return true;
+    }
+    if(AF_UNIX == address->getFamily()) {
+        RemoveStaleUnixSocket(down_cast<const UnixAddress*>(address));
+    }
     Socket::UniquePtr sock = Socket::CreateTcp(address);
     if(!sock->bind(address)) {
         NEMO_LOG_ERROR(systemLogger) << "bind fail errno="
@@ -44,7 +239,8 @@ bool TcpServer::bindAddress(const Address* address) {
             << " address=[" << address->toString() << "]";
         return false;
     }
-    if(!sock->listen()) {
+    config_->socketOptions.applyToListener(sock.get());
+    if(!sock->listen(config_->socketOptions.backlog)) {
         NEMO_LOG_ERROR(systemLogger) << "listen fail errno="
             << errno << " errstr=" << strerror(errno)
             << " address=[" << address->toString() << "]";
@@ -60,7 +256,11 @@ TcpServer::TcpServer(const coroutine::Scheduler::SharedPtr& ioScheduler,
     Server(ioScheduler),
     acceptScheduler_(acceptScheduler),
     handleScheduler_(handleScheduler),
-    recvTimeoutMillionSeconds_(tcpServerReadTimeout->getValue()) {
+    recvTimeoutMillionSeconds_(tcpServerReadTimeout->getValue()),
+    draining_(false),
+    parkIdle_(tcpServerParkIdle->getValue()),
+    idleTimeoutMillionSeconds_(tcpServerIdleTimeout->getValue()),
+    maxIdleConnections_(tcpServerMaxIdleConnections->getValue()) {
     if (nullptr == acceptScheduler_) {
         acceptScheduler_ = ioScheduler_;
     }
@@ -109,6 +309,11 @@ bool TcpServer::start() {
             startAccept(sock.get());
         });
     }
+    if(parkIdle_) {
+        acceptScheduler_->addTask([this](){
+            sweepIdle();
+        });
+    }
     acceptScheduler_->threadStart();
     ioScheduler_->threadStart();
     handleScheduler_->threadStart();
@@ -129,6 +334,7 @@ bool TcpServer::loadCertificates(StringArg certFile, StringArg keyFile) {
     for (size_t i = 0; i < sockets_.size(); ++i) {
         SecureSocket* sSocket = dynamic_cast<SecureSocket*>(sockets_[i].get());
         if (sSocket) {
+            sSocket->setAlpnProtocols(alpnProtocols_);
             if(!sSocket->loadCertificates(certFile, keyFile)) {
                 return false;
             }
@@ -142,7 +348,8 @@ String TcpServer::toString(StringArg prefix) const {
     std::stringstream ss;
     ss << prefix << "[type=" << config_->type
        << " name=" << config_->name << " ssl=" << config_->ssl
-       << " recv_timeout=" << recvTimeoutMillionSeconds_ << "]" 
+       << " recv_timeout=" << recvTimeoutMillionSeconds_
+       << " socket=" << config_->socketOptions.toString() << "]" 
        << "\n";
     for(auto& sock : sockets_) {
         ss <<  (prefix.empty() ? "    " : prefix)
@@ -0,0 +1,371 @@
+#include "net/udp_server.h"
+
+#include <netinet/udp.h>
+#include <poll.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "net/io/hook.h"
+#include "log/log.h"
+#include "common/config.h"
+#include "common/macro.h"
+
+namespace nemo {
+namespace net {
+
+static ConfigVar<uint32_t>* udpServerBatchSize =
+   Config::Lookup("udp_server.batch_size", (uint32_t)32,
+            "max datagrams received by one recvmmsg and sent by one sendmmsg");
+static ConfigVar<uint32_t>* udpServerMaxDatagramSize =
+   Config::Lookup("udp_server.max_datagram_size", (uint32_t)2048,
+            "max size of a received datagram without gro and of a reply");
+static ConfigVar<uint32_t>* udpServerSocketsPerAddress =
+   Config::Lookup("udp_server.sockets_per_address", (uint32_t)0,
+            "SO_REUSEPORT sockets bound to each address, 0 means one per io thread");
+static ConfigVar<bool>* udpServerGro =
+   Config::Lookup("udp_server.gro", true,
+            "receive coalesced datagrams with UDP_GRO");
+static ConfigVar<bool>* udpServerGso =
+   Config::Lookup("udp_server.gso", true,
+            "send equal sized replies to the same peer as one UDP_SEGMENT message");
+static ConfigVar<uint32_t>* udpServerMtu =
+   Config::Lookup("udp_server.mtu", (uint32_t)1500,
+            "mtu of the outgoing path, caps the gso segment size so the kernel does not reject it");
+static Logger::SharedPtr systemLogger = NEMO_LOG_NAME("system");
+
+/// 等待数据时的超时时间, 超时后检查是否已经停止
+static constexpr int kPollIntervalMillionSeconds = 1000;
+/// GRO合并后一次接收的最大长度
+static constexpr size_t kMaxGroSize = 65535;
+/// 一个GSO消息最多的分段数(内核的UDP_MAX_SEGMENTS)
+static constexpr size_t kMaxGsoSegments = 64;
+/// 一个GSO消息的最大长度, 需要留出IP和UDP头部
+static constexpr size_t kMaxGsoBytes = 65000;
+/// 一个消息的控制数据长度, 接收时是UDP_GRO的int, 发送时是UDP_SEGMENT的uint16_t
+static const size_t kControlSize = CMSG_SPACE(sizeof(int));
+/// UDP头部长度
+static constexpr size_t kUdpHeaderSize = 8;
+
+/**
+ * @brief 一个socket独占的收发缓冲区, 在socket的协程中循环使用
+ */
+struct UdpServer::Ring {
+    Ring(size_t batchSize, size_t slotSize, const SocketInfo& info) :
+        info(info),
+        slotSize(slotSize),
+        buffer(batchSize * slotSize),
+        msgs(batchSize),
+        iovs(batchSize),
+        peers(batchSize),
+        controls(batchSize * kControlSize),
+        sendMsgs(batchSize),
+        sendIovs(batchSize),
+        sendControls(batchSize * kControlSize),
+        replyCounts(batchSize) {
+    }
+
+    SocketInfo info;
+    size_t slotSize;                        ///< 每个数据报的接收空间
+    std::vector<char> buffer;               ///< 接收缓冲区, 每个消息一个slot
+    std::vector<mmsghdr> msgs;
+    std::vector<iovec> iovs;
+    std::vector<sockaddr_storage> peers;
+    std::vector<char> controls;
+    std::vector<mmsghdr> sendMsgs;
+    std::vector<iovec> sendIovs;
+    std::vector<char> sendControls;
+    std::vector<size_t> replyCounts;        ///< 每个发送的消息包含的回复数
+};
+
+static bool SamePeer(const sockaddr_storage& lhs, socklen_t lhsLen,
+                     const sockaddr_storage& rhs, socklen_t rhsLen) {
+    return lhsLen == rhsLen && 0 == ::memcmp(&lhs, &rhs, lhsLen);
+}
+
+bool UdpServer::Batch::sendTo(const sockaddr* peer, socklen_t peerLen, const void* data, size_t len) {
+    if(len > maxDatagramSize_ || peerLen > sizeof(sockaddr_storage)) {
+        return false;
+    }
+    Reply& reply = replies_.emplace_back();
+    ::memcpy(&reply.peer, peer, peerLen);
+    reply.peerLen = peerLen;
+    reply.offset = payload_.size();
+    reply.size = len;
+    payload_.append(static_cast<const char*>(data), len);
+    return true;
+}
+
+void UdpServer::Batch::clear() {
+    datagrams_.clear();
+    replies_.clear();
+    payload_.clear();
+}
+
+UdpServer::UdpServer(const coroutine::Scheduler::SharedPtr& ioScheduler) :
+    Server(ioScheduler),
+    batchSize_(std::max<uint32_t>(1, udpServerBatchSize->getValue())),
+    maxDatagramSize_(std::min<size_t>(kMaxGroSize, udpServerMaxDatagramSize->getValue())),
+    socketsPerAddress_(udpServerSocketsPerAddress->getValue()),
+    mtu_(std::clamp<size_t>(udpServerMtu->getValue(), 576, kMaxGroSize)),
+    gro_(udpServerGro->getValue()),
+    gso_(udpServerGso->getValue()) {
+    if(0 == socketsPerAddress_) {
+        socketsPerAddress_ = ioScheduler_->getThreadNumber();
+    }
+    config_->type = "udp";
+}
+
+UdpServer::~UdpServer() {
+    stop();
+}
+
+bool UdpServer::bindAddress(const Address* address) {
+    for(size_t i = 0; i < socketsPerAddress_; ++i) {
+        Socket::UniquePtr sock = Socket::CreateUdp(address);
+        if(!sock->isValid() || !sock->setOption(SOL_SOCKET, SO_REUSEPORT, 1)) {
+            return false;
+        }
+        config_->socketOptions.applyToListener(sock.get());
+        //内核不支持时这个socket按单个数据报的大小接收
+        SocketInfo info;
+        info.gro = gro_ && sock->setOption(SOL_UDP, UDP_GRO, 1);
+        size_t ipHeaderSize = AF_INET6 == address->getFamily() ? 40 : 20;
+        info.maxSegment = mtu_ - ipHeaderSize - kUdpHeaderSize;
+        if(!sock->bind(address)) {
+            NEMO_LOG_ERROR(systemLogger) << "bind fail errno="
+                << errno << " errstr=" << strerror(errno)
+                << " address=[" << address->toString() << "]";
+            return false;
+        }
+        sockets_.emplace_back(std::move(sock));
+        socketInfos_.push_back(info);
+    }
+    return true;
+}
+
+bool UdpServer::bind(const Address* address, bool ssl) {
+    if(ssl) {
+        NEMO_LOG_ERROR(systemLogger) << "udp server does not support ssl";
+        return false;
+    }
+    return bindAddress(address);
+}
+
+bool UdpServer::bind(const std::vector<Address::UniquePtr>& addresses,
+        std::vector<Address*>& fails, bool ssl) {
+    for(auto& address : addresses) {
+        if(!bind(address.get(), ssl)) {
+            fails.emplace_back(address.get());
+        }
+    }
+    return fails.empty();
+}
+
+bool UdpServer::start() {
+    if(!stop_) {
+        return true;
+    }
+    stop_ = false;
+
+    for(size_t i = 0; i < sockets_.size(); ++i) {
+        Socket* rawSock = sockets_[i].get();
+        SocketInfo info = socketInfos_[i];
+        ioScheduler_->addTask([this, rawSock, info](){
+            runSocket(rawSock, info);
+        });
+    }
+    ioScheduler_->threadStart();
+    return true;
+}
+
+void UdpServer::stop() {
+    stop_ = true;
+    ioScheduler_->stop();
+
+    sockets_.clear();
+    socketInfos_.clear();
+}
+
+bool UdpServer::isGroEnabled() const {
+    return !socketInfos_.empty() && std::all_of(socketInfos_.begin(), socketInfos_.end(),
+        [](const SocketInfo& info) { return info.gro; });
+}
+
+void UdpServer::handleBatch(Batch& batch) {
+    NEMO_LOG_DEBUG(systemLogger) << "handleBatch: " << batch.size() << " datagrams";
+}
+
+void UdpServer::runSocket(Socket* sock, const SocketInfo& info) {
+    Ring ring(batchSize_, info.gro ? kMaxGroSize : maxDatagramSize_, info);
+    Batch batch(maxDatagramSize_);
+    while(!stop_) {
+        batch.clear();
+        int result = receive(sock, ring, batch);
+        if(result < 0) {
+            NEMO_LOG_ERROR(systemLogger) << "recvmmsg fail errno=" << errno
+                << " errstr=" << strerror(errno) << " " << *sock;
+            break;
+        }
+        if(0 == result) {
+            continue;
+        }
+        handleBatch(batch);
+        flush(sock, ring, batch);
+    }
+}
+
+int UdpServer::receive(Socket* sock, Ring& ring, Batch& batch) {
+    int fd = sock->getSocketFd();
+    for(size_t i = 0; i < batchSize_; ++i) {
+        ring.iovs[i].iov_base = &ring.buffer[i * ring.slotSize];
+        ring.iovs[i].iov_len = ring.slotSize;
+        msghdr& hdr = ring.msgs[i].msg_hdr;
+        hdr.msg_name = &ring.peers[i];
+        hdr.msg_namelen = sizeof(sockaddr_storage);
+        hdr.msg_iov = &ring.iovs[i];
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = ring.info.gro ? &ring.controls[i * kControlSize] : nullptr;
+        hdr.msg_controllen = ring.info.gro ? kControlSize : 0;
+        hdr.msg_flags = 0;
+    }
+
+    //recvmmsg没有hook, 没有数据时挂起协程等待可读
+    int count = ::recvmmsg(fd, ring.msgs.data(), batchSize_, MSG_DONTWAIT, nullptr);
+    if(count < 0) {
+        if(EAGAIN != errno && EINTR != errno) {
+            return -1;
+        }
+        return io::WaitFd(fd, POLLIN, kPollIntervalMillionSeconds) < 0 ? -1 : 0;
+    }
+
+    for(int i = 0; i < count; ++i) {
+        msghdr& hdr = ring.msgs[i].msg_hdr;
+        if(hdr.msg_flags & MSG_TRUNC) {
+            NEMO_LOG_DEBUG(systemLogger) << "drop truncated datagram, len="
+                << ring.msgs[i].msg_len << " " << *sock;
+            continue;
+        }
+        const char* data = static_cast<const char*>(ring.iovs[i].iov_base);
+        size_t len = ring.msgs[i].msg_len;
+        size_t segment = len;
+        for(cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+            if(SOL_UDP == cmsg->cmsg_level && UDP_GRO == cmsg->cmsg_type) {
+                int gsoSize = 0;
+                ::memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof(gsoSize));
+                if(gsoSize > 0) {
+                    segment = gsoSize;
+                }
+            }
+        }
+        //GRO合并的数据报除最后一个外长度都是segment, 长度为0的数据报也交给handleBatch
+        const sockaddr* peer = reinterpret_cast<const sockaddr*>(&ring.peers[i]);
+        size_t offset = 0;
+        do {
+            size_t size = std::min(segment, len - offset);
+            batch.datagrams_.push_back({data + offset, size, peer, hdr.msg_namelen});
+            offset += size;
+        } while(offset < len);
+    }
+    return batch.datagrams_.size();
+}
+
+void UdpServer::flush(Socket* sock, Ring& ring, Batch& batch) {
+    int fd = sock->getSocketFd();
+    const std::vector<Batch::Reply>& replies = batch.replies_;
+    size_t next = 0;
+    while(next < replies.size() && !stop_) {
+        //打包最多batchSize_个消息, 开启GSO时发往同一地址的等长回复合并成一个消息,
+        //段长超过MTU时内核返回EINVAL, 这样的回复单独发送
+        bool gso = gso_;
+        size_t count = 0;
+        size_t index = next;
+        while(count < batchSize_ && index < replies.size()) {
+            const Batch::Reply& first = replies[index];
+            size_t segments = 1;
+            size_t total = first.size;
+            while(gso && first.size > 0 && first.size <= ring.info.maxSegment &&
+                    index + segments < replies.size() &&
+                    segments < kMaxGsoSegments) {
+                const Batch::Reply& reply = replies[index + segments];
+                if(reply.size == 0 || reply.size > first.size || total + reply.size > kMaxGsoBytes ||
+                        !SamePeer(first.peer, first.peerLen, reply.peer, reply.peerLen)) {
+                    break;
+                }
+                total += reply.size;
+                ++segments;
+                if(reply.size < first.size) { //只有最后一段可以更短
+                    break;
+                }
+            }
+
+            ring.sendIovs[count].iov_base = const_cast<char*>(&batch.payload_[first.offset]);
+            ring.sendIovs[count].iov_len = total;
+            msghdr& hdr = ring.sendMsgs[count].msg_hdr;
+            ::memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_name = const_cast<sockaddr_storage*>(&first.peer);
+            hdr.msg_namelen = first.peerLen;
+            hdr.msg_iov = &ring.sendIovs[count];
+            hdr.msg_iovlen = 1;
+            if(segments > 1) {
+                char* control = &ring.sendControls[count * kControlSize];
+                ::memset(control, 0, kControlSize);
+                hdr.msg_control = control;
+                hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t segmentSize = first.size;
+                ::memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+            }
+            ring.replyCounts[count] = segments;
+            index += segments;
+            ++count;
+        }
+
+        int sent = ::sendmmsg(fd, ring.sendMsgs.data(), count, MSG_DONTWAIT);
+        if(sent < 0) {
+            if(EAGAIN == errno || EINTR == errno) {
+                if(io::WaitFd(fd, POLLOUT, kPollIntervalMillionSeconds) < 0) {
+                    return;
+                }
+                continue;
+            }
+            if(ring.replyCounts[0] > 1 &&
+                    (EIO == errno || ENOPROTOOPT == errno || EOPNOTSUPP == errno)) {
+                //内核或网卡不支持UDP_SEGMENT, 之后逐个发送. 其它错误只丢弃这个消息
+                NEMO_LOG_WARN(systemLogger) << "disable udp gso, sendmmsg errno=" << errno
+                    << " errstr=" << strerror(errno) << " " << *sock;
+                gso_ = false;
+                continue;
+            }
+            //UDP不保证送达, 丢弃发送失败的数据报
+            NEMO_LOG_DEBUG(systemLogger) << "sendmmsg fail errno=" << errno
+                << " errstr=" << strerror(errno) << " " << *sock;
+            next += ring.replyCounts[0];
+            continue;
+        }
+        for(int i = 0; i < sent; ++i) {
+            next += ring.replyCounts[i];
+        }
+    }
+}
+
+String UdpServer::toString(StringArg prefix) const {
+    std::stringstream ss;
+    ss << prefix << "[type=" << config_->type
+       << " name=" << config_->name
+       << " sockets_per_address=" << socketsPerAddress_
+       << " batch_size=" << batchSize_
+       << " gro=" << isGroEnabled() << " gso=" << gso_ << "]"
+       << "\n";
+    for(auto& sock : sockets_) {
+        ss <<  (prefix.empty() ? "    " : prefix)
+           << *sock << std::endl;
+    }
+    return ss.str();
+}
+
+} // namespace net
+} // namespace nemo
@@ -31,7 +31,7 @@ namespace net {
     action save_port
     {
         if (fpc != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, fpc - mark)));
         }
         mark = NULL;
     }
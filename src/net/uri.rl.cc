@@ -137,7 +137,7 @@ tr489:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -146,7 +146,7 @@ tr493:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -194,7 +194,7 @@ tr566:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -208,7 +208,7 @@ tr570:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -353,7 +353,7 @@ tr490:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -362,7 +362,7 @@ tr494:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -441,7 +441,7 @@ tr492:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -450,7 +450,7 @@ tr496:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -498,7 +498,7 @@ tr569:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -512,7 +512,7 @@ tr573:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -5506,7 +5506,7 @@ tr567:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -5525,7 +5525,7 @@ tr571:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -10585,7 +10585,7 @@ case 560:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -10686,7 +10686,7 @@ case 560:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -10709,7 +10709,7 @@ case 560:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
@@ -10740,7 +10740,7 @@ case 560:
 #line 32 "/programs/nemo/src/net/uri.rl"
 	{
         if (p != mark) {
-            uri->setPort(LexicalCast<uint16_t>(mark));
+            uri->setPort(LexicalCast<uint16_t>(String(mark, p - mark)));
         }
         mark = NULL;
     }
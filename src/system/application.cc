@@ -1,5 +1,9 @@
 #include "system/application.h"
 
+#include <signal.h>
+#include <unistd.h>
+
+#include <chrono>
 #include <vector>
 #include <iostream>
 
@@ -9,6 +13,7 @@
 #include "log/log.h"
 #include "common/config.h"
 #include "net/http/http_server.h"
+#include "net/listener_handoff.h"
 #include "coroutine/coroutine.h"
 #include "db/db.h"
 #include "orm/mapper.h"
@@ -26,6 +31,14 @@ static nemo::ConfigVar<std::vector<nemo::db::DbConfig>>* dbsConfigs
 static ConfigVar<std::vector<orm::MapperConfig>>* ormsConfigs
     = Config::Lookup("mappers", std::vector<orm::MapperConfig>(), "mappers configs");
 
+static ConfigVar<String>* hotRestartPathConfig
+    = Config::Lookup("application.hot_restart.path", String(),
+                     "unix socket path used to hand listening sockets over to a restarted process, empty to disable");
+
+static ConfigVar<uint64_t>* drainTimeoutConfig
+    = Config::Lookup("application.drain_timeout", static_cast<uint64_t>(30 * 1000),
+                     "max milliseconds to wait for open connections when shutting down gracefully");
+
 Application::Application(Token) :
     isDaemon_(false) {
 }
@@ -41,6 +54,13 @@ void Application::runTask() {
         }
     });
 
+    //热重启时先接收旧进程的监听socket, 绑定相同的地址时直接使用
+    String hotRestartPath = hotRestartPathConfig->getValue();
+    size_t inherited = net::ListenerHandoff::Receive(hotRestartPath);
+    if(inherited > 0) {
+        std::cout << "inherited " << inherited << " listeners from " << hotRestartPath << "\n";
+    }
+
     // 加载服务器
     auto serverConfigs = serversConfigs->getValue();
     std::vector<net::TcpServer::UniquePtr> servers;
@@ -48,6 +68,16 @@ void Application::runTask() {
         NEMO_LOG_DEBUG(systemLogger) << "\n" << LexicalCast<String, net::ServerConfig>(serverConfig);
         std::vector<net::Address::UniquePtr> addresses;
         for(auto& address : serverConfig.addresses) {
+            //unix:/path或者unix:@name
+            if(address.starts_with("unix:")) {
+                net::UnixAddress::UniquePtr unixAddress = net::UnixAddress::Parse(address);
+                if(!unixAddress) {
+                    NEMO_LOG_ERROR(systemLogger) << "invalid unix address: " << address;
+                    exit(0);
+                }
+                addresses.emplace_back(std::move(unixAddress));
+                continue;
+            }
             String::size_type pos = address.find_last_of(":");
             if(pos == std::string::npos) {
                 addresses.emplace_back(std::make_unique<net::UnixAddress>(address));
@@ -90,6 +120,8 @@ void Application::runTask() {
         }
         //and so on(https, rpc, echo)
 
+        //socket选项在bind时使用, 配置要先设置
+        server->setConfig(serverConfig);
         if(!serverConfig.name.empty()) {
             server->setName(serverConfig.name);
         }
@@ -103,7 +135,6 @@ void Application::runTask() {
                     << serverConfig.certFile << " key_file=" << serverConfig.keyFile;
             }
         }
-        server->setConfig(serverConfig);
         String serverName = server->getName();
         servers_.emplace(serverName, std::move(server));
     }
@@ -120,14 +151,69 @@ void Application::runTask() {
     ModuleManager::GetInstance().foreach([](Module* module){
         module->onServerUp();
     });
+
+    if(!hotRestartPath.empty()) {
+        coroutine_async [this, hotRestartPath](){
+            this->waitHotRestart(hotRestartPath);
+        };
+    }
+}
+
+void Application::waitHotRestart(const String& path) {
+    std::vector<net::Socket*> listeners;
+    for(auto& [serverName, server] : servers_) {
+        for(auto& sock : server->getSockets()) {
+            listeners.push_back(sock.get());
+        }
+    }
+    if(!net::ListenerHandoff::Serve(path, listeners)) {
+        NEMO_LOG_ERROR(systemLogger) << "hot restart disabled, path=" << path;
+        return;
+    }
+    //新进程已经接管监听socket, 与收到SIGTERM一样由主线程排空连接并停止调度器.
+    //这里运行在全局调度器的协程中, 不能在这里停止调度器
+    NEMO_LOG_INFO(systemLogger) << "hot restart handed over, path=" << path;
+    ::kill(::getpid(), SIGTERM);
+}
+
+bool Application::shutdown(uint64_t timeoutMillionSeconds) {
+    auto deadline = std::chrono::steady_clock::now()
+                        + std::chrono::milliseconds(timeoutMillionSeconds);
+    bool drained = true;
+    for(auto& [serverName, server] : servers_) {
+        auto remain = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now()).count();
+        drained = server->drain(remain > 0 ? remain : 0) && drained;
+    }
+    return drained;
+}
+
+void Application::stop(uint64_t timeoutMillionSeconds) {
+    bool drained = shutdown(timeoutMillionSeconds);
+    NEMO_LOG_INFO(systemLogger) << "servers shutdown, drained=" << drained;
+    for(auto& [serverName, server] : servers_) {
+        server->stop();
+    }
+    coroutine_scheduler->stop();
 }
 
 int Application::main(int argc, char** argv) {
+    //在启动任何线程之前屏蔽退出信号, 其它线程继承屏蔽字, 信号只由主线程通过sigwait处理
+    sigset_t signals;
+    ::sigemptyset(&signals);
+    ::sigaddset(&signals, SIGTERM);
+    ::sigaddset(&signals, SIGINT);
+    ::pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
     coroutine_async [this](){
         this->runTask();
     };
-    coroutine_start;
+    coroutine_async_start;
 
+    int signo = 0;
+    ::sigwait(&signals, &signo);
+    NEMO_LOG_INFO(systemLogger) << "receive signal " << signo << ", shutdown";
+    stop(drainTimeoutConfig->getValue());
     return 0;
 }
 
@@ -0,0 +1,247 @@
+#include <unistd.h>
+
+#include <atomic>
+#include <fstream>
+#include <map>
+
+#include "net/dns_resolver.h"
+#include "net/socket.h"
+#include "coroutine/scheduler.h"
+#include "log/log.h"
+#include "common/config.h"
+#include "common/macro.h"
+
+using namespace nemo;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+static coroutine::Scheduler scheduler("dns", 2);
+static const uint16_t kPort = 15353;
+static std::atomic<bool> stop{false};
+static std::atomic<bool> ready{false};
+static std::atomic<bool> done{false};
+static std::mutex queriesMutex;
+static std::map<String, int> queries;   ///< "类型 域名" -> 查询次数
+
+static int Queries(const String& key) {
+    std::lock_guard<std::mutex> lock(queriesMutex);
+    return queries[key];
+}
+
+static void Append16(String& out, uint16_t v) {
+    out.push_back(static_cast<char>(v >> 8));
+    out.push_back(static_cast<char>(v & 0xff));
+}
+
+static void AppendRecord(String& out, uint16_t type, uint32_t ttl, const String& data) {
+    Append16(out, 0xc00c);
+    Append16(out, type);
+    Append16(out, 1);
+    Append16(out, static_cast<uint16_t>(ttl >> 16));
+    Append16(out, static_cast<uint16_t>(ttl & 0xffff));
+    Append16(out, static_cast<uint16_t>(data.size()));
+    out.append(data);
+}
+
+/**
+ * @brief 桩DNS服务器的应答
+ *        test.nemo: A 10.0.0.1 10.0.0.2, AAAA fd00::1, TTL 1秒
+ *        nodata.nemo: 没有记录, SOA MINIMUM 1秒
+ *        big.nemo: UDP应答被截断, TCP应答A 10.0.0.9
+ *        其他: NXDOMAIN
+ */
+static String Answer(const String& query, bool tcp) {
+    size_t offset = 12;
+    String name;
+    while(offset < query.size() && query[offset]) {
+        uint8_t len = query[offset];
+        if(!name.empty()) {
+            name.push_back('.');
+        }
+        name.append(query, offset + 1, len);
+        offset += 1 + len;
+    }
+    uint16_t type = (static_cast<uint8_t>(query[offset + 1]) << 8) | static_cast<uint8_t>(query[offset + 2]);
+    String question = query.substr(12, offset + 5 - 12);
+    {
+        std::lock_guard<std::mutex> lock(queriesMutex);
+        ++queries[std::to_string(type) + " " + name + (tcp ? " tcp" : "")];
+    }
+
+    String records;
+    uint16_t flags = 0x8180;
+    uint16_t answers = 0;
+    uint16_t authorities = 0;
+    if("test.nemo" == name && 1 == type) {
+        AppendRecord(records, 1, 1, String("\x0a\x00\x00\x01", 4));
+        AppendRecord(records, 1, 1, String("\x0a\x00\x00\x02", 4));
+        answers = 2;
+    } else if("test.nemo" == name && 28 == type) {
+        AppendRecord(records, 28, 1, String("\xfd\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x01", 16));
+        answers = 1;
+    } else if("nodata.nemo" == name) {
+        String soa("\x00\x00", 2);
+        soa.append(String(16, '\x00'));
+        soa.append(String("\x00\x00\x00\x01", 4));
+        AppendRecord(records, 6, 60, soa);
+        authorities = 1;
+    } else if("big.nemo" == name && 1 == type) {
+        if(tcp) {
+            AppendRecord(records, 1, 60, String("\x0a\x00\x00\x09", 4));
+            answers = 1;
+        } else {
+            flags |= 0x0200;
+        }
+    } else if("big.nemo" != name) {
+        flags |= 3;
+    }
+
+    String response = query.substr(0, 2);
+    Append16(response, flags);
+    Append16(response, 1);
+    Append16(response, answers);
+    Append16(response, authorities);
+    Append16(response, 0);
+    response.append(question);
+    response.append(records);
+    return response;
+}
+
+void UdpServer() {
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    net::Socket::UniquePtr sock = net::Socket::CreateUdp(address.get());
+    NEMO_ASSERT(sock->bind(address.get()));
+    sock->setRecvTimeout(100);
+    ready = true;
+    char buffer[512];
+    net::Ipv4Address from;
+    while(!stop) {
+        int n = sock->recvFrom(buffer, sizeof(buffer), &from);
+        if(n > 0) {
+            String response = Answer(String(buffer, n), false);
+            sock->sendTo(response.data(), response.size(), &from);
+        }
+    }
+}
+
+void TcpServer() {
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    net::Socket::UniquePtr sock = net::Socket::CreateTcp(address.get());
+    NEMO_ASSERT(sock->bind(address.get()));
+    NEMO_ASSERT(sock->listen());
+    sock->setRecvTimeout(100);
+    while(!stop) {
+        net::Socket::UniquePtr client = sock->accept();
+        if(!client) {
+            continue;
+        }
+        char buffer[514];
+        int n = client->recv(buffer, sizeof(buffer));
+        NEMO_ASSERT(n > 2);
+        String response = Answer(String(buffer + 2, n - 2), true);
+        String framed;
+        Append16(framed, static_cast<uint16_t>(response.size()));
+        framed.append(response);
+        client->send(framed.data(), framed.size());
+    }
+}
+
+static std::vector<String> Resolve(StringArg name, int family) {
+    std::vector<net::IpAddress::UniquePtr> addresses;
+    std::vector<String> result;
+    if(net::DnsResolver::GetInstance().resolve(name, family, addresses)) {
+        for(auto& address : addresses) {
+            result.push_back(address->toString());
+        }
+    }
+    return result;
+}
+
+void TestResolve() {
+    while(!ready) {
+        ::usleep(10 * 1000);
+    }
+
+    std::vector<String> v4 = Resolve("test.nemo", AF_INET);
+    NEMO_ASSERT(v4.size() == 2 && v4[0] == "10.0.0.1:0" && v4[1] == "10.0.0.2:0");
+    NEMO_ASSERT(Resolve("TEST.nemo.", AF_INET) == v4);
+    NEMO_ASSERT(Queries("1 test.nemo") == 1);
+
+    //IPv6在前, 与IPv4交替
+    std::vector<String> all = Resolve("test.nemo", AF_UNSPEC);
+    NEMO_ASSERT(all.size() == 3 && all[0] == "[fd00::1]:0" && all[1] == v4[0] && all[2] == v4[1]);
+    NEMO_ASSERT(Queries("1 test.nemo") == 1 && Queries("28 test.nemo") == 1);
+    NEMO_LOG_INFO(rootLogger) << "dns resolve and cache test passed";
+
+    //search域
+    NEMO_ASSERT(Resolve("test", AF_INET) == v4);
+    NEMO_ASSERT(Queries("1 test") == 0);
+
+    //否定结果的缓存
+    NEMO_ASSERT(Resolve("missing.nemo.", AF_INET).empty());
+    NEMO_ASSERT(Resolve("missing.nemo.", AF_INET).empty());
+    NEMO_ASSERT(Queries("1 missing.nemo") == 1);
+    NEMO_ASSERT(Resolve("nodata.nemo", AF_INET6).empty());
+    NEMO_ASSERT(Resolve("nodata.nemo", AF_INET6).empty());
+    NEMO_ASSERT(Queries("28 nodata.nemo") == 1);
+    NEMO_LOG_INFO(rootLogger) << "dns negative cache test passed";
+
+    //TTL到期后重新查询
+    ::usleep(1100 * 1000);
+    NEMO_ASSERT(Resolve("test.nemo", AF_INET) == v4);
+    NEMO_ASSERT(Queries("1 test.nemo") == 2);
+    NEMO_ASSERT(Resolve("missing.nemo.", AF_INET).empty());
+    NEMO_ASSERT(Queries("1 missing.nemo") == 2);
+    NEMO_ASSERT(Resolve("nodata.nemo", AF_INET6).empty());
+    NEMO_ASSERT(Queries("28 nodata.nemo") == 2);
+    NEMO_LOG_INFO(rootLogger) << "dns ttl test passed";
+
+    //hosts文件优先
+    NEMO_ASSERT(Resolve("Hosted.nemo", AF_INET) == std::vector<String>{"10.9.9.9:0"});
+    NEMO_ASSERT(Queries("1 hosted.nemo") == 0);
+
+    //截断后通过TCP查询
+    NEMO_ASSERT(Resolve("big.nemo", AF_INET) == std::vector<String>{"10.0.0.9:0"});
+    NEMO_ASSERT(Queries("1 big.nemo") == 1 && Queries("1 big.nemo tcp") == 1);
+    NEMO_LOG_INFO(rootLogger) << "dns hosts and tcp fallback test passed";
+
+    auto address = net::Address::LookupAnyIPAddress("test.nemo:8080");
+    NEMO_ASSERT(address && address->toString() == "10.0.0.1:8080");
+    NEMO_ASSERT(!net::Address::LookupAnyIPAddress("missing.nemo.:80"));
+    std::vector<net::Address::UniquePtr> addresses;
+    net::Address::Lookup("test.nemo:443", std::back_inserter(addresses),
+                        net::SocketAttribute(AF_UNSPEC, SOCK_STREAM, 0));
+    NEMO_ASSERT(addresses.size() == 3 && addresses[0]->toString() == "[fd00::1]:443");
+    NEMO_ASSERT(Queries("1 test.nemo") == 2);
+    NEMO_LOG_INFO(rootLogger) << "address lookup test passed";
+
+    stop = true;
+    done = true;
+}
+
+int main(int argc, char** argv) {
+    char hosts[] = "/tmp/nemo_dns_hosts_XXXXXX";
+    char resolvConf[] = "/tmp/nemo_dns_resolv_XXXXXX";
+    ::close(::mkstemp(hosts));
+    ::close(::mkstemp(resolvConf));
+    std::ofstream(hosts) << "# test hosts\n10.9.9.9\thosted.nemo  # comment\n";
+    std::ofstream(resolvConf) << "nameserver 192.0.2.1\nsearch nemo\noptions ndots:1 timeout:1 attempts:1\n";
+
+    Config::LookupBase("dns.hosts")->fromString(hosts);
+    Config::LookupBase("dns.resolv_conf")->fromString(resolvConf);
+    Config::LookupBase("dns.nameservers")->fromString("- 127.0.0.1:" + std::to_string(kPort));
+    Config::LookupBase("dns.negative_ttl")->fromString("1");
+
+    scheduler.addTask(UdpServer);
+    scheduler.addTask(TcpServer);
+    scheduler.addTask(TestResolve);
+    scheduler.threadStart();
+    while(!done) {
+        ::usleep(10 * 1000);
+    }
+    ::usleep(300 * 1000);
+    scheduler.stop();
+
+    ::unlink(hosts);
+    ::unlink(resolvConf);
+    return 0;
+}
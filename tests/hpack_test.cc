@@ -0,0 +1,158 @@
+#include "net/http/hpack.h"
+
+#include "log/log.h"
+#include "common/macro.h"
+
+using namespace nemo;
+using namespace nemo::net::http;
+
+static nemo::Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+
+static String FromHex(StringArg hex) {
+    String out;
+    for(size_t i = 0; i + 1 < hex.size(); i += 2) {
+        out.push_back(static_cast<char>(std::stoi(String(hex.substr(i, 2)), nullptr, 16)));
+    }
+    return out;
+}
+
+static bool Decode(HpackDecoder& decoder, StringArg data, HpackDecoder::FieldVector& fields) {
+    fields.clear();
+    return decoder.decode(reinterpret_cast<const uint8_t*>(data.data()), data.size(), fields);
+}
+
+/**
+ * @brief RFC 7541 C.4, 使用Huffman编码的三个连续请求
+ */
+void TestDecodeRfcExample() {
+    HpackDecoder decoder;
+    HpackDecoder::FieldVector fields;
+
+    NEMO_ASSERT(Decode(decoder, FromHex("828684418cf1e3c2e5f23a6ba0ab90f4ff"), fields));
+    NEMO_ASSERT(fields.size() == 4);
+    NEMO_ASSERT(fields[0].first == ":method" && fields[0].second == "GET");
+    NEMO_ASSERT(fields[3].first == ":authority" && fields[3].second == "www.example.com");
+    NEMO_ASSERT(decoder.getTable().getSize() == 57);
+
+    NEMO_ASSERT(Decode(decoder, FromHex("828684be5886a8eb10649cbf"), fields));
+    NEMO_ASSERT(fields.size() == 5);
+    NEMO_ASSERT(fields[3].second == "www.example.com");
+    NEMO_ASSERT(fields[4].first == "cache-control" && fields[4].second == "no-cache");
+    NEMO_ASSERT(decoder.getTable().getSize() == 110);
+
+    NEMO_ASSERT(Decode(decoder, FromHex("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"), fields));
+    NEMO_ASSERT(fields.size() == 5);
+    NEMO_ASSERT(fields[2].second == "/index.html");
+    NEMO_ASSERT(fields[4].first == "custom-key" && fields[4].second == "custom-value");
+    NEMO_ASSERT(decoder.getTable().getSize() == 164);
+
+    //引用不存在的索引, 以及包含EOS的Huffman串
+    NEMO_ASSERT(!Decode(decoder, FromHex("ff00"), fields));
+    NEMO_ASSERT(!Decode(decoder, FromHex("0085ffffffffff"), fields));
+    NEMO_LOG_INFO(rootLogger) << "hpack decode test passed";
+}
+
+/**
+ * @brief 编码器输出的头部块能被解码器还原, 动态表保持一致
+ */
+void TestRoundTrip() {
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    HpackDecoder::FieldVector fields;
+    String all;
+    for(int i = 1; i < 256; ++i) {
+        all.push_back(static_cast<char>(i));
+    }
+
+    for(int round = 0; round < 3; ++round) {
+        String block;
+        encoder.begin(block);
+        encoder.encode(":status", "200", block);
+        encoder.encode("server", "nemo", block);
+        encoder.encode("content-type", "text/html", block);
+        encoder.encode("x-binary", all, block);
+        encoder.encode("content-length", std::to_string(round), block, false);
+        NEMO_ASSERT(Decode(decoder, block, fields));
+        NEMO_ASSERT(fields.size() == 5);
+        NEMO_ASSERT(fields[1].second == "nemo");
+        NEMO_ASSERT(fields[3].second == all);
+        NEMO_ASSERT(fields[4].second == std::to_string(round));
+        NEMO_ASSERT(encoder.getTable().getSize() == decoder.getTable().getSize());
+        if(round > 0) { //第二次开始除了content-length都是索引字段
+            NEMO_ASSERT(block.size() < 10);
+        }
+    }
+
+    //对端缩小动态表
+    encoder.setMaxTableSize(64);
+    String block;
+    encoder.begin(block);
+    encoder.encode("server", "nemo", block);
+    NEMO_ASSERT(Decode(decoder, block, fields));
+    NEMO_ASSERT(decoder.getTable().getMaxSize() == 64);
+    NEMO_ASSERT(encoder.getTable().getSize() == decoder.getTable().getSize());
+    NEMO_LOG_INFO(rootLogger) << "hpack round trip test passed";
+}
+
+/**
+ * @brief 重复引用一个大的动态表条目, 解码后的大小超过上限时不再生成字段, 动态表保持一致
+ */
+void TestDecodeListLimit() {
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    String block;
+    encoder.begin(block);
+    encoder.encode("x-big", String(4000, 'a'), block);
+    size_t insert = block.size();
+    for(int i = 0; i < 1000; ++i) {
+        block.push_back(static_cast<char>(0x80 | 62)); //动态表第一个条目
+    }
+    encoder.encode("x-after", "b", block);
+
+    HpackDecoder::FieldVector fields;
+    size_t listSize = 0;
+    NEMO_ASSERT(decoder.decode(reinterpret_cast<const uint8_t*>(block.data()), block.size(),
+                               fields, 64 * 1024, &listSize));
+    NEMO_ASSERT(listSize > 1000 * 4000);
+    NEMO_ASSERT(fields.empty());
+    NEMO_ASSERT(decoder.getTable().getSize() == encoder.getTable().getSize());
+
+    //没有超过上限时字段完整输出
+    fields.clear();
+    NEMO_ASSERT(decoder.decode(reinterpret_cast<const uint8_t*>(block.data()), insert,
+                               fields, 64 * 1024, &listSize));
+    NEMO_ASSERT(fields.size() == 1 && listSize == 5 + 4000 + 32);
+    NEMO_LOG_INFO(rootLogger) << "hpack decode list limit test passed";
+}
+
+/**
+ * @brief 超过32位的整数视为解码失败, 头部块按COMPRESSION_ERROR处理
+ */
+void TestDecodeIntegerOverflow() {
+    uint64_t value = 0;
+    String data;
+    hpack::EncodeInteger(UINT32_MAX, 5, 0, data);
+    NEMO_ASSERT(hpack::DecodeInteger(reinterpret_cast<const uint8_t*>(data.data()), data.size(),
+                                     5, value) == data.size() && UINT32_MAX == value);
+    data.clear();
+    hpack::EncodeInteger(static_cast<uint64_t>(UINT32_MAX) + 1, 5, 0, data);
+    NEMO_ASSERT(hpack::DecodeInteger(reinterpret_cast<const uint8_t*>(data.data()), data.size(),
+                                     5, value) == 0);
+    //索引字段带有9个后续字节, 接近uint64_t的上限
+    String wrap = FromHex("ff81808080808080808002");
+    NEMO_ASSERT(hpack::DecodeInteger(reinterpret_cast<const uint8_t*>(wrap.data()), wrap.size(),
+                                     7, value) == 0);
+
+    HpackDecoder decoder;
+    HpackDecoder::FieldVector fields;
+    NEMO_ASSERT(!Decode(decoder, wrap, fields));
+    NEMO_LOG_INFO(rootLogger) << "hpack decode integer overflow test passed";
+}
+
+int main(int argc, char** argv) {
+    TestDecodeRfcExample();
+    TestRoundTrip();
+    TestDecodeListLimit();
+    TestDecodeIntegerOverflow();
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "net/http/http_server.h"
+#include "net/http/http2.h"
+#include "net/http/hpack.h"
+#include "log/log.h"
+#include "common/config.h"
+#include "common/macro.h"
+
+using namespace nemo;
+using namespace nemo::net::http;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+static const uint16_t kPort = 18085;
+static std::atomic<int> running{0};
+static std::atomic<int> maxRunning{0};
+
+/**
+ * @brief 在主线程中(不经过hook)连接服务器并发送客户端连接前言, 读超时1秒
+ */
+static int Connect() {
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    NEMO_ASSERT(::connect(fd, address->getAddr(), address->getAddrLen()) == 0);
+    struct timeval tv = {1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    String preface(kHttp2Preface.data(), kHttp2Preface.size());
+    AppendHttp2Frame(preface, Http2FrameType::SETTINGS, 0, 0, StringArg());
+    NEMO_ASSERT(::send(fd, preface.data(), preface.size(), 0) == (ssize_t)preface.size());
+    return fd;
+}
+
+/**
+ * @brief 打开一个流发送GET /slow, 紧接着重置它
+ */
+static void AppendOpenAndReset(HpackEncoder& encoder, uint32_t streamId, String& out) {
+    String block;
+    encoder.begin(block);
+    encoder.encode(":method", "GET", block);
+    encoder.encode(":scheme", "http", block);
+    encoder.encode(":path", "/slow", block);
+    encoder.encode(":authority", "local", block);
+    AppendHttp2Frame(out, Http2FrameType::HEADERS, Http2Flag::END_HEADERS | Http2Flag::END_STREAM,
+                     streamId, block);
+    String payload;
+    AppendHttp2Uint32(payload, static_cast<uint32_t>(Http2Error::CANCEL));
+    AppendHttp2Frame(out, Http2FrameType::RST_STREAM, 0, streamId, payload);
+}
+
+/**
+ * @brief 读取帧直到收到GOAWAY或者读超时
+ * @param[out] refused 收到的REFUSED_STREAM数
+ * @return GOAWAY中的错误码, 没有收到GOAWAY时返回NO_ERROR
+ */
+static Http2Error ReadFrames(int fd, int& refused) {
+    refused = 0;
+    String data;
+    char buffer[4096];
+    while(true) {
+        while(data.size() >= kHttp2FrameHeaderSize) {
+            Http2FrameHeader header;
+            header.parse(data.data());
+            if(data.size() < kHttp2FrameHeaderSize + header.length) {
+                break;
+            }
+            const char* payload = data.data() + kHttp2FrameHeaderSize;
+            if(Http2FrameType::RST_STREAM == header.type &&
+                static_cast<uint32_t>(Http2Error::REFUSED_STREAM) == ReadHttp2Uint32(payload)) {
+                ++refused;
+            } else if(Http2FrameType::GOAWAY == header.type) {
+                return static_cast<Http2Error>(ReadHttp2Uint32(payload + 4));
+            }
+            data.erase(0, kHttp2FrameHeaderSize + header.length);
+        }
+        ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        if(n <= 0) {
+            return Http2Error::NO_ERROR;
+        }
+        data.append(buffer, n);
+    }
+}
+
+/**
+ * @brief 被重置的流在处理协程结束前仍然占用并发数, 超出的新流收到REFUSED_STREAM
+ */
+void TestResetKeepsConcurrency() {
+    int fd = Connect();
+    HpackEncoder encoder;
+    String frames;
+    for(uint32_t i = 0; i < 10; ++i) {
+        AppendOpenAndReset(encoder, 2 * i + 1, frames);
+    }
+    NEMO_ASSERT(::send(fd, frames.data(), frames.size(), 0) == (ssize_t)frames.size());
+    int refused = 0;
+    NEMO_ASSERT(ReadFrames(fd, refused) == Http2Error::NO_ERROR);
+    NEMO_ASSERT(refused == 6 && maxRunning == 4);
+    ::close(fd);
+    NEMO_LOG_INFO(rootLogger) << "http2 reset stream concurrency test passed";
+}
+
+/**
+ * @brief 客户端重置流的频率超过限制时以ENHANCE_YOUR_CALM关闭连接
+ */
+void TestRapidReset() {
+    Config::LookupBase("http.http2.max_reset_streams")->fromString("5");
+    int fd = Connect();
+    HpackEncoder encoder;
+    String frames;
+    for(uint32_t i = 0; i < 10; ++i) {
+        AppendOpenAndReset(encoder, 2 * i + 1, frames);
+    }
+    NEMO_ASSERT(::send(fd, frames.data(), frames.size(), 0) == (ssize_t)frames.size());
+    int refused = 0;
+    NEMO_ASSERT(ReadFrames(fd, refused) == Http2Error::ENHANCE_YOUR_CALM);
+    ::close(fd);
+    NEMO_LOG_INFO(rootLogger) << "http2 rapid reset test passed";
+}
+
+int main(int argc, char** argv) {
+    Config::LookupBase("http.http2.max_concurrent_streams")->fromString("4");
+    auto scheduler = std::make_shared<coroutine::Scheduler>("http2", 2);
+    HttpServer server(true, scheduler, scheduler, scheduler);
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    NEMO_ASSERT(server.bind(address.get()));
+    server.getServletDispatcher()->addServlet("/slow", [](HttpRequest*, HttpResponse* response, HttpSession*) {
+        int n = ++running;
+        for(int max = maxRunning; n > max && !maxRunning.compare_exchange_weak(max, n);) {
+        }
+        ::usleep(300 * 1000);
+        --running;
+        response->setBody(String("slow"));
+        return 0;
+    });
+    NEMO_ASSERT(server.start());
+
+    TestResetKeepsConcurrency();
+    ::usleep(500 * 1000);
+    TestRapidReset();
+
+    server.stop();
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include "net/http/http_parser.h"
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <new>
+
+#include "log/log.h"
+#include "common/types.h"
+#include "container/arena.h"
+
+using namespace nemo;
+
+static nemo::Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+
+/// 当前线程调用全局operator new的次数, 其他线程(日志等)的分配不计入
+static thread_local size_t sAllocCount = 0;
+
+void* operator new(size_t size) {
+    ++sAllocCount;
+    void* p = ::malloc(size ? size : 1);
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    ::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    ::free(p);
+}
+
+//std::pmr::new_delete_resource()使用带对齐参数的版本
+void* operator new(size_t size, std::align_val_t align) {
+    ++sAllocCount;
+    size_t alignment = static_cast<size_t>(align);
+    void* p = ::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    ::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    ::free(p);
+}
+
+static const StringArg kRequest =
+    "GET /Nemo/index.html?id=1024&name=nemo HTTP/1.1\r\n"
+    "Host: www.baidu.com\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/96.0.4664.45 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark\r\n"
+    "X-Request-Id: 7f3a9c0e-5b1d-4e8a-9f2c-1d6b8e4a3c70\r\n"
+    "\r\n";
+
+struct BenchResult {
+    double allocsPerRequest;
+    double requestsPerSecond;
+};
+
+/**
+ * @brief 模拟HttpServer处理一个请求的过程: 解析头部, servlet读写头部和参数, 序列化响应
+ * @param[in] arena 为空时使用默认的堆内存
+ */
+template<size_t N>
+static BenchResult Bench(Arena<N>* arena, size_t times) {
+    std::pmr::memory_resource* resource = arena ? arena : std::pmr::get_default_resource();
+    net::http::HttpRequestParser parser;
+    String msg;
+    String writeBuffer;
+    writeBuffer.reserve(4096);
+
+    size_t allocs = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < times; ++i) {
+        msg.assign(kRequest.data(), kRequest.size());
+
+        size_t before = sAllocCount;
+        //reset之后解析器内部的请求是空的, 不再引用内存池中的内存
+        parser.reset(resource);
+        if(arena) {
+            arena->reset();
+        }
+        parser.execute(msg.data(), msg.size());
+        net::http::HttpRequest* request = parser.getRequest();
+
+        net::http::HttpResponse response(request->getVersion(), request->isClose(), resource);
+        response.setHeader("Server", "nemo");
+        response.setHeader("Content-Type", "text/plain");
+        request->setParam("id", "1024");
+        response.setHeader("X-Request-Id", request->getHeader(net::http::HttpHeaderId::HOST));
+        response.setHeader("X-Param-Id", request->getParam("id"));
+        writeBuffer.clear();
+        response.appendTo(writeBuffer);
+        allocs += sAllocCount - before;
+    }
+    std::chrono::duration<double> cost = std::chrono::steady_clock::now() - begin;
+    return BenchResult{static_cast<double>(allocs) / times, times / cost.count()};
+}
+
+int main(int argc, char** argv) {
+    size_t times = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    Arena<4096> arena;
+    Bench<4096>(nullptr, times / 10); //预热
+    BenchResult heap = Bench<4096>(nullptr, times);
+    Bench(&arena, times / 10);
+    BenchResult pooled = Bench(&arena, times);
+
+    NEMO_LOG_INFO(rootLogger) << "times=" << times;
+    NEMO_LOG_INFO(rootLogger) << "heap:  " << heap.allocsPerRequest << " allocs/req "
+        << static_cast<uint64_t>(heap.requestsPerSecond) << " req/s";
+    NEMO_LOG_INFO(rootLogger) << "arena: " << pooled.allocsPerRequest << " allocs/req "
+        << static_cast<uint64_t>(pooled.requestsPerSecond) << " req/s"
+        << " arena_bytes=" << arena.getAllocBytes();
+
+    return 0;
+}
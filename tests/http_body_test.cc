@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include "net/http/http_server.h"
+#include "log/log.h"
+#include "common/config.h"
+#include "common/macro.h"
+
+using namespace nemo;
+using namespace nemo::net::http;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+static const uint16_t kPort = 18083;
+static String fileContent;
+static int fileFd = -1;
+static std::atomic<bool> overflowRejected{false};
+
+/**
+ * @brief 先写入一段内存数据, 再发送整个文件
+ */
+static int32_t WriteAndSendFile(HttpResponse* response, HttpSession* session) {
+    HttpBodyWriter* writer = session->getBodyWriter(response);
+    if(writer->write(StringArg("head:")) < 0) {
+        return -1;
+    }
+    return writer->sendFile(fileFd, 0, fileContent.size()) < 0 ? -1 : 0;
+}
+
+/**
+ * @brief 在主线程中(不经过hook)连接服务器, 读超时1秒
+ */
+static int Connect() {
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    NEMO_ASSERT(::connect(fd, address->getAddr(), address->getAddrLen()) == 0);
+    struct timeval tv = {1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+/**
+ * @brief 读取一个响应, 按响应的传输编码读取消息体
+ * @param[in, out] data 已经读到的数据, 返回时保留属于下一个响应的数据
+ * @param[out] headers 响应头部, 转换为小写
+ * @return 去掉传输编码之后的消息体
+ */
+static String ReadResponse(int fd, String& data, String& headers) {
+    char buffer[4096];
+    auto fill = [&]() {
+        ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        NEMO_ASSERT(n > 0);
+        data.append(buffer, n);
+    };
+    size_t end;
+    while(String::npos == (end = data.find("\r\n\r\n"))) {
+        fill();
+    }
+    headers = data.substr(0, end + 2);
+    data.erase(0, end + 4);
+    std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+
+    String body;
+    size_t field = headers.find("content-length: ");
+    if(String::npos != field) {
+        size_t length = std::stoul(headers.substr(field + 16));
+        while(data.size() < length) {
+            fill();
+        }
+        body = data.substr(0, length);
+        data.erase(0, length);
+    } else {
+        NEMO_ASSERT(String::npos != headers.find("transfer-encoding: chunked"));
+        while(true) {
+            size_t lineEnd;
+            while(String::npos == (lineEnd = data.find("\r\n"))) {
+                fill();
+            }
+            size_t size = std::stoul(data.substr(0, lineEnd), nullptr, 16);
+            while(data.size() < lineEnd + 2 + size + 2) {
+                fill();
+            }
+            NEMO_ASSERT(data.compare(lineEnd + 2 + size, 2, "\r\n") == 0);
+            body.append(data, lineEnd + 2, size);
+            data.erase(0, lineEnd + 2 + size + 2);
+            if(0 == size) {
+                break;
+            }
+        }
+    }
+    return body;
+}
+
+/**
+ * @brief 发送一个GET请求, 要求响应成功
+ */
+static String Request(StringArg path, StringArg extraHeaders, String& headers) {
+    int fd = Connect();
+    String request = "GET " + String(path) + " HTTP/1.1\r\nHost: local\r\n" + String(extraHeaders) + "\r\n";
+    NEMO_ASSERT(::send(fd, request.data(), request.size(), 0) == (ssize_t)request.size());
+    String data;
+    String body = ReadResponse(fd, data, headers);
+    NEMO_ASSERT(headers.starts_with("http/1.1 200"));
+    ::close(fd);
+    return body;
+}
+
+static String Gunzip(const String& data) {
+    z_stream zs;
+    ::memset(&zs, 0, sizeof(zs));
+    NEMO_ASSERT(::inflateInit2(&zs, 16 + MAX_WBITS) == Z_OK);
+    String out(fileContent.size() * 2 + 1024, '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = data.size();
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = out.size();
+    NEMO_ASSERT(::inflate(&zs, Z_FINISH) == Z_STREAM_END);
+    out.resize(out.size() - zs.avail_out);
+    ::inflateEnd(&zs);
+    return out;
+}
+
+/**
+ * @brief 定长消息体: write和sendFile都从Content-Length中扣除, 超出时失败
+ */
+void TestFixedLength() {
+    String headers;
+    String body = Request("/fixed", StringArg(), headers);
+    NEMO_ASSERT(body == "head:" + fileContent);
+    NEMO_ASSERT(String::npos == headers.find("transfer-encoding"));
+
+    body = Request("/overflow", StringArg(), headers);
+    NEMO_ASSERT(overflowRejected && body == "head:" + fileContent.substr(0, 10));
+    NEMO_LOG_INFO(rootLogger) << "http body writer fixed length test passed";
+}
+
+/**
+ * @brief chunked消息体: write和sendFile各自成为一个chunk
+ */
+void TestChunked() {
+    String headers;
+    String body = Request("/chunked", StringArg(), headers);
+    NEMO_ASSERT(body == "head:" + fileContent);
+    NEMO_LOG_INFO(rootLogger) << "http body writer chunked test passed";
+}
+
+/**
+ * @brief 压缩的消息体: 文件内容读出后和内存数据一起压缩, 以chunked发送
+ */
+void TestCompressed() {
+    String headers;
+    String body = Request("/chunked", "Accept-Encoding: gzip\r\n", headers);
+    NEMO_ASSERT(String::npos != headers.find("content-encoding: gzip"));
+    NEMO_ASSERT(body.size() < fileContent.size());
+    NEMO_ASSERT(Gunzip(body) == "head:" + fileContent);
+    NEMO_LOG_INFO(rootLogger) << "http body writer compressed test passed";
+}
+
+/**
+ * @brief chunked请求体: 忽略chunk扩展和trailer, 之后的流水线请求不受影响
+ */
+void TestChunkedDecode() {
+    int fd = Connect();
+    String requests = "POST /echo HTTP/1.1\r\nHost: local\r\nTransfer-Encoding: chunked\r\n\r\n"
+                      "5;name=value\r\nhello\r\n"
+                      "6 ; ext=\"quoted\"\r\n world\r\n"
+                      "A\r\n, chunked!\r\n"
+                      "0\r\nX-Trailer: one\r\nX-Other: two\r\n\r\n"
+                      "GET /fixed HTTP/1.1\r\nHost: local\r\n\r\n";
+    NEMO_ASSERT(::send(fd, requests.data(), requests.size(), 0) == (ssize_t)requests.size());
+    String data;
+    String headers;
+    NEMO_ASSERT(ReadResponse(fd, data, headers) == "hello world, chunked!");
+    NEMO_ASSERT(headers.starts_with("http/1.1 200"));
+    NEMO_ASSERT(ReadResponse(fd, data, headers) == "head:" + fileContent);
+    ::close(fd);
+
+    //chunk大小不是十六进制数字时读取失败
+    fd = Connect();
+    String bad = "POST /echo HTTP/1.1\r\nHost: local\r\nTransfer-Encoding: chunked\r\n\r\n"
+                 "zz\r\nhello\r\n0\r\n\r\n";
+    NEMO_ASSERT(::send(fd, bad.data(), bad.size(), 0) == (ssize_t)bad.size());
+    data.clear();
+    ReadResponse(fd, data, headers);
+    NEMO_ASSERT(!headers.starts_with("http/1.1 200"));
+    ::close(fd);
+    NEMO_LOG_INFO(rootLogger) << "http body reader chunked decode test passed";
+}
+
+/**
+ * @brief 客户端收到第一个响应之后才发送第二个请求的剩余部分, 缓存的响应不能等到下一个请求完整才发送.
+ *        消息体之后多余的CRLF按空行忽略
+ */
+void TestPipelineSplit() {
+    int fd = Connect();
+    String first = "POST /echo HTTP/1.1\r\nHost: local\r\nContent-Length: 5\r\n\r\nhello"
+                   "\r\nGET /fix";
+    NEMO_ASSERT(::send(fd, first.data(), first.size(), 0) == (ssize_t)first.size());
+    String data;
+    String headers;
+    NEMO_ASSERT(ReadResponse(fd, data, headers) == "hello");
+    NEMO_ASSERT(headers.starts_with("http/1.1 200") && data.empty());
+
+    String rest = "ed HTTP/1.1\r\nHost: local\r\n\r\n";
+    NEMO_ASSERT(::send(fd, rest.data(), rest.size(), 0) == (ssize_t)rest.size());
+    NEMO_ASSERT(ReadResponse(fd, data, headers) == "head:" + fileContent);
+    NEMO_ASSERT(headers.starts_with("http/1.1 200"));
+    ::close(fd);
+    NEMO_LOG_INFO(rootLogger) << "http split pipeline test passed";
+}
+
+int main(int argc, char** argv) {
+    Config::LookupBase("http.compress.enable")->fromString("1");
+    for(int i = 0; fileContent.size() < 64 * 1024; ++i) {
+        fileContent.append("line ").append(std::to_string(i)).append(" of the file body\n");
+    }
+    char path[] = "/tmp/nemo_http_body_test_XXXXXX";
+    fileFd = ::mkstemp(path);
+    NEMO_ASSERT(fileFd >= 0);
+    ::unlink(path);
+    NEMO_ASSERT(::write(fileFd, fileContent.data(), fileContent.size()) == (ssize_t)fileContent.size());
+
+    auto scheduler = std::make_shared<coroutine::Scheduler>("body", 2);
+    HttpServer server(true, scheduler, scheduler, scheduler);
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    NEMO_ASSERT(server.bind(address.get()));
+    ServletDispatcher* dispatcher = server.getServletDispatcher();
+    dispatcher->addServlet("/fixed", [](HttpRequest*, HttpResponse* response, HttpSession* session) {
+        response->setHeader("Content-Type", "application/octet-stream");
+        response->setHeader("Content-Length", std::to_string(5 + fileContent.size()));
+        return WriteAndSendFile(response, session);
+    });
+    //文件比Content-Length剩余的长度大, sendFile失败且不发送任何数据, 之后仍然可以写入
+    dispatcher->addServlet("/overflow", [](HttpRequest*, HttpResponse* response, HttpSession* session) {
+        response->setHeader("Content-Type", "application/octet-stream");
+        response->setHeader("Content-Length", "15");
+        HttpBodyWriter* writer = session->getBodyWriter(response);
+        writer->write(StringArg("head:"));
+        overflowRejected = writer->sendFile(fileFd, 0, fileContent.size()) < 0;
+        return writer->sendFile(fileFd, 0, 10) == 10 ? 0 : -1;
+    });
+    dispatcher->addServlet("/chunked", [](HttpRequest*, HttpResponse* response, HttpSession* session) {
+        response->setHeader("Content-Type", "text/plain");
+        return WriteAndSendFile(response, session);
+    });
+    //流式读取请求体, 每次只读3个字节, 跨越chunk的边界
+    HttpServlet::UniquePtr echo(new FunctionServlet([](HttpRequest*, HttpResponse* response, HttpSession* session) {
+        HttpBodyReader* reader = session->getBodyReader();
+        String body;
+        char buffer[3];
+        ssize_t n = 0;
+        while((n = reader->read(buffer, sizeof(buffer))) > 0) {
+            body.append(buffer, n);
+        }
+        if(n < 0) {
+            response->setStatus(HttpStatus::BAD_REQUEST);
+        }
+        response->setBody(body);
+        return 0;
+    }));
+    echo->setStreamBody(true);
+    dispatcher->addServlet("/echo", std::move(echo));
+    NEMO_ASSERT(server.start());
+
+    TestFixedLength();
+    TestChunked();
+    TestCompressed();
+    TestChunkedDecode();
+    TestPipelineSplit();
+
+    server.stop();
+    ::close(fileFd);
+    return 0;
+}
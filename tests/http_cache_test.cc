@@ -0,0 +1,188 @@
+#include "net/http/http_cache.h"
+
+#include <unistd.h>
+
+#include <atomic>
+
+#include "net/http/http.h"
+#include "net/http/http_session.h"
+#include "net/http/servlet.h"
+#include "coroutine/scheduler.h"
+#include "log/log.h"
+#include "common/config.h"
+#include "common/macro.h"
+
+using namespace nemo;
+using namespace nemo::net::http;
+
+static nemo::Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+
+void TestCacheControl() {
+    HttpCacheControl control;
+    control.parse("public, max-age=60, s-maxage=\"120\", stale-while-revalidate=30");
+    NEMO_ASSERT(control.maxAge == 60);
+    NEMO_ASSERT(control.sMaxAge == 120);
+    NEMO_ASSERT(control.staleWhileRevalidate == 30);
+    NEMO_ASSERT(control.getTtl() == 120);
+    NEMO_ASSERT(!control.noStore && !control.noCache && !control.isPrivate);
+
+    HttpCacheControl other;
+    other.parse("No-Store,private , max-age=abc");
+    NEMO_ASSERT(other.noStore && other.isPrivate);
+    NEMO_ASSERT(other.maxAge == -1);
+    NEMO_ASSERT(other.getTtl() <= 0);
+    NEMO_LOG_INFO(rootLogger) << "cache control parse test passed";
+}
+
+void TestMatchETag() {
+    NEMO_ASSERT(HttpResponseCache::MatchETag("\"a\"", "\"a\""));
+    NEMO_ASSERT(HttpResponseCache::MatchETag("\"b\", W/\"a\"", "\"a\""));
+    NEMO_ASSERT(HttpResponseCache::MatchETag("\"a\"", "W/\"a\""));
+    NEMO_ASSERT(HttpResponseCache::MatchETag("*", "\"a\""));
+    NEMO_ASSERT(!HttpResponseCache::MatchETag("\"b\"", "\"a\""));
+    NEMO_ASSERT(!HttpResponseCache::MatchETag("", "\"a\""));
+    NEMO_ASSERT(!HttpResponseCache::MatchETag("*", ""));
+    NEMO_LOG_INFO(rootLogger) << "etag match test passed";
+}
+
+/**
+ * @brief 新鲜期内的请求不再执行servlet, Vary字段区分变体, If-None-Match返回304
+ */
+void TestHandle() {
+    Config::LookupBase("http.cache.enable")->fromString("1");
+    auto cache = std::make_shared<HttpResponseCache>(nullptr);
+    int calls = 0;
+    FunctionServlet servlet([&calls](HttpRequest* request, HttpResponse* response, HttpSession*) {
+        ++calls;
+        response->setHeader("Cache-Control", "max-age=60");
+        response->setHeader("Vary", "Accept-Language");
+        response->setHeader("ETag", "\"v" + std::to_string(calls) + "\"");
+        response->setBody("lang=" + request->getHeader("Accept-Language"));
+        return 0;
+    });
+
+    auto get = [&](StringArg lang, StringArg ifNoneMatch) {
+        HttpRequest request;
+        request.setPath("/cached");
+        if(!lang.empty()) {
+            request.setHeader("Accept-Language", lang);
+        }
+        if(!ifNoneMatch.empty()) {
+            request.setHeader("If-None-Match", ifNoneMatch);
+        }
+        auto response = std::make_unique<HttpResponse>();
+        cache->handle(nullptr, &servlet, &request, response.get(), nullptr);
+        return response;
+    };
+
+    NEMO_ASSERT(get("", "")->getBody() == "lang=");
+    NEMO_ASSERT(get("", "")->getBody() == "lang=");
+    NEMO_ASSERT(calls == 1);
+    NEMO_ASSERT(get("fr", "")->getBody() == "lang=fr");
+    NEMO_ASSERT(get("fr", "")->getBody() == "lang=fr");
+    NEMO_ASSERT(calls == 2);
+
+    auto notModified = get("", "\"v1\"");
+    NEMO_ASSERT(notModified->getStatus() == HttpStatus::NOT_MODIFIED);
+    NEMO_ASSERT(notModified->getBody().empty());
+    NEMO_ASSERT(calls == 2);
+
+    cache->invalidate("/cached");
+    NEMO_ASSERT(cache->getBytes() == 0);
+    NEMO_ASSERT(get("", "")->getBody() == "lang=");
+    NEMO_ASSERT(calls == 3);
+    NEMO_LOG_INFO(rootLogger) << "response cache handle test passed";
+}
+
+/**
+ * @brief 挂载了过滤器的路由在命中缓存时也执行过滤器
+ */
+void TestFilteredHandle() {
+    auto cache = std::make_shared<HttpResponseCache>(nullptr);
+    int calls = 0;
+    int filtered = 0;
+    auto servlet = std::make_shared<FunctionServlet>([&calls](HttpRequest*, HttpResponse* response, HttpSession*) {
+        ++calls;
+        response->setHeader("Cache-Control", "max-age=60");
+        response->setBody(StringArg("secret"));
+        return 0;
+    });
+    auto auth = std::make_shared<FunctionFilter>([&filtered](HttpRequest* request, HttpResponse* response, HttpSession*) {
+        ++filtered;
+        if(request->getHeader("X-Token") != "ok") {
+            response->setStatus(HttpStatus::UNAUTHORIZED);
+            return false;
+        }
+        return true;
+    }, [](HttpRequest*, HttpResponse* response, HttpSession*) {
+        response->setHeader("X-Filtered", "1");
+    });
+    FilteredServlet chain(servlet, {auth});
+
+    auto get = [&](StringArg token) {
+        HttpRequest request;
+        request.setPath("/filtered");
+        request.setHeader("X-Token", token);
+        auto response = std::make_unique<HttpResponse>();
+        cache->handle(nullptr, &chain, &request, response.get(), nullptr);
+        return response;
+    };
+
+    NEMO_ASSERT(get("ok")->getBody() == "secret");
+    auto hit = get("ok");
+    NEMO_ASSERT(hit->getBody() == "secret" && hit->getHeader("X-Filtered") == "1");
+    NEMO_ASSERT(calls == 1 && filtered == 2);
+    auto rejected = get("bad");
+    NEMO_ASSERT(rejected->getStatus() == HttpStatus::UNAUTHORIZED && rejected->getBody().empty());
+    NEMO_ASSERT(calls == 1 && filtered == 3);
+    NEMO_LOG_INFO(rootLogger) << "response cache filter test passed";
+}
+
+/**
+ * @brief 过期后返回旧响应, 后台刷新时servlet拿到的session不为空, 也不占用socket
+ */
+void TestRefresh() {
+    coroutine::Scheduler scheduler("cache", 1);
+    scheduler.threadStart();
+    auto cache = std::make_shared<HttpResponseCache>(&scheduler);
+    std::atomic<int> calls{0};
+    ServletDispatcher dispatcher;
+    dispatcher.addServlet("/stale", [&calls](HttpRequest*, HttpResponse* response, HttpSession* session) {
+        NEMO_ASSERT(session && session->getResource());
+        //第一次由请求触发, 第二次是后台刷新
+        NEMO_ASSERT((0 == calls) == (session->getSocket() != nullptr));
+        response->setHeader("Cache-Control", "max-age=1, stale-while-revalidate=30");
+        response->setBody("v" + std::to_string(++calls));
+        return 0;
+    });
+
+    HttpSession session(net::Socket::CreateTcpSocket());
+    auto get = [&]() {
+        HttpRequest request;
+        request.setPath("/stale");
+        auto response = std::make_unique<HttpResponse>();
+        HttpServlet::SharedPtr servlet = dispatcher.getMatchedServlet(&request);
+        cache->handle(&dispatcher, servlet.get(), &request, response.get(), &session);
+        return response->getBody();
+    };
+
+    NEMO_ASSERT(get() == "v1");
+    ::usleep(1100 * 1000);
+    NEMO_ASSERT(get() == "v1");
+    for(int i = 0; i < 100 && calls != 2; ++i) {
+        ::usleep(10 * 1000);
+    }
+    ::usleep(10 * 1000);
+    NEMO_ASSERT(get() == "v2");
+    scheduler.stop();
+    NEMO_LOG_INFO(rootLogger) << "response cache refresh test passed";
+}
+
+int main(int argc, char** argv) {
+    TestCacheControl();
+    TestMatchETag();
+    TestHandle();
+    TestFilteredHandle();
+    TestRefresh();
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include "net/http/http_client.h"
+#include "net/socket.h"
+#include "coroutine/scheduler.h"
+#include "log/log.h"
+#include "common/macro.h"
+
+using namespace nemo;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+static coroutine::Scheduler scheduler("client", 4);
+static const uint16_t kPort = 18082;
+static std::atomic<bool> ready{false};
+static std::atomic<bool> done{false};
+static std::atomic<int> hedged{0};
+static std::atomic<int> maxPipelined{0};
+
+/**
+ * @brief 响应消息体为请求路径
+ *        /slow等待500毫秒, /hedge第一次等待1秒
+ */
+static void HandleClient(net::Socket::SharedPtr client) {
+    String data;
+    char buffer[4096];
+    while(true) {
+        int n = client->recv(buffer, sizeof(buffer));
+        if(n <= 0) {
+            return;
+        }
+        data.append(buffer, n);
+        int pipelined = 0;
+        size_t end;
+        while(String::npos != (end = data.find("\r\n\r\n"))) {
+            String request = data.substr(0, end);
+            data.erase(0, end + 4);
+            ++pipelined;
+            size_t begin = request.find(' ') + 1;
+            String path = request.substr(begin, request.find(' ', begin) - begin);
+            if(path == "/slow" || (path == "/hedge" && 0 == hedged++)) {
+                ::usleep((path == "/slow" ? 500 : 1000) * 1000);
+            }
+            String response = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(path.size()) +
+                              "\r\n\r\n" + path;
+            if(client->send(response.data(), response.size()) <= 0) {
+                return;
+            }
+        }
+        int max = maxPipelined;
+        while(pipelined > max && !maxPipelined.compare_exchange_weak(max, pipelined)) {
+        }
+    }
+}
+
+void Server() {
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    net::Socket::UniquePtr sock = net::Socket::CreateTcp(address.get());
+    NEMO_ASSERT(sock->bind(address.get()));
+    NEMO_ASSERT(sock->listen());
+    sock->setRecvTimeout(100);
+    ready = true;
+    while(!done) {
+        net::Socket::SharedPtr client = sock->accept();
+        if(client) {
+            scheduler.addTask(std::bind(HandleClient, client));
+        }
+    }
+}
+
+static int64_t ElapsedMillionSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+void TestClient() {
+    while(!ready) {
+        ::usleep(10 * 1000);
+    }
+    String origin = "http://127.0.0.1:" + std::to_string(kPort);
+    net::http::HttpClient client;
+
+    //超时未结束的请求被取消, 不影响其他请求
+    std::vector<net::http::HttpClientRequest> requests;
+    for(int i = 0; i < 10; ++i) {
+        net::http::HttpClientRequest request;
+        request.url = origin + (i % 5 == 4 ? "/slow" : "/fast" + std::to_string(i));
+        requests.push_back(request);
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto results = client.fanOut(requests, 200);
+    NEMO_ASSERT(ElapsedMillionSeconds(start) < 400);
+    NEMO_ASSERT(results.size() == requests.size());
+    for(int i = 0; i < 10; ++i) {
+        if(i % 5 == 4) {
+            NEMO_ASSERT(results[i]->errorCode == net::http::HttpResult::ErrorCode::TIMEOUT);
+        } else {
+            NEMO_ASSERT(results[i]->errorCode == net::http::HttpResult::ErrorCode::OK);
+            NEMO_ASSERT(results[i]->response->getBody() == "/fast" + std::to_string(i));
+        }
+    }
+    NEMO_LOG_INFO(rootLogger) << "http client fan out test passed";
+
+    net::http::HttpClientRequest slow;
+    slow.url = origin + "/slow";
+    auto future = client.async(slow, 2000);
+    ::usleep(50 * 1000);
+    start = std::chrono::steady_clock::now();
+    future->cancel();
+    future->wait();
+    NEMO_ASSERT(ElapsedMillionSeconds(start) < 100);
+    NEMO_ASSERT(future->get()->errorCode == net::http::HttpResult::ErrorCode::CANCELLED);
+    NEMO_LOG_INFO(rootLogger) << "http client cancel test passed";
+
+    //第一次请求等待1秒, 对冲请求在50毫秒后发出并先返回
+    net::http::HttpClientRequest hedge;
+    hedge.url = origin + "/hedge";
+    hedge.hedge = true;
+    start = std::chrono::steady_clock::now();
+    future = client.async(hedge, 2000);
+    future->wait();
+    auto result = future->get();
+    NEMO_ASSERT(result->errorCode == net::http::HttpResult::ErrorCode::OK);
+    NEMO_ASSERT(result->response->getBody() == "/hedge" && hedged == 2);
+    NEMO_ASSERT(ElapsedMillionSeconds(start) < 500);
+    NEMO_LOG_INFO(rootLogger) << "http client hedge test passed";
+
+    requests.clear();
+    for(int i = 0; i < 8; ++i) {
+        net::http::HttpClientRequest request;
+        request.url = origin + "/p" + std::to_string(i);
+        requests.push_back(request);
+    }
+    requests[3].method = net::http::HttpMethod::POST;
+    requests.push_back(net::http::HttpClientRequest());
+    requests.back().url = "bad url";
+    results = client.pipeline(requests, 1000);
+    for(int i = 0; i < 8; ++i) {
+        NEMO_ASSERT(results[i]->errorCode == net::http::HttpResult::ErrorCode::OK);
+        NEMO_ASSERT(results[i]->response->getBody() == "/p" + std::to_string(i));
+    }
+    NEMO_ASSERT(results[8]->errorCode == net::http::HttpResult::ErrorCode::INVALID_URL);
+    NEMO_ASSERT(maxPipelined >= 2);
+    NEMO_LOG_INFO(rootLogger) << "http client pipeline test passed";
+
+    done = true;
+}
+
+int main(int argc, char** argv) {
+    scheduler.addTask(Server);
+    scheduler.addTask(TestClient);
+    scheduler.threadStart();
+    while(!done) {
+        ::usleep(10 * 1000);
+    }
+    ::usleep(300 * 1000);
+    scheduler.stop();
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "net/http/http_compress.h"
+
+#include <zlib.h>
+
+#include "net/http/http.h"
+#include "log/log.h"
+#include "common/config.h"
+#include "common/macro.h"
+
+using namespace nemo;
+using namespace nemo::net::http;
+
+static nemo::Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+
+void TestNegotiate() {
+    NEMO_ASSERT(NegotiateContentCoding("") == HttpContentCoding::IDENTITY);
+    NEMO_ASSERT(NegotiateContentCoding("identity") == HttpContentCoding::IDENTITY);
+    NEMO_ASSERT(NegotiateContentCoding("deflate, gzip") == HttpContentCoding::GZIP);
+    NEMO_ASSERT(NegotiateContentCoding("gzip;q=0.5, deflate;q=0.8") == HttpContentCoding::DEFLATE);
+    NEMO_ASSERT(NegotiateContentCoding("gzip;q=0, deflate;q=0") == HttpContentCoding::IDENTITY);
+    NEMO_ASSERT(NegotiateContentCoding("X-GZIP") == HttpContentCoding::GZIP);
+    NEMO_ASSERT(NegotiateContentCoding("*;q=0.1, gzip;q=0") != HttpContentCoding::GZIP);
+#ifdef NEMO_HAVE_BROTLI
+    NEMO_ASSERT(NegotiateContentCoding("gzip, deflate, br") == HttpContentCoding::BROTLI);
+#else
+    NEMO_ASSERT(NegotiateContentCoding("gzip, deflate, br") == HttpContentCoding::GZIP);
+#endif
+    NEMO_LOG_INFO(rootLogger) << "content coding negotiate test passed";
+}
+
+void TestCompressibleType() {
+    NEMO_ASSERT(HttpCompression::IsCompressibleType("application/json; charset=utf-8"));
+    NEMO_ASSERT(HttpCompression::IsCompressibleType("text/html"));
+    NEMO_ASSERT(HttpCompression::IsCompressibleType("application/problem+json"));
+    NEMO_ASSERT(!HttpCompression::IsCompressibleType("image/png"));
+    NEMO_ASSERT(!HttpCompression::IsCompressibleType(""));
+
+    //修改配置后替换整个类型列表
+    auto types = Config::LookupBase("http.compress.types");
+    String saved = types->toString();
+    NEMO_ASSERT(types->fromString("[image/png]"));
+    NEMO_ASSERT(HttpCompression::IsCompressibleType("image/png"));
+    NEMO_ASSERT(!HttpCompression::IsCompressibleType("text/html"));
+    NEMO_ASSERT(types->fromString(saved));
+    NEMO_ASSERT(HttpCompression::IsCompressibleType("text/html"));
+    NEMO_LOG_INFO(rootLogger) << "compressible type test passed";
+}
+
+/**
+ * @brief 压缩结果能被zlib还原, 重复的消息体命中缓存后结果不变
+ */
+void TestApply() {
+    String body;
+    for(int i = 0; i < 500; ++i) {
+        body.append("{\"id\":").append(std::to_string(i)).append(",\"name\":\"nemo\"},");
+    }
+    for(int round = 0; round < 3; ++round) {
+        HttpResponse response;
+        response.setHeader("Content-Type", "application/json");
+        response.setBody(body);
+        NEMO_ASSERT(HttpCompression::Apply(HttpContentCoding::GZIP, &response));
+        NEMO_ASSERT(response.getHeader(HttpHeaderId::CONTENT_ENCODING) == "gzip");
+        NEMO_ASSERT(response.getHeader(HttpHeaderId::VARY) == "Accept-Encoding");
+        NEMO_ASSERT(response.getBody().size() < body.size() / 4);
+
+        z_stream zs = {};
+        NEMO_ASSERT(::inflateInit2(&zs, 15 + 16) == Z_OK);
+        String out(body.size() + 1, '\0');
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(response.getBody().data()));
+        zs.avail_in = response.getBody().size();
+        zs.next_out = reinterpret_cast<Bytef*>(out.data());
+        zs.avail_out = out.size();
+        NEMO_ASSERT(::inflate(&zs, Z_FINISH) == Z_STREAM_END);
+        out.resize(zs.total_out);
+        ::inflateEnd(&zs);
+        NEMO_ASSERT(out == body);
+    }
+
+    //已经编码过的响应和不在列表中的类型不处理
+    HttpResponse encoded;
+    encoded.setHeader("Content-Type", "application/json");
+    encoded.setHeader("Content-Encoding", "gzip");
+    encoded.setBody(body);
+    NEMO_ASSERT(!HttpCompression::Apply(HttpContentCoding::GZIP, &encoded));
+    HttpResponse image;
+    image.setHeader("Content-Type", "image/png");
+    image.setBody(body);
+    NEMO_ASSERT(!HttpCompression::Apply(HttpContentCoding::GZIP, &image));
+    NEMO_ASSERT(image.getBody() == body);
+    NEMO_LOG_INFO(rootLogger) << "compress apply test passed";
+}
+
+/**
+ * @brief 流式压缩每次写入的数据都能立即解码, 不会等到结束才输出
+ */
+void TestStreamFlush() {
+    HttpCompressor::UniquePtr compressor = HttpCompressor::Create(HttpContentCoding::GZIP);
+    z_stream zs = {};
+    NEMO_ASSERT(::inflateInit2(&zs, 15 + 16) == Z_OK);
+    String decoded;
+    for(int i = 0; i < 3; ++i) {
+        String event = "data: " + std::to_string(i) + "\n\n";
+        String out;
+        NEMO_ASSERT(compressor->compress(event.data(), event.size(), out, false));
+        NEMO_ASSERT(!out.empty());
+        char buffer[256];
+        zs.next_in = reinterpret_cast<Bytef*>(out.data());
+        zs.avail_in = out.size();
+        zs.next_out = reinterpret_cast<Bytef*>(buffer);
+        zs.avail_out = sizeof(buffer);
+        int rt = ::inflate(&zs, Z_SYNC_FLUSH);
+        NEMO_ASSERT(Z_OK == rt && 0 == zs.avail_in);
+        decoded.append(buffer, sizeof(buffer) - zs.avail_out);
+        NEMO_ASSERT(decoded.size() >= event.size() && decoded.ends_with(event));
+    }
+    ::inflateEnd(&zs);
+
+#ifdef NEMO_HAVE_BROTLI
+    HttpCompressor::UniquePtr brotli = HttpCompressor::Create(HttpContentCoding::BROTLI);
+    String out;
+    NEMO_ASSERT(brotli->compress("data: 0\n\n", 9, out, false));
+    NEMO_ASSERT(!out.empty());
+#endif
+    NEMO_LOG_INFO(rootLogger) << "compress stream flush test passed";
+}
+
+int main(int argc, char** argv) {
+    Config::LookupBase("http.compress.enable")->fromString("1");
+    TestNegotiate();
+    TestCompressibleType();
+    TestApply();
+    TestStreamFlush();
+    return 0;
+}
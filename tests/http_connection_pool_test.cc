@@ -0,0 +1,181 @@
+#include <unistd.h>
+
+#include <atomic>
+#include <vector>
+
+#include "net/http/http_connection.h"
+#include "net/socket.h"
+#include "coroutine/scheduler.h"
+#include "log/log.h"
+#include "common/macro.h"
+
+using namespace nemo;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+static coroutine::Scheduler scheduler("pool", 2);
+static const uint16_t kPort = 18081;
+static std::atomic<bool> ready{false};
+static std::atomic<bool> done{false};
+static std::atomic<int> accepted{0};
+static std::atomic<int> requests{0};
+static std::atomic<int> pipelined{0};
+
+/**
+ * @brief 处理一个连接上的请求
+ *        /close返回Connection: close并关闭连接, /linger响应之后过一段时间关闭连接,
+ *        /http10返回HTTP/1.0的keep-alive响应. 读到的数据中已经有下一个请求时计入pipelined
+ */
+static void HandleClient(net::Socket::SharedPtr client) {
+    String data;
+    char buffer[1024];
+    while(true) {
+        size_t end;
+        while(String::npos == (end = data.find("\r\n\r\n"))) {
+            int n = client->recv(buffer, sizeof(buffer));
+            if(n <= 0) {
+                return;
+            }
+            data.append(buffer, n);
+        }
+        String request = data.substr(0, end);
+        data.erase(0, end + 4);
+        ++requests;
+        if(String::npos != data.find("\r\n\r\n")) {
+            ++pipelined;
+        }
+        NEMO_ASSERT(request.find("Host: 127.0.0.1") != String::npos ||
+                    request.find("host: 127.0.0.1") != String::npos);
+        bool close = request.compare(0, 10, "GET /close") == 0;
+        bool http10 = request.compare(0, 11, "GET /http10") == 0;
+        String body = std::to_string(accepted.load());
+        String response = (http10 ? "HTTP/1.0 200 OK\r\nConnection: keep-alive" : "HTTP/1.1 200 OK") +
+                          String("\r\nContent-Length: ") + std::to_string(body.size()) +
+                          (close ? "\r\nConnection: close" : "") + "\r\n\r\n" + body;
+        client->send(response.data(), response.size());
+        if(request.compare(0, 11, "GET /linger") == 0) {
+            ::usleep(50 * 1000);
+            client->close();
+            return;
+        }
+        if(close) {
+            client->close();
+            return;
+        }
+    }
+}
+
+void Server() {
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    net::Socket::UniquePtr sock = net::Socket::CreateTcp(address.get());
+    NEMO_ASSERT(sock->bind(address.get()));
+    NEMO_ASSERT(sock->listen());
+    sock->setRecvTimeout(100);
+    ready = true;
+    while(!done) {
+        net::Socket::SharedPtr client = sock->accept();
+        if(client) {
+            ++accepted;
+            scheduler.addTask(std::bind(HandleClient, client));
+        }
+    }
+}
+
+/**
+ * @brief 只在HTTP/1.1的持久连接上使用流水线, HTTP/1.0的keep-alive服务器每次只发送一个请求
+ */
+static void TestPipeline() {
+    String url = "http://127.0.0.1:" + std::to_string(kPort);
+    for(const char* path : {"/http10", "/"}) {
+        net::http::HttpConnectionPool::SharedPtr pool = net::http::HttpConnectionPool::Create(
+            url, "", 4, 60 * 1000, 0);
+        std::vector<net::http::HttpRequest::UniquePtr> owned;
+        std::vector<const net::http::HttpRequest*> batch;
+        for(int i = 0; i < 4; ++i) {
+            owned.push_back(pool->createRequest(net::http::HttpMethod::GET, path));
+            batch.push_back(owned.back().get());
+        }
+        pipelined = 0;
+        auto results = pool->doPipeline(batch, 1000);
+        for(auto& result : results) {
+            NEMO_ASSERT(result->errorCode == net::http::HttpResult::ErrorCode::OK);
+        }
+        NEMO_ASSERT(String("/") == path ? pipelined > 0 : pipelined == 0);
+    }
+    NEMO_LOG_INFO(rootLogger) << "pool pipeline version test passed";
+}
+
+void TestPool() {
+    while(!ready) {
+        ::usleep(10 * 1000);
+    }
+    net::http::HttpConnectionPool::SharedPtr pool = net::http::HttpConnectionPool::Create(
+        "http://127.0.0.1:" + std::to_string(kPort), "", 4, 60 * 1000, 3);
+    NEMO_ASSERT(pool);
+
+    //同一个连接处理3个请求后换新连接
+    for(int i = 0; i < 5; ++i) {
+        auto result = pool->doGet("/", 1000);
+        NEMO_ASSERT(result->errorCode == net::http::HttpResult::ErrorCode::OK);
+        NEMO_ASSERT(result->response->getBody() == (i < 3 ? "1" : "2"));
+    }
+    NEMO_ASSERT(accepted == 2 && pool->getIdleCount() == 1 && pool->getLeasedCount() == 0);
+    NEMO_LOG_INFO(rootLogger) << "pool reuse and max request test passed";
+
+    //响应要求关闭的连接不归还
+    auto result = pool->doGet("/close", 1000);
+    NEMO_ASSERT(result->errorCode == net::http::HttpResult::ErrorCode::OK);
+    NEMO_ASSERT(pool->getIdleCount() == 0);
+
+    //对端关闭的空闲连接在取出时被丢弃
+    result = pool->doGet("/linger", 1000);
+    NEMO_ASSERT(result->errorCode == net::http::HttpResult::ErrorCode::OK);
+    NEMO_ASSERT(pool->getIdleCount() == 1 && accepted == 3);
+    ::usleep(100 * 1000);
+    {
+        auto lease = pool->acquire();
+        NEMO_ASSERT(lease && !lease.isReused() && pool->getLeasedCount() == 1);
+        NEMO_ASSERT(pool->getIdleCount() == 0 && accepted == 4);
+    }
+    NEMO_ASSERT(pool->getIdleCount() == 1 && pool->getLeasedCount() == 0);
+    NEMO_LOG_INFO(rootLogger) << "pool health check test passed";
+
+    //LIFO: 最近归还的连接先被取出
+    {
+        auto first = pool->acquire();
+        auto second = pool->acquire();
+        NEMO_ASSERT(first.isReused() && !second.isReused());
+        net::Socket* recent = second->getSocket();
+        first = net::http::HttpConnectionPool::Lease();
+        second = net::http::HttpConnectionPool::Lease();
+        NEMO_ASSERT(pool->getIdleCount() == 2);
+        auto third = pool->acquire();
+        NEMO_ASSERT(third.isReused() && third->getSocket() == recent);
+    }
+    NEMO_LOG_INFO(rootLogger) << "pool lifo test passed";
+
+    //预热和空闲超时
+    pool->setMinIdle(3);
+    pool->maintain();
+    NEMO_ASSERT(pool->getIdleCount() == 3);
+    pool->setMinIdle(0);
+    pool->setIdleTimeout(100);
+    ::usleep(200 * 1000);
+    pool->maintain();
+    NEMO_ASSERT(pool->getIdleCount() == 0);
+    NEMO_LOG_INFO(rootLogger) << "pool prewarm and idle reap test passed";
+
+    TestPipeline();
+    done = true;
+}
+
+int main(int argc, char** argv) {
+    scheduler.addTask(Server);
+    scheduler.addTask(TestPool);
+    scheduler.threadStart();
+    while(!done) {
+        ::usleep(10 * 1000);
+    }
+    ::usleep(300 * 1000);
+    scheduler.stop();
+    return 0;
+}
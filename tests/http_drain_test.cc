@@ -0,0 +1,144 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "net/http/http_server.h"
+#include "net/http/ws_servlet.h"
+#include "log/log.h"
+#include "common/macro.h"
+
+using namespace nemo;
+using namespace nemo::net::http;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+static const uint16_t kPipelinePort = 18077;
+static const uint16_t kWsPort = 18078;
+
+static HttpServer::UniquePtr StartServer(const coroutine::Scheduler::SharedPtr& scheduler, uint16_t port) {
+    auto server = std::make_unique<HttpServer>(true, scheduler, scheduler, scheduler);
+    auto address = net::IpAddress::Create("127.0.0.1", port);
+    NEMO_ASSERT(server->bind(address.get()));
+    ServletDispatcher* dispatcher = server->getServletDispatcher();
+    dispatcher->addServlet("/slow", [](HttpRequest*, HttpResponse* response, HttpSession*) {
+        ::usleep(300 * 1000);
+        response->setBody(String("slow"));
+        return 0;
+    });
+    dispatcher->addServlet("/hello", [](HttpRequest*, HttpResponse* response, HttpSession*) {
+        response->setBody(String("hello"));
+        return 0;
+    });
+    dispatcher->addServlet("/ws", std::make_unique<FunctionWsServlet>(
+            [](HttpRequest*, WsMessage* message, WsSession* ws) {
+        return ws->sendMessage(message) < 0 ? -1 : 0;
+    }));
+    NEMO_ASSERT(server->start());
+    return server;
+}
+
+/**
+ * @brief 在主线程中(不经过hook)连接服务器, 读超时1秒
+ */
+static int Connect(uint16_t port) {
+    auto address = net::IpAddress::Create("127.0.0.1", port);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    NEMO_ASSERT(::connect(fd, address->getAddr(), address->getAddrLen()) == 0);
+    struct timeval tv = {1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+static size_t Count(const String& data, StringArg pattern) {
+    size_t count = 0;
+    for(size_t pos = data.find(pattern); String::npos != pos; pos = data.find(pattern, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+/**
+ * @brief 处理请求期间开始优雅关闭, 已经收到的流水线请求都得到响应, 最后一个响应关闭连接
+ */
+void TestPipelineDrain(const coroutine::Scheduler::SharedPtr& scheduler) {
+    HttpServer::UniquePtr server = StartServer(scheduler, kPipelinePort);
+    int fd = Connect(kPipelinePort);
+    String requests = "GET /slow HTTP/1.1\r\nHost: local\r\n\r\n"
+                      "GET /hello HTTP/1.1\r\nHost: local\r\n\r\n"
+                      "GET /hello HTTP/1.1\r\nHost: local\r\n\r\n";
+    NEMO_ASSERT(::send(fd, requests.data(), requests.size(), 0) == (ssize_t)requests.size());
+    ::usleep(100 * 1000);
+
+    bool drained = false;
+    std::thread drainer([&]() {
+        drained = server->drain(2000);
+    });
+    String response;
+    char buffer[4096];
+    ssize_t n = 0;
+    while((n = ::recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        response.append(buffer, n);
+    }
+    drainer.join();
+    ::close(fd);
+
+    NEMO_ASSERT(drained);
+    NEMO_ASSERT(Count(response, "HTTP/1.1 200") == 3);
+    size_t slow = response.find("slow");
+    size_t last = response.rfind("HTTP/1.1 200");
+    NEMO_ASSERT(String::npos != slow && slow < response.find("hello"));
+    NEMO_ASSERT(Count(response.substr(last), "close") == 1);
+    NEMO_ASSERT(Count(response.substr(0, last), "close") == 0);
+    server->stop();
+    NEMO_LOG_INFO(rootLogger) << "http pipeline drain test passed";
+}
+
+/**
+ * @brief 优雅关闭时websocket连接收到1001关闭帧, 之后连接结束
+ */
+void TestWebSocketDrain(const coroutine::Scheduler::SharedPtr& scheduler) {
+    HttpServer::UniquePtr server = StartServer(scheduler, kWsPort);
+    int fd = Connect(kWsPort);
+    String handshake = "GET /ws HTTP/1.1\r\nHost: local\r\n"
+                       "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                       "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                       "Sec-WebSocket-Version: 13\r\n\r\n";
+    NEMO_ASSERT(::send(fd, handshake.data(), handshake.size(), 0) == (ssize_t)handshake.size());
+    String response;
+    char buffer[4096];
+    while(String::npos == response.find("\r\n\r\n")) {
+        ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        NEMO_ASSERT(n > 0);
+        response.append(buffer, n);
+    }
+    NEMO_ASSERT(response.starts_with("HTTP/1.1 101"));
+    response.erase(0, response.find("\r\n\r\n") + 4);
+
+    bool drained = false;
+    std::thread drainer([&]() {
+        drained = server->drain(2000);
+    });
+    while(response.size() < 4) {
+        ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        NEMO_ASSERT(n > 0);
+        response.append(buffer, n);
+    }
+    //FIN+CLOSE, 长度2, 状态码1001
+    NEMO_ASSERT(response == String("\x88\x02\x03\xe9", 4));
+
+    //服务器已经关闭读端, 不等待客户端回复关闭帧
+    NEMO_ASSERT(::recv(fd, buffer, sizeof(buffer), 0) == 0);
+    drainer.join();
+    ::close(fd);
+    NEMO_ASSERT(drained);
+    server->stop();
+    NEMO_LOG_INFO(rootLogger) << "websocket drain test passed";
+}
+
+int main(int argc, char** argv) {
+    auto scheduler = std::make_shared<coroutine::Scheduler>("drain", 2);
+    TestPipelineDrain(scheduler);
+    scheduler = std::make_shared<coroutine::Scheduler>("drain", 2);
+    TestWebSocketDrain(scheduler);
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "net/http/http_header.h"
+
+#include "log/log.h"
+#include "common/macro.h"
+
+using namespace nemo;
+using namespace nemo::net::http;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+
+void TestGetSet() {
+    HttpHeaders headers;
+    headers.set("Host", "example.com");
+    headers.set("X-Trace", "abc");
+    headers.set("content-length", "10");
+    NEMO_ASSERT(headers.size() == 3);
+    NEMO_ASSERT(headers.get(HttpHeaderId::HOST) == "example.com");
+    NEMO_ASSERT(headers.get("HOST") == "example.com");
+    NEMO_ASSERT(headers.get("x-trace") == "abc");
+    NEMO_ASSERT(headers.get(HttpHeaderId::CONTENT_LENGTH) == "10");
+    NEMO_ASSERT(headers.get("X-Missing", "none") == "none");
+
+    StringArg value;
+    NEMO_ASSERT(headers.has("X-TRACE", &value) && value == "abc");
+    NEMO_ASSERT(!headers.has(HttpHeaderId::COOKIE));
+
+    //保持插入顺序, 覆盖不改变位置
+    headers.set("host", "other.com");
+    NEMO_ASSERT(headers.size() == 3);
+    NEMO_ASSERT(headers.at(0).first == "Host" && headers.at(0).second == "other.com");
+    NEMO_ASSERT(headers.at(2).first == "content-length");
+
+    headers.erase("Host");
+    NEMO_ASSERT(headers.size() == 2 && !headers.has(HttpHeaderId::HOST));
+    //删除后常用字段的索引跟着前移
+    NEMO_ASSERT(headers.get(HttpHeaderId::CONTENT_LENGTH) == "10");
+    size_t count = 0;
+    for(auto [name, val] : headers) {
+        NEMO_ASSERT(headers.get(name) == val);
+        ++count;
+    }
+    NEMO_ASSERT(count == 2);
+
+    headers.clear();
+    NEMO_ASSERT(headers.empty() && headers.getStorageSize() == 0);
+    NEMO_ASSERT(!headers.has(HttpHeaderId::CONTENT_LENGTH));
+    NEMO_LOG_INFO(rootLogger) << "http headers get/set test passed";
+}
+
+/**
+ * @brief 覆盖时放得下就复用原来的位置, 旧值留下的空洞会被回收
+ */
+void TestOverwriteReuse() {
+    HttpHeaders headers;
+    headers.set("X-A", "aaaaaaaa");
+    headers.set("X-B", "b");
+    size_t size = headers.getStorageSize();
+
+    //先变短再变长, 不超过原来的长度时不追加
+    headers.set("X-A", "a");
+    headers.set("X-A", "aaaaaaa");
+    NEMO_ASSERT(headers.getStorageSize() == size);
+    NEMO_ASSERT(headers.get("X-A") == "aaaaaaa");
+
+    //末尾的值原地扩展
+    headers.set("X-B", "bbbb");
+    NEMO_ASSERT(headers.getStorageSize() == size + 3);
+    NEMO_ASSERT(headers.get("X-B") == "bbbb");
+
+    //中间的值反复变长, 占用的内存有上限
+    for(size_t i = 1; i <= 200; ++i) {
+        headers.set("X-A", String(i, 'x'));
+        NEMO_ASSERT(headers.get("X-A") == String(i, 'x'));
+        NEMO_ASSERT(headers.get("X-B") == "bbbb");
+        NEMO_ASSERT(headers.getStorageSize() <= 2 * (6 + 4 + 200));
+    }
+
+    //值指向容器内部
+    headers.set("X-B", headers.get("X-A"));
+    NEMO_ASSERT(headers.get("X-B") == String(200, 'x'));
+
+    //反复删除和添加, 占用的内存有上限
+    for(int i = 0; i < 200; ++i) {
+        headers.set("X-C", "ccc");
+        headers.erase("X-A");
+        headers.set("X-A", "a");
+        headers.erase("X-C");
+    }
+    NEMO_ASSERT(headers.size() == 2 && headers.get("X-A") == "a");
+    NEMO_ASSERT(headers.getStorageSize() <= 2 * (6 + 200 + 3 + 1));
+    NEMO_LOG_INFO(rootLogger) << "http headers overwrite reuse test passed";
+}
+
+int main(int argc, char** argv) {
+    TestGetSet();
+    TestOverwriteReuse();
+    return 0;
+}
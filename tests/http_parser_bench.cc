@@ -0,0 +1,68 @@
+#include "net/http/http_parser.h"
+
+#include <chrono>
+
+#include "log/log.h"
+#include "common/types.h"
+#include "common/config.h"
+
+using namespace nemo;
+
+static nemo::Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+
+static const StringArg kRequest =
+    "GET /Nemo/index.html?id=1024&name=nemo HTTP/1.1\r\n"
+    "Host: www.baidu.com\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/96.0.4664.45 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark\r\n"
+    "\r\n";
+
+/**
+ * @brief 用同一个解析器反复解析kRequest, 返回每秒解析的请求数
+ */
+static double Bench(bool simd, size_t times) {
+    static ConfigVar<String>* parserConfig = Config::Lookup("http.request.parser", String("ragel"));
+    parserConfig->setValue(simd ? "simd" : "ragel");
+
+    net::http::HttpRequestParser parser;
+    String msg;
+    size_t parsed = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < times; ++i) {
+        msg.assign(kRequest.data(), kRequest.size()); //execute会移动数据, 每次重新拷贝
+        parser.reset();
+        parser.execute(msg.data(), msg.size());
+        if(parser.isFinished() && !parser.hasError()) {
+            ++parsed;
+        }
+    }
+    std::chrono::duration<double> cost = std::chrono::steady_clock::now() - begin;
+    if(parsed != times) {
+        NEMO_LOG_ERROR(rootLogger) << "parse failed, simd=" << simd
+            << " parsed=" << parsed << " times=" << times;
+    }
+    return times / cost.count();
+}
+
+int main(int argc, char** argv) {
+    size_t times = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    Bench(false, times / 10); //预热
+    double ragel = Bench(false, times);
+    Bench(true, times / 10);
+    double simd = Bench(true, times);
+
+    NEMO_LOG_INFO(rootLogger) << "times=" << times
+        << " simd_accelerated=" << net::http::IsHttpSimdParserAccelerated();
+    NEMO_LOG_INFO(rootLogger) << "ragel: " << static_cast<uint64_t>(ragel) << " req/s";
+    NEMO_LOG_INFO(rootLogger) << "simd:  " << static_cast<uint64_t>(simd) << " req/s"
+        << " (" << simd / ragel << "x)";
+
+    return 0;
+}
@@ -6,6 +6,7 @@
 #include "net/socket.h"
 #include "log/log.h"
 #include "common/types.h"
+#include "common/config.h"
 #include "container/buffer.h"
 
 using namespace nemo;
@@ -14,10 +15,12 @@ static nemo::Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
 
 void TestRequest(nemo::StringArg httpMsg);
 void TestResponse(nemo::StringArg httpMsg);
+void TestSimdRequest();
 void Test(StringArg uriStr);
 
 int main(int argc, char** argv) {
     TestRequest("");
+    TestSimdRequest();
     //TestResponse("");
     //Test("www.baidu.com");
 
@@ -50,6 +53,74 @@ void TestRequest(StringArg httpMsg) {
     NEMO_LOG_DEBUG(rootLogger) << "msg=" << msg;
 }
 
+/**
+ * @brief 用两个解析器解析同一个报文, 返回解析结果
+ */
+static String ParseRequestWith(bool simd, StringArg httpMsg) {
+    static ConfigVar<String>* parserConfig = Config::Lookup("http.request.parser", String("ragel"));
+    parserConfig->setValue(simd ? "simd" : "ragel");
+
+    String msg(httpMsg.data(), httpMsg.size());
+    net::http::HttpRequestParser parser;
+    size_t offset = parser.execute(msg.data(), msg.size());
+    //出错和不完整时两个解析器已消费的长度不同, 只比较状态
+    std::stringstream ss;
+    if(parser.hasError()) {
+        ss << "error";
+    } else if(!parser.isFinished()) {
+        ss << "not finished";
+    } else {
+        ss << "offset=" << offset << "\n" << *parser.getRequest();
+    }
+    return ss.str();
+}
+
+void TestSimdRequest() {
+    const char* messages[] = {
+        "POST / HTTP/1.1\r\n"
+        "Host: www.baidu.com\r\n"
+        "Content-Length: 10\r\n"
+        "\r\n"
+        "0123456789",
+
+        "GET /Nemo/xx?id=1&name=nemo#top HTTP/1.0\r\n"
+        "Host:www.baidu.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9\r\n"
+        "Cookie: a=1; b=2\r\n"
+        "\r\n",
+
+        "DELETE /a/very/long/path/that/spans/more/than/sixteen/bytes HTTP/1.1\r\n"
+        "X-Empty:\r\n"
+        "X-Tab:\tvalue\r\n"
+        "\r\n",
+
+        //头部不完整
+        "GET / HTTP/1.1\r\nHost: www.baidu.com\r\n",
+
+        //格式错误
+        "GET / HTTP/1.1\r\nHost www.baidu.com\r\n\r\n",
+        "GET / HTTP/1.1\r\nHo st: www.baidu.com\r\n\r\n",
+        "GET /index.html FTP/1.1\r\n\r\n",
+    };
+
+    size_t failed = 0;
+    for(const char* msg : messages) {
+        String ragel = ParseRequestWith(false, msg);
+        String simd = ParseRequestWith(true, msg);
+        if(ragel != simd) {
+            ++failed;
+            NEMO_LOG_ERROR(rootLogger) << "simd parser mismatch\nragel: " << ragel
+                << "\nsimd: " << simd;
+        }
+    }
+    NEMO_LOG_INFO(rootLogger) << "simd parser accelerated="
+        << net::http::IsHttpSimdParserAccelerated()
+        << " total=" << std::size(messages)
+        << " failed=" << failed;
+}
+
 void TestResponse(StringArg httpMsg) {
     String msg(httpMsg.data(), httpMsg.size());
     if (msg.empty()) {
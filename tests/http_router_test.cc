@@ -0,0 +1,345 @@
+#include "net/http/servlet.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "net/http/http.h"
+#include "log/log.h"
+#include "common/macro.h"
+#include "common/thread.h"
+
+using namespace nemo;
+using namespace nemo::net::http;
+
+static nemo::Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+
+/**
+ * @brief 只用来区分匹配结果的servlet
+ */
+class NamedServlet : public HttpServlet {
+public:
+    NamedServlet(StringArg name) : HttpServlet(name) {}
+
+    int32_t handle(HttpRequest* request, HttpResponse* response, HttpSession* session) override {
+        return 0;
+    }
+};
+
+/**
+ * @brief 记录创建次数的servlet, 用来检查ServletCreator每个请求创建一个新的对象
+ */
+class CountedServlet : public HttpServlet {
+public:
+    static int created;
+
+    CountedServlet() : HttpServlet("counted") {
+        ++created;
+    }
+
+    int32_t handle(HttpRequest* request, HttpResponse* response, HttpSession* session) override {
+        return 0;
+    }
+};
+
+int CountedServlet::created = 0;
+
+static HttpServlet::UniquePtr Named(StringArg name) {
+    return std::make_unique<NamedServlet>(name);
+}
+
+static String Match(ServletDispatcher& dispatcher, HttpMethod method, StringArg path,
+                    HttpRequest* request = nullptr) {
+    HttpRequest tmp;
+    if(!request) {
+        request = &tmp;
+    }
+    request->setMethod(method);
+    request->setPath(String(path));
+    return dispatcher.getMatchedServlet(request)->getName();
+}
+
+void TestMatch() {
+    ServletDispatcher dispatcher;
+    dispatcher.addServlet("/", Named("root"));
+    dispatcher.addServlet("/users", Named("users"));
+    dispatcher.addServlet("/users/new", Named("users_new"));
+    dispatcher.addRoute(HttpMethod::GET, "/users/:id", Named("get_user"));
+    dispatcher.addRoute(HttpMethod::DELETE, "/users/:id", Named("del_user"));
+    dispatcher.addServlet("/users/:id/posts/:post", Named("user_post"));
+    dispatcher.addServlet("/users/:id/edit", Named("user_edit"));
+    dispatcher.addServlet("/static/*file", Named("static"));
+    dispatcher.addGlobServlet("/Nemo_*", Named("glob"));
+    dispatcher.addServlet("/use", Named("use"));
+
+    //同一位置的参数名不一致
+    NEMO_ASSERT(!dispatcher.addRoute(HttpMethod::GET, "/users/:name/x", Named("conflict")));
+    //参数必须从'/'之后开始, 通配只能在末尾
+    NEMO_ASSERT(!dispatcher.addRoute(HttpMethod::GET, "/a:b", Named("invalid")));
+    NEMO_ASSERT(!dispatcher.addRoute(HttpMethod::GET, "/a/*x/y", Named("invalid")));
+
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/") == "root");
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/users") == "users");
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/use") == "use");
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/user") == "NotFoundServlet");
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/users/new") == "users_new");
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::DELETE, "/users/new") == "users_new");
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/users/42") == "get_user");
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::DELETE, "/users/42") == "del_user");
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::POST, "/users/42") == "MethodNotAllowedServlet");
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/users/") == "NotFoundServlet");
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/Nemo_abc/def") == "glob");
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/Nemo_") == "glob");
+
+    //静态片段/users/new匹配失败后回溯到参数片段
+    HttpRequest request;
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/users/new/edit", &request) == "user_edit");
+    NEMO_ASSERT(request.getRouteParam("id") == "new");
+
+    HttpRequest request2;
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::PUT, "/users/7/posts/hello", &request2) == "user_post");
+    NEMO_ASSERT(request2.getRouteParam("id") == "7");
+    NEMO_ASSERT(request2.getRouteParam("post") == "hello");
+
+    HttpRequest request3;
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/static/css/a.css", &request3) == "static");
+    NEMO_ASSERT(request3.getRouteParam("file") == "css/a.css");
+
+    dispatcher.delRoute(HttpMethod::GET, "/users/:id");
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/users/42") == "MethodNotAllowedServlet");
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::DELETE, "/users/42") == "del_user");
+    dispatcher.delServlet("/users");
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/users") == "NotFoundServlet");
+    NEMO_ASSERT(dispatcher.getServlet("/static/*file")->getName() == "static");
+
+    NEMO_LOG_INFO(rootLogger) << "router match test passed";
+}
+
+/**
+ * @brief 重复注册的路由被拒绝, 路径只对其它方法有路由时返回405和Allow头部
+ */
+void TestDuplicateAndMethodNotAllowed() {
+    ServletDispatcher dispatcher;
+    dispatcher.addServlet("/health", Named("first"));
+    dispatcher.addServlet("/health", Named("second"));
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/health") == "first");
+    NEMO_ASSERT(dispatcher.addRoute(HttpMethod::GET, "/items/:id", Named("get_item")));
+    NEMO_ASSERT(!dispatcher.addRoute(HttpMethod::GET, "/items/:id", Named("get_item2")));
+    NEMO_ASSERT(dispatcher.addRoute(HttpMethod::PUT, "/items/:id", Named("put_item")));
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/items/1") == "get_item");
+    //删除后可以重新注册
+    dispatcher.delServlet("/health");
+    dispatcher.addServlet("/health", Named("second"));
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::GET, "/health") == "second");
+
+    HttpRequest request;
+    HttpResponse response;
+    request.setMethod(HttpMethod::DELETE);
+    request.setPath("/items/1");
+    dispatcher.handle(&request, &response, nullptr);
+    NEMO_ASSERT(response.getStatus() == HttpStatus::METHOD_NOT_ALLOWED);
+    NEMO_ASSERT(response.getHeader("Allow") == "GET, PUT");
+
+    HttpResponse notFound;
+    request.setPath("/items");
+    dispatcher.handle(&request, &notFound, nullptr);
+    NEMO_ASSERT(notFound.getStatus() == HttpStatus::NOT_FOUND);
+    NEMO_LOG_INFO(rootLogger) << "router duplicate and method not allowed test passed";
+}
+
+/**
+ * @brief 2000条路由下的查找耗时
+ */
+void BenchMatch(size_t times) {
+    ServletDispatcher dispatcher;
+    constexpr size_t kRoutes = 2000;
+    //批量添加只发布一次快照
+    dispatcher.updateRoutes([](HttpRouter& router) {
+        for(size_t i = 0; i < kRoutes; ++i) {
+            String prefix = "/api/v" + std::to_string(i % 4) + "/service" + std::to_string(i);
+            router.add(HttpMethod::GET, prefix + "/items/:id",
+                std::make_unique<HoldServletCreator>(Named("item")));
+            router.add(HttpRouter::kAnyMethod, prefix + "/status",
+                std::make_unique<HoldServletCreator>(Named("status")));
+        }
+        return true;
+    });
+
+    EpochDomain::Reader reader(dispatcher.getEpochDomain());
+    HttpRequest request;
+    request.setMethod(HttpMethod::GET);
+    request.setPath("/api/v3/service1999/items/12345");
+    auto begin = std::chrono::steady_clock::now();
+    size_t matched = 0;
+    for(size_t i = 0; i < times; ++i) {
+        EpochDomain::Guard guard(reader);
+        if(dispatcher.route(&request)->getName() == "item") {
+            ++matched;
+        }
+    }
+    std::chrono::duration<double> cost = std::chrono::steady_clock::now() - begin;
+    NEMO_ASSERT(matched == times);
+    NEMO_LOG_INFO(rootLogger) << "routes=" << kRoutes * 2 << " times=" << times
+        << " " << static_cast<uint64_t>(times / cost.count()) << " match/s";
+}
+
+/**
+ * @brief 读者持续匹配路由的同时, 写者反复替换路由表
+ */
+void TestConcurrentUpdate() {
+    ServletDispatcher dispatcher;
+    dispatcher.addRoute(HttpMethod::GET, "/stable/:id", Named("stable"));
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> mismatched{0};
+    std::vector<Thread::UniquePtr> readers;
+    for(int i = 0; i < 4; ++i) {
+        readers.push_back(std::make_unique<Thread>([&]() {
+            EpochDomain::ReaderLease reader(dispatcher.getEpochDomain());
+            HttpRequest request;
+            request.setMethod(HttpMethod::GET);
+            request.setPath("/stable/1");
+            while(!stop.load(std::memory_order_relaxed)) {
+                EpochDomain::Guard guard(reader.get());
+                if(dispatcher.route(&request)->getName() != "stable") {
+                    ++mismatched;
+                }
+            }
+        }, "router_reader"));
+        readers.back()->start();
+    }
+
+    for(int i = 0; i < 2000; ++i) {
+        String path = "/dynamic/" + std::to_string(i % 16);
+        dispatcher.addServlet(path, Named("dynamic"));
+        dispatcher.delServlet(path);
+    }
+    stop = true;
+    for(auto& reader : readers) {
+        reader->join();
+    }
+
+    EpochDomain* epoch = dispatcher.getEpochDomain();
+    epoch->reclaim();
+    NEMO_ASSERT(0 == mismatched);
+    NEMO_ASSERT(0 == epoch->getRetiredCount());
+    NEMO_LOG_INFO(rootLogger) << "router concurrent update test passed";
+}
+
+/**
+ * @brief 过滤器按前缀挂载, before按添加顺序执行, after按相反顺序执行, 返回false时不执行servlet
+ */
+void TestFilter() {
+    ServletDispatcher dispatcher;
+    String trace;
+    dispatcher.addServlet("/api/users/:id", [&trace](HttpRequest*, HttpResponse*, HttpSession*) {
+        trace += "servlet ";
+        return 0;
+    });
+    dispatcher.addServlet("/health", Named("health"));
+    HttpServlet* health = dispatcher.getMatchedServlet("/health").get();
+
+    auto makeFilter = [&trace](StringArg name, bool pass) {
+        String tag(name);
+        return std::make_shared<FunctionFilter>(
+            [&trace, tag, pass](HttpRequest*, HttpResponse* response, HttpSession*) {
+                trace += tag + ".before ";
+                if(!pass) {
+                    response->setStatus(HttpStatus::UNAUTHORIZED);
+                }
+                return pass;
+            },
+            [&trace, tag](HttpRequest*, HttpResponse*, HttpSession*) {
+                trace += tag + ".after ";
+            });
+    };
+    auto timing = makeFilter("timing", true);
+    auto auth = makeFilter("auth", true);
+    dispatcher.addFilter(timing);
+    dispatcher.addFilter("/api/", auth);
+    //先注册过滤器后注册的路由同样生效
+    dispatcher.addRoute(HttpMethod::POST, "/api/login", Named("login"));
+
+    HttpRequest request;
+    HttpResponse response;
+    request.setMethod(HttpMethod::GET);
+    request.setPath("/api/users/1");
+    dispatcher.handle(&request, &response, nullptr);
+    NEMO_ASSERT(trace == "timing.before auth.before servlet auth.after timing.after ");
+
+    trace.clear();
+    request.setPath("/health");
+    dispatcher.handle(&request, &response, nullptr);
+    NEMO_ASSERT(trace == "timing.before timing.after ");
+
+    trace.clear();
+    request.setPath("/missing");
+    dispatcher.handle(&request, &response, nullptr);
+    NEMO_ASSERT(trace == "timing.before timing.after ");
+    NEMO_ASSERT(response.getStatus() == HttpStatus::NOT_FOUND);
+
+    NEMO_ASSERT(Match(dispatcher, HttpMethod::POST, "/api/login") == "login");
+
+    //405同样经过全局过滤器
+    trace.clear();
+    request.setPath("/api/login");
+    dispatcher.handle(&request, &response, nullptr);
+    NEMO_ASSERT(trace == "timing.before timing.after ");
+    NEMO_ASSERT(response.getStatus() == HttpStatus::METHOD_NOT_ALLOWED);
+
+    trace.clear();
+    dispatcher.addFilter("/api/", makeFilter("deny", false));
+    request.setPath("/api/users/1");
+    dispatcher.handle(&request, &response, nullptr);
+    NEMO_ASSERT(trace == "timing.before auth.before deny.before auth.after timing.after ");
+    NEMO_ASSERT(response.getStatus() == HttpStatus::UNAUTHORIZED);
+
+    //没有过滤器的路由恢复为原来的servlet
+    dispatcher.delFilter(timing);
+    NEMO_ASSERT(dispatcher.getMatchedServlet("/health").get() == health);
+    NEMO_LOG_INFO(rootLogger) << "servlet filter test passed";
+}
+
+/**
+ * @brief route返回的servlet不增加引用计数, ServletCreator注册的路由仍然每个请求创建新对象.
+ *        同一线程上归还的读者被下一次借用复用
+ */
+void TestRawRoute() {
+    ServletDispatcher dispatcher;
+    dispatcher.addServletCreator<CountedServlet>("/counted");
+    dispatcher.addServlet("/named", Named("named"));
+    EpochDomain* epoch = dispatcher.getEpochDomain();
+
+    EpochDomain::Reader* first = nullptr;
+    {
+        EpochDomain::ReaderLease reader(epoch);
+        first = &reader.get();
+        EpochDomain::Guard guard(reader.get());
+        HttpRequest request;
+        request.setMethod(HttpMethod::GET);
+        request.setPath("/named");
+        HttpServlet* named = dispatcher.route(&request);
+        NEMO_ASSERT(named->getName() == "named" && named->shared_from_this().use_count() == 2);
+
+        request.setPath("/counted");
+        HttpServlet* counted = dispatcher.route(&request);
+        int created = CountedServlet::created;
+        HttpResponse response;
+        counted->handle(&request, &response, nullptr);
+        counted->handle(&request, &response, nullptr);
+        NEMO_ASSERT(CountedServlet::created == created + 2);
+    }
+    EpochDomain::ReaderLease reader(epoch);
+    NEMO_ASSERT(&reader.get() == first);
+    NEMO_LOG_INFO(rootLogger) << "router raw route test passed";
+}
+
+int main(int argc, char** argv) {
+    TestMatch();
+    TestDuplicateAndMethodNotAllowed();
+    TestFilter();
+    TestRawRoute();
+    TestConcurrentUpdate();
+    BenchMatch(argc > 1 ? std::stoul(argv[1]) : 1000000);
+    return 0;
+}
@@ -39,6 +39,24 @@ void Test() {
             return 0;
     });
 
+    //流式回显消息体, 内存占用与消息体大小无关
+    net::http::HttpServlet::UniquePtr echo(new net::http::FunctionServlet([](net::http::HttpRequest* request,
+                net::http::HttpResponse* response,
+                net::http::HttpSession* session) {
+            net::http::HttpBodyReader* reader = session->getBodyReader();
+            net::http::HttpBodyWriter* writer = session->getBodyWriter(response);
+            char buff[4096];
+            ssize_t len = 0;
+            while((len = reader->read(buff, sizeof(buff))) > 0) {
+                if(writer->write(buff, len) < 0) {
+                    return -1;
+                }
+            }
+            return len < 0 ? -1 : 0;
+    }));
+    echo->setStreamBody(true);
+    servletDispatch->addServlet("/Nemo/echo", std::move(echo));
+
     servletDispatch->addGlobServlet("/Nemo/*", [](net::http::HttpRequest* request,
                 net::http::HttpResponse* response,
                 net::http::HttpSession* session) {
@@ -0,0 +1,53 @@
+#include "container/lru_cache.h"
+
+#include "log/log.h"
+#include "common/types.h"
+#include "common/macro.h"
+
+using namespace nemo;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+
+void TestEvictOrder() {
+    LruCache<int, String> cache(2);
+    String value;
+    cache.put(1, "one");
+    cache.put(2, "two");
+    //访问1之后2成为最久没有使用的元素
+    NEMO_ASSERT(cache.get(1, value) && value == "one");
+    cache.put(3, "three");
+    NEMO_ASSERT(cache.size() == 2);
+    NEMO_ASSERT(!cache.get(2, value));
+    NEMO_ASSERT(cache.get(1, value) && cache.get(3, value));
+
+    //覆盖已有的元素不淘汰
+    cache.put(3, "THREE");
+    NEMO_ASSERT(cache.size() == 2 && cache.get(3, value) && value == "THREE");
+
+    NEMO_ASSERT(cache.evict(&value) && value == "one");
+    NEMO_ASSERT(cache.erase(3) && cache.size() == 0);
+    NEMO_ASSERT(!cache.evict());
+    NEMO_LOG_INFO(rootLogger) << "lru cache evict order test passed";
+}
+
+/**
+ * @brief limit为0时不缓存任何元素
+ */
+void TestZeroLimit() {
+    LruCache<String, int> cache(0);
+    String key = "key";
+    int value = 0;
+    cache.put("a", 1);
+    cache.put(key, 2);
+    cache.put(String("b"), value);
+    cache.put(key, value);
+    NEMO_ASSERT(cache.size() == 0 && !cache.get("a", value));
+    NEMO_ASSERT(!cache.evict());
+    NEMO_LOG_INFO(rootLogger) << "lru cache zero limit test passed";
+}
+
+int main(int argc, char** argv) {
+    TestEvictOrder();
+    TestZeroLimit();
+    return 0;
+}
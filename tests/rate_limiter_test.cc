@@ -0,0 +1,160 @@
+#include "net/http/rate_limiter.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "net/http/http.h"
+#include "net/http/http_server.h"
+#include "net/address.h"
+#include "log/log.h"
+#include "common/macro.h"
+
+using namespace nemo;
+using namespace nemo::net;
+using namespace nemo::net::http;
+
+static nemo::Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+
+constexpr int64_t kSecond = 1000000000;
+
+/**
+ * @brief 突发burst个请求后按rate匀速放行, 拒绝时返回需要等待的时间
+ */
+void TestGcra() {
+    GcraLimiter limiter(10, 3, 1024);
+    int64_t now = 100 * kSecond;
+    NEMO_ASSERT(0 == limiter.acquire("a", now));
+    NEMO_ASSERT(0 == limiter.acquire("a", now));
+    NEMO_ASSERT(0 == limiter.acquire("a", now));
+    int64_t wait = limiter.acquire("a", now);
+    NEMO_ASSERT(wait == kSecond / 10);
+    //其它键互不影响
+    NEMO_ASSERT(0 == limiter.acquire("b", now));
+    //等待一个间隔后恢复一个请求
+    NEMO_ASSERT(0 == limiter.acquire("a", now + wait));
+    NEMO_ASSERT(limiter.acquire("a", now + wait) > 0);
+    //空闲足够久后恢复全部突发额度
+    now += kSecond;
+    for(int i = 0; i < 3; ++i) {
+        NEMO_ASSERT(0 == limiter.acquire("a", now));
+    }
+    NEMO_ASSERT(limiter.acquire("a", now) > 0);
+    NEMO_LOG_INFO(rootLogger) << "gcra limiter test passed";
+}
+
+void TestEvict() {
+    GcraLimiter limiter(1, 1, 64, 4);
+    for(int i = 0; i < 1000; ++i) {
+        limiter.acquire(std::to_string(i), 0);
+    }
+    NEMO_ASSERT(limiter.size() <= 64);
+    NEMO_LOG_INFO(rootLogger) << "gcra limiter evict test passed";
+}
+
+void TestHttpRateLimiter() {
+    RateLimitRule byIp;
+    byIp.prefix = "/api";
+    byIp.rate = 1;
+    byIp.burst = 2;
+    RateLimitRule byHeader;
+    byHeader.key = "header:X-Api-Key";
+    byHeader.rate = 1;
+    byHeader.burst = 1;
+    HttpRateLimiter limiter({byIp, byHeader}, 1024);
+
+    Address::UniquePtr client = Address::LookupAnyIPAddress("10.0.0.1:1234");
+    HttpRequest request;
+    request.setPath("/api/users");
+    request.setHeader("X-Api-Key", "k1");
+    uint32_t retryAfter = 0;
+    NEMO_ASSERT(limiter.allow(&request, client.get(), &retryAfter));
+    request.setHeader("X-Api-Key", "k2");
+    NEMO_ASSERT(limiter.allow(&request, client.get(), &retryAfter));
+    request.setHeader("X-Api-Key", "k3");
+    NEMO_ASSERT(!limiter.allow(&request, client.get(), &retryAfter));
+    NEMO_ASSERT(1 == retryAfter);
+
+    //不匹配前缀的请求只受按字段限流的规则约束
+    request.setPath("/static/a.js");
+    NEMO_ASSERT(limiter.allow(&request, client.get(), &retryAfter));
+    request.setHeader("X-Api-Key", "k1");
+    NEMO_ASSERT(!limiter.allow(&request, client.get(), &retryAfter));
+    NEMO_LOG_INFO(rootLogger) << "http rate limiter test passed";
+}
+
+/**
+ * @brief 前面的规则通过而后面的规则拒绝时, 退还前面规则的额度
+ */
+void TestRefund() {
+    RateLimitRule byIp;
+    byIp.rate = 1;
+    byIp.burst = 2;
+    RateLimitRule byHeader;
+    byHeader.key = "header:X-Api-Key";
+    byHeader.rate = 1;
+    byHeader.burst = 1;
+    HttpRateLimiter limiter({byIp, byHeader}, 1024);
+
+    Address::UniquePtr client = Address::LookupAnyIPAddress("10.0.0.2:1234");
+    HttpRequest request;
+    request.setPath("/api");
+    request.setHeader("X-Api-Key", "k1");
+    NEMO_ASSERT(limiter.allow(&request, client.get(), nullptr));
+    //k1被第二条规则拒绝, 第一条规则的额度不被占用
+    NEMO_ASSERT(!limiter.allow(&request, client.get(), nullptr));
+    request.setHeader("X-Api-Key", "k2");
+    NEMO_ASSERT(limiter.allow(&request, client.get(), nullptr));
+    request.setHeader("X-Api-Key", "k3");
+    NEMO_ASSERT(!limiter.allow(&request, client.get(), nullptr));
+    NEMO_LOG_INFO(rootLogger) << "http rate limiter refund test passed";
+}
+
+/**
+ * @brief 被拒绝的请求带有消息体时, 发送429后关闭连接, 消息体不会被当作下一个请求
+ */
+void TestServerReject() {
+    RateLimitRule rule;
+    rule.rate = 1;
+    rule.burst = 1;
+    auto scheduler = std::make_shared<coroutine::Scheduler>("limit", 1);
+    HttpServer server(true, scheduler, scheduler, scheduler);
+    server.setRateLimiter(std::make_shared<HttpRateLimiter>(std::vector<RateLimitRule>{rule}, 1024));
+    auto address = IpAddress::Create("127.0.0.1", 18075);
+    NEMO_ASSERT(server.bind(address.get()));
+    NEMO_ASSERT(server.start());
+
+    //在主线程中(不经过hook)发送, 读到超时为止
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    NEMO_ASSERT(::connect(fd, address->getAddr(), address->getAddrLen()) == 0);
+    timeval timeout{1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    String smuggled = "GET /smuggled HTTP/1.1\r\nHost: a\r\n\r\n";
+    String requests = "GET / HTTP/1.1\r\nHost: a\r\n\r\n"
+                      "POST / HTTP/1.1\r\nHost: a\r\nContent-Length: "
+                      + std::to_string(smuggled.size()) + "\r\n\r\n" + smuggled;
+    NEMO_ASSERT(::send(fd, requests.data(), requests.size(), 0) == (ssize_t)requests.size());
+    String response;
+    char buffer[4096];
+    ssize_t n = 0;
+    while((n = ::recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        response.append(buffer, n);
+    }
+    ::close(fd);
+
+    size_t first = response.find("HTTP/1.1 404");
+    size_t second = response.find("HTTP/1.1 429");
+    NEMO_ASSERT(String::npos != first && String::npos != second && first < second);
+    NEMO_ASSERT(String::npos == response.find("HTTP/1.1", second + 1));
+    NEMO_ASSERT(String::npos != response.find("Retry-After: 1", second));
+    server.stop();
+    NEMO_LOG_INFO(rootLogger) << "http server reject test passed";
+}
+
+int main(int argc, char** argv) {
+    TestGcra();
+    TestEvict();
+    TestHttpRateLimiter();
+    TestRefund();
+    TestServerReject();
+    return 0;
+}
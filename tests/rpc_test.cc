@@ -0,0 +1,208 @@
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include <google/protobuf/wrappers.pb.h>
+
+#include "net/rpc/rpc_client.h"
+#include "net/rpc/rpc_server.h"
+#include "coroutine/scheduler.h"
+#include "log/log.h"
+#include "common/config.h"
+#include "common/macro.h"
+
+using namespace nemo;
+using namespace nemo::net::rpc;
+using google::protobuf::StringValue;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+static coroutine::Scheduler scheduler("client", 2);
+static const uint16_t kPort = 18070;
+static const uint32_t kEcho = 1;
+static const uint32_t kSlow = 2;
+static const uint32_t kFail = 3;
+static const uint32_t kNotify = 4;
+static const uint32_t kRawEcho = 5;
+static std::atomic<int> notified{0};
+static std::atomic<bool> done{false};
+
+static void RegisterMethods(RpcServer& server) {
+    server.registerMethod<StringValue, StringValue>(kEcho,
+            [](const StringValue& request, StringValue& response) {
+        response.set_value(request.value());
+        return RpcStatus::OK;
+    });
+    //等待value毫秒, 用来检查同一个连接上的请求乱序完成
+    server.registerMethod<StringValue, StringValue>(kSlow,
+            [](const StringValue& request, StringValue& response) {
+        ::usleep(std::stoi(request.value()) * 1000);
+        response.set_value(request.value());
+        return RpcStatus::OK;
+    });
+    server.registerHandler(kFail, [](StringArg, String&) {
+        return RpcStatus::INTERNAL;
+    });
+    server.registerHandler(kNotify, [](StringArg request, String&) {
+        notified += request.size();
+        return RpcStatus::OK;
+    });
+    server.registerHandler(kRawEcho, [](StringArg request, String& response) {
+        response.assign(request.data(), request.size());
+        return RpcStatus::OK;
+    });
+}
+
+void TestCall(RpcClient& client) {
+    StringValue request;
+    StringValue response;
+    request.set_value("hello");
+    NEMO_ASSERT(client.call(kEcho, request, response) == RpcStatus::OK);
+    NEMO_ASSERT(response.value() == "hello");
+
+    //大于读缓冲区的负载
+    request.set_value(String(1024 * 1024, 'x'));
+    NEMO_ASSERT(client.call(kEcho, request, response) == RpcStatus::OK);
+    NEMO_ASSERT(response.value() == request.value());
+
+    String out;
+    NEMO_ASSERT(client.call(kFail, StringArg(), out) == RpcStatus::INTERNAL);
+    NEMO_ASSERT(client.call(100, StringArg(), out) == RpcStatus::NOT_FOUND);
+    NEMO_ASSERT(client.call(kEcho, StringArg("\xff\xff"), out) == RpcStatus::BAD_REQUEST);
+    NEMO_LOG_INFO(rootLogger) << "rpc call test passed";
+}
+
+void TestMultiplex(RpcClient& client) {
+    //连接池只有一个连接, 慢请求不阻塞之后的请求
+    std::atomic<int> finished{0};
+    std::atomic<int> order{0};
+    std::atomic<int> slowOrder{-1};
+    coroutine::WaitGroup wg(21);
+    scheduler.addTask([&]() {
+        StringValue request;
+        StringValue response;
+        request.set_value("300");
+        NEMO_ASSERT(client.call(kSlow, request, response) == RpcStatus::OK);
+        NEMO_ASSERT(response.value() == "300");
+        slowOrder = order++;
+        ++finished;
+        wg.done();
+    });
+    for(int i = 0; i < 20; ++i) {
+        scheduler.addTask([&, i]() {
+            StringValue request;
+            StringValue response;
+            request.set_value(std::to_string(i));
+            NEMO_ASSERT(client.call(kEcho, request, response) == RpcStatus::OK);
+            NEMO_ASSERT(response.value() == std::to_string(i));
+            ++order;
+            ++finished;
+            wg.done();
+        });
+    }
+    wg.wait();
+    NEMO_ASSERT(finished == 21 && slowOrder == 20);
+    NEMO_LOG_INFO(rootLogger) << "rpc multiplex test passed";
+}
+
+void TestTimeout(RpcClient& client) {
+    StringValue request;
+    StringValue response;
+    request.set_value("300");
+    NEMO_ASSERT(client.call(kSlow, request, response, 50) == RpcStatus::TIMEOUT);
+    //超时的响应到达后被丢弃, 连接仍然可用
+    ::usleep(400 * 1000);
+    request.set_value("after");
+    NEMO_ASSERT(client.call(kEcho, request, response) == RpcStatus::OK);
+    NEMO_ASSERT(response.value() == "after");
+
+    NEMO_ASSERT(client.notify(kNotify, "12345"));
+    for(int i = 0; i < 100 && notified != 5; ++i) {
+        ::usleep(10 * 1000);
+    }
+    NEMO_ASSERT(notified == 5);
+    NEMO_LOG_INFO(rootLogger) << "rpc timeout test passed";
+}
+
+/**
+ * @brief 客户端只发请求不读响应, 服务端积压的响应超过高水位后不再读取请求,
+ *        客户端的发送被TCP窗口阻塞, 服务端不会把所有请求的响应都堆积在内存中
+ */
+void TestBackPressure() {
+    Config::LookupBase("rpc.write_high_water")->fromString("65536");
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int bufferSize = 64 * 1024;
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+    NEMO_ASSERT(::connect(fd, address->getAddr(), address->getAddrLen()) == 0);
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    String frame;
+    RpcHeader header;
+    header.methodId = kRawEcho;
+    AppendRpcFrame(frame, header, String(64 * 1024, 'x'));
+    const size_t total = 128 * 1024 * 1024;
+    size_t sent = 0;
+    //连续500毫秒发不出去时认为服务端已经停止读取
+    for(int stalls = 0; sent < total && stalls < 50;) {
+        size_t offset = sent % frame.size();
+        ssize_t n = ::send(fd, frame.data() + offset, frame.size() - offset, MSG_NOSIGNAL);
+        if(n > 0) {
+            sent += n;
+            stalls = 0;
+        } else {
+            NEMO_ASSERT(EAGAIN == errno);
+            ++stalls;
+            ::usleep(10 * 1000);
+        }
+    }
+    NEMO_LOG_INFO(rootLogger) << "rpc back pressure, sent=" << sent;
+    NEMO_ASSERT(sent < total / 4);
+    ::close(fd);
+    Config::LookupBase("rpc.write_high_water")->fromString("4194304");
+    NEMO_LOG_INFO(rootLogger) << "rpc back pressure test passed";
+}
+
+void TestReconnect(RpcServer& server) {
+    //服务端优雅关闭后连接断开, 之后的调用返回CONNECTION_ERROR
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    RpcClient client(address.get(), 1);
+    StringValue request;
+    StringValue response;
+    request.set_value("drain");
+    NEMO_ASSERT(client.call(kEcho, request, response) == RpcStatus::OK);
+    NEMO_ASSERT(server.drain(1000));
+    NEMO_ASSERT(client.call(kEcho, request, response) == RpcStatus::CONNECTION_ERROR);
+    NEMO_LOG_INFO(rootLogger) << "rpc drain test passed";
+}
+
+int main(int argc, char** argv) {
+    auto serverScheduler = std::make_shared<coroutine::Scheduler>("rpc", 2);
+    RpcServer server(serverScheduler, serverScheduler, serverScheduler);
+    RegisterMethods(server);
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    NEMO_ASSERT(server.bind(address.get()));
+    NEMO_ASSERT(server.start());
+    TestBackPressure();
+
+    scheduler.addTask([&]() {
+        {
+            RpcClient client(address.get(), 1);
+            TestCall(client);
+            TestMultiplex(client);
+            TestTimeout(client);
+        }
+        TestReconnect(server);
+        done = true;
+    });
+    scheduler.threadStart();
+    while(!done) {
+        ::usleep(10 * 1000);
+    }
+    ::usleep(300 * 1000);
+    scheduler.stop();
+    server.stop();
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+
+#include "net/socket.h"
+#include "net/ssl_context.h"
+#include "coroutine/scheduler.h"
+#include "log/log.h"
+#include "common/config.h"
+#include "common/macro.h"
+#include "test_certificate.h"
+
+using namespace nemo;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+static coroutine::Scheduler scheduler("tls", 2);
+static const uint16_t kPort = 18444;
+static const size_t kBigSize = 4 * 1024 * 1024;
+static const size_t kFileSize = 1024 * 1024 + 123;
+static std::atomic<bool> ready{false};
+static std::atomic<bool> done{false};
+static std::atomic<int> records{0};
+static char certFile[] = "/tmp/nemo_tls_cert_XXXXXX";
+static char keyFile[] = "/tmp/nemo_tls_key_XXXXXX";
+static char dataFile[] = "/tmp/nemo_tls_data_XXXXXX";
+
+/**
+ * @brief 生成sendFile发送的文件
+ */
+static void CreateDataFile() {
+    int fd = ::mkstemp(dataFile);
+    String data(kFileSize, '\0');
+    for(size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(i % 253);
+    }
+    NEMO_ASSERT(::write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+    ::close(fd);
+}
+
+/**
+ * @brief 统计客户端收到的应用数据记录数
+ */
+static void MessageCallback(int writeP, int version, int contentType, const void* buf,
+                            size_t len, SSL* ssl, void* arg) {
+    if(!writeP && SSL3_RT_HEADER == contentType && len > 0 &&
+            SSL3_RT_APPLICATION_DATA == static_cast<const unsigned char*>(buf)[0]) {
+        ++records;
+    }
+}
+
+/**
+ * @brief 收到"big"时用1KB的iovec发送4MB数据, 收到"file"时用sendFile发送文件(跳过第一个字节),
+ *        否则原样返回
+ */
+static void HandleClient(net::Socket::SharedPtr client) {
+    client->setRecvTimeout(500);
+    char buffer[4096];
+    while(true) {
+        int n = client->recv(buffer, sizeof(buffer));
+        if(n <= 0) {
+            return;
+        }
+        if(String(buffer, n) == "big") {
+            String data(kBigSize, '\0');
+            for(size_t i = 0; i < data.size(); ++i) {
+                data[i] = static_cast<char>(i % 251);
+            }
+            std::vector<iovec> iov(data.size() / 1024);
+            for(size_t i = 0; i < iov.size(); ++i) {
+                iov[i].iov_base = &data[i * 1024];
+                iov[i].iov_len = 1024;
+            }
+            NEMO_ASSERT(client->send(iov.data(), iov.size()) == static_cast<int>(kBigSize));
+        } else if(String(buffer, n) == "file") {
+            int fd = ::open(dataFile, O_RDONLY);
+            size_t sent = 0;
+            while(sent < kFileSize - 1) {
+                int64_t result = client->sendFile(fd, 1 + sent, kFileSize - 1 - sent);
+                NEMO_ASSERT(result > 0);
+                sent += result;
+            }
+            ::close(fd);
+            NEMO_LOG_INFO(rootLogger) << "ktls send=" << down_cast<net::SecureSocket*>(client.get())->isKtlsSend();
+        } else {
+            NEMO_ASSERT(client->send(buffer, n) == n);
+        }
+    }
+}
+
+void Server() {
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    net::SecureSocket::UniquePtr sock = net::SecureSocket::CreateTcp(address.get());
+    NEMO_ASSERT(sock->bind(address.get()));
+    NEMO_ASSERT(sock->listen());
+    NEMO_ASSERT(sock->loadCertificates(certFile, keyFile));
+    sock->setRecvTimeout(100);
+    ready = true;
+    while(!done) {
+        net::Socket::SharedPtr client = sock->accept();
+        if(client) {
+            scheduler.addTask(std::bind(HandleClient, client));
+        }
+    }
+}
+
+static int64_t ElapsedMillionSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+void TestSecureSocket() {
+    while(!ready) {
+        ::usleep(10 * 1000);
+    }
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+
+    //不发送ClientHello的连接不影响其他连接的握手
+    net::Socket::UniquePtr silent = net::Socket::CreateTcp(address.get());
+    NEMO_ASSERT(silent->connect(address.get()));
+    ::usleep(50 * 1000);
+    auto start = std::chrono::steady_clock::now();
+    net::SecureSocket::UniquePtr client = net::SecureSocket::CreateTcp(address.get());
+    NEMO_ASSERT(client->connect(address.get()));
+    NEMO_ASSERT(client->send("hello", 5) == 5);
+    char buffer[16];
+    NEMO_ASSERT(client->recv(buffer, sizeof(buffer)) == 5 && String(buffer, 5) == "hello");
+    NEMO_ASSERT(ElapsedMillionSeconds(start) < 200);
+    //握手按接收超时结束
+    silent->setRecvTimeout(2000);
+    NEMO_ASSERT(silent->recv(buffer, sizeof(buffer)) == 0);
+    NEMO_ASSERT(ElapsedMillionSeconds(start) < 1000);
+    NEMO_LOG_INFO(rootLogger) << "tls handshake in connection coroutine test passed";
+
+    //iovec合并成16KB的记录, 接收方读得慢时发送方等待可写
+    client->setRecvTimeout(5000);
+    NEMO_ASSERT(client->send("big", 3) == 3);
+    ::usleep(100 * 1000);
+    String data(kBigSize, '\0');
+    size_t received = 0;
+    while(received < kBigSize) {
+        int n = client->recv(&data[received], std::min<size_t>(kBigSize - received, 65536));
+        NEMO_ASSERT(n > 0);
+        received += n;
+    }
+    for(size_t i = 0; i < data.size(); ++i) {
+        NEMO_ASSERT(data[i] == static_cast<char>(i % 251));
+    }
+    //4MB/16KB=256个记录, 另外是hello和TLS 1.3加密的握手消息、会话票据
+    NEMO_LOG_INFO(rootLogger) << "application data records=" << records;
+    NEMO_ASSERT(records <= 256 + 16);
+    NEMO_LOG_INFO(rootLogger) << "tls coalesced write test passed";
+
+    //内核不支持kTLS时回退到读出文件再加密
+    NEMO_ASSERT(client->send("file", 4) == 4);
+    received = 0;
+    while(received < kFileSize - 1) {
+        int n = client->recv(&data[received], kFileSize - 1 - received);
+        NEMO_ASSERT(n > 0);
+        received += n;
+    }
+    for(size_t i = 0; i < kFileSize - 1; ++i) {
+        NEMO_ASSERT(data[i] == static_cast<char>((i + 1) % 253));
+    }
+    NEMO_LOG_INFO(rootLogger) << "tls send file test passed";
+
+    client->close();
+    done = true;
+}
+
+int main(int argc, char** argv) {
+    test::CreateCertificate(certFile, keyFile);
+    CreateDataFile();
+    Config::LookupBase("tls.ktls")->fromString("1");
+    ::SSL_CTX_set_msg_callback(net::SslContextRegistry::GetInstance().getClientContext().get(),
+                               MessageCallback);
+    scheduler.addTask(Server);
+    scheduler.addTask(TestSecureSocket);
+    scheduler.threadStart();
+    while(!done) {
+        ::usleep(10 * 1000);
+    }
+    ::usleep(300 * 1000);
+    scheduler.stop();
+
+    ::unlink(certFile);
+    ::unlink(keyFile);
+    ::unlink(dataFile);
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "container/small_vector.h"
+
+#include "log/log.h"
+#include "common/macro.h"
+
+using namespace nemo;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+
+typedef SmallVector<int, 4> IntVector;
+
+static bool Equals(const IntVector& vec, std::initializer_list<int> expect) {
+    return vec.size() == expect.size() && std::equal(vec.begin(), vec.end(), expect.begin());
+}
+
+void TestInlineAndGrow() {
+    IntVector vec;
+    NEMO_ASSERT(vec.empty() && vec.isInline() && vec.capacity() == 4);
+    for(int i = 0; i < 4; ++i) {
+        vec.push_back(i);
+    }
+    NEMO_ASSERT(vec.isInline());
+    vec.push_back(4);
+    NEMO_ASSERT(!vec.isInline() && vec.capacity() == 8);
+    NEMO_ASSERT(Equals(vec, {0, 1, 2, 3, 4}));
+
+    vec.erase(0);
+    vec.erase(3);
+    NEMO_ASSERT(Equals(vec, {1, 2, 3}));
+    vec.pop_back();
+    NEMO_ASSERT(vec.back() == 2);
+
+    //清空保留已经分配的内存
+    vec.clear();
+    NEMO_ASSERT(vec.empty() && vec.capacity() == 8);
+
+    IntVector reserved;
+    reserved.reserve(100);
+    NEMO_ASSERT(!reserved.isInline() && reserved.capacity() == 100);
+    NEMO_LOG_INFO(rootLogger) << "small vector inline and grow test passed";
+}
+
+void TestCopyAndMove() {
+    IntVector small;
+    small.push_back(1);
+    small.push_back(2);
+    IntVector big;
+    for(int i = 0; i < 10; ++i) {
+        big.push_back(i);
+    }
+
+    IntVector copy(big);
+    NEMO_ASSERT(copy.size() == 10 && copy[9] == 9 && copy.data() != big.data());
+    copy = small;
+    NEMO_ASSERT(Equals(copy, {1, 2}));
+
+    //内联的数据逐个复制, 堆内存直接接管
+    IntVector movedSmall(std::move(small));
+    NEMO_ASSERT(Equals(movedSmall, {1, 2}) && movedSmall.isInline() && small.empty());
+    const int* data = big.data();
+    IntVector movedBig(std::move(big));
+    NEMO_ASSERT(movedBig.data() == data && movedBig.size() == 10);
+    NEMO_ASSERT(big.empty() && big.isInline());
+
+    movedSmall = std::move(movedBig);
+    NEMO_ASSERT(movedSmall.data() == data && movedSmall.size() == 10);
+    movedSmall = std::move(copy);
+    NEMO_ASSERT(Equals(movedSmall, {1, 2}) && copy.empty() && copy.isInline());
+    NEMO_LOG_INFO(rootLogger) << "small vector copy and move test passed";
+}
+
+int main(int argc, char** argv) {
+    TestInlineAndGrow();
+    TestCopyAndMove();
+    return 0;
+}
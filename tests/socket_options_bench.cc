@@ -0,0 +1,138 @@
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+
+#include "net/socket.h"
+#include "net/socket_options.h"
+#include "coroutine/scheduler.h"
+#include "log/log.h"
+#include "common/macro.h"
+
+using namespace nemo;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+static coroutine::Scheduler scheduler("bench", 2);
+static const uint16_t kBasePort = 18090;
+static const size_t kMessageSize = 64;
+static const size_t kBulkBlockSize = 64 * 1024;
+static std::atomic<int> listening{0};
+static std::atomic<bool> done{false};
+
+/**
+ * @brief 第一个字节为'p'时原样返回kMessageSize字节的消息,
+ *        为'b'时读取后面8字节长度的数据后返回一个字节
+ */
+static void HandleClient(net::Socket::SharedPtr client) {
+    String buffer(kBulkBlockSize, '\0');
+    while(true) {
+        char type;
+        if(client->recv(&type, 1, MSG_WAITALL) != 1) {
+            return;
+        }
+        if('p' == type) {
+            if(client->recv(&buffer[0], kMessageSize, MSG_WAITALL) != (int)kMessageSize ||
+                    client->send(buffer.data(), kMessageSize) != (int)kMessageSize) {
+                return;
+            }
+            continue;
+        }
+        uint64_t total = 0;
+        if(client->recv(&total, sizeof(total), MSG_WAITALL) != sizeof(total)) {
+            return;
+        }
+        while(total > 0) {
+            int n = client->recv(&buffer[0], std::min<uint64_t>(total, buffer.size()));
+            if(n <= 0) {
+                return;
+            }
+            total -= n;
+        }
+        client->send("k", 1);
+    }
+}
+
+static void Server(net::SocketOptions options, uint16_t port) {
+    auto address = net::IpAddress::Create("127.0.0.1", port);
+    net::Socket::UniquePtr sock = net::Socket::CreateTcp(address.get());
+    NEMO_ASSERT(sock->bind(address.get()));
+    options.applyToListener(sock.get());
+    NEMO_ASSERT(sock->listen(options.backlog));
+    sock->setRecvTimeout(100);
+    ++listening;
+    while(!done) {
+        net::Socket::SharedPtr client = sock->accept();
+        if(!client) {
+            continue;
+        }
+        options.applyToConnection(client.get());
+        scheduler.addTask(std::bind(HandleClient, client));
+    }
+}
+
+/**
+ * @brief 在主线程中(不经过hook)测试一个预设
+ * @param[in] times 请求/响应的次数
+ * @param[in] bulkBytes 批量发送的字节数
+ */
+static void Bench(const net::SocketOptions& options, uint16_t port, size_t times, uint64_t bulkBytes) {
+    auto address = net::IpAddress::Create("127.0.0.1", port);
+    net::Socket::UniquePtr sock = net::Socket::CreateTcp(address.get());
+    NEMO_ASSERT(sock->connect(address.get()));
+
+    //小消息的往返延迟
+    char message[1 + kMessageSize];
+    message[0] = 'p';
+    auto begin = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < times; ++i) {
+        NEMO_ASSERT(sock->send(message, sizeof(message)) == (int)sizeof(message));
+        NEMO_ASSERT(sock->recv(message + 1, kMessageSize, MSG_WAITALL) == (int)kMessageSize);
+    }
+    std::chrono::duration<double, std::micro> rtt = std::chrono::steady_clock::now() - begin;
+
+    //批量发送的吞吐量
+    char header[1 + sizeof(uint64_t)];
+    header[0] = 'b';
+    memcpy(header + 1, &bulkBytes, sizeof(bulkBytes));
+    String block(kBulkBlockSize, 'x');
+    begin = std::chrono::steady_clock::now();
+    NEMO_ASSERT(sock->send(header, sizeof(header)) == (int)sizeof(header));
+    for(uint64_t sent = 0; sent < bulkBytes; ) {
+        int n = sock->send(block.data(), std::min<uint64_t>(bulkBytes - sent, block.size()));
+        NEMO_ASSERT(n > 0);
+        sent += n;
+    }
+    char ack;
+    NEMO_ASSERT(sock->recv(&ack, 1) == 1);
+    std::chrono::duration<double> bulk = std::chrono::steady_clock::now() - begin;
+    sock->close();
+
+    NEMO_LOG_INFO(rootLogger) << "profile=" << options.profile
+        << " rtt=" << rtt.count() / times << "us"
+        << " throughput=" << bulkBytes / bulk.count() / (1024 * 1024) << "MB/s";
+}
+
+int main(int argc, char** argv) {
+    size_t times = argc > 1 ? std::stoul(argv[1]) : 20000;
+    uint64_t bulkBytes = (argc > 2 ? std::stoul(argv[2]) : 1024) * 1024 * 1024;
+
+    const char* profiles[] = {"default", "latency", "throughput"};
+    std::vector<net::SocketOptions> options(3);
+    for(size_t i = 0; i < options.size(); ++i) {
+        NEMO_ASSERT(net::SocketOptions::Preset(profiles[i], options[i]));
+        scheduler.addTask(std::bind(Server, options[i], kBasePort + i));
+    }
+    scheduler.threadStart();
+    while(listening < 3) {
+        ::usleep(10 * 1000);
+    }
+    for(size_t i = 0; i < options.size(); ++i) {
+        NEMO_LOG_INFO(rootLogger) << options[i].toString();
+        Bench(options[i], kBasePort + i, times / 10, bulkBytes / 10); //预热
+        Bench(options[i], kBasePort + i, times, bulkBytes);
+    }
+    done = true;
+    ::usleep(300 * 1000);
+    scheduler.stop();
+    return 0;
+}
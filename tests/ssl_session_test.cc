@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "net/socket.h"
+#include "net/ssl_context.h"
+#include "coroutine/scheduler.h"
+#include "log/log.h"
+#include "common/config.h"
+#include "common/macro.h"
+#include "test_certificate.h"
+
+using namespace nemo;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+static coroutine::Scheduler scheduler("ssl", 2);
+static const uint16_t kPort = 18443;
+static std::atomic<bool> ready{false};
+static std::atomic<bool> done{false};
+static char certFile[] = "/tmp/nemo_ssl_cert_XXXXXX";
+static char keyFile[] = "/tmp/nemo_ssl_key_XXXXXX";
+
+/**
+ * @brief 握手之后发送"ok", TLS 1.3的会话票据在握手之后发送
+ */
+void Server() {
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    net::SecureSocket::UniquePtr sock = net::SecureSocket::CreateTcp(address.get());
+    NEMO_ASSERT(sock->bind(address.get()));
+    NEMO_ASSERT(sock->listen());
+    NEMO_ASSERT(sock->loadCertificates(certFile, keyFile));
+    sock->setRecvTimeout(100);
+    ready = true;
+    while(!done) {
+        net::Socket::UniquePtr client = sock->accept();
+        if(client) {
+            client->send("ok", 2);
+            char c;
+            client->recv(&c, 1);
+        }
+    }
+}
+
+/**
+ * @brief 建立一个TLS连接
+ * @return 是否复用了会话
+ */
+static bool Connect(StringArg serverName = "localhost") {
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    net::SecureSocket::UniquePtr sock = net::SecureSocket::CreateTcp(address.get());
+    sock->setServerName(serverName);
+    NEMO_ASSERT(sock->connect(address.get()));
+    char buffer[2];
+    NEMO_ASSERT(sock->recv(buffer, sizeof(buffer)) == 2);
+    bool reused = sock->isSessionReused();
+    sock->close();
+    return reused;
+}
+
+void TestSession() {
+    while(!ready) {
+        ::usleep(10 * 1000);
+    }
+
+    //相同证书的socket共享SSL_CTX
+    net::SslContextRegistry& registry = net::SslContextRegistry::GetInstance();
+    auto ctx = registry.getServerContext(certFile, keyFile);
+    NEMO_ASSERT(ctx && ctx == registry.getServerContext(certFile, keyFile));
+    NEMO_ASSERT(!registry.getServerContext("/nonexistent.pem", keyFile));
+    NEMO_ASSERT(registry.getClientContext() == registry.getClientContext());
+    NEMO_LOG_INFO(rootLogger) << "ssl context registry test passed";
+
+    NEMO_ASSERT(!Connect());
+    NEMO_ASSERT(Connect());
+    NEMO_ASSERT(Connect());
+    //会话按主机名分开缓存
+    NEMO_ASSERT(!Connect("example.com"));
+    NEMO_ASSERT(Connect("example.com"));
+    NEMO_LOG_INFO(rootLogger) << "ssl session resumption test passed";
+
+    //密钥轮换后旧票据仍然有效
+    Config::LookupBase("tls.ticket_key_rotation")->fromString("1");
+    ::usleep(1100 * 1000);
+    NEMO_ASSERT(Connect());
+    //超过有效期的密钥被丢弃, 进行完整的握手
+    Config::LookupBase("tls.session_timeout")->fromString("1");
+    ::usleep(2100 * 1000);
+    NEMO_ASSERT(!Connect());
+    NEMO_ASSERT(Connect());
+    NEMO_LOG_INFO(rootLogger) << "ssl ticket key rotation test passed";
+
+    done = true;
+}
+
+int main(int argc, char** argv) {
+    test::CreateCertificate(certFile, keyFile);
+    scheduler.addTask(Server);
+    scheduler.addTask(TestSession);
+    scheduler.threadStart();
+    while(!done) {
+        ::usleep(10 * 1000);
+    }
+    ::usleep(300 * 1000);
+    scheduler.stop();
+
+    ::unlink(certFile);
+    ::unlink(keyFile);
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "net/tcp_server.h"
+#include "log/log.h"
+#include "common/config.h"
+#include "common/macro.h"
+
+using namespace nemo;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+static const uint16_t kPort = 18084;
+
+/**
+ * @brief 回显一次数据后把连接交给reactor等待
+ */
+class ParkServer : public net::TcpServer {
+public:
+    ParkServer(const coroutine::Scheduler::SharedPtr& scheduler)
+        : TcpServer(scheduler, scheduler, scheduler) {
+    }
+
+    size_t getParkedCount() {
+        std::lock_guard<std::mutex> lockGuard(connectionsMutex_);
+        return parked_.size();
+    }
+
+    size_t getConnectionCount() {
+        std::lock_guard<std::mutex> lockGuard(connectionsMutex_);
+        return connections_.size();
+    }
+
+    std::atomic<int> handled{0};
+
+protected:
+    void handleClient(net::Socket::SharedPtr client) override {
+        ConnectionPtr connection = getConnection(client.get());
+        char buffer[256];
+        int n = client->recv(buffer, sizeof(buffer));
+        if(n <= 0 || client->send(buffer, n) != n) {
+            return;
+        }
+        ++handled;
+        connection->parkOnReturn = canPark();
+    }
+};
+
+/**
+ * @brief 在主线程中(不经过hook)连接服务器
+ */
+static int Connect() {
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    NEMO_ASSERT(::connect(fd, address->getAddr(), address->getAddrLen()) == 0);
+    struct timeval tv = {4, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+static void Echo(int fd, StringArg data) {
+    NEMO_ASSERT(::send(fd, data.data(), data.size(), 0) == (ssize_t)data.size());
+    char buffer[256];
+    ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+    NEMO_ASSERT(n == (ssize_t)data.size() && StringArg(buffer, n) == data);
+}
+
+/**
+ * @brief 等待条件成立, 最多等待timeout毫秒
+ */
+template<class Predicate>
+static bool WaitFor(Predicate&& predicate, int timeout = 1000) {
+    for(int i = 0; i < timeout / 10 && !predicate(); ++i) {
+        ::usleep(10 * 1000);
+    }
+    return predicate();
+}
+
+static bool IsClosed(int fd) {
+    char buffer[16];
+    return ::recv(fd, buffer, sizeof(buffer), 0) == 0;
+}
+
+/**
+ * @brief 空闲连接交给reactor等待, 收到数据后重新启动处理协程
+ */
+void TestPark(ParkServer& server, int a) {
+    Echo(a, "first");
+    NEMO_ASSERT(WaitFor([&]() { return server.getParkedCount() == 1; }));
+    Echo(a, "second");
+    NEMO_ASSERT(WaitFor([&]() { return server.getParkedCount() == 1; }));
+    //b和c已经连接, 还在处理协程中等待第一个请求
+    NEMO_ASSERT(server.handled == 2 && server.getConnectionCount() == 3);
+    NEMO_LOG_INFO(rootLogger) << "tcp server park test passed";
+}
+
+/**
+ * @brief 空闲连接数超过max_idle_connections时最早进入等待的连接被关闭
+ */
+void TestEvict(ParkServer& server, int a, int b, int c) {
+    Echo(b, "b");
+    NEMO_ASSERT(WaitFor([&]() { return server.getParkedCount() == 2; }));
+    Echo(c, "c");
+    NEMO_ASSERT(IsClosed(a));
+    NEMO_ASSERT(WaitFor([&]() { return server.getConnectionCount() == 2; }));
+    NEMO_ASSERT(server.getParkedCount() == 2);
+    //b重新进入等待后排在c之后, 连接数没有超过限制
+    Echo(b, "b again");
+    NEMO_ASSERT(WaitFor([&]() { return server.getParkedCount() == 2; }));
+    NEMO_ASSERT(server.getConnectionCount() == 2);
+    NEMO_LOG_INFO(rootLogger) << "tcp server max idle eviction test passed";
+}
+
+/**
+ * @brief 等待超过idle_timeout的连接被定期关闭
+ */
+void TestSweep(ParkServer& server, int b, int c) {
+    NEMO_ASSERT(IsClosed(c));
+    NEMO_ASSERT(IsClosed(b));
+    NEMO_ASSERT(WaitFor([&]() { return server.getConnectionCount() == 0; }));
+    NEMO_ASSERT(server.getParkedCount() == 0);
+    NEMO_LOG_INFO(rootLogger) << "tcp server idle sweep test passed";
+}
+
+int main(int argc, char** argv) {
+    Config::LookupBase("tcp_server.park_idle")->fromString("1");
+    Config::LookupBase("tcp_server.idle_timeout")->fromString("2000");
+    Config::LookupBase("tcp_server.max_idle_connections")->fromString("2");
+
+    auto scheduler = std::make_shared<coroutine::Scheduler>("park", 2);
+    ParkServer server(scheduler);
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    NEMO_ASSERT(server.bind(address.get()));
+    NEMO_ASSERT(server.start());
+
+    int a = Connect();
+    int b = Connect();
+    int c = Connect();
+    TestPark(server, a);
+    TestEvict(server, a, b, c);
+    TestSweep(server, b, c);
+
+    ::close(a);
+    ::close(b);
+    ::close(c);
+    server.stop();
+    return 0;
+}
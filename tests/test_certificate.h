@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+namespace nemo {
+namespace test {
+
+/**
+ * @brief 生成CN为localhost的自签名证书, 有效期1小时
+ * @param[in,out] certFile mkstemp的文件名模板, 返回证书文件名
+ * @param[in,out] keyFile mkstemp的文件名模板, 返回私钥文件名
+ */
+inline void CreateCertificate(char* certFile, char* keyFile) {
+    ::close(::mkstemp(certFile));
+    ::close(::mkstemp(keyFile));
+    EVP_PKEY* key = ::EVP_EC_gen("P-256");
+    X509* cert = ::X509_new();
+    ::ASN1_INTEGER_set(::X509_get_serialNumber(cert), 1);
+    ::X509_gmtime_adj(::X509_getm_notBefore(cert), 0);
+    ::X509_gmtime_adj(::X509_getm_notAfter(cert), 3600);
+    ::X509_set_pubkey(cert, key);
+    X509_NAME* name = ::X509_get_subject_name(cert);
+    ::X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                 reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+    ::X509_set_issuer_name(cert, name);
+    ::X509_sign(cert, key, ::EVP_sha256());
+
+    FILE* fp = ::fopen(certFile, "w");
+    ::PEM_write_X509(fp, cert);
+    ::fclose(fp);
+    fp = ::fopen(keyFile, "w");
+    ::PEM_write_PrivateKey(fp, key, nullptr, nullptr, 0, nullptr, nullptr);
+    ::fclose(fp);
+    ::X509_free(cert);
+    ::EVP_PKEY_free(key);
+}
+
+} // namespace test
+} // namespace nemo
@@ -0,0 +1,139 @@
+#include <netinet/udp.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <vector>
+
+#include "net/udp_server.h"
+#include "log/log.h"
+#include "common/config.h"
+#include "common/macro.h"
+
+using namespace nemo;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+static const uint16_t kPort = 18053;
+static const size_t kDatagramSize = 100;
+static std::atomic<size_t> maxBatch{0};
+static std::atomic<size_t> received{0};
+static std::atomic<size_t> lastBatch{0};
+
+/**
+ * @brief 原样返回每个数据报
+ */
+class EchoServer : public net::UdpServer {
+public:
+    using net::UdpServer::UdpServer;
+
+protected:
+    void handleBatch(Batch& batch) override {
+        size_t size = batch.size();
+        size_t current = maxBatch;
+        while(size > current && !maxBatch.compare_exchange_weak(current, size)) {
+        }
+        received += size;
+        lastBatch = size;
+        for(const net::Datagram& datagram : batch) {
+            NEMO_ASSERT(batch.reply(datagram, datagram.data, datagram.size));
+        }
+    }
+};
+
+/**
+ * @brief 接收count个数据报, 检查内容与发送的一致
+ */
+static void RecvReplies(int fd, size_t count, size_t size = kDatagramSize) {
+    char buffer[2048];
+    for(size_t i = 0; i < count; ++i) {
+        ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        NEMO_ASSERT(n == static_cast<ssize_t>(size));
+        NEMO_ASSERT(buffer[0] == buffer[size - 1]);
+    }
+}
+
+void TestBatch(int fd, const sockaddr_in& server) {
+    //连续发送的数据报由recvmmsg一次收到多个
+    char buffer[kDatagramSize];
+    for(size_t i = 0; i < 64; ++i) {
+        ::memset(buffer, 'a' + i % 26, sizeof(buffer));
+        NEMO_ASSERT(::sendto(fd, buffer, sizeof(buffer), 0,
+            reinterpret_cast<const sockaddr*>(&server), sizeof(server)) == sizeof(buffer));
+    }
+    RecvReplies(fd, 64);
+    NEMO_LOG_INFO(rootLogger) << "max batch=" << maxBatch;
+    NEMO_ASSERT(maxBatch > 1);
+    NEMO_LOG_INFO(rootLogger) << "udp batch test passed";
+}
+
+/**
+ * @brief 用UDP_SEGMENT一次发送10个size字节的数据报
+ */
+static void SendSegments(int fd, const sockaddr_in& server, size_t size) {
+    std::vector<char> buffer(size * 10);
+    for(size_t i = 0; i < 10; ++i) {
+        ::memset(buffer.data() + i * size, '0' + i, size);
+    }
+    iovec iov = {buffer.data(), buffer.size()};
+    char control[CMSG_SPACE(sizeof(uint16_t))] = {0};
+    msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_name = const_cast<sockaddr_in*>(&server);
+    msg.msg_namelen = sizeof(server);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t segmentSize = size;
+    ::memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+    NEMO_ASSERT(::sendmsg(fd, &msg, 0) == static_cast<ssize_t>(buffer.size()));
+}
+
+void TestSegmentation(EchoServer& echo, int fd, const sockaddr_in& server) {
+    //客户端用UDP_SEGMENT发送10个数据报, 开启GRO的服务端一次收到, 拆开后分别回复;
+    //回复合并成一个GSO消息, 没有开启GRO的客户端收到10个数据报
+    size_t before = received;
+    SendSegments(fd, server, kDatagramSize);
+    RecvReplies(fd, 10);
+    NEMO_ASSERT(received - before == 10);
+    NEMO_ASSERT(lastBatch == 10 && echo.isGroEnabled() && echo.isGsoEnabled());
+
+    //段长超过MTU(1500)减去头部的回复不合并, 逐个发送, GSO保持开启
+    before = received;
+    SendSegments(fd, server, 1600);
+    RecvReplies(fd, 10, 1600);
+    NEMO_ASSERT(received - before == 10 && echo.isGsoEnabled());
+    NEMO_LOG_INFO(rootLogger) << "udp gro/gso test passed";
+}
+
+int main(int argc, char** argv) {
+    Config::LookupBase("udp_server.sockets_per_address")->fromString("2");
+    auto scheduler = std::make_shared<coroutine::Scheduler>("udp", 2);
+    EchoServer server(scheduler);
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    NEMO_ASSERT(server.bind(address.get()));
+    NEMO_ASSERT(server.getSockets().size() == 2);
+    NEMO_ASSERT(server.start());
+    NEMO_LOG_INFO(rootLogger) << server.toString("");
+
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    timeval timeout = {5, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    sockaddr_in serverAddr;
+    ::memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(kPort);
+    serverAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::usleep(100 * 1000);
+
+    TestBatch(fd, serverAddr);
+    TestSegmentation(server, fd, serverAddr);
+
+    ::close(fd);
+    server.stop();
+    return 0;
+}
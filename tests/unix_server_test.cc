@@ -0,0 +1,112 @@
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "net/http/http_server.h"
+#include "log/log.h"
+#include "common/macro.h"
+
+using namespace nemo;
+
+static Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+static const char* kPath = "/tmp/nemo_unix_server_test.sock";
+static const char* kAbstract = "unix:@nemo_unix_server_test";
+
+void TestParse() {
+    auto path = net::UnixAddress::Parse(String("unix:") + kPath);
+    NEMO_ASSERT(path && !path->isAbstract() && path->getPath() == kPath);
+    auto abstract = net::UnixAddress::Parse(kAbstract);
+    NEMO_ASSERT(abstract && abstract->isAbstract());
+    NEMO_ASSERT(abstract->getAddrLen() == offsetof(sockaddr_un, sun_path) + 1 + ::strlen("nemo_unix_server_test"));
+    NEMO_ASSERT(!net::UnixAddress::Parse("unix:"));
+    NEMO_ASSERT(!net::UnixAddress::Parse("unix:@"));
+    NEMO_ASSERT(!net::UnixAddress::Parse(kPath));
+    NEMO_ASSERT(!net::UnixAddress::Parse("127.0.0.1:80"));
+    NEMO_ASSERT(!net::UnixAddress::Parse("unix:/" + String(200, 'x')));
+    //文件路径最长107字节(加上结尾的'\0'), 抽象名字最长107字节(加上开头的'\0')
+    NEMO_ASSERT(net::UnixAddress::Parse("unix:/" + String(106, 'x')));
+    NEMO_ASSERT(!net::UnixAddress::Parse("unix:/" + String(107, 'x')));
+    auto longest = net::UnixAddress::Parse("unix:@" + String(107, 'x'));
+    NEMO_ASSERT(longest && longest->isAbstract());
+    NEMO_ASSERT(longest->getAddrLen() == sizeof(sockaddr_un));
+    NEMO_ASSERT(!net::UnixAddress::Parse("unix:@" + String(108, 'x')));
+    NEMO_LOG_INFO(rootLogger) << "unix address parse test passed";
+}
+
+/**
+ * @brief 留下一个没有进程监听的socket文件, 模拟异常退出的进程
+ */
+static void LeaveStaleSocket(const net::Address* address) {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    NEMO_ASSERT(::bind(fd, address->getAddr(), address->getAddrLen()) == 0);
+    ::close(fd);
+    struct stat st;
+    NEMO_ASSERT(::lstat(kPath, &st) == 0 && S_ISSOCK(st.st_mode));
+}
+
+/**
+ * @brief 在主线程中(不经过hook)发送请求, 返回响应的消息体
+ */
+static String Request(const net::Address* address) {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    NEMO_ASSERT(::connect(fd, address->getAddr(), address->getAddrLen()) == 0);
+    String request = "GET /whoami HTTP/1.1\r\nHost: local\r\n\r\n";
+    NEMO_ASSERT(::send(fd, request.data(), request.size(), 0) == (ssize_t)request.size());
+    //按Content-Length读取, 不依赖服务端关闭连接
+    String response;
+    char buffer[4096];
+    size_t pos = String::npos;
+    size_t length = 0;
+    while(String::npos == pos || response.size() < pos + 4 + length) {
+        ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        NEMO_ASSERT(n > 0);
+        response.append(buffer, n);
+        if(String::npos == pos && String::npos != (pos = response.find("\r\n\r\n"))) {
+            size_t field = response.find("content-length: ");
+            NEMO_ASSERT(String::npos != field);
+            length = std::stoul(response.substr(field + 16));
+        }
+    }
+    ::close(fd);
+    NEMO_ASSERT(response.starts_with("HTTP/1.1 200"));
+    return response.substr(pos + 4);
+}
+
+int main(int argc, char** argv) {
+    TestParse();
+
+    auto path = net::UnixAddress::Parse(String("unix:") + kPath);
+    auto abstract = net::UnixAddress::Parse(kAbstract);
+    auto longest = net::UnixAddress::Parse("unix:@nemo_unix_server_test" + String(107 - 21, 'x'));
+    ::unlink(kPath);
+    LeaveStaleSocket(path.get());
+
+    auto scheduler = std::make_shared<coroutine::Scheduler>("unix", 2);
+    net::http::HttpServer server(true, scheduler, scheduler, scheduler);
+    NEMO_ASSERT(server.bind(path.get()));
+    NEMO_ASSERT(server.bind(abstract.get()));
+    NEMO_ASSERT(server.bind(longest.get()));
+    server.getServletDispatcher()->addServlet("/whoami", [](net::http::HttpRequest* request,
+                net::http::HttpResponse* response,
+                net::http::HttpSession* session) {
+        const net::PeerCredentials* credentials = request->getPeerCredentials();
+        if(credentials) {
+            response->setBody(std::to_string(credentials->pid) + " " + std::to_string(credentials->uid));
+        } else {
+            response->setBody(String("none"));
+        }
+        return 0;
+    });
+    NEMO_ASSERT(server.start());
+    NEMO_LOG_INFO(rootLogger) << server.toString("");
+
+    String expect = std::to_string(::getpid()) + " " + std::to_string(::getuid());
+    NEMO_ASSERT(Request(path.get()) == expect);
+    NEMO_ASSERT(Request(abstract.get()) == expect);
+    NEMO_ASSERT(Request(longest.get()) == expect);
+    NEMO_LOG_INFO(rootLogger) << "unix listener peer credentials test passed";
+
+    server.stop();
+    ::unlink(kPath);
+    return 0;
+}
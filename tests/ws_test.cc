@@ -0,0 +1,325 @@
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "net/http/http_server.h"
+#include "net/http/ws_servlet.h"
+#include "net/http/ws_session.h"
+#include "log/log.h"
+#include "common/macro.h"
+
+using namespace nemo;
+using namespace nemo::net::http;
+
+static nemo::Logger::SharedPtr rootLogger = NEMO_LOG_NAME("root");
+static const uint16_t kPort = 18079;
+
+/**
+ * @brief RFC 6455 1.3中的握手示例
+ */
+void TestAcceptKey() {
+    NEMO_ASSERT(WsSession::AcceptKey("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+    NEMO_LOG_INFO(rootLogger) << "websocket accept key test passed";
+}
+
+/**
+ * @brief 各种长度下SIMD/逐字节掩码的结果一致, 两次掩码还原数据
+ */
+void TestMask() {
+    const uint8_t key[4] = {0x37, 0xfa, 0x21, 0x3d};
+    for(size_t len = 0; len < 100; ++len) {
+        String data;
+        for(size_t i = 0; i < len; ++i) {
+            data.push_back(static_cast<char>(i * 7));
+        }
+        String masked = data;
+        WsMask(masked.data(), masked.size(), key);
+        for(size_t i = 0; i < len; ++i) {
+            NEMO_ASSERT(static_cast<uint8_t>(masked[i]) == (static_cast<uint8_t>(data[i]) ^ key[i % 4]));
+        }
+        WsMask(masked.data(), masked.size(), key);
+        NEMO_ASSERT(masked == data);
+    }
+    NEMO_LOG_INFO(rootLogger) << "websocket mask test passed";
+}
+
+/**
+ * @brief permessage-deflate参数协商(RFC 7692), 总是要求客户端不保留压缩上下文
+ */
+void TestNegotiateDeflate() {
+    String accepted;
+    int serverBits = 0;
+
+    WsSession::NegotiateDeflate("x-webkit-deflate-frame", accepted, serverBits);
+    NEMO_ASSERT(accepted.empty());
+
+    WsSession::NegotiateDeflate("permessage-deflate", accepted, serverBits);
+    NEMO_ASSERT(accepted == "permessage-deflate; server_no_context_takeover; client_no_context_takeover");
+    NEMO_ASSERT(serverBits == 15);
+
+    //第一个offer的参数不合法, 接受第二个
+    WsSession::NegotiateDeflate("permessage-deflate; server_max_window_bits=8, "
+                                "permessage-deflate; client_no_context_takeover; "
+                                "client_max_window_bits=\"10\"; server_max_window_bits=12",
+                                accepted, serverBits);
+    NEMO_ASSERT(accepted == "permessage-deflate; server_no_context_takeover; "
+                            "server_max_window_bits=12; client_no_context_takeover");
+    NEMO_ASSERT(serverBits == 12);
+
+    WsSession::NegotiateDeflate("permessage-deflate; client_max_window_bits=7", accepted, serverBits);
+    NEMO_ASSERT(accepted.empty());
+    WsSession::NegotiateDeflate("permessage-deflate; foo", accepted, serverBits);
+    NEMO_ASSERT(accepted.empty());
+    NEMO_LOG_INFO(rootLogger) << "websocket negotiate deflate test passed";
+}
+
+/**
+ * @brief 在主线程中(不经过hook)完成握手, 读超时1秒
+ * @param[out] extensions 响应中的Sec-WebSocket-Extensions
+ */
+static int Connect(StringArg offer, String& extensions) {
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    NEMO_ASSERT(::connect(fd, address->getAddr(), address->getAddrLen()) == 0);
+    struct timeval tv = {1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    String request = "GET /ws HTTP/1.1\r\nHost: local\r\n"
+                     "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                     "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                     "Sec-WebSocket-Version: 13\r\n";
+    if(!offer.empty()) {
+        request.append("Sec-WebSocket-Extensions: ").append(offer).append("\r\n");
+    }
+    request.append("\r\n");
+    NEMO_ASSERT(::send(fd, request.data(), request.size(), 0) == (ssize_t)request.size());
+    //逐字节读取, 不读走握手之后的帧
+    String response;
+    char c;
+    while(!response.ends_with("\r\n\r\n")) {
+        NEMO_ASSERT(::recv(fd, &c, 1, 0) == 1);
+        response.push_back(c);
+    }
+    NEMO_ASSERT(response.starts_with("HTTP/1.1 101"));
+    extensions.clear();
+    size_t pos = response.find("Sec-WebSocket-Extensions: ");
+    if(String::npos != pos) {
+        pos += 26;
+        extensions = response.substr(pos, response.find("\r\n", pos) - pos);
+    }
+    return fd;
+}
+
+/**
+ * @brief 发送一个带掩码的客户端帧
+ */
+static void SendFrame(int fd, WsOpcode opcode, StringArg payload, bool fin = true, bool rsv1 = false) {
+    const uint8_t key[4] = {0x12, 0x34, 0x56, 0x78};
+    String frame;
+    frame.push_back((fin ? 0x80 : 0) | (rsv1 ? 0x40 : 0) | static_cast<uint8_t>(opcode));
+    if(payload.size() < 126) {
+        frame.push_back(0x80 | payload.size());
+    } else {
+        NEMO_ASSERT(payload.size() <= 0xffff);
+        frame.push_back(0x80 | 126);
+        frame.push_back(payload.size() >> 8);
+        frame.push_back(payload.size() & 0xff);
+    }
+    frame.append(reinterpret_cast<const char*>(key), 4);
+    size_t offset = frame.size();
+    frame.append(payload);
+    WsMask(&frame[offset], payload.size(), key);
+    NEMO_ASSERT(::send(fd, frame.data(), frame.size(), 0) == (ssize_t)frame.size());
+}
+
+static void RecvAll(int fd, char* data, size_t len) {
+    while(len > 0) {
+        ssize_t n = ::recv(fd, data, len, 0);
+        NEMO_ASSERT(n > 0);
+        data += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief 读取一个服务端帧, 服务端的帧不带掩码
+ */
+static WsOpcode RecvFrame(int fd, String& payload, bool* rsv1 = nullptr) {
+    uint8_t header[2];
+    RecvAll(fd, reinterpret_cast<char*>(header), 2);
+    NEMO_ASSERT(header[0] & 0x80);
+    uint64_t length = header[1] & 0x7f;
+    if(126 == length) {
+        uint8_t ext[2];
+        RecvAll(fd, reinterpret_cast<char*>(ext), 2);
+        length = (ext[0] << 8) | ext[1];
+    } else {
+        NEMO_ASSERT(length < 126);
+    }
+    payload.resize(length);
+    RecvAll(fd, payload.data(), length);
+    if(rsv1) {
+        *rsv1 = header[0] & 0x40;
+    }
+    return static_cast<WsOpcode>(header[0] & 0x0f);
+}
+
+/**
+ * @brief 读取CLOSE帧并返回状态码
+ */
+static uint16_t RecvClose(int fd) {
+    String payload;
+    NEMO_ASSERT(RecvFrame(fd, payload) == WsOpcode::CLOSE && payload.size() >= 2);
+    return (static_cast<uint8_t>(payload[0]) << 8) | static_cast<uint8_t>(payload[1]);
+}
+
+/**
+ * @brief 使用raw deflate压缩并去掉Z_SYNC_FLUSH的尾部(RFC 7692 7.2.1)
+ */
+static String Compress(StringArg data) {
+    z_stream zs;
+    ::memset(&zs, 0, sizeof(zs));
+    NEMO_ASSERT(::deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    String out(::deflateBound(&zs, data.size()) + 16, '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = data.size();
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = out.size();
+    NEMO_ASSERT(::deflate(&zs, Z_SYNC_FLUSH) == Z_OK);
+    out.resize(out.size() - zs.avail_out - 4);
+    ::deflateEnd(&zs);
+    return out;
+}
+
+static String Decompress(StringArg data) {
+    String in(data);
+    in.append("\x00\x00\xff\xff", 4);
+    z_stream zs;
+    ::memset(&zs, 0, sizeof(zs));
+    NEMO_ASSERT(::inflateInit2(&zs, -15) == Z_OK);
+    String out(64 * 1024, '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(in.data());
+    zs.avail_in = in.size();
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = out.size();
+    int rt = ::inflate(&zs, Z_SYNC_FLUSH);
+    NEMO_ASSERT(Z_OK == rt || Z_STREAM_END == rt);
+    out.resize(out.size() - zs.avail_out);
+    ::inflateEnd(&zs);
+    return out;
+}
+
+/**
+ * @brief 分片消息按顺序拼接, 分片之间的PING立即得到回复, 多字节字符可以跨分片
+ */
+void TestFragmentation() {
+    String extensions;
+    int fd = Connect(StringArg(), extensions);
+    NEMO_ASSERT(extensions.empty());
+
+    //"héllo": é(0xc3 0xa9)拆在两个分片中
+    SendFrame(fd, WsOpcode::TEXT, "h\xc3", false);
+    SendFrame(fd, WsOpcode::PING, "probe");
+    SendFrame(fd, WsOpcode::CONTINUATION, "\xa9l", false);
+    SendFrame(fd, WsOpcode::PONG, "");
+    SendFrame(fd, WsOpcode::CONTINUATION, "lo", true);
+
+    String payload;
+    NEMO_ASSERT(RecvFrame(fd, payload) == WsOpcode::PONG && payload == "probe");
+    NEMO_ASSERT(RecvFrame(fd, payload) == WsOpcode::TEXT && payload == "h\xc3\xa9llo");
+
+    //没有开始的分片消息不能有CONTINUATION, 控制帧不能分片
+    SendFrame(fd, WsOpcode::CONTINUATION, "x");
+    NEMO_ASSERT(RecvClose(fd) == WsCloseCode::PROTOCOL_ERROR);
+    ::close(fd);
+
+    fd = Connect(StringArg(), extensions);
+    SendFrame(fd, WsOpcode::TEXT, "a", false);
+    SendFrame(fd, WsOpcode::PING, "", false);
+    NEMO_ASSERT(RecvClose(fd) == WsCloseCode::PROTOCOL_ERROR);
+    ::close(fd);
+    NEMO_LOG_INFO(rootLogger) << "websocket fragmentation test passed";
+}
+
+/**
+ * @brief 压缩的消息解压后回显, 服务端的回复同样压缩; 分片的压缩消息在最后一个分片之后解压
+ */
+void TestDeflateRoundTrip() {
+    String extensions;
+    int fd = Connect("permessage-deflate; client_max_window_bits", extensions);
+    NEMO_ASSERT(extensions == "permessage-deflate; server_no_context_takeover; client_no_context_takeover");
+
+    String text;
+    for(int i = 0; i < 100; ++i) {
+        text.append("websocket deflate round trip ").append(std::to_string(i)).append("\n");
+    }
+    //每条消息独立压缩, 连续两条消息使用相同的压缩结果
+    String compressed = Compress(text);
+    for(int i = 0; i < 2; ++i) {
+        SendFrame(fd, WsOpcode::TEXT, compressed, true, true);
+        String payload;
+        bool rsv1 = false;
+        NEMO_ASSERT(RecvFrame(fd, payload, &rsv1) == WsOpcode::TEXT && rsv1);
+        NEMO_ASSERT(Decompress(payload) == text);
+    }
+
+    size_t half = compressed.size() / 2;
+    SendFrame(fd, WsOpcode::BINARY, StringArg(compressed).substr(0, half), false, true);
+    SendFrame(fd, WsOpcode::PING, "mid");
+    SendFrame(fd, WsOpcode::CONTINUATION, StringArg(compressed).substr(half), true);
+    String payload;
+    bool rsv1 = false;
+    NEMO_ASSERT(RecvFrame(fd, payload) == WsOpcode::PONG && payload == "mid");
+    NEMO_ASSERT(RecvFrame(fd, payload, &rsv1) == WsOpcode::BINARY && rsv1);
+    NEMO_ASSERT(Decompress(payload) == text);
+
+    //短消息不压缩
+    SendFrame(fd, WsOpcode::TEXT, Compress("short"), true, true);
+    NEMO_ASSERT(RecvFrame(fd, payload, &rsv1) == WsOpcode::TEXT && !rsv1 && payload == "short");
+    ::close(fd);
+    NEMO_LOG_INFO(rootLogger) << "websocket deflate round trip test passed";
+}
+
+/**
+ * @brief 文本消息不是合法的UTF-8时以1007关闭, 二进制消息不检查
+ */
+void TestInvalidUtf8() {
+    String extensions;
+    int fd = Connect(StringArg(), extensions);
+    SendFrame(fd, WsOpcode::BINARY, "\xff\xfe");
+    String payload;
+    NEMO_ASSERT(RecvFrame(fd, payload) == WsOpcode::BINARY && payload == "\xff\xfe");
+    //代理区码点U+D800
+    SendFrame(fd, WsOpcode::TEXT, "0123456789\xed\xa0\x80");
+    NEMO_ASSERT(RecvClose(fd) == WsCloseCode::INVALID_PAYLOAD);
+    ::close(fd);
+
+    const char* invalid[] = {"\xc0\xaf", "\xe0\x80\xaf", "\xf4\x90\x80\x80", "abc\xe2\x82", "\x80"};
+    for(const char* text : invalid) {
+        fd = Connect(StringArg(), extensions);
+        SendFrame(fd, WsOpcode::TEXT, text);
+        NEMO_ASSERT(RecvClose(fd) == WsCloseCode::INVALID_PAYLOAD);
+        ::close(fd);
+    }
+    NEMO_LOG_INFO(rootLogger) << "websocket utf-8 test passed";
+}
+
+int main(int argc, char** argv) {
+    TestAcceptKey();
+    TestMask();
+    TestNegotiateDeflate();
+
+    auto scheduler = std::make_shared<coroutine::Scheduler>("ws", 2);
+    HttpServer server(true, scheduler, scheduler, scheduler);
+    auto address = net::IpAddress::Create("127.0.0.1", kPort);
+    NEMO_ASSERT(server.bind(address.get()));
+    server.getServletDispatcher()->addServlet("/ws", std::make_unique<FunctionWsServlet>(
+            [](HttpRequest*, WsMessage* message, WsSession* ws) {
+        return ws->sendMessage(message) < 0 ? -1 : 0;
+    }));
+    NEMO_ASSERT(server.start());
+    TestFragmentation();
+    TestDeflateRoundTrip();
+    TestInvalidUtf8();
+    server.stop();
+    return 0;
+}